@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * analysis.c - Analysis of the audio as it is extracted.  The checksum,
+ *              peak and loudness analyses share one kernel, which makes a
+ *              single pass over each buffer while it's still in the cache,
+ *              rather than one pass per analysis.  Silence gets a vector
+ *              scan of its own.  The loudness meter lives in loudness.c.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "checksum.h"
+#include "loudness.h"
+#include "analysis.h"
+
+
+/*========================================================================*/
+int
+fnAnalysis_ParseFlags(char *szAnalyses)
+/*
+ * Convert a comma separated list of analysis names into analysis flags.
+ *
+ *   Input:  szAnalyses - The list, ie "peak,silence", or "all".
+ * Returns:  The analysis flags, or -1 if a name is not recognised.
+ */
+/*========================================================================*/
+{
+  char *szList,					/* Copy of the list          */
+       *pList,					/* Current position          */
+       *szName;					/* Current name              */
+  int  iFlags = 0;				/* Flags gathered            */
+
+
+  if (! (szList = strdup(szAnalyses)))  return -1;
+
+  for (pList = szList; (szName = strsep(&pList, ",")) != NULL; ) {
+    if (strcmp(szName, "checksum") == 0)       iFlags |= kiAnalysis_Checksum;
+    else if (strcmp(szName, "peak") == 0)      iFlags |= kiAnalysis_Peak;
+    else if (strcmp(szName, "silence") == 0)   iFlags |= kiAnalysis_Silence;
+    else if (strcmp(szName, "loudness") == 0)  iFlags |= kiAnalysis_Loudness;
+    else if (strcmp(szName, "all") == 0)       iFlags |= kiAnalysis_All;
+    else {
+      free(szList);
+      return -1;
+    }
+  }
+
+  free(szList);
+  return iFlags;
+}
+
+
+/*========================================================================*/
+void
+fnAnalysis_Initialize(struct AudioAnalysis_t *pstAnalysis, int iFlags)
+/*
+ * Reset the analysis results before a track is extracted.
+ *
+ *   Input:  pstAnalysis - The analysis structure.
+ *           iFlags      - Analyses to enable (kiAnalysis_*).
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  int iSilenceThreshold;			/* Preserved threshold       */
+
+
+  iSilenceThreshold = pstAnalysis->iSilenceThreshold;
+
+  fnAnalysis_Dispose(pstAnalysis);
+  memset(pstAnalysis, 0, sizeof(struct AudioAnalysis_t));
+
+  pstAnalysis->iFlags            = iFlags;
+  pstAnalysis->iSilenceThreshold = iSilenceThreshold;
+
+  if (iFlags & kiAnalysis_Loudness)
+    fnLoudness_Initialize(&pstAnalysis->stLoudness, CDDA_SAMPLE_RATE);
+}
+
+
+/*========================================================================*/
+int
+fnAnalysis_AppendSpan(struct AudioAnalysis_t *pstAnalysis, u_long lStart, u_long lLength)
+/*
+ * Record a run of silence.
+ *
+ *   Input:  pstAnalysis - The analysis structure.
+ *           lStart      - First silent frame.
+ *           lLength     - Number of silent frames.
+ *
+ * Returns:  -1 on memory allocation error, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct SilenceSpan_t *pstResized;		/* Spans after realloc()     */
+
+
+  if (pstAnalysis->iSpans == pstAnalysis->iSpansAllocated) {
+    if (! (pstResized = (struct SilenceSpan_t *) realloc(pstAnalysis->pstSpans,
+                        (pstAnalysis->iSpansAllocated + 16) * sizeof(struct SilenceSpan_t))))
+      return -1;
+
+    pstAnalysis->pstSpans         = pstResized;
+    pstAnalysis->iSpansAllocated += 16;
+  }
+
+  pstAnalysis->pstSpans[pstAnalysis->iSpans].lStart  = lStart;
+  pstAnalysis->pstSpans[pstAnalysis->iSpans].lLength = lLength;
+  pstAnalysis->iSpans++;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnAnalysis_ScanSilence(struct AudioAnalysis_t *pstAnalysis, const u_char *pBuffer,
+                       u_long lFrames, u_long lFirstFrame)
+/*
+ * Find the silent frames in a buffer, where a frame is silent if neither
+ * channel exceeds the silence threshold.  With SSE2, four frames are
+ * compared at once, and runs of silence (the common case at the edges of
+ * a track) cost one comparison and one mask test per four frames; frames
+ * are only looked at one by one where sound and silence meet.  Runs of
+ * at least kiAnalysis_MinimumGap frames are recorded when sound ends them.
+ *
+ *   Input:  pstAnalysis - The analysis structure.
+ *           pBuffer     - The audio data.
+ *           lFrames     - Frames in pBuffer.
+ *           lFirstFrame - Frame number of the first frame in pBuffer.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  u_long lFrame = 0,				/* Current frame             */
+         lRun;					/* Silent frames in a row    */
+  int    iLoudMask,				/* Frames above the threshold */
+         iFrame;				/* Frame within the group    */
+#ifdef __SSE2__
+  __m128i vSamples,				/* Four frames               */
+          vThreshold;				/* The threshold, 8 times    */
+#else
+  int    iLeft,					/* Left sample               */
+         iRight;				/* Right sample              */
+#endif
+
+
+  lRun = pstAnalysis->lTrailingSilence;
+
+#ifdef __SSE2__
+  vThreshold = _mm_set1_epi16((short) pstAnalysis->iSilenceThreshold);
+#endif
+
+  while (lFrame < lFrames) {
+#ifdef __SSE2__
+    /* |sample| > threshold, four frames at a time.  The negation saturates,
+     * so -32768 compares as 32767.  Four mask bits per frame.
+     */
+    if (lFrames - lFrame >= 4) {
+      vSamples  = _mm_loadu_si128((const __m128i *) (pBuffer + lFrame * 4));
+      vSamples  = _mm_max_epi16(vSamples, _mm_subs_epi16(_mm_setzero_si128(), vSamples));
+      iLoudMask = _mm_movemask_epi8(_mm_cmpgt_epi16(vSamples, vThreshold));
+      iFrame    = 4;
+    } else {
+      vSamples  = _mm_cvtsi32_si128((int) CRC_LE32(pBuffer + lFrame * 4));
+      vSamples  = _mm_max_epi16(vSamples, _mm_subs_epi16(_mm_setzero_si128(), vSamples));
+      iLoudMask = _mm_movemask_epi8(_mm_cmpgt_epi16(vSamples, vThreshold)) & 0x0f;
+      iFrame    = 1;
+    }
+
+    if (!iLoudMask) {
+      lRun   += iFrame;
+      lFrame += iFrame;
+      pstAnalysis->lSilentFrames += iFrame;
+      continue;
+    }
+#else
+    iLeft  = (int16_t) (pBuffer[lFrame * 4]     | pBuffer[lFrame * 4 + 1] << 8);
+    iRight = (int16_t) (pBuffer[lFrame * 4 + 2] | pBuffer[lFrame * 4 + 3] << 8);
+
+    iLoudMask = ((iLeft  < 0 ? -iLeft  : iLeft)  > pstAnalysis->iSilenceThreshold) ||
+                ((iRight < 0 ? -iRight : iRight) > pstAnalysis->iSilenceThreshold);
+    iFrame    = 1;
+#endif
+
+    /* Sound and silence meet in this group; walk it a frame at a time. */
+    for (; iFrame > 0; iFrame--, iLoudMask >>= 4, lFrame++) {
+      if (!(iLoudMask & 0x0f)) {
+        lRun++;
+        pstAnalysis->lSilentFrames++;
+        continue;
+      }
+
+      if (!pstAnalysis->iHeardSound) {
+        pstAnalysis->lLeadingSilence = lRun;
+        pstAnalysis->iHeardSound     = 1;
+      }
+
+      /* A failed allocation costs the span, not the extraction. */
+      if (lRun >= kiAnalysis_MinimumGap)
+        fnAnalysis_AppendSpan(pstAnalysis, lFirstFrame + lFrame - lRun, lRun);
+
+      lRun = 0;
+    }
+  }
+
+  /* Silence still running may yet be ended by sound, or run out the track. */
+  pstAnalysis->lTrailingSilence = lRun;
+
+  if (!pstAnalysis->iHeardSound)
+    pstAnalysis->lLeadingSilence = lRun;
+}
+
+
+/*========================================================================*/
+int
+fnAnalysis_Threshold(double dDecibels)
+/*
+ * Convert a silence threshold in dBFS to the largest sample value which
+ * is still counted as silence.
+ *
+ *   Input:  dDecibels - The threshold, ie -60.  (0 dBFS is full scale)
+ * Returns:  The threshold as a sample value.
+ */
+/*========================================================================*/
+{
+  if (dDecibels >= 0)  return kiAnalysis_FullScale;
+
+  return (int) (32768.0 * pow(10.0, dDecibels / 20.0));
+}
+
+
+/*========================================================================*/
+void
+fnAnalysis_ProcessBuffer(struct AudioAnalysis_t *pstAnalysis, const void *pvBuffer,
+                         size_t iLength)
+/*
+ * Bring every enabled analysis up to date with a buffer of 16 bit,
+ * little-endian, stereo CDDA.  The buffer is read once: each group of two
+ * frames is loaded as two words which feed the CRC directly, and are then
+ * split into the four samples the level analyses need.  Running totals are
+ * kept in locals for the length of the buffer.  Silence, which only needs a
+ * comparison per sample, is left to fnAnalysis_ScanSilence().
+ *
+ *   Input:  pstAnalysis - The analysis structure.
+ *           pvBuffer    - The audio data.
+ *           iLength     - Bytes in pvBuffer (a multiple of 4).
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  const u_char *pBuffer;			/* Current position          */
+  u_int32_t lWord0,				/* First frame               */
+            lWord1,				/* Second frame              */
+            lCRC;				/* Running CRC (inverted)    */
+  u_long    lClipped = 0,			/* Clipped samples           */
+            lFirstFrame;			/* Frame number of pBuffer   */
+  int       aiSample[4],			/* Samples of both frames    */
+            aiMagnitude[4],			/* Their magnitudes          */
+            iPeakLeft,				/* Peak, left channel        */
+            iPeakRight,				/* Peak, right channel       */
+            iFlags;				/* Enabled analyses          */
+
+
+  iFlags = pstAnalysis->iFlags;
+
+  if (!iFlags)  return;
+
+  pBuffer    = (const u_char *) pvBuffer;
+  lCRC       = ~pstAnalysis->lChecksum;
+  iPeakLeft  = pstAnalysis->aiPeak[0];
+  iPeakRight = pstAnalysis->aiPeak[1];
+
+  lFirstFrame           = pstAnalysis->lFrames;
+  pstAnalysis->lFrames += iLength / 4;
+
+  /* Silence has its own vector pass, made while the buffer is still in the
+   * first level cache.
+   */
+  if (iFlags & kiAnalysis_Silence)
+    fnAnalysis_ScanSilence(pstAnalysis, pBuffer, iLength / 4, lFirstFrame);
+
+  /* Two frames, eight bytes, at a time.  A trailing odd frame is padded by
+   * handling it as a group whose second frame is skipped.
+   */
+  while (iLength >= 4) {
+    lWord0 = CRC_LE32(pBuffer);
+    lWord1 = (iLength >= 8) ? CRC_LE32(pBuffer + 4) : 0;
+
+    if (iFlags & kiAnalysis_Checksum) {
+      if (iLength >= 8)
+        CRC_SLICE8(lCRC, lWord0, lWord1);
+      else {
+        int iByte;
+
+        for (iByte = 0; iByte < 4; iByte++)
+          lCRC = alCRCtable[0][(lCRC ^ pBuffer[iByte]) & 0xff] ^ (lCRC >> 8);
+      }
+    }
+
+    if (iFlags & (kiAnalysis_Peak | kiAnalysis_Loudness)) {
+      aiSample[0] = (int16_t) (lWord0 & 0xffff);
+      aiSample[1] = (int16_t) (lWord0 >> 16);
+      aiSample[2] = (int16_t) (lWord1 & 0xffff);
+      aiSample[3] = (int16_t) (lWord1 >> 16);
+
+      aiMagnitude[0] = aiSample[0] < 0 ? -aiSample[0] : aiSample[0];
+      aiMagnitude[1] = aiSample[1] < 0 ? -aiSample[1] : aiSample[1];
+      aiMagnitude[2] = aiSample[2] < 0 ? -aiSample[2] : aiSample[2];
+      aiMagnitude[3] = aiSample[3] < 0 ? -aiSample[3] : aiSample[3];
+
+      if (iFlags & kiAnalysis_Peak) {
+        if (aiMagnitude[0] > iPeakLeft)   iPeakLeft  = aiMagnitude[0];
+        if (aiMagnitude[2] > iPeakLeft)   iPeakLeft  = aiMagnitude[2];
+        if (aiMagnitude[1] > iPeakRight)  iPeakRight = aiMagnitude[1];
+        if (aiMagnitude[3] > iPeakRight)  iPeakRight = aiMagnitude[3];
+
+        lClipped += (aiMagnitude[0] >= kiAnalysis_FullScale) +
+                    (aiMagnitude[1] >= kiAnalysis_FullScale) +
+                    (aiMagnitude[2] >= kiAnalysis_FullScale) +
+                    (aiMagnitude[3] >= kiAnalysis_FullScale);
+      }
+
+      if (iFlags & kiAnalysis_Loudness)
+        fnLoudness_AddFrames(&pstAnalysis->stLoudness, aiSample, (iLength >= 8) ? 2 : 1);
+
+    }
+
+    pBuffer += (iLength >= 8) ? 8 : 4;
+    iLength -= (iLength >= 8) ? 8 : 4;
+  }
+
+  /* Fold this buffer's totals into the track's. */
+  pstAnalysis->lChecksum        = ~lCRC;
+  pstAnalysis->aiPeak[0]        = iPeakLeft;
+  pstAnalysis->aiPeak[1]        = iPeakRight;
+  pstAnalysis->lClippedSamples += lClipped;
+}
+
+
+/*========================================================================*/
+double
+fnAnalysis_Decibels(double dLevel)
+/*
+ * Convert a level relative to full scale into dBFS.
+ *
+ *   Input:  dLevel - The level, where 1.0 is full scale.
+ * Returns:  The level in dBFS (-99.9 for silence).
+ */
+/*========================================================================*/
+{
+  if (dLevel <= 0.00001)  return -99.9;
+
+  return 20.0 * log10(dLevel);
+}
+
+
+/*========================================================================*/
+void
+fnAnalysis_Report(struct AudioAnalysis_t *pstAnalysis)
+/*
+ * Display the results of the enabled analyses, in the style of the
+ * extraction status.
+ *
+ *   Input:  pstAnalysis - The analysis structure.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  struct LoudnessMeter_t  *pstMeter;		/* The track's meter         */
+  struct LoudnessResult_t stLoudness;		/* Its results               */
+  struct SilenceSpan_t    *pstSpan;		/* Current run of silence    */
+  int    iSpan;					/* Current span index        */
+
+
+  if (pstAnalysis->iFlags & kiAnalysis_Checksum)
+    fprintf(stderr, "Checksum ........ [ CRC-32 %08x ]\n", pstAnalysis->lChecksum);
+
+  if (pstAnalysis->iFlags & kiAnalysis_Peak)
+    fprintf(stderr, "Peak ............ [ L %.1f dBFS, R %.1f dBFS, %lu clipped ]\n",
+            fnAnalysis_Decibels(pstAnalysis->aiPeak[0] / 32768.0),
+            fnAnalysis_Decibels(pstAnalysis->aiPeak[1] / 32768.0),
+            pstAnalysis->lClippedSamples);
+
+  if (pstAnalysis->iFlags & kiAnalysis_Loudness) {
+    pstMeter = &pstAnalysis->stLoudness;
+    fnLoudness_Result(&pstMeter, 1, &stLoudness);
+
+    fprintf(stderr, "Loudness ........ [ %.1f LUFS, LRA %.1f LU, true peak %.1f dBTP, gain %+.2f dB ]\n",
+            stLoudness.dIntegrated, stLoudness.dRange,
+            fnAnalysis_Decibels(stLoudness.dTruePeak), stLoudness.dGain);
+  }
+
+  if (pstAnalysis->iFlags & kiAnalysis_Silence) {
+    fprintf(stderr, "Silence ......... [ %.2f sec lead-in, %.2f sec run-out, %.2f sec total ]\n",
+            pstAnalysis->lLeadingSilence / (double) CDDA_SAMPLE_RATE,
+            pstAnalysis->lTrailingSilence / (double) CDDA_SAMPLE_RATE,
+            pstAnalysis->lSilentFrames / (double) CDDA_SAMPLE_RATE);
+
+    /* Gaps within the track, to the frame.  A long one followed by sound is
+     * the usual sign of a hidden track.
+     */
+    for (iSpan = 0; iSpan < pstAnalysis->iSpans; iSpan++) {
+      pstSpan = &pstAnalysis->pstSpans[iSpan];
+
+      if (pstSpan->lStart == 0)  continue;
+
+      fprintf(stderr, "Gap ............. [ %lu:%06.3f to %lu:%06.3f, frames %lu-%lu ]\n",
+              pstSpan->lStart / (CDDA_SAMPLE_RATE * 60),
+              (pstSpan->lStart % (CDDA_SAMPLE_RATE * 60)) / (double) CDDA_SAMPLE_RATE,
+              (pstSpan->lStart + pstSpan->lLength) / (CDDA_SAMPLE_RATE * 60),
+              ((pstSpan->lStart + pstSpan->lLength) % (CDDA_SAMPLE_RATE * 60)) /
+                (double) CDDA_SAMPLE_RATE,
+              pstSpan->lStart, pstSpan->lStart + pstSpan->lLength - 1);
+
+      if (pstSpan->lLength >= kiAnalysis_HiddenGap)
+        fprintf(stderr, "Hidden track .... [ Possible, after %.1f sec of silence ]\n",
+                pstSpan->lLength / (double) CDDA_SAMPLE_RATE);
+    }
+  }
+}
+
+
+/*========================================================================*/
+void
+fnAnalysis_Dispose(struct AudioAnalysis_t *pstAnalysis)
+/*
+ * Free the memory held by the analyses (but not pstAnalysis itself).
+ *
+ *   Input:  pstAnalysis - The analysis structure.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  fnLoudness_Dispose(&pstAnalysis->stLoudness);
+
+  if (pstAnalysis->pstSpans) {
+    free(pstAnalysis->pstSpans);
+    pstAnalysis->pstSpans = NULL;
+  }
+
+  pstAnalysis->iSpans = pstAnalysis->iSpansAllocated = 0;
+}
+
+/* EOF */
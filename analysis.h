@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * analysis.h - Header for the audio analysis kernel.
+ *
+ * $Id$
+ */
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Analysis flags (struct AudioAnalysis_t's iFlags) */
+#define kiAnalysis_Checksum	0x01	/* CRC-32 of the audio data                */
+#define kiAnalysis_Peak		0x02	/* Peak sample level and clipping          */
+#define kiAnalysis_Silence	0x04	/* Silent frames at the edges, and overall */
+#define kiAnalysis_Loudness	0x08	/* EBU R128 loudness, true peak, ReplayGain */
+#define kiAnalysis_All		0x0f	/* Everything above                        */
+
+#define kiAnalysis_FullScale	32767	/* Samples at or above this are clipped    */
+
+#define kiAnalysis_MinimumGap	(CDDA_SAMPLE_RATE * 2)  /* Shortest silence reported */
+#define kiAnalysis_HiddenGap	(CDDA_SAMPLE_RATE * 10) /* Silence before a hidden track */
+
+/* A run of silence within a track, to the frame. */
+struct SilenceSpan_t {
+  u_long lStart,                    /* First silent frame                          */
+         lLength;                   /* Silent frames in the run                    */
+};
+
+/* Running results of the analyses for one track.  Every enabled analysis
+ * is brought up to date by a single pass over each buffer.  Requires
+ * loudness.h.
+ */
+struct AudioAnalysis_t {
+  int       iFlags;                 /* Enabled analyses (kiAnalysis_*)             */
+
+  u_int32_t lChecksum;              /* CRC-32 of the data seen so far              */
+
+  int       aiPeak[2];              /* Largest absolute sample, per channel        */
+  u_long    lClippedSamples;        /* Samples at full scale                       */
+
+  int       iSilenceThreshold;      /* Largest sample still counted as silence     */
+  int       iHeardSound;            /* A non-silent frame has been seen            */
+  u_long    lSilentFrames,          /* Silent frames in total                      */
+            lLeadingSilence,        /* Silent frames before the first sound        */
+            lTrailingSilence;       /* Silent frames since the last sound          */
+  struct SilenceSpan_t *pstSpans;   /* Runs of silence ended by sound              */
+  int       iSpans,                 /* Entries in pstSpans                         */
+            iSpansAllocated;        /* Entries allocated                           */
+
+  struct LoudnessMeter_t stLoudness; /* K-weighted loudness and true peak        */
+
+  u_long    lFrames;                /* Frames (stereo sample pairs) analysed       */
+};
+
+/* Analysis function prototypes. */
+int    fnAnalysis_ParseFlags(char *szAnalyses);
+void   fnAnalysis_Initialize(struct AudioAnalysis_t *pstAnalysis, int iFlags);
+void   fnAnalysis_ProcessBuffer(struct AudioAnalysis_t *pstAnalysis, const void *pvBuffer,
+                                size_t iLength);
+double fnAnalysis_Decibels(double dLevel);
+int    fnAnalysis_Threshold(double dDecibels);
+void   fnAnalysis_Report(struct AudioAnalysis_t *pstAnalysis);
+void   fnAnalysis_Dispose(struct AudioAnalysis_t *pstAnalysis);
+
+/* EOF */
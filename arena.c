@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * arena.c - Arenas, which hand out memory from a few large blocks and free
+ *           it all at once.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "arena.h"
+
+
+/*========================================================================*/
+void
+fnArena_Initialize(struct Arena_t *pstArena)
+/*
+ * Start an empty arena.  No memory is taken until the first allocation.
+ *
+ *   Input:  pstArena - The arena.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  pstArena->pstBlocks  = NULL;
+  pstArena->iAllocated = 0;
+  pstArena->iReserved  = 0;
+}
+
+
+/*========================================================================*/
+void *
+fnArena_Alloc(struct Arena_t *pstArena, size_t iSize)
+/*
+ * Allocate zeroed memory from the arena, as calloc() would.  It stays
+ * allocated until the arena is released.
+ *
+ *   Input:  pstArena - The arena.
+ *           iSize    - Bytes wanted.
+ *
+ * Returns:  The memory, or NULL if the heap is exhausted.
+ */
+/*========================================================================*/
+{
+  struct ArenaBlock_t *pstBlock;		/* Block allocated from      */
+  size_t iBlockSize;				/* Bytes in a new block      */
+  void   *pvMemory;				/* The memory handed out     */
+
+
+  iSize    = ARENA_ROUND(iSize ? iSize : 1);
+  pstBlock = pstArena->pstBlocks;
+
+  if (!pstBlock || (pstBlock->iUsed + iSize > pstBlock->iSize)) {
+    iBlockSize = (iSize > kiArena_Oversize) ? iSize : kiArena_BlockSize;
+
+    /* Blocks come from calloc(), and their memory is never handed out
+     * twice, so it is already zeroed.
+     */
+    if (! (pstBlock = (struct ArenaBlock_t *)
+                      calloc(1, ARENA_ROUND(sizeof(struct ArenaBlock_t)) + iBlockSize)))
+      return NULL;
+
+    pstBlock->iSize = iBlockSize;
+    pstArena->iReserved += iBlockSize;
+
+    /* A large allocation takes a block of its own, which goes behind the
+     * block in use so that what's left of that isn't abandoned.
+     */
+    if ((iSize > kiArena_Oversize) && pstArena->pstBlocks) {
+      pstBlock->pstNext = pstArena->pstBlocks->pstNext;
+      pstArena->pstBlocks->pstNext = pstBlock;
+
+    } else {
+      pstBlock->pstNext = pstArena->pstBlocks;
+      pstArena->pstBlocks = pstBlock;
+    }
+  }
+
+  pvMemory = (char *) pstBlock + ARENA_ROUND(sizeof(struct ArenaBlock_t)) + pstBlock->iUsed;
+
+  pstBlock->iUsed += iSize;
+  pstArena->iAllocated += iSize;
+
+  return pvMemory;
+}
+
+
+/*========================================================================*/
+char *
+fnArena_Strdup(struct Arena_t *pstArena, const char *szString)
+/*
+ * Copy a string into the arena, as strdup() would.
+ *
+ *   Input:  pstArena - The arena.
+ *           szString - The string.
+ *
+ * Returns:  The copy, or NULL if the heap is exhausted.
+ */
+/*========================================================================*/
+{
+  size_t iLength;				/* The string's length       */
+  char   *szCopy;				/* ... and its copy          */
+
+
+  iLength = strlen(szString);
+
+  if ((szCopy = (char *) fnArena_Alloc(pstArena, iLength + 1)))
+    memcpy(szCopy, szString, iLength);
+
+  return szCopy;
+}
+
+
+/*========================================================================*/
+void
+fnArena_Adopt(struct Arena_t *pstArena, struct Arena_t *pstOther)
+/*
+ * Take over another arena's blocks, so that what was allocated from it is
+ * released with this one.  They go behind the block in use, which carries
+ * on being allocated from.
+ *
+ *   Input:  pstArena - The arena.
+ *           pstOther - The arena whose blocks it takes; left empty.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  struct ArenaBlock_t *pstLast;			/* pstOther's last block     */
+
+
+  if (!pstOther->pstBlocks)  return;
+
+  for (pstLast = pstOther->pstBlocks; pstLast->pstNext; pstLast = pstLast->pstNext)
+    ;
+
+  if (pstArena->pstBlocks) {
+    pstLast->pstNext = pstArena->pstBlocks->pstNext;
+    pstArena->pstBlocks->pstNext = pstOther->pstBlocks;
+  } else
+    pstArena->pstBlocks = pstOther->pstBlocks;
+
+  pstArena->iAllocated += pstOther->iAllocated;
+  pstArena->iReserved  += pstOther->iReserved;
+
+  fnArena_Initialize(pstOther);
+}
+
+
+/*========================================================================*/
+void
+fnArena_Release(struct Arena_t *pstArena)
+/*
+ * Free everything allocated from the arena, leaving it empty.
+ *
+ *   Input:  pstArena - The arena.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  struct ArenaBlock_t *pstBlock;		/* Block being freed         */
+
+
+#ifdef DEBUG
+  fprintf(stderr, "DEBUG   : Arena released, %lu of %lu bytes used.\n",
+          (u_long) pstArena->iAllocated, (u_long) pstArena->iReserved);
+#endif
+
+  while ((pstBlock = pstArena->pstBlocks)) {
+    pstArena->pstBlocks = pstBlock->pstNext;
+    free(pstBlock);
+  }
+
+  fnArena_Initialize(pstArena);
+}
+
+/* EOF */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * arena.h - Header for the arenas which hold a disc's information, so that
+ *           it is freed in one go when the disc is done with.
+ *
+ * $Id$
+ */
+
+#include <stddef.h>
+
+/* An arena hands out memory from a chain of large blocks, and never takes
+ * any back until the whole arena is released.  Everything found out about
+ * a disc (its TOC, track information, CDDB titles and filenames) lives as
+ * long as the disc does, so it is allocated from the disc's arena and
+ * freed with it, rather than a piece at a time.  Arenas aren't locked; a
+ * disc's arena is only used by the thread which reads its information.  A
+ * lookup running beside it allocates from an arena of its own, which the
+ * disc's adopts when the lookup is done.
+ */
+
+#define kiArena_BlockSize	4096	/* Bytes in each of an arena's blocks      */
+#define kiArena_Alignment	16	/* Every allocation is aligned to this     */
+#define kiArena_Oversize	(kiArena_BlockSize / 4)
+					/* Larger allocations get a block each     */
+
+/* Round a size up to the alignment. */
+#define ARENA_ROUND(iSize)	(((iSize) + kiArena_Alignment - 1) & \
+				 ~((size_t) kiArena_Alignment - 1))
+
+/* One of an arena's blocks.  Its memory follows the header, aligned. */
+struct ArenaBlock_t {
+  struct ArenaBlock_t *pstNext;     /* The block allocated before this one         */
+  size_t iSize,                     /* Bytes of memory in the block                */
+         iUsed;                     /* ... and handed out                          */
+};
+
+/* An arena. */
+struct Arena_t {
+  struct ArenaBlock_t *pstBlocks;   /* Its blocks, the one in use first            */
+  size_t iAllocated;                /* Bytes handed out                            */
+  size_t iReserved;                 /* ... and taken from the heap                 */
+};
+
+/* Arena function prototypes. */
+void  fnArena_Initialize(struct Arena_t *pstArena);
+void *fnArena_Alloc(struct Arena_t *pstArena, size_t iSize);
+char *fnArena_Strdup(struct Arena_t *pstArena, const char *szString);
+void  fnArena_Adopt(struct Arena_t *pstArena, struct Arena_t *pstOther);
+void  fnArena_Release(struct Arena_t *pstArena);
+
+/* EOF */
@@ -0,0 +1,558 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * cache.c - The rip cache.  A disc which has been ripped before is
+ *           recognised by its CDDB disc ID and TOC, and a sample of each
+ *           track's sectors; its files are then cloned or linked from the
+ *           cache rather than read from the disc again.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "checksum.h"
+#include "cache.h"
+
+
+/*========================================================================*/
+size_t
+fnCache_TOC(char *szTOC, size_t iLength, struct ioc_toc_header *pstTOCheader,
+            struct ioc_read_toc_entry *pstTOCentries)
+/*
+ * Write the disc's TOC out as text, a line per entry.
+ *
+ *   Input:  szTOC         - Where to put it.
+ *           iLength       - Bytes available at szTOC.
+ *           pstTOCheader  - The disc's TOC header.
+ *           pstTOCentries - ... and entries, the lead-out included.
+ *
+ * Returns:  The length of the text, or 0 if it didn't fit.
+ */
+/*========================================================================*/
+{
+  size_t iUsed = 0;				/* Bytes of szTOC used       */
+  int    iTrackIndex;				/* Current TOC entry         */
+
+
+  for (iTrackIndex = 0; (iTrackIndex <= pstTOCheader->ending_track) && (iUsed < iLength);
+       iTrackIndex++)
+    iUsed += snprintf(szTOC + iUsed, iLength - iUsed, "%i %02i:%02i:%02i %#x\n",
+                      pstTOCentries->data[iTrackIndex].track,
+                      pstTOCentries->data[iTrackIndex].addr.msf.minute,
+                      pstTOCentries->data[iTrackIndex].addr.msf.second,
+                      pstTOCentries->data[iTrackIndex].addr.msf.frame,
+                      pstTOCentries->data[iTrackIndex].control);
+
+  return (iUsed < iLength) ? iUsed : 0;
+}
+
+
+/*========================================================================*/
+void
+fnCache_Key(char *szKey, size_t iLength, char *szDiscID, struct ioc_toc_header *pstTOCheader,
+            struct ioc_read_toc_entry *pstTOCentries)
+/*
+ * Name a disc, by its CDDB ID and the CRC-32 of its TOC (CDDB IDs are far
+ * from unique).
+ *
+ *   Input:  szKey         - Where to put the name.
+ *           iLength       - Bytes available at szKey.
+ *           szDiscID      - The disc's CDDB ID.
+ *           pstTOCheader  - The disc's TOC header.
+ *           pstTOCentries - ... and entries, the lead-out included.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  char szTOC[kiMaxStringLength * 4];		/* The TOC, as text          */
+
+
+  snprintf(szKey, iLength, "%s-%08x", szDiscID,
+           fnCRC_Update(0, szTOC, fnCache_TOC(szTOC, sizeof(szTOC), pstTOCheader, pstTOCentries)));
+}
+
+
+/*========================================================================*/
+int
+fnCache_Open(struct RipCache_t *pstCache, char *szRoot, char *szDiscID,
+             struct ioc_toc_header *pstTOCheader, struct ioc_read_toc_entry *pstTOCentries)
+/*
+ * Find the disc's entry in the cache, creating it (and the cache) if need
+ * be.
+ *
+ *   Input:  pstCache      - The entry.
+ *           szRoot        - The cache's directory.
+ *           szDiscID      - The disc's CDDB ID.
+ *           pstTOCheader  - The disc's TOC header.
+ *           pstTOCentries - ... and entries, the lead-out included.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  char   szTOC[kiMaxStringLength * 4],		/* The TOC, as text          */
+         szKey[kiMaxStringLength],		/* The entry's name          */
+         szFilename[kiMaxStringLength];		/* The entry's TOC file      */
+  size_t iUsed;					/* Bytes of szTOC used       */
+  int    iFileDesc;				/* The TOC file              */
+
+
+#ifdef DEBUG
+  fprintf(stderr, "FUNCTION: fnCache_Open()\n");
+#endif
+
+  if ((iUsed = fnCache_TOC(szTOC, sizeof(szTOC), pstTOCheader, pstTOCentries)) == 0) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  fnCache_Key(szKey, sizeof(szKey), szDiscID, pstTOCheader, pstTOCentries);
+
+  if (snprintf(pstCache->szDirectory, sizeof(pstCache->szDirectory), "%s/%s", szRoot, szKey) >=
+      (int) sizeof(pstCache->szDirectory)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if (((mkdir(szRoot, 0755) < 0) && (errno != EEXIST)) ||
+      ((mkdir(pstCache->szDirectory, 0755) < 0) && (errno != EEXIST)))
+    return -1;
+
+  /* The TOC is kept for whoever looks in the cache; it is never read. */
+  if (snprintf(szFilename, sizeof(szFilename), "%s/toc", pstCache->szDirectory) >=
+      (int) sizeof(szFilename)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if ((iFileDesc = open(szFilename, O_WRONLY | O_CREAT | O_EXCL, 0644)) >= 0) {
+    write(iFileDesc, szTOC, iUsed);
+    close(iFileDesc);
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnCache_Describe(char *szFormat, size_t iLength, struct ExtractionOptions_t *pstOptions,
+                 char *szWriter, int iDeemphasis)
+/*
+ * Describe everything which shapes a track's output file, so that a file
+ * is only taken from the cache by a run which would have written the same.
+ * How the file is written (-p, -u, -x, -z) doesn't matter.
+ *
+ *   Input:  szFormat    - Where to put the description.
+ *           iLength     - Bytes available at szFormat.
+ *           pstOptions  - The user's extraction options.
+ *           szWriter    - The output format's name.
+ *           iDeemphasis - The track is de-emphasised (flag).
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  snprintf(szFormat, iLength, "%s channels %i bits %i float %i rate %i dither %i quality %i "
+           "deemphasis %i trim %#x silence %i", szWriter, pstOptions->iOutputChannels,
+           pstOptions->iOutputBits, pstOptions->iOutputFloat, pstOptions->iOutputRate,
+           pstOptions->iDither, pstOptions->iResampleQuality, iDeemphasis,
+           pstOptions->iTrimFlags, pstOptions->iTrimFlags ? pstOptions->iSilenceThreshold : 0);
+}
+
+
+/*========================================================================*/
+int
+fnCache_Sample(int iDeviceDesc, int iLBAstart, int iLBAend, u_long *alLBA, u_int32_t *alCRC)
+/*
+ * Read a few of a track's sectors, spread evenly across it, and take the
+ * CRC-32 of each.
+ *
+ *   Input:  iDeviceDesc - The CD-ROM device descriptor.
+ *           iLBAstart   - The track's first block.
+ *           iLBAend     - ... and its last.
+ *           alLBA       - kiCache_Samples blocks' worth of room.
+ *           alCRC       - ... and as many CRCs'.
+ *
+ * Returns:  -1 if a sector couldn't be read (see errno), 0 otherwise.
+ *
+ *           alLBA       - The blocks read.
+ *           alCRC       - ... and their CRC-32s.
+ */
+/*========================================================================*/
+{
+  struct ioc_read_cdda stReadCDDA;		/* CDDA read request         */
+  u_char aBlock[CDDA_DATA_LENGTH];		/* A sector                  */
+  int    iSample,				/* Current sector            */
+         iRetry;				/* Attempts at reading it    */
+
+
+  stReadCDDA.frames = 1;
+  stReadCDDA.buffer = aBlock;
+
+  for (iSample = 0; iSample < kiCache_Samples; iSample++) {
+    alLBA[iSample] = iLBAstart + (u_long) (iLBAend - iLBAstart) * (iSample + 1) /
+                                 (kiCache_Samples + 1);
+
+    stReadCDDA.lba = alLBA[iSample];
+
+    for (iRetry = 0; ioctl(iDeviceDesc, CDIOREADCDDA, &stReadCDDA) != 0; iRetry++)
+      if (iRetry >= kiCache_Retries) {
+        errno = EIO;
+        return -1;
+      }
+
+    alCRC[iSample] = fnCRC_Update(0, aBlock, CDDA_DATA_LENGTH);
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCache_Names(struct RipCache_t *pstCache, struct CacheEntry_t *pstEntry, int iTrack,
+              char *szFormat, char *szExtension)
+/*
+ * Name a track's file in the cache, and its summary.
+ *
+ * Returns:  -1 if either name is too long (errno is ENAMETOOLONG), 0
+ *           otherwise.
+ */
+/*========================================================================*/
+{
+  u_int32_t lFormat;				/* CRC-32 of szFormat        */
+
+
+  lFormat = fnCRC_Update(0, szFormat, strlen(szFormat));
+
+  if ((snprintf(pstEntry->szAudio, sizeof(pstEntry->szAudio), "%s/track-%02i.%08x.%s",
+                pstCache->szDirectory, iTrack, lFormat, szExtension) >=
+       (int) sizeof(pstEntry->szAudio)) ||
+      (snprintf(pstEntry->szSummary, sizeof(pstEntry->szSummary), "%s/track-%02i.%08x.sum",
+                pstCache->szDirectory, iTrack, lFormat) >= (int) sizeof(pstEntry->szSummary))) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCache_Read(struct CacheEntry_t *pstEntry, char *szFormat)
+/*
+ * Read a track's summary.
+ *
+ *   Input:  pstEntry - The track, named.
+ *           szFormat - Its file's format (see fnCache_Describe()).
+ *
+ * Returns:  -1 on error (see errno; ENOENT if there is no complete summary
+ *           for that format), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  FILE   *fSummary;				/* The summary               */
+  char   szLine[kiMaxStringLength];		/* A line of it              */
+  unsigned long long llLength;			/* The file's length         */
+  long   ltModified;				/* ... and modification time */
+  u_long lLBA;					/* A sector sampled          */
+  u_int32_t lCRC;				/* ... and its CRC           */
+  int    iFields = 0,				/* Fields found              */
+         iSamples = 0;				/* Sectors found             */
+
+
+  if ((fSummary = fopen(pstEntry->szSummary, "r")) == NULL)
+    return -1;
+
+  while (fgets(szLine, sizeof(szLine), fSummary)) {
+    szLine[strcspn(szLine, "\n")] = '\0';
+
+    if (strncmp(szLine, "format ", 7) == 0) {
+      if (strcmp(szLine + 7, szFormat) == 0)  iFields |= 0x01;
+
+    } else if (sscanf(szLine, "file %llu %ld", &llLength, &ltModified) == 2) {
+      pstEntry->llLength   = llLength;
+      pstEntry->ltModified = ltModified;
+      iFields |= 0x02;
+
+    } else if (strcmp(szLine, "checksum none") == 0) {
+      pstEntry->iChecksum = 0;
+      iFields |= 0x04;
+
+    } else if (sscanf(szLine, "checksum %x", &pstEntry->lChecksum) == 1) {
+      pstEntry->iChecksum = 1;
+      iFields |= 0x04;
+
+    } else if ((sscanf(szLine, "sector %lu %x", &lLBA, &lCRC) == 2) &&
+               (iSamples < kiCache_Samples)) {
+      pstEntry->alLBA[iSamples]   = lLBA;
+      pstEntry->alCRC[iSamples++] = lCRC;
+    }
+  }
+
+  fclose(fSummary);
+
+  if ((iFields != 0x07) || (iSamples != kiCache_Samples)) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCache_Fetch(struct RipCache_t *pstCache, struct CacheEntry_t *pstEntry, int iDeviceDesc,
+              int iTrack, int iLBAstart, int iLBAend, char *szFormat, char *szExtension,
+              int iChecksum, int iOutfileDesc, char *szFilename)
+/*
+ * Put a track's file in place from the cache, if it's there and the disc
+ * still matches it.  The file is cloned into the output file where the
+ * filesystem allows, or else hard linked in its place.
+ *
+ *   Input:  pstCache     - The disc's entry.
+ *           pstEntry     - The track's file in the cache, to be filled in.
+ *           iDeviceDesc  - The CD-ROM device descriptor.
+ *           iTrack       - The track.
+ *           iLBAstart    - Its first block.
+ *           iLBAend      - ... and its last.
+ *           szFormat     - The output file's format (see fnCache_Describe()).
+ *           szExtension  - ... and extension.
+ *           iChecksum    - The audio's checksum is wanted (flag).
+ *           iOutfileDesc - The output file, newly created and empty.
+ *           szFilename   - ... and its name.
+ *
+ * Returns:  -1 if the file can't be used (see errno; ENOENT if it isn't
+ *           cached, ESTALE if the disc or the cached file differ from when
+ *           it was cached), 0 otherwise.
+ *
+ *           pstEntry     - The cached file, and how it was put in place.
+ */
+/*========================================================================*/
+{
+  char      szTemporary[kiMaxStringLength];	/* The link, until renamed   */
+  struct stat stStatus;				/* The cached file's status  */
+  u_long    alLBA[kiCache_Samples];		/* Sectors read              */
+  u_int32_t alCRC[kiCache_Samples];		/* ... and their CRCs        */
+  int       iSample;				/* Current sector            */
+#ifdef FICLONE
+  int       iCacheDesc;				/* The cached file           */
+#endif
+
+
+#ifdef DEBUG
+  fprintf(stderr, "FUNCTION: fnCache_Fetch()\n");
+#endif
+
+  memset(pstEntry, 0, sizeof(struct CacheEntry_t));
+
+  if ((fnCache_Names(pstCache, pstEntry, iTrack, szFormat, szExtension) < 0) ||
+      (fnCache_Read(pstEntry, szFormat) < 0))
+    return -1;
+
+  if (iChecksum && !pstEntry->iChecksum) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  /* A hard linked output file which has since been changed has changed the
+   * cached file with it.
+   */
+  if (stat(pstEntry->szAudio, &stStatus) < 0)
+    return -1;
+
+  if (((u_int64_t) stStatus.st_size != pstEntry->llLength) ||
+      (stStatus.st_mtime != pstEntry->ltModified)) {
+    errno = ESTALE;
+    return -1;
+  }
+
+  if (fnCache_Sample(iDeviceDesc, iLBAstart, iLBAend, alLBA, alCRC) < 0)
+    return -1;
+
+  for (iSample = 0; iSample < kiCache_Samples; iSample++)
+    if ((alLBA[iSample] != pstEntry->alLBA[iSample]) ||
+        (alCRC[iSample] != pstEntry->alCRC[iSample])) {
+      errno = ESTALE;
+      return -1;
+    }
+
+#ifdef FICLONE
+  if ((iCacheDesc = open(pstEntry->szAudio, O_RDONLY)) >= 0) {
+    if (ioctl(iOutfileDesc, FICLONE, iCacheDesc) == 0) {
+      close(iCacheDesc);
+      pstEntry->iHow = kiCache_Reflinked;
+      return 0;
+    }
+
+    close(iCacheDesc);
+  }
+#endif
+
+  /* The link is made beside the output file, then renamed over it. */
+  if (snprintf(szTemporary, sizeof(szTemporary), "%s.%i", szFilename, (int) getpid()) >=
+      (int) sizeof(szTemporary)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if (link(pstEntry->szAudio, szTemporary) < 0)
+    return -1;
+
+  if (rename(szTemporary, szFilename) < 0) {
+    unlink(szTemporary);
+    return -1;
+  }
+
+  pstEntry->iHow = kiCache_Linked;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCache_Store(struct RipCache_t *pstCache, struct CacheEntry_t *pstEntry, int iDeviceDesc,
+              int iTrack, int iLBAstart, int iLBAend, char *szFormat, char *szExtension,
+              char *szFilename)
+/*
+ * Add a track's output file to the cache, replacing any file it held for
+ * the track in that format.  The file is cloned where the filesystem
+ * allows, or else hard linked.  Nothing is copied: the cache must be on
+ * the same filesystem as the output files.
+ *
+ *   Input:  pstCache     - The disc's entry.
+ *           pstEntry     - The track's file; iChecksum and lChecksum are
+ *                          recorded.
+ *           iDeviceDesc  - The CD-ROM device descriptor.
+ *           iTrack       - The track.
+ *           iLBAstart    - Its first block.
+ *           iLBAend      - ... and its last.
+ *           szFormat     - The output file's format (see fnCache_Describe()).
+ *           szExtension  - ... and extension.
+ *           szFilename   - The output file, complete.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  char      szTemporary[kiMaxStringLength];	/* A file, until renamed     */
+  struct stat stStatus;				/* The cached file's status  */
+  FILE      *fSummary;				/* The summary               */
+  int       iSample;				/* Current sector            */
+#ifdef FICLONE
+  int       iCacheDesc,				/* The cached file           */
+            iOutfileDesc;			/* The output file           */
+#endif
+
+
+#ifdef DEBUG
+  fprintf(stderr, "FUNCTION: fnCache_Store()\n");
+#endif
+
+  if (fnCache_Names(pstCache, pstEntry, iTrack, szFormat, szExtension) < 0)
+    return -1;
+
+  if (fnCache_Sample(iDeviceDesc, iLBAstart, iLBAend, pstEntry->alLBA, pstEntry->alCRC) < 0)
+    return -1;
+
+  /* Without its summary, the old file is no longer used. */
+  if ((unlink(pstEntry->szSummary) < 0) && (errno != ENOENT))
+    return -1;
+
+  if (snprintf(szTemporary, sizeof(szTemporary), "%s.%i", pstEntry->szAudio, (int) getpid()) >=
+      (int) sizeof(szTemporary)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  unlink(szTemporary);
+
+  pstEntry->iHow = kiCache_Linked;
+
+#ifdef FICLONE
+  if ((iOutfileDesc = open(szFilename, O_RDONLY)) >= 0) {
+    if ((iCacheDesc = open(szTemporary, O_WRONLY | O_CREAT | O_EXCL, 0644)) >= 0) {
+      if (ioctl(iCacheDesc, FICLONE, iOutfileDesc) == 0)
+        pstEntry->iHow = kiCache_Reflinked;
+      else
+        unlink(szTemporary);
+
+      close(iCacheDesc);
+    }
+
+    close(iOutfileDesc);
+  }
+#endif
+
+  if ((pstEntry->iHow == kiCache_Linked) && (link(szFilename, szTemporary) < 0))
+    return -1;
+
+  if ((rename(szTemporary, pstEntry->szAudio) < 0) || (stat(pstEntry->szAudio, &stStatus) < 0)) {
+    unlink(szTemporary);
+    return -1;
+  }
+
+  pstEntry->llLength   = stStatus.st_size;
+  pstEntry->ltModified = stStatus.st_mtime;
+
+  /* The summary goes last, so that the file is used only once it's whole. */
+  if (snprintf(szTemporary, sizeof(szTemporary), "%s.%i", pstEntry->szSummary, (int) getpid()) >=
+      (int) sizeof(szTemporary)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if ((fSummary = fopen(szTemporary, "w")) == NULL)
+    return -1;
+
+  fprintf(fSummary, "# DAEX rip cache: track %i\n", iTrack);
+  fprintf(fSummary, "format %s\n", szFormat);
+  fprintf(fSummary, "file %llu %ld\n", (unsigned long long) pstEntry->llLength,
+          (long) pstEntry->ltModified);
+
+  if (pstEntry->iChecksum)
+    fprintf(fSummary, "checksum %08x\n", pstEntry->lChecksum);
+  else
+    fprintf(fSummary, "checksum none\n");
+
+  for (iSample = 0; iSample < kiCache_Samples; iSample++)
+    fprintf(fSummary, "sector %lu %08x\n", pstEntry->alLBA[iSample], pstEntry->alCRC[iSample]);
+
+  if ((fclose(fSummary) != 0) || (rename(szTemporary, pstEntry->szSummary) < 0)) {
+    unlink(szTemporary);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* EOF */
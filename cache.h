@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * cache.h - Header for the rip cache, which keeps each track's output file
+ *           under the disc's CDDB ID and TOC.
+ *
+ * $Id$
+ */
+
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/fs.h>			/* FICLONE                                 */
+#endif
+
+/* The cache is a directory holding an entry for each disc, named for its
+ * CDDB disc ID and the CRC-32 of its TOC (CDDB IDs are far from unique):
+ *
+ *   <directory>/<disc ID>-<TOC CRC>/toc                    The TOC, as text
+ *   <directory>/<disc ID>-<TOC CRC>/track-NN.<format>.<ext> A track's file
+ *   <directory>/<disc ID>-<TOC CRC>/track-NN.<format>.sum  ... and summary
+ *
+ * where <format> is the CRC-32 of a description of everything which shapes
+ * the file (see fnCache_Describe()).  The summary holds that description,
+ * the file's length and modification time, the CRC-32 of its audio if it
+ * was taken, and the CRC-32 of a few of the track's sectors, spread across
+ * it, as read from the disc.  Those sectors are read again before the file
+ * is used, and the track is extracted afresh if any of them differ.
+ */
+
+#define kiCache_Samples		8	/* Sectors checked per track               */
+#define kiCache_Retries		10	/* Attempts at reading each one            */
+#define kiCache_Uncached	(kiAnalysis_Peak | kiAnalysis_Silence | kiAnalysis_Loudness)
+					/* Analyses only an extraction can give    */
+
+/* How a cached file was put in place */
+#define kiCache_Reflinked	0	/* A copy-on-write clone of the file       */
+#define kiCache_Linked		1	/* A hard link to the file                 */
+
+/* A disc's entry in the cache. */
+struct RipCache_t {
+  char szDirectory[kiMaxStringLength]; /* The entry's directory                    */
+};
+
+/* A track's file in the cache, and what's known of it. */
+struct CacheEntry_t {
+  char      szAudio[kiMaxStringLength],   /* The file                              */
+            szSummary[kiMaxStringLength]; /* ... and its summary                   */
+  u_int64_t llLength;               /* The file's length                           */
+  time_t    ltModified;             /* ... and modification time                   */
+  int       iChecksum;              /* lChecksum was taken (flag)                  */
+  u_int32_t lChecksum;              /* CRC-32 of the audio, as for -k              */
+  u_long    alLBA[kiCache_Samples]; /* Sectors sampled                             */
+  u_int32_t alCRC[kiCache_Samples]; /* ... and their CRC-32s                       */
+  int       iHow;                   /* How it was put in place (kiCache_*)         */
+};
+
+/* Rip cache function prototypes. */
+size_t fnCache_TOC(char *szTOC, size_t iLength, struct ioc_toc_header *pstTOCheader,
+                   struct ioc_read_toc_entry *pstTOCentries);
+void fnCache_Key(char *szKey, size_t iLength, char *szDiscID, struct ioc_toc_header *pstTOCheader,
+                 struct ioc_read_toc_entry *pstTOCentries);
+int  fnCache_Open(struct RipCache_t *pstCache, char *szRoot, char *szDiscID,
+                  struct ioc_toc_header *pstTOCheader, struct ioc_read_toc_entry *pstTOCentries);
+void fnCache_Describe(char *szFormat, size_t iLength, struct ExtractionOptions_t *pstOptions,
+                      char *szWriter, int iDeemphasis);
+int  fnCache_Sample(int iDeviceDesc, int iLBAstart, int iLBAend, u_long *alLBA, u_int32_t *alCRC);
+int  fnCache_Fetch(struct RipCache_t *pstCache, struct CacheEntry_t *pstEntry, int iDeviceDesc,
+                   int iTrack, int iLBAstart, int iLBAend, char *szFormat, char *szExtension,
+                   int iChecksum, int iOutfileDesc, char *szFilename);
+int  fnCache_Store(struct RipCache_t *pstCache, struct CacheEntry_t *pstEntry, int iDeviceDesc,
+                   int iTrack, int iLBAstart, int iLBAend, char *szFormat, char *szExtension,
+                   char *szFilename);
+
+/* EOF */
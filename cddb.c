@@ -32,6 +32,11 @@
  */
 
 #include "daex.h"
+#include "arena.h"
+#include "resample.h"
+#include "convert.h"
+#include "writer.h"
+#include "freedb.h"
 #include "cddb.h"
 
 
@@ -124,7 +129,8 @@ fnCDDB_BuildQueryString(void *pvDiscInformation)
   memset(&szTemp1, 0, sizeof(szTemp1));
 
   /* Allocate memory for the track frame offsets. */
-  pstCDDBinformation->iTrackFrameOffset = (int *) calloc(pstTOCheader->ending_track, sizeof(int));
+  pstCDDBinformation->iTrackFrameOffset = (int *)
+                   fnArena_Alloc(pstDiscInformation->pstArena, pstTOCheader->ending_track * sizeof(int));
 
   if (!pstCDDBinformation->iTrackFrameOffset) {
     fprintf(stderr, "DAEX: Unable to allocate memory for the track frame offset array.\n");
@@ -132,7 +138,8 @@ fnCDDB_BuildQueryString(void *pvDiscInformation)
   }
 
   /* Allocate memory for the track play time array. */
-  pstCDDBinformation->iTrackSeconds = (int *) calloc(pstTOCheader->ending_track, sizeof(int));
+  pstCDDBinformation->iTrackSeconds = (int *)
+                   fnArena_Alloc(pstDiscInformation->pstArena, pstTOCheader->ending_track * sizeof(int));
 
   if (!pstCDDBinformation->iTrackSeconds) {
     fprintf(stderr, "DAEX: Unable to allocate memory for the track play time array.\n");
@@ -169,7 +176,7 @@ fnCDDB_BuildQueryString(void *pvDiscInformation)
   snprintf(szQuery, sizeof(szQuery), "cddb query %s %d %s%d", szDiscID, 
           pstTOCheader->ending_track, szTemp1, pstCDDBinformation->iDiscTotalSeconds);
 
-  if (! (pstCDDBinformation->szCDDBquery = strdup(szQuery))) {
+  if (! (pstCDDBinformation->szCDDBquery = fnArena_Strdup(pstDiscInformation->pstArena, szQuery))) {
     fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the CDDB query string.\n");
     return -1;
   }
@@ -178,105 +185,322 @@ fnCDDB_BuildQueryString(void *pvDiscInformation)
 }
 
 
+/*========================================================================*/
+void
+fnCDDB_InitConnection(struct CDDBconnection_t *pstConnection, int iSocketFD)
+/*
+ * Set up a connection's read buffer, empty, over a connected socket.  Each
+ * connection buffers its own input, so any number of sessions may be open
+ * at once.
+ *
+ *   Input:  pstConnection - The connection.
+ *           iSocketFD     - A connected socket.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  pstConnection->iSocketFD  = iSocketFD;
+  pstConnection->iTimeout   = -1;
+  pstConnection->iRequests  = 0;
+  pstConnection->iKeepAlive = 1;
+  pstConnection->iFraming   = kiCDDB_Stream;
+  pstConnection->iStart     = 0;
+  pstConnection->iEnd       = 0;
+  pstConnection->iRaw       = 0;
+}
+
+
 /*========================================================================*/
 int
-fnReadChar(int iSocketFD, char *cBuffer)
+fnCDDB_Unframe(struct CDDBconnection_t *pstConnection)
 /*
- * Set a static pointer to the first character in a static array. Read 
- * characters from the socket's input buffer, and store them in the buffer.
- * Each time the function is called, return the next character in the buffer.
- * If no more characters are available, attempt to fill the buffer once again 
- * through another call to "read".  Exit on error.
+ * Take as much of the input read as possible out of its HTTP framing, and
+ * make it available to fnCDDB_ReadLine().  A Content-Length body stops at
+ * its length; a chunked one has its chunk sizes and trailer cut out, in
+ * place.
  *
- *   Input:  iSocketFD  - A connected socket.
- *           cBuffer    - The memory location where we'll place the next character read
- *                        from the buffer.
+ *   Input:  pstConnection - The connection.
  *
- * Returns:  -1 on error, 1 on success.
+ * Returns:  -1 on a malformed chunk size (errno is EPROTO), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  char   *pFraming,				/* A line of framing         */
+         *pNewline,				/* ... its end               */
+         *pEnd;					/* The end of a chunk size   */
+  size_t iTake,					/* Bytes of data taken       */
+         iLine;					/* Bytes of framing          */
+
+
+  if (pstConnection->iFraming == kiCDDB_Stream) {
+    pstConnection->iEnd = pstConnection->iRaw;
+    return 0;
+  }
+
+  while ((pstConnection->iEnd < pstConnection->iRaw) &&
+         ((pstConnection->iFraming == kiCDDB_Length) ||
+          (pstConnection->iChunkState != kiCDDB_ChunkDone))) {
+
+    if ((pstConnection->iFraming == kiCDDB_Length) ||
+        (pstConnection->iChunkState == kiCDDB_ChunkData)) {
+      iTake = pstConnection->iRaw - pstConnection->iEnd;
+
+      if (iTake > (size_t) pstConnection->lBodyLeft)  iTake = pstConnection->lBodyLeft;
+
+      pstConnection->iEnd      += iTake;
+      pstConnection->lBodyLeft -= iTake;
+
+      if (pstConnection->iFraming == kiCDDB_Length)  return 0;
+
+      if (pstConnection->lBodyLeft == 0)
+        pstConnection->iChunkState = kiCDDB_ChunkEnd;
+
+      continue;
+    }
+
+    /* The rest of the framing comes a line at a time. */
+    pFraming = pstConnection->aBuffer + pstConnection->iEnd;
+
+    if (! (pNewline = memchr(pFraming, '\n', pstConnection->iRaw - pstConnection->iEnd)))
+      return 0;
+
+    iLine = pNewline + 1 - pFraming;
+    *pNewline = 0;
+
+    switch (pstConnection->iChunkState) {
+      case kiCDDB_ChunkEnd:
+        pstConnection->iChunkState = kiCDDB_ChunkSize;
+        break;
+
+      case kiCDDB_ChunkSize:
+        pstConnection->lBodyLeft = strtol(pFraming, &pEnd, 16);
+
+        if ((pEnd == pFraming) || (pstConnection->lBodyLeft < 0)) {
+          errno = EPROTO;
+          return -1;
+        }
+
+        pstConnection->iChunkState = pstConnection->lBodyLeft ? kiCDDB_ChunkData :
+                                                                kiCDDB_ChunkTrailer;
+        break;
+
+      case kiCDDB_ChunkTrailer:
+        if ((*pFraming == '\r') || (*pFraming == 0))
+          pstConnection->iChunkState = kiCDDB_ChunkDone;
+        break;
+    }
+
+    memmove(pFraming, pFraming + iLine, pstConnection->iRaw - pstConnection->iEnd - iLine);
+    pstConnection->iRaw -= iLine;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCDDB_ReadLine(struct CDDBconnection_t *pstConnection, char **pszLine)
+/*
+ * Return the next line from the connection.  The socket is read a buffer
+ * at a time, and the buffer searched for the end of each line; the line
+ * is handed back where it lies, with its "\r\n" replaced by a NULL, and
+ * stays valid until the next call.  A last line without a newline is
+ * returned as it is.  Should the connection have a timeout, no read waits
+ * longer than that; a timeout of 0 never waits at all.  Over HTTP, the
+ * input ends with the body of the reply.
+ *
+ *   Input:  pstConnection - The connection.
+ *           pszLine       - Where to put a pointer to the line.
+ *
+ * Returns:  The number of bytes the line took up (at least 1), 0 at the
+ *           end of the input, or -1 on error (see errno; EMSGSIZE for a
+ *           line longer than the buffer, ETIMEDOUT if the timeout passed,
+ *           or EAGAIN if it is 0 and no whole line has arrived).
  *
- *           cBuffer    - A character from the static read buffer.
+ *           pszLine       - The line.
  */
 /*========================================================================*/
 {
-  static int iCharactersRead = 0;
-  static char *pBuffer;
-  static char szBuffer[MAX_CDDB_LINE_LENGTH];
+  struct pollfd stPoll;				/* Waiting for input         */
+  char    *pNewline;				/* The end of the line       */
+  size_t  iScanned;				/* Bytes known to hold none  */
+  ssize_t iRead;				/* Bytes read from socket    */
+  int     iReady;				/* Input has arrived (flag)  */
+
+
+  iScanned = 0;
+
+  for (;;) {
+    /* Is there a whole line buffered? */
+    if ((pNewline = memchr(pstConnection->aBuffer + pstConnection->iStart + iScanned, '\n',
+                           pstConnection->iEnd - pstConnection->iStart - iScanned))) {
+      *pszLine = pstConnection->aBuffer + pstConnection->iStart;
+      iRead    = pNewline + 1 - *pszLine;
 
+      if ((pNewline > *pszLine) && (pNewline[-1] == '\r'))  pNewline--;
+      *pNewline = 0;
 
-  if (iCharactersRead <= 0) {
+      pstConnection->iStart += iRead;
+      return iRead;
+    }
+
+    iScanned = pstConnection->iEnd - pstConnection->iStart;
+
+    /* No -- move what there is of it to the front, and read some more. */
+    if (pstConnection->iStart > 0) {
+      memmove(pstConnection->aBuffer, pstConnection->aBuffer + pstConnection->iStart,
+              pstConnection->iRaw - pstConnection->iStart);
+      pstConnection->iEnd  -= pstConnection->iStart;
+      pstConnection->iRaw  -= pstConnection->iStart;
+      pstConnection->iStart = 0;
+    }
+
+    /* At the end of an HTTP body, there is nothing more to read. */
+    if (((pstConnection->iFraming == kiCDDB_Length) && (pstConnection->lBodyLeft == 0)) ||
+        ((pstConnection->iFraming == kiCDDB_Chunked) &&
+         (pstConnection->iChunkState == kiCDDB_ChunkDone)))
+      break;
+
+    if (pstConnection->iRaw == kiCDDB_ReadBuffer) {
+      errno = EMSGSIZE;
+      return -1;
+    }
 
-   repeat:
-    if ((iCharactersRead = read(iSocketFD, &szBuffer, sizeof(szBuffer))) < 0) {
-      if (errno == EINTR)  goto repeat;
-      else  return -1;
+    if (pstConnection->iTimeout >= 0) {
+      stPoll.fd     = pstConnection->iSocketFD;
+      stPoll.events = POLLIN;
+
+      if ((iReady = poll(&stPoll, 1, pstConnection->iTimeout)) < 0) {
+        if (errno == EINTR)  continue;
+        return -1;
 
-    } else if (iCharactersRead == 0)  return 0;
+      } else if (iReady == 0) {
+        errno = pstConnection->iTimeout ? ETIMEDOUT : EAGAIN;
+        return -1;
+      }
+    }
 
-    pBuffer = szBuffer;
+    if ((iRead = read(pstConnection->iSocketFD, pstConnection->aBuffer + pstConnection->iRaw,
+                      kiCDDB_ReadBuffer - pstConnection->iRaw)) < 0) {
+      if (errno == EINTR)  continue;
+      return -1;
+    }
+
+    if (iRead == 0) {
+      pstConnection->iKeepAlive = 0;
+      break;
+    }
+
+    pstConnection->iRaw += iRead;
+
+    if (fnCDDB_Unframe(pstConnection) < 0)
+      return -1;
   }
 
-  iCharactersRead--;
-  *cBuffer = *pBuffer++;
+  /* At the end of the input, hand back whatever is left. */
+  if (pstConnection->iEnd == pstConnection->iStart)  return 0;
+
+  *pszLine = pstConnection->aBuffer + pstConnection->iStart;
+  iRead    = pstConnection->iEnd - pstConnection->iStart;
 
-  return 1;
+  pstConnection->aBuffer[pstConnection->iEnd] = 0;
+  pstConnection->iStart = pstConnection->iEnd;
+  return iRead;
 }
 
 
 /*========================================================================*/
 int
-fnReadLine(int iSocketFD, char *szBuffer, int iMaxSize)
+fnCDDB_ParseEntryLine(void *pvDiscInformation, char *szLine, int *piTrackTitleIndex)
 /*
- * Read characters from fnReadChar() until the buffer provided is filled,
- * a newline is returned, there are no more characters, or we encounter an 
- * error.
+ * Take the disc title or a track title from a line of an xmcd entry, and
+ * store it in the appropriate location in the DiscInformation_t struct
+ * (pvDiscInformation).  Other lines are ignored.  The entry may come from
+ * a server, or from the freedb index.
  *
- *   Input:  iSocketFD - A connected socket.
- *           szBuffer  - Buffer to store the line read.
- *           iMaxSize  - Maximum size of szBuffer.
+ *   Input:  pvDiscInformation - Pointer to the disc information structure,
+ *                               with its track title array allocated.
+ *           szLine            - The line, without its "\r\n".
+ *           piTrackTitleIndex - Track titles stored so far, plus one.
  *
- * Returns:  Number of bytes stored in the buffer.
+ * Returns:  pvDiscInformation - Disc or track title information
+ *           piTrackTitleIndex - ... advanced past a track title.
  *
- *           szBuffer  - Characters read from the socket.
+ *            0 - No error.
+ *           -1 - Memory allocation error, or too many track titles.
  */
 /*========================================================================*/
 {
-  int iCharactersRead,
-      iCounter;
-  char cTemp;
-  char *pBuffer;
+  struct DiscInformation_t *pstDiscInfo;     /* Disc information structure.           */
+  struct ioc_toc_header *pstTOCheader;       /* Disc's Table Of Contents header.      */
+  struct CDDBinformation_t *pstCDDBinfo;     /* Returned CDDB information             */
+  char szTempTitle[80];                      /* Temporary (disc|track) title          */
+  int iTrack;                                /* Track returned by the query. Not used */
 
 
-  pBuffer = szBuffer;
+  pstDiscInfo  = (struct DiscInformation_t *) pvDiscInformation;
+  pstTOCheader = pstDiscInfo->pstTOCheader;
+  pstCDDBinfo  = pstDiscInfo->pstCDDBinformation;
+
+  /* Clear the temporary title, as an empty title won't. */
+  szTempTitle[0] = 0;
 
-  for (iCounter=1; iCounter < iMaxSize; iCounter++) {
-    if ((iCharactersRead = fnReadChar(iSocketFD, &cTemp)) < 0) {
-      return -1;   /* Error. */
+  /*********************************************************************
+   * Read the disc title and store it in the CDDB info structure as
+   * szDiscTitle.  Titles are copied into the disc's arena at their
+   * own length; should there be multiple DTITLE lines, the last wins.
+   *********************************************************************/
 
-    } else if (iCharactersRead == 0) {
-      if (iCounter == 1)
-        return 0;  /* EOF, no data read. */
-      else 
-        break;     /* EOF, terminate and return data received. */
+  if (sscanf(szLine, "DTITLE=%79[^\r\n]", szTempTitle) > 0) {
+
+    if (! (pstCDDBinfo->szDiscTitle = fnArena_Strdup(pstDiscInfo->pstArena, szTempTitle))) {
+      fprintf(stderr, "Unable to allocate sufficient memory for the disc title.\n");
+      return -1;
     }
 
-    *pBuffer++ = cTemp;
-    if (cTemp == '\n')  break;
+    return 0;
   }
 
-  *pBuffer = 0;
+  /*********************************************************************
+   * Read the track title, and store in the appropriate location in the
+   * track title array.
+   *********************************************************************/
+
+  if (sscanf(szLine, "TTITLE%u=%79[^\r\n]", &iTrack, szTempTitle) > 0) {
+
+    /* Check for any inconsistency between the number of tracks expected and the
+     * number of tracks returned.
+     */
+    if (*piTrackTitleIndex > pstTOCheader->ending_track) {
+      fprintf(stderr, "DAEX: Too many titles returned (%d expected, %d returned).\n",
+              pstTOCheader->ending_track, *piTrackTitleIndex);
+      return -1;
+    }
+
+    if (! (pstCDDBinfo->szTrackTitle[*piTrackTitleIndex - 1] =
+           fnArena_Strdup(pstDiscInfo->pstArena, szTempTitle))) {
+      fprintf(stderr, "Unable to allocate sufficient memory for the track title.\n");
+      return -1;
+    }
+
+    /* Increase the track title index. */
+    (*piTrackTitleIndex)++;
+  }
 
-  return iCounter;
+  return 0;
 }
 
 
 /*========================================================================*/
 int
-fnCDDB_ReadEntry(int iSocketFD, void *pvDiscInformation)
+fnCDDB_ReadEntry(struct CDDBconnection_t *pstConnection, void *pvDiscInformation)
 /*
  * Read the disc title and track title information, and store in the
  * appropriate locations in the DiscInformation_t struct (pvDiscInformation).
  *
- *   Input:  iSocketFD         - A connected socket.
+ *   Input:  pstConnection     - A connection to the server.
  *           pvDiscInformation - Pointer to the disc information structure.
  *
  * Returns:  pvDiscInformation - Disc and track title information 
@@ -291,309 +515,860 @@ fnCDDB_ReadEntry(int iSocketFD, void *pvDiscInformation)
   struct DiscInformation_t *pstDiscInfo;     /* Disc information structure.           */
   struct ioc_toc_header *pstTOCheader;       /* Disc's Table Of Contents header.      */
   struct CDDBinformation_t *pstCDDBinfo;     /* Returned CDDB information             */
-  char szInputBuffer[MAX_CDDB_LINE_LENGTH],  /* Input buffer read from the file desc. */
-       *szTempTitle,                         /* Temporary (disc|track) title          */
-       *szTempTitle_Realloced;               /* Reallocated (disc|track) title        */
+  char *szInputBuffer;                       /* A line read from the connection       */
   int iTrackTitleIndex = 1;                  /* Index for the track title array       */ 
-  int iTrack,                                /* Track returned by the query. Not used */
-      iCharactersRead;                       /* Number of char's return by fnReadLine */
+  int iCharactersRead;                       /* Number of char's return by fnReadLine */
 
 
   pstDiscInfo  = (struct DiscInformation_t *) pvDiscInformation;
   pstTOCheader = pstDiscInfo->pstTOCheader;
   pstCDDBinfo  = pstDiscInfo->pstCDDBinformation;
 
-  if (! (pstCDDBinfo->szTrackTitle = (char **) calloc(pstTOCheader->ending_track, sizeof(char *)))) {
+  if (! (pstCDDBinfo->szTrackTitle = (char **)
+         fnArena_Alloc(pstDiscInfo->pstArena, pstTOCheader->ending_track * sizeof(char *)))) {
     fprintf(stderr, "Unable to allocate sufficient memory for the track titles array.\n");
     return -1;
   }
 
-  if (! (szTempTitle = (char *) calloc(1, 80))) {
-    fprintf(stderr, "Unable to allocate sufficient memory for the temporary title.\n");
-    return -1;
-  }
-
   /* Read the contents of the query. */
-  while((iCharactersRead = fnReadLine(iSocketFD, szInputBuffer, MAX_CDDB_LINE_LENGTH)) > 0) {
+  while((iCharactersRead = fnCDDB_ReadLine(pstConnection, &szInputBuffer)) > 0) {
 
 #ifdef CDDB_DEBUG
     /* Display the server's response. */
-    fprintf(stderr, "CDDBD: %s", szInputBuffer);
+    fprintf(stderr, "CDDBD: %s\n", szInputBuffer);
 #endif
 
     /* If a period is found on a line by itself, we break -- CDDBP uses this as
      * a terminating marker.
      */
-    if (strncmp(szInputBuffer, ".\r\n", 3) == 0) {
+    if (strcmp(szInputBuffer, ".") == 0) {
 #ifdef CDDB_DEBUG
       fprintf(stderr, "DAEX: Received terminating marker.\n"); 
 #endif
       break; 
     }
 
-    /*********************************************************************
-     * Read the disc title and store it in the CDDB info structure as
-     * szDiscTitle.
-     *********************************************************************/
+    if (fnCDDB_ParseEntryLine(pstDiscInfo, szInputBuffer, &iTrackTitleIndex) < 0)
+      return -1;
+  }
 
-    if (sscanf(szInputBuffer, "DTITLE=%79[^\r\n]\r\n", szTempTitle) > 0) {
+  /* If there was an error reading from the socket, or the remote end closed the
+   * connection, alert the user.
+   */
+  if (iCharactersRead < 0) {
+    fprintf(stderr, "DAEX: Error reading from socket: %s.\n", strerror(errno));
+    return -2;
 
-      /* Prevent memory leaks in the event that there are multiple DTITLE
-       * lines.
-       */
-      if (pstCDDBinfo->szDiscTitle)  free(pstCDDBinfo->szDiscTitle);
+  } else if (iCharactersRead == 0) {
+    fprintf(stderr, "DAEX: Session terminated prematurely.\n");
+    return -3;
+  }
 
-      /* We attempt to use only the space necessary to store the disc's title. */
-      if ((szTempTitle_Realloced = (char *) realloc(szTempTitle, strlen(szTempTitle) + 1))) {
+  /* Check for any inconsistency between the number of tracks expected and the
+   * number of tracks returned.
+   */
+  if (iTrackTitleIndex - 1 < pstTOCheader->ending_track) {
+    fprintf(stderr, "DAEX: Too few titles returned (%d expected, %d returned).\n", 
+            pstTOCheader->ending_track, iTrackTitleIndex - 1);
+    return -2;
+  }
 
-        /* Attempt to copy the temporary title into the CDDB info structure. */
-        if (! (pstCDDBinfo->szDiscTitle = (char *) strdup(szTempTitle_Realloced))) {
-          fprintf(stderr, "Unable to allocate sufficient memory for the disc title.\n");
-          return -1;
-        }
-   
-	/* Attempt to reset the temporary title to 80 bytes. If realloc()'ing fails,
-	 * free the memory once used, and re-malloc() it.  If this fails, exit.
-         */
-        if (! (szTempTitle = (void *) realloc(szTempTitle_Realloced, 80))) {
-          free(szTempTitle_Realloced);
-          szTempTitle_Realloced = NULL;
-
-          if (! (szTempTitle = (void *) malloc(80))) {
-            fprintf(stderr, "Unable to allocate sufficient memory for the temporary title.\n");
-            return -1;
-          }
-	}
+  return 0;
+}
 
+
+/*========================================================================*/
+int
+fnCDDB_ParseServers(char *szServers, struct CDDBserver_t *astServers, int iMaxServers)
+/*
+ * Split a list of CDDB servers, each either "hostname:port" for a cddbp
+ * server or "http://hostname[:port][/path]" for a cddb.cgi one, separated
+ * by commas.
+ *
+ *   Input:  szServers   - The list.
+ *           astServers  - Where to put the servers.
+ *           iMaxServers - Room at astServers.
+ *
+ * Returns:  The number of servers, or -1 if the list is malformed, empty
+ *           or too long.
+ */
+/*========================================================================*/
+{
+  struct CDDBserver_t *pstServer;		/* The current server        */
+  char szList[kiMaxStringLength],		/* A copy of the list        */
+       *pList,					/* What's left of it         */
+       *pServer,				/* The current server's entry */
+       *pHost,					/* ... its hostname          */
+       *pPath;					/* ... and cddb.cgi's path   */
+  int  iServers = 0;				/* Servers found             */
+
+
+  snprintf(szList, sizeof(szList), "%s", szServers);
+  pList = szList;
+
+  while ((pServer = strsep(&pList, ","))) {
+    if (iServers == iMaxServers)
+      return -1;
+
+    pstServer = &astServers[iServers];
+
+    if (strncasecmp(pServer, "http://", 7) == 0) {
+      pServer += 7;
+
+      if ((pPath = strchr(pServer, '/'))) {
+        snprintf(pstServer->szPath, sizeof(pstServer->szPath), "%s", pPath);
+        *pPath = 0;
       } else
-	 /* The reallocation failed -- copy the title to the CDDB info structure as it 
-          * was.  Exit upon failure.
-          */
-         if (! (pstCDDBinfo->szDiscTitle = (char *) strdup(szTempTitle))) {
-           fprintf(stderr, "Unable to allocate sufficient memory for the disc title.\n");
-           return -1;
-         }
+        snprintf(pstServer->szPath, sizeof(pstServer->szPath), "%s", kszCDDB_DefaultPath);
+
+      pHost = strsep(&pServer, ":");
+      pstServer->iPort = pServer ? atoi(pServer) : kiCDDB_HTTPPort;
+
+    } else {
+      pstServer->szPath[0] = 0;
+
+      pHost = strsep(&pServer, ":");
 
-       /* Clear the temporary title for reuse. */
-       memset(szTempTitle, 0, 80);
+      if (!pServer)
+        return -1;
 
-       continue;
+      pstServer->iPort = atoi(pServer);
     }
 
-    /*********************************************************************
-     * Read the track title, and store in the appropriate location in the
-     * track title array.
-     *********************************************************************/
+    if (!*pHost || (pstServer->iPort < 1) || (pstServer->iPort > 65535))
+      return -1;
 
-    if (sscanf(szInputBuffer, "TTITLE%u=%79[^\r\n]\r\n", &iTrack, szTempTitle) > 0) {
+    snprintf(pstServer->szHost, sizeof(pstServer->szHost), "%s", pHost);
 
-      /* Check for any inconsistency between the number of tracks expected and the
-       * number of tracks returned.
-       */
-      if (iTrackTitleIndex > pstTOCheader->ending_track) {
-        fprintf(stderr, "DAEX: Too many titles returned (%d expected, %d returned).\n",
-                pstTOCheader->ending_track, iTrackTitleIndex);
-        return -1;
-      }
+    iServers++;
+  }
 
-      /* We attempt to use only the space necessary to store the track's title. */
-      if ((szTempTitle_Realloced = (char * ) realloc(szTempTitle, strlen(szTempTitle) + 1))) {
+  return iServers ? iServers : -1;
+}
 
-        /* Attempt to copy the temporary title into the CDDB info structure's track
-         * title array. 
-         */
-        if (! (pstCDDBinfo->szTrackTitle[iTrackTitleIndex - 1] = 
-	                               (char *) strdup(szTempTitle_Realloced))) {
-          fprintf(stderr, "Unable to allocate sufficient memory for the track title.\n");
-          return -1;
-        }
 
-	/* Attempt to reset the temporary title to 80 bytes. If realloc()'ing fails,
-	 * free the memory once used, and re-malloc() it.  If this fails, exit.
-         */
-        if (! (szTempTitle = (void *) realloc(szTempTitle_Realloced, 80))) {
-          free(szTempTitle_Realloced);
-          szTempTitle_Realloced = NULL;
+/*========================================================================*/
+int
+fnCDDB_Reconnect(struct CDDBconnection_t *pstConnection)
+/*
+ * Open a new connection to the server an HTTP connection was made to, in
+ * place of the old one, for a server that won't keep it open.
+ *
+ *   Input:  pstConnection - The connection.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct pollfd stPoll;				/* Waiting for the connect   */
+  socklen_t iLength;				/* Length of iError          */
+  int    iSocket,				/* The new connection        */
+         iError,				/* How the connect went      */
+         iTimeout;				/* The read timeout          */
 
-          if (! (szTempTitle = (void *) malloc(80))) {
-            fprintf(stderr, "Unable to allocate sufficient memory for the temporary title.\n");
-            return -1;
-          }
-	}
 
-      } else
-	 /* The reallocation failed -- copy the track title to the CDDB info structure's
-          * track title array as it was.  Exit upon failure.
-          */
-         if (! (pstCDDBinfo->szTrackTitle[iTrackTitleIndex - 1] = (char *) strdup(szTempTitle))) {
-           fprintf(stderr, "Unable to allocate sufficient memory for the track title.\n");
-           return -1;
-         }
+  close(pstConnection->iSocketFD);
 
-      /* Clear the temporary title for reuse. */
-      memset(szTempTitle, 0, 80);
+  iTimeout = pstConnection->iTimeout;
+  fnCDDB_InitConnection(pstConnection, -1);
+  pstConnection->iTimeout = iTimeout;
 
-      /* Increase the track title index. */
-      iTrackTitleIndex++;
+  if ((iSocket = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    return -1;
 
-      continue;
+  fcntl(iSocket, F_SETFL, fcntl(iSocket, F_GETFL) | O_NONBLOCK);
+
+  if (connect(iSocket, (struct sockaddr *) &pstConnection->stAddress,
+              sizeof(pstConnection->stAddress)) < 0) {
+    if (errno != EINPROGRESS) {
+      close(iSocket);
+      return -1;
+    }
+
+    stPoll.fd     = iSocket;
+    stPoll.events = POLLOUT;
+    iLength       = sizeof(iError);
+
+    if ((iError = poll(&stPoll, 1, kiCDDB_ConnectTimeout * 1000)) <= 0)
+      iError = iError ? errno : ETIMEDOUT;
+    else if (getsockopt(iSocket, SOL_SOCKET, SO_ERROR, &iError, &iLength) < 0)
+      iError = errno;
+
+    if (iError) {
+      close(iSocket);
+      errno = iError;
+      return -1;
     }
   }
 
-  /* Clean up the temporary buffers. */
-  free(szTempTitle);
+  fcntl(iSocket, F_SETFL, fcntl(iSocket, F_GETFL) & ~O_NONBLOCK);
+  pstConnection->iSocketFD = iSocket;
 
-  /* If there was an error reading from the socket, or the remote end closed the
-   * connection, alert the user.
-   */
-  if (iCharactersRead < 0) {
-    fprintf(stderr, "DAEX: Error reading from socket: %s.\n", strerror(errno));
-    return -2;
+  return 0;
+}
 
-  } else if (iCharactersRead == 0) {
-    fprintf(stderr, "DAEX: Session terminated prematurely.\n");
-    return -3;
+
+/*========================================================================*/
+int
+fnCDDB_AddParameter(char *szBuffer, size_t iSize, char *szName, char *szText)
+/*
+ * Add a parameter to a URL's query, its value encoded: spaces become "+",
+ * and anything but a letter, digit or one of "-_.~" becomes "%xx".
+ *
+ *   Input:  szBuffer - The URL so far.
+ *           iSize    - Room at szBuffer.
+ *           szName   - The parameter's name.
+ *           szText   - ... and its value.
+ *
+ * Returns:  -1 if the URL won't fit, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  size_t iLength;				/* Length of the URL         */
+
+
+  iLength = strlen(szBuffer);
+  iLength += snprintf(szBuffer + iLength, iSize - iLength, "%c%s=",
+                      strchr(szBuffer, '?') ? '&' : '?', szName);
+
+  if (iLength >= iSize)
+    return -1;
+
+  for (; *szText; szText++) {
+    if (iLength + 4 > iSize)
+      return -1;
+
+    if (isalnum((unsigned char) *szText) || strchr("-_.~", *szText))
+      szBuffer[iLength++] = *szText;
+    else if (*szText == ' ')
+      szBuffer[iLength++] = '+';
+    else
+      iLength += sprintf(szBuffer + iLength, "%%%02X", (unsigned char) *szText);
   }
 
-  /* Check for any inconsistency between the number of tracks expected and the
-   * number of tracks returned.
-   */
-  if (iTrackTitleIndex - 1 < pstTOCheader->ending_track) {
-    fprintf(stderr, "DAEX: Too few titles returned (%d expected, %d returned).\n", 
-            pstTOCheader->ending_track, iTrackTitleIndex - 1);
+  szBuffer[iLength] = 0;
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCDDB_ReadResponse(struct CDDBconnection_t *pstConnection)
+/*
+ * Read an HTTP reply's status line and headers, and set the connection up
+ * to read its body, the CDDB server's reply, through fnCDDB_ReadLine().
+ *
+ *   Input:  pstConnection - The connection.
+ *
+ * Returns:  -2 if the reply was an error (it is shown), -1 if there was
+ *           no reply (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  char   szStatus[MAX_CDDB_LINE_LENGTH],	/* The status line           */
+         *szLine,				/* A header                  */
+         *pValue;				/* ... its value             */
+  long   lLength = -1;				/* Content-Length, if given  */
+  int    iMajor, iMinor,			/* HTTP version              */
+         iStatus,				/* Status code               */
+         iChunked = 0,				/* Chunked body (flag)       */
+         iRead;					/* Bytes read                */
+
+
+  /* The headers aren't framed; everything read until the body is. */
+  pstConnection->iFraming = kiCDDB_Stream;
+  pstConnection->iEnd     = pstConnection->iRaw;
+
+  if ((iRead = fnCDDB_ReadLine(pstConnection, &szLine)) <= 0) {
+    if (iRead == 0)  errno = ECONNRESET;
+    return -1;
+  }
+
+  if (sscanf(szLine, "HTTP/%d.%d %d", &iMajor, &iMinor, &iStatus) != 3) {
+    errno = EPROTO;
+    return -1;
+  }
+
+  snprintf(szStatus, sizeof(szStatus), "%s", szLine);
+
+  /* HTTP/1.1 connections stay open unless the server says otherwise. */
+  pstConnection->iKeepAlive = (iMajor * 10 + iMinor >= 11);
+
+  while ((iRead = fnCDDB_ReadLine(pstConnection, &szLine)) > 0) {
+    if (!*szLine)  break;
+
+    if (! (pValue = strchr(szLine, ':')))
+      continue;
+
+    for (*pValue++ = 0; (*pValue == ' ') || (*pValue == '\t'); pValue++)
+      ;
+
+    if (strcasecmp(szLine, "Content-Length") == 0)
+      lLength = atol(pValue);
+    else if (strcasecmp(szLine, "Transfer-Encoding") == 0)
+      iChunked = (strcasecmp(pValue, "chunked") == 0);
+    else if (strcasecmp(szLine, "Connection") == 0) {
+      if (strcasecmp(pValue, "close") == 0)
+        pstConnection->iKeepAlive = 0;
+      else if (strcasecmp(pValue, "keep-alive") == 0)
+        pstConnection->iKeepAlive = 1;
+    }
+  }
+
+  if (iRead <= 0) {
+    if (iRead == 0)  errno = ECONNRESET;
+    return -1;
+  }
+
+  if (iStatus != 200) {
+    fprintf(stderr, "DAEX: %s:%i: %s.\n", pstConnection->stServer.szHost,
+            pstConnection->stServer.iPort, szStatus);
+    pstConnection->iKeepAlive = 0;
     return -2;
   }
 
+  if (iChunked) {
+    pstConnection->iFraming    = kiCDDB_Chunked;
+    pstConnection->iChunkState = kiCDDB_ChunkSize;
+
+  } else if (lLength >= 0) {
+    pstConnection->iFraming  = kiCDDB_Length;
+    pstConnection->lBodyLeft = lLength;
+
+  } else
+    pstConnection->iKeepAlive = 0;
+
+  /* What has been read of the body goes back through its framing. */
+  pstConnection->iEnd = pstConnection->iStart;
+
+  if (fnCDDB_Unframe(pstConnection) < 0)
+    return -1;
+
+  pstConnection->iRequests++;
   return 0;
 }
 
 
 /*========================================================================*/
-int
-fnCDDB_DoDNSlookup(char *szArg1, void *pvInetAddress)
+void
+fnCDDB_Hello(char *szBuffer, size_t iSize)
 /*
- * Do a lookup on the hostname or IP provided, and return the resulting
- * network address.
+ * Say who we are, as the CDDB "hello" command wants: the user's name,
+ * the hostname, and the client and its version.
  *
- *   Input:  szArg1        - Hostname or IP address (a.b.c.d)
- *           pvInetAddress - Pointer to the network address.
+ *   Input:  szBuffer - Where to put it.
+ *           iSize    - Room at szBuffer.
  *
- * Returns:  pvInetAddress - Pointer to the network address.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  char szHostname[MAXHOSTNAMELEN],		/* Hostname of this machine  */
+       *szLoginName;				/* Current user's name       */
+
+
+  /* Attempt to grab the current user's username and the hostname.  If
+   * this fails, make up generic ones.
+   */
+  if (! (szLoginName = getlogin()))
+    szLoginName = "unknown";
+
+  if (gethostname(szHostname, MAXHOSTNAMELEN) < 0)
+    snprintf(szHostname, MAXHOSTNAMELEN, "unknown.hostname");
+
+  snprintf(szBuffer, iSize, "%s %s DAEX %s", szLoginName, szHostname, kszVersion);
+}
+
+
+/*========================================================================*/
+int
+fnCDDB_SendCommand(struct CDDBconnection_t *pstConnection, char *szCommand)
+/*
+ * Send a CDDB command.  To a cddbp server, it is sent as it is.  To a
+ * cddb.cgi server, it goes as an HTTP request along with our "hello", and
+ * the reply's headers are read; the connection is kept open between
+ * requests if the server allows, and reopened if it doesn't, or if it was
+ * closed while idle.
  *
- *            0 - No error.
- *           -1 - Error resolving the address.
+ *   Input:  pstConnection - A connection to the server.
+ *           szCommand     - The command, without the "\r\n".
+ *
+ * Returns:  -1 on error, 0 otherwise.
  */
 /*========================================================================*/
 {
-  struct hostent *pstHostEntry;               /* Host entry structure for gethostbyname() */
-  struct in_addr *pstInetAddress;             /* InetAddr structure for the remote IP.    */
+  char   szRequest[kiCDDB_HTTPRequest],		/* The request               */
+         szHello[MAX_CDDB_LINE_LENGTH],		/* Our "hello"               */
+         *szLine;				/* Rest of the last reply    */
+  size_t iLength;				/* Length of the request     */
+  int    iReturnValue,				/* fnCDDB_ReadResponse()'s   */
+         iRetry;				/* Retried once (flag)       */
+
+
+  if (!pstConnection->stServer.szPath[0]) {
+    snprintf(szRequest, sizeof(szRequest), "%s\r\n", szCommand);
+
+    if (write(pstConnection->iSocketFD, szRequest, strlen(szRequest)) < 0) {
+      fprintf(stderr, "DAEX: Error writing to socket: %s.\n", strerror(errno));
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /* Skip whatever is left of the last reply's body. */
+  if (pstConnection->iFraming != kiCDDB_Stream)
+    while (fnCDDB_ReadLine(pstConnection, &szLine) > 0)
+      ;
+
+  fnCDDB_Hello(szHello, sizeof(szHello));
+
+  snprintf(szRequest, sizeof(szRequest), "GET %s", pstConnection->stServer.szPath);
 
+  if ((fnCDDB_AddParameter(szRequest, sizeof(szRequest), "cmd", szCommand) < 0) ||
+      (fnCDDB_AddParameter(szRequest, sizeof(szRequest), "hello", szHello) < 0) ||
+      (fnCDDB_AddParameter(szRequest, sizeof(szRequest), "proto", "1") < 0)) {
+    fprintf(stderr, "DAEX: Command exceeds the size of the HTTP request.\n");
+    return -1;
+  }
 
-  pstInetAddress = (struct in_addr *) pvInetAddress;
+  iLength = strlen(szRequest);
+  snprintf(szRequest + iLength, sizeof(szRequest) - iLength,
+           " HTTP/1.1\r\nHost: %s:%i\r\nUser-Agent: DAEX/%s\r\n"
+           "Connection: keep-alive\r\n\r\n",
+           pstConnection->stServer.szHost, pstConnection->stServer.iPort, kszVersion);
 
-  /* We first attempt to convert the argument as a numeric IP address, and store it in 
-   * sInetAddress as a network compatible address.  If this fails, we attempt to convert
-   * the argument as a hostname, and store the primary address returned in sInetAddress as
-   * a network compatible address.  On error, we return -1.
+#ifdef CDDB_DEBUG
+  fprintf(stderr, "DAEX: HTTP request follows:\n%s", szRequest);
+#endif
+
+  /* A connection that has been idle may have been closed by the server;
+   * one that has answered before gets a second chance on a new one.
    */
-  if (!inet_aton(szArg1, pstInetAddress)) {
-    if (! (pstHostEntry = gethostbyname(szArg1))) {
-      fprintf(stderr, "DAEX: Hostname/IP lookup failed: %s.\n", hstrerror(h_errno));
+  for (iRetry = 0; ; iRetry = 1) {
+    if ((!pstConnection->iKeepAlive || iRetry) && (fnCDDB_Reconnect(pstConnection) < 0)) {
+      fprintf(stderr, "DAEX: Unable to reconnect: %s.\n", strerror(errno));
       return -1;
     }
 
-   /* Store the primary network address (the first returned, at any rate). */
-   *pstInetAddress = * (struct in_addr *) pstHostEntry->h_addr_list[0];
+    if (send(pstConnection->iSocketFD, szRequest, strlen(szRequest), MSG_NOSIGNAL) >= 0) {
+      if ((iReturnValue = fnCDDB_ReadResponse(pstConnection)) == 0)
+        return 0;
+
+      if (iReturnValue == -2)
+        return -1;
+    }
+
+    if (iRetry || !pstConnection->iRequests) {
+      fprintf(stderr, "DAEX: HTTP request failed: %s.\n", strerror(errno));
+      return -1;
+    }
+
+    pstConnection->iKeepAlive = 0;
+  }
+}
+
+
+/*========================================================================*/
+void *
+fnCDDB_Resolve(void *pvResolve)
+/*
+ * Look up a server's address, in a thread of its own so that a slow name
+ * server can be given up on.  The address is sent back over a socket; if
+ * the lookup fails, or nobody is waiting any more, the socket is just
+ * closed.
+ *
+ *   Input:  pvResolve - The server, and the socket to answer on.  Freed
+ *                       here.
+ *
+ * Returns:  NULL.
+ */
+/*========================================================================*/
+{
+  struct CDDBresolve_t *pstResolve;		/* The request               */
+  struct addrinfo stHints,			/* The address wanted        */
+                  *pstResult;			/* ... and those found       */
+  struct sockaddr_in stAddress;			/* The one used              */
+  char   szPort[8];				/* The server's port, as text */
+
+
+  pstResolve = (struct CDDBresolve_t *) pvResolve;
+
+  memset(&stHints, 0, sizeof(stHints));
+  stHints.ai_family   = AF_INET;
+  stHints.ai_socktype = SOCK_STREAM;
+
+  snprintf(szPort, sizeof(szPort), "%i", pstResolve->stServer.iPort);
+
+  if (getaddrinfo(pstResolve->stServer.szHost, szPort, &stHints, &pstResult) == 0) {
+    memcpy(&stAddress, pstResult->ai_addr, sizeof(stAddress));
+    freeaddrinfo(pstResult);
+
+    send(pstResolve->iReply, &stAddress, sizeof(stAddress), MSG_NOSIGNAL);
   }
 
-  return 0;
+  close(pstResolve->iReply);
+  free(pstResolve);
+
+  return NULL;
 }
 
 
 /*========================================================================*/
-int
-fnCDDB_ConnectToServer(char *szHostname, int iPort)
+long
+fnCDDB_Clock(void)
+/*
+ * Returns:  A monotonic clock, in milliseconds.
+ */
+/*========================================================================*/
+{
+  struct timespec stNow;			/* The time                  */
+
+
+  clock_gettime(CLOCK_MONOTONIC, &stNow);
+
+  return stNow.tv_sec * 1000L + stNow.tv_nsec / 1000000L;
+}
+
+
+/*========================================================================*/
+void
+fnCDDB_Abandon(struct CDDBattempt_t *pstAttempt, const char *szReason)
 /*
- * Connect to the host/port specified and return the connected socket.
+ * Give up on a server, saying why.
  *
- *   Input: szHostname - Hostname/IP of the CDDB server.
- *          iPort      - Port on which the CDDB server listens.
+ *   Input:  pstAttempt - The attempt on the server.
+ *           szReason   - Why, or NULL to say nothing.
  *
- * Returns: The connected socket on success, or -1 on error.
+ * Returns:  None.
  */
 /*========================================================================*/
 {
-  int iSocketFD;                              /* The socket used to connect.             */
-  struct sockaddr_in sSocket;                 /* Socket address structure for connect(). */
-  struct in_addr *pstInetAddress;             /* InetAddr structure for the remote IP.   */
+  if (szReason)
+    fprintf(stderr, "DAEX: %s:%i: %s.\n", pstAttempt->stServer.szHost, pstAttempt->stServer.iPort,
+            szReason);
+
+  if (pstAttempt->iResolver >= 0)  close(pstAttempt->iResolver);
+  if (pstAttempt->stConnection.iSocketFD >= 0)  close(pstAttempt->stConnection.iSocketFD);
 
+  pstAttempt->iResolver              = -1;
+  pstAttempt->stConnection.iSocketFD = -1;
+  pstAttempt->iState                 = kiCDDB_Failed;
+}
 
-  /* Attempt to allocate memory for the address structure.  Return with error on error. */
-  pstInetAddress = (struct in_addr *) calloc(1, sizeof(struct in_addr));
 
-  if (!pstInetAddress) {
-    fprintf(stderr, "Unable to allocate sufficient memory for the address structure.\n");
-    return -1;
+/*========================================================================*/
+void
+fnCDDB_Advance(void *pvDiscInformation, struct CDDBattempt_t *pstAttempt)
+/*
+ * Take an attempt on a server as far as it will go without waiting: from
+ * its address to a connection, from the connection to its banner, and
+ * from the banner to the reply to our "hello" (an HTTP server is ready as
+ * soon as it is connected).  Called whenever what the attempt is waiting
+ * on is ready.
+ *
+ *   Input:  pvDiscInformation - Disc information structure.
+ *           pstAttempt        - The attempt.
+ *
+ * Returns:  None.  The attempt is kiCDDB_Ready once the server has shaken
+ *           hands, or kiCDDB_Failed.
+ */
+/*========================================================================*/
+{
+  struct sockaddr_in stAddress;			/* The server's address      */
+  socklen_t iLength;				/* ... and its length        */
+  char   *szLine;				/* A line from the server    */
+  int    iSocket,				/* The connection            */
+         iCode,					/* A reply's code            */
+         iSessionState;				/* For fnCDDB_SendRequest()  */
+  ssize_t iRead;				/* Bytes read                */
+
+
+  switch (pstAttempt->iState) {
+    case kiCDDB_Resolving:
+      iRead = recv(pstAttempt->iResolver, &stAddress, sizeof(stAddress), 0);
+
+      close(pstAttempt->iResolver);
+      pstAttempt->iResolver = -1;
+
+      if (iRead != sizeof(stAddress)) {
+        fnCDDB_Abandon(pstAttempt, "Hostname lookup failed");
+        return;
+      }
+
+      if ((iSocket = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        fnCDDB_Abandon(pstAttempt, strerror(errno));
+        return;
+      }
+
+      fnCDDB_InitConnection(&pstAttempt->stConnection, iSocket);
+      pstAttempt->stConnection.stServer  = pstAttempt->stServer;
+      pstAttempt->stConnection.stAddress = stAddress;
+      fcntl(iSocket, F_SETFL, fcntl(iSocket, F_GETFL) | O_NONBLOCK);
+
+      if ((connect(iSocket, (struct sockaddr *) &stAddress, sizeof(stAddress)) < 0) &&
+          (errno != EINPROGRESS)) {
+        fnCDDB_Abandon(pstAttempt, strerror(errno));
+        return;
+      }
+
+      pstAttempt->iState = kiCDDB_Connecting;
+      return;
+
+    case kiCDDB_Connecting:
+      iLength = sizeof(iCode);
+
+      if (getsockopt(pstAttempt->stConnection.iSocketFD, SOL_SOCKET, SO_ERROR, &iCode,
+                     &iLength) < 0)
+        iCode = errno;
+
+      if (iCode) {
+        fnCDDB_Abandon(pstAttempt, strerror(iCode));
+        return;
+      }
+
+      /* Connected.  From here on, the connection's reads don't wait. */
+      iSocket = pstAttempt->stConnection.iSocketFD;
+      fcntl(iSocket, F_SETFL, fcntl(iSocket, F_GETFL) & ~O_NONBLOCK);
+
+      pstAttempt->stConnection.iTimeout = 0;
+
+      /* cddb.cgi servers don't greet; each request carries our "hello". */
+      pstAttempt->iState = pstAttempt->stServer.szPath[0] ? kiCDDB_Ready : kiCDDB_Greeting;
+      return;
+
+    case kiCDDB_Greeting:
+    case kiCDDB_Greeted:
+      while ((iRead = fnCDDB_ReadLine(&pstAttempt->stConnection, &szLine)) > 0) {
+#ifdef CDDB_DEBUG
+        fprintf(stderr, "CDDBD: %s\n", szLine);
+#endif
+        if (sscanf(szLine, "%d", &iCode) != 1) {
+          fnCDDB_Abandon(pstAttempt, "Not a CDDB server");
+          return;
+        }
+
+        if (pstAttempt->iState == kiCDDB_Greeting) {
+          /* 200 and 201 let us in (read/write, and read only). */
+          if ((iCode != 200) && (iCode != 201)) {
+            fnCDDB_Abandon(pstAttempt, "No connections allowed");
+            return;
+          }
+
+          iSessionState = SESSION_CONNECTING;
+
+          if (fnCDDB_SendRequest(&pstAttempt->stConnection, pvDiscInformation, &iSessionState,
+                                 szLine) < 0) {
+            fnCDDB_Abandon(pstAttempt, NULL);
+            return;
+          }
+
+          pstAttempt->iState = kiCDDB_Greeted;
+
+        } else {
+          /* 200 shakes hands, and 402 says we already have. */
+          if ((iCode != 200) && (iCode != 402)) {
+            fnCDDB_Abandon(pstAttempt, "Handshake not successful");
+            return;
+          }
+
+          pstAttempt->iState = kiCDDB_Ready;
+          return;
+        }
+      }
+
+      if (iRead == 0)
+        fnCDDB_Abandon(pstAttempt, "Connection closed by the server");
+      else if (errno != EAGAIN)
+        fnCDDB_Abandon(pstAttempt, strerror(errno));
+
+      return;
   }
+}
+
 
-  /* Attempt to lookup the hostname specified by the user.  Return with error on error. */
-  if (fnCDDB_DoDNSlookup(szHostname, pstInetAddress) < 0) {
+/*========================================================================*/
+int
+fnCDDB_OpenSession(void *pvDiscInformation, char *szServers,
+                   struct CDDBconnection_t *pstConnection)
+/*
+ * Connect to one of the CDDB servers listed, and shake hands.  All of the
+ * servers are tried at once, every lookup, connection and reply being
+ * waited on together, and the first to shake hands is used; the rest are
+ * dropped.  None may take longer than kiCDDB_ConnectTimeout seconds.
+ *
+ *   Input:  pvDiscInformation - Disc information structure.
+ *           szServers         - The servers, "hostname:port[,...]".
+ *           pstConnection     - Where to put the connection.
+ *
+ * Returns:  -1 if no server could be reached, 0 otherwise.
+ *
+ *           pstConnection     - The connection, ready for a query, with
+ *                               a kiCDDB_ReadTimeout second deadline on
+ *                               each read.
+ */
+/*========================================================================*/
+{
+  struct CDDBserver_t  astServers[kiCDDB_MaxServers];	/* The servers          */
+  struct CDDBattempt_t *astAttempts;		/* ... and attempts on them  */
+  struct CDDBresolve_t *pstResolve;		/* A lookup                  */
+  struct pollfd astPoll[kiCDDB_MaxServers];	/* What's being waited on    */
+  pthread_t tResolver;				/* A lookup's thread         */
+  long   lDeadline,				/* When to give up           */
+         lRemaining;				/* ... and how long till then */
+  int    aiPolled[kiCDDB_MaxServers],		/* Attempt each poll is for  */
+         aiPair[2],				/* A lookup's reply socket   */
+         iServers,				/* Servers listed            */
+         iPolled,				/* Descriptors polled        */
+         iIndex,				/* Current attempt/poll      */
+         iWinner = -1;				/* The first to shake hands  */
+
+
+  if ((iServers = fnCDDB_ParseServers(szServers, astServers, kiCDDB_MaxServers)) < 0) {
+    fprintf(stderr, "DAEX: Malformed CDDB server list.\n");
     return -1;
   }
 
-  /* Create the socket we'll use to connect to the CDDB server. Return with error on
-   * error. 
-   */
-  if ((iSocketFD = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-    fprintf(stderr, "DAEX: Unable to create socket: %s.\n", strerror(errno));
+  if (! (astAttempts = (struct CDDBattempt_t *) calloc(iServers, sizeof(struct CDDBattempt_t)))) {
+    fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the CDDB connections.\n");
     return -1;
   }
 
-  /* Initialize the socket address structure, and fill in the port and address information. */
-  memset(&sSocket, 0, sizeof(struct sockaddr_in));
+  /* Look all of the servers up at once. */
+  for (iIndex = 0; iIndex < iServers; iIndex++) {
+    astAttempts[iIndex].stServer  = astServers[iIndex];
+    astAttempts[iIndex].iResolver = -1;
+    astAttempts[iIndex].iState    = kiCDDB_Failed;
+    fnCDDB_InitConnection(&astAttempts[iIndex].stConnection, -1);
 
-  sSocket.sin_family        = AF_INET;
-  sSocket.sin_port          = htons(iPort);
-  sSocket.sin_addr          = *pstInetAddress;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, aiPair) < 0) {
+      fnCDDB_Abandon(&astAttempts[iIndex], strerror(errno));
+      continue;
+    }
 
-  /* Free up the previously allocated memory. */
-  free(pstInetAddress);
+    if (! (pstResolve = (struct CDDBresolve_t *) malloc(sizeof(struct CDDBresolve_t)))) {
+      close(aiPair[0]);
+      close(aiPair[1]);
+      fnCDDB_Abandon(&astAttempts[iIndex], strerror(ENOMEM));
+      continue;
+    }
 
-  /* Connect to the CDDB server. Return with error on error. */
-  if (connect(iSocketFD, (struct sockaddr *) &sSocket, sizeof(struct sockaddr_in)) < 0) {
-    fprintf(stderr, "DAEX: Unable to connect to CDDB server: %s.\n", strerror(errno));
-    return -1;
+    pstResolve->stServer = astServers[iIndex];
+    pstResolve->iReply   = aiPair[1];
+
+    if ((errno = pthread_create(&tResolver, NULL, fnCDDB_Resolve, pstResolve)) != 0) {
+      free(pstResolve);
+      close(aiPair[0]);
+      close(aiPair[1]);
+      fnCDDB_Abandon(&astAttempts[iIndex], strerror(errno));
+      continue;
+    }
+
+    pthread_detach(tResolver);
+
+    astAttempts[iIndex].iResolver = aiPair[0];
+    astAttempts[iIndex].iState    = kiCDDB_Resolving;
+  }
+
+  lDeadline = fnCDDB_Clock() + kiCDDB_ConnectTimeout * 1000L;
+
+  while (iWinner < 0) {
+    /* Wait on whatever each attempt is waiting on. */
+    for (iIndex = iPolled = 0; iIndex < iServers; iIndex++) {
+      switch (astAttempts[iIndex].iState) {
+        case kiCDDB_Resolving:
+          astPoll[iPolled].fd     = astAttempts[iIndex].iResolver;
+          astPoll[iPolled].events = POLLIN;
+          break;
+
+        case kiCDDB_Connecting:
+          astPoll[iPolled].fd     = astAttempts[iIndex].stConnection.iSocketFD;
+          astPoll[iPolled].events = POLLOUT;
+          break;
+
+        case kiCDDB_Greeting:
+        case kiCDDB_Greeted:
+          astPoll[iPolled].fd     = astAttempts[iIndex].stConnection.iSocketFD;
+          astPoll[iPolled].events = POLLIN;
+          break;
+
+        default:
+          continue;
+      }
+
+      aiPolled[iPolled++] = iIndex;
+    }
+
+    if (!iPolled)  break;
+
+    if ((lRemaining = lDeadline - fnCDDB_Clock()) <= 0) {
+      for (iIndex = 0; iIndex < iPolled; iIndex++)
+        fnCDDB_Abandon(&astAttempts[aiPolled[iIndex]], "Timed out");
+      break;
+    }
+
+    if (poll(astPoll, iPolled, (int) lRemaining) < 0) {
+      if (errno == EINTR)  continue;
+
+      for (iIndex = 0; iIndex < iPolled; iIndex++)
+        fnCDDB_Abandon(&astAttempts[aiPolled[iIndex]], strerror(errno));
+      break;
+    }
+
+    for (iIndex = 0; (iIndex < iPolled) && (iWinner < 0); iIndex++) {
+      if (!astPoll[iIndex].revents)  continue;
+
+      fnCDDB_Advance(pvDiscInformation, &astAttempts[aiPolled[iIndex]]);
+
+      if (astAttempts[aiPolled[iIndex]].iState == kiCDDB_Ready)
+        iWinner = aiPolled[iIndex];
+    }
   }
 
-  /* Return the connected socket. */
-  return iSocketFD;
+  /* Drop the rest. */
+  for (iIndex = 0; iIndex < iServers; iIndex++)
+    if ((iIndex != iWinner) && (astAttempts[iIndex].iState != kiCDDB_Failed))
+      fnCDDB_Abandon(&astAttempts[iIndex], NULL);
+
+  if (iWinner >= 0) {
+    *pstConnection = astAttempts[iWinner].stConnection;
+    pstConnection->iTimeout = kiCDDB_ReadTimeout * 1000;
+
+    fprintf(stderr, "DAEX: Connection established with %s:%i.\n",
+            astAttempts[iWinner].stServer.szHost, astAttempts[iWinner].stServer.iPort);
+  }
+
+  free(astAttempts);
+
+  return (iWinner >= 0) ? 0 : -1;
 }
 
 
 /*========================================================================*/
 void
-fnCDDB_SessionTerminate(int iSocketFD, int iType)
+fnCDDB_SessionTerminate(struct CDDBconnection_t *pstConnection, int iType)
 /*
  * Close the current session by closing the socket, and/or sending the
- * CDDB "quit" command.
+ * CDDB "quit" command.  An HTTP connection is simply closed; cddb.cgi has
+ * no "quit".
  *
- *   Input:  iSocketFD - A connected socket.
- *           iType     - How to go about closing the socket.  1 == send the
- *                       CDDB "quit" command first, 0 == don't.
+ *   Input:  pstConnection - A connection to the server.
+ *           iType         - How to go about closing the socket.  1 == send the
+ *                           CDDB "quit" command first, 0 == don't.
  *
  * Returns:  None.
  */
 /*========================================================================*/
 {
-  if (iType == 1) {
-    write(iSocketFD, "quit\r\n", 6);
+  if ((iType == 1) && ! pstConnection->stServer.szPath[0]) {
+    write(pstConnection->iSocketFD, "quit\r\n", 6);
 
 #ifdef CDDB_DEBUG
     fprintf(stderr, "DAEX: Sent QUIT command.\n");
 #endif
   }
 
-  close(iSocketFD);
+  close(pstConnection->iSocketFD);
 
   fprintf(stderr, "DAEX: Connection closed.\n");
 }
@@ -601,14 +1376,14 @@ fnCDDB_SessionTerminate(int iSocketFD, int iType)
 
 /*========================================================================*/
 int
-fnCDDB_SendRequest(int iSocketFD, void *pvDiscInformation, int *iSessionState,
-                   char *szBuffer)
+fnCDDB_SendRequest(struct CDDBconnection_t *pstConnection, void *pvDiscInformation,
+                   int *iSessionState, char *szBuffer)
 /*
  * Provide functionality for the client end of DAEX.  Our requests to the
  * CDDB server are sent from this function (the request sent depends on the 
  * current session state).
  *
- *   Input:  iSocketFD         - A connected socket.
+ *   Input:  pstConnection     - A connection to the server.
  *           pvDiscInformation - Pointer to the disc information structure.
  *           iSessionState     - The current session state.
  *           szBuffer          - Line of input from the server.
@@ -624,9 +1399,8 @@ fnCDDB_SendRequest(int iSocketFD, void *pvDiscInformation, int *iSessionState,
   struct CDDBinformation_t *pstCDDBinformation; /* Pointer to the CDDB information struct */
   char szCategory[25],                          /* Local category (ie, rock, jazz, etc).  */
        szDiscID[9],                             /* Local DiscID (from the server).        */
-       szHostname[MAXHOSTNAMELEN],              /* Hostname of the current machine.       */
+       szHello[MAX_CDDB_LINE_LENGTH],           /* Who we are, for the "hello" command.   */
        szSendBuffer[MAX_CDDB_LINE_LENGTH];      /* Buffer sent to the remote CDDB server. */
-  char *szLoginName;                            /* Username of the current user.          */
 
 
   pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
@@ -635,36 +1409,18 @@ fnCDDB_SendRequest(int iSocketFD, void *pvDiscInformation, int *iSessionState,
   switch(*iSessionState) {
    case SESSION_CONNECTING: {  /* We're connected, initiate the handshake. */
 
-     /* Attempt to grab the current user's username.  If this fails, set the username
-      * passed to CDDB server to "unknown".  If the grab was successful, allocate a
-      * new buffer to store the username.  We do this to avoid a strcmp() after building
-      * the send buffer -- instead we just free our variable, szLoginName (the value 
-      * returned from getlogin() is a pointer to a static buffer).
-      */
-     if (! (szLoginName = getlogin())) {
-       if (! (szLoginName = strdup("unknown"))) {
-         fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the current username.\n");
-         return -1;
-       }
-     } else
-       if (! (szLoginName = strdup(szLoginName))) {
-         fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the current username.\n");
-         return -1;
-       }
-
-     /* Attempt to grab the hostname.  If this fails, create a generic one. */
-     if (gethostname(szHostname, MAXHOSTNAMELEN) < 0) {
-       snprintf(szHostname, MAXHOSTNAMELEN, "unknown.hostname");
-     }
-
-     /* Create the send buffer. */
-     snprintf(szSendBuffer, sizeof(szSendBuffer),
-              "cddb hello %s %s DAEX %s\r\n", szLoginName, szHostname, kszVersion);
+     fnCDDB_Hello(szHello, sizeof(szHello));
 
-     free(szLoginName);
+     /* Create the send buffer, so long as the hello fits in it. */
+     if (snprintf(szSendBuffer, sizeof(szSendBuffer), "cddb hello %s", szHello) >=
+         (int) sizeof(szSendBuffer)) {
+       fprintf(stderr, "DAEX: Hello string exceeds the size of the send buffer.\n");
+       return -1;
+     }
 
      /* Send the buffer containing our CDDB HELLO command. */
-     write(iSocketFD, szSendBuffer, strlen(szSendBuffer));
+     if (fnCDDB_SendCommand(pstConnection, szSendBuffer) < 0)
+       return -1;
 
 #ifdef CDDB_DEBUG
      fprintf(stderr, "DAEX: Sent HELLO command.\n");
@@ -686,14 +1442,15 @@ fnCDDB_SendRequest(int iSocketFD, void *pvDiscInformation, int *iSessionState,
       }
 
       /* Create the send buffer. */
-      snprintf(szSendBuffer, sizeof(szSendBuffer), "%s\r\n", pstCDDBinformation->szCDDBquery);
+      snprintf(szSendBuffer, sizeof(szSendBuffer), "%s", pstCDDBinformation->szCDDBquery);
 
 #ifdef CDDB_DEBUG
-      fprintf(stderr, "DAEX: Query string follows:\n%s", szSendBuffer);
+      fprintf(stderr, "DAEX: Query string follows:\n%s\n", szSendBuffer);
 #endif
 
       /* Send the query string to the server. */
-      write(iSocketFD, szSendBuffer, strlen(szSendBuffer));
+      if (fnCDDB_SendCommand(pstConnection, szSendBuffer) < 0)
+        return -1;
 
 #ifdef CDDB_DEBUG
       fprintf(stderr, "DAEX: Sent QUERY command.\n");
@@ -705,24 +1462,26 @@ fnCDDB_SendRequest(int iSocketFD, void *pvDiscInformation, int *iSessionState,
 
    case SESSION_SENT_QUERY: {  /* The query was successful, read the response. */
 
-     if (sscanf(szBuffer, "%*u %24s %8s %*s\r\n", szCategory, szDiscID) == 2) {
+     if (sscanf(szBuffer, "%*u %24s %8s %*s", szCategory, szDiscID) == 2) {
 
         /* NULL terminate the variables read. */
         szCategory[sizeof(szCategory) - 1] = 0;
         szDiscID[sizeof(szDiscID) - 1] = 0;
 
         /* Copy the disc's category in the CDDB information structure. */
-        if (! (pstCDDBinformation->szDiscCategory = strdup(szCategory))) {
+        if (! (pstCDDBinformation->szDiscCategory =
+               fnArena_Strdup(pstDiscInformation->pstArena, szCategory))) {
           fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the disc category.\n");
           return -1;
 	}
 
         /* Create the send buffer. */
-        snprintf(szSendBuffer, sizeof(szSendBuffer), "cddb read %s %s\r\n", 
+        snprintf(szSendBuffer, sizeof(szSendBuffer), "cddb read %s %s", 
                  szCategory, szDiscID);
 
         /* Send the query string to the server. */
-        write(iSocketFD, szSendBuffer, strlen(szSendBuffer));
+        if (fnCDDB_SendCommand(pstConnection, szSendBuffer) < 0)
+          return -1;
 
 #ifdef CDDB_DEBUG
         fprintf(stderr, "DAEX: Sent READ command.\n");
@@ -751,11 +1510,12 @@ fnCDDB_SendRequest(int iSocketFD, void *pvDiscInformation, int *iSessionState,
 
 /*========================================================================*/
 int
-fnCDDB_DoCDDBLookup(int iSocketFD, void *pvDiscInformation, int *iSessionState)
+fnCDDB_DoCDDBLookup(struct CDDBconnection_t *pstConnection, void *pvDiscInformation,
+                    int *iSessionState)
 /*
  * Parse input from the CDDB server and send the appropriate response.
  *
- *   Input: iSocketFD         - A connected socket.
+ *   Input: pstConnection     - A connection to the server.
  *          pvDiscInformation - Pointer to the disc information structure.
  *          iSessionState     - The current session state.
  *
@@ -768,7 +1528,7 @@ fnCDDB_DoCDDBLookup(int iSocketFD, void *pvDiscInformation, int *iSessionState)
 /*========================================================================*/
 {
   struct DiscInformation_t *pstDiscInformation; /* Pointer to disc information structure. */
-  char szInputBuffer[MAX_CDDB_LINE_LENGTH];     /* Input buffer for server's response.    */
+  char *szInputBuffer;                          /* A line of the server's response.       */
   int iResponseCode,                            /* CDDB response code                     */
       iCharactersRead;                          /* Characters read from the socket.       */
 
@@ -776,23 +1536,13 @@ fnCDDB_DoCDDBLookup(int iSocketFD, void *pvDiscInformation, int *iSessionState)
   pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
 
   /* Read data from the socket until we encouter an error. */
-  while ((iCharactersRead = fnReadLine(iSocketFD, szInputBuffer, MAX_CDDB_LINE_LENGTH)) > 0) {
+  while ((iCharactersRead = fnCDDB_ReadLine(pstConnection, &szInputBuffer)) > 0) {
 
 #ifdef CDDB_DEBUG
     /* Display the server's response. */
-    fprintf(stderr, "CDDBD: %s", &szInputBuffer[0]);
+    fprintf(stderr, "CDDBD: %s\n", szInputBuffer);
 #endif
 
-    /* We assume that any response from the remote server will contain at least
-     * one linefeed, and that we're reading the maximum line length from the
-     * socket (which is defined as 256 characters in the CDDB 1.3.1 server docs).
-     * If a linefeed is not found in the returned buffer, we label it as an error.
-     */
-    if (!strchr(szInputBuffer, '\n')) {
-      fprintf(stderr, "DAEX: Input buffer does not contain a newline.  Exiting.\n");
-      return -2;
-    }
-
     /* Parse the response code from the buffer... see the CDDB Server Protocol
      * Specifcations for more information.
      */
@@ -995,7 +1745,7 @@ fnCDDB_DoCDDBLookup(int iSocketFD, void *pvDiscInformation, int *iSessionState)
       /* Process the next request.  If there is an error in processing, return an
        * error to this function's caller so that we may disconnect.
        */
-      if (fnCDDB_SendRequest(iSocketFD, pstDiscInformation, iSessionState, 
+      if (fnCDDB_SendRequest(pstConnection, pstDiscInformation, iSessionState, 
                              szInputBuffer) < 0) {
         return -2;
       }
@@ -1016,11 +1766,13 @@ fnCDDB_DoCDDBLookup(int iSocketFD, void *pvDiscInformation, int *iSessionState)
 
 /*========================================================================*/
 int
-fnCDDB_SessionWrapper(int iSocketFD, void *pvDiscInformation, int *iTerminationType)
+fnCDDB_SessionWrapper(struct CDDBconnection_t *pstConnection, void *pvDiscInformation,
+                      int *iTerminationType)
 /*
  * Handle the lookup and retrieval of the disc's title and track information.
  *
- *   Input:  iSocketFD         - A connected socket.
+ *   Input:  pstConnection     - A connection to the server, on which we
+ *                               have already shaken hands.
  *           pvDiscInformation - Pointer to the disc information struct.
  *           iTerminationType  - How to go about terminating the session.
  *                                 0 == don't send the "quit" command.
@@ -1050,12 +1802,16 @@ fnCDDB_SessionWrapper(int iSocketFD, void *pvDiscInformation, int *iTerminationT
 
   fprintf(stderr, "DAEX: Negotiating session.\n");
 
-  connection_negotiate:
-
   /* Set the initial state of the session.  We'll use these states to determine the
-   * meaning of the server's reponse code.
+   * meaning of the server's reponse code.  fnCDDB_OpenSession() has seen to the
+   * handshake, so we start with the query.
    */
-  iSessionState = SESSION_CONNECTING;
+  iSessionState = SESSION_SENT_HELLO;
+
+  connection_negotiate:
+
+  if (fnCDDB_SendRequest(pstConnection, pstDiscInformation, &iSessionState, "") < 0)
+    return -1;
 
   /* Do the initial queries, so that we may retrieve the disc and track title information.
    * On error, fnCDDB_DoCDDBLookup() will return one of the following values:
@@ -1065,7 +1821,7 @@ fnCDDB_SessionWrapper(int iSocketFD, void *pvDiscInformation, int *iTerminationT
    *   -3   Negotiation error.
    *   -4   No handshake.
    */
-  if ((iReturnValue = fnCDDB_DoCDDBLookup(iSocketFD, pstDiscInformation, &iSessionState)) < 0) {
+  if ((iReturnValue = fnCDDB_DoCDDBLookup(pstConnection, pstDiscInformation, &iSessionState)) < 0) {
 
     switch(iReturnValue) {
      case -1:
@@ -1085,6 +1841,7 @@ fnCDDB_SessionWrapper(int iSocketFD, void *pvDiscInformation, int *iTerminationT
          break;
        }
 
+       iSessionState = SESSION_CONNECTING;
        goto connection_negotiate;
      }
     }
@@ -1101,7 +1858,7 @@ fnCDDB_SessionWrapper(int iSocketFD, void *pvDiscInformation, int *iTerminationT
    *   -2  Socket read error.
    *   -3  Remote end closed the connection.
    */
-  if ((iReturnValue = fnCDDB_ReadEntry(iSocketFD, pstDiscInformation)) < 0) {
+  if ((iReturnValue = fnCDDB_ReadEntry(pstConnection, pstDiscInformation)) < 0) {
 
     switch(iReturnValue) {
      case -1:
@@ -1122,20 +1879,19 @@ fnCDDB_SessionWrapper(int iSocketFD, void *pvDiscInformation, int *iTerminationT
 
 /*========================================================================*/
 char *
-fnCDDB_ConvertTitleToFilename(char *szTitle, int iTitleTypeFlag)
+fnCDDB_ConvertTitleToFilename(struct Arena_t *pstArena, char *szTitle, int iTitleTypeFlag)
 /*
  * Convert a CDDB title to something which could be used as a filename.
  *
- *   Input:  szTitle        - The CDDB title.
+ *   Input:  pstArena       - The disc's arena, to keep the filename in.
+ *           szTitle        - The CDDB title.
  *           iTitleTypeFlag - Type of title we're converting. 0 == track, 1 == disc.
  *
  * Returns:  Pointer to the filename, or NULL on error.
  */
 /*========================================================================*/
 {
-  char *szFilename,                  /* The converted filename.                     */
-       *szTempFilename,              /* Temporary filename based on the CDDB title. */
-       *szTempFilename_Realloced;    /* The realloced title.                        */
+  char *szTempFilename;              /* Temporary filename based on the CDDB title. */
   int  iCounter,                     /* Current character counter.                  */
        iPreviouslyModified,          /* Flag to indicate previously modified chars. */
        iFilenameIndex,               /* Character counter for the actual filename.  */
@@ -1144,11 +1900,11 @@ fnCDDB_ConvertTitleToFilename(char *szTitle, int iTitleTypeFlag)
 
   iTitleLength = strlen(szTitle);
 
-  /* Allocate memory for the filename, including the terminating NULL.  Once the 
-   * conversion is complete, we copy the pointer from the temporary variable to the
-   * "permanent" variable (permanent for this function at any rate). :)
+  /* Allocate memory for the filename, including the terminating NULL.  The
+   * filename is never longer than the title, and the arena's memory comes
+   * zeroed, so it is terminated however short it turns out.
    */
-  if (!(szTempFilename = (char *) calloc(1, iTitleLength + 1))) {
+  if (!(szTempFilename = (char *) fnArena_Alloc(pstArena, iTitleLength + 1))) {
     fprintf(stderr, "Unable to allocate sufficient memory for the track filename.\n");
     return NULL;
   }
@@ -1190,38 +1946,8 @@ fnCDDB_ConvertTitleToFilename(char *szTitle, int iTitleTypeFlag)
     }
   }
 
-  /* If the converted filename is shorter than it's original length, we attempt to
-   * reallocate it's memory usage so that it only uses the memory it requires. Otherwise,
-   * it would appear that no changes to the title have been made in it's conversion to
-   * a filename.
-   */
-  if (iFilenameIndex < iTitleLength) {
-
-    /* We attempt to use only the space necessary to store the track's filename. */
-    if ((szTempFilename_Realloced = (char *) realloc(szTempFilename, iFilenameIndex+1))) {
-      szTempFilename_Realloced[iFilenameIndex] = 0;  /* Terminate the string. */
-
-      /* Copy the pointer from the reallocated temporary filename to the track filename 
-       * string. 
-       */
-      szFilename = szTempFilename_Realloced;
-
-    } else {
-      /* The reallocation failed -- copy the pointer from the temporary filename to the 
-       * track filename string.
-       */
-      szFilename = szTempFilename;
-    }
-
-  } else
-    /* The temporary filename was the same length as the title -- apparently, no changes 
-     * were made.  Therefore, we just copy the pointer from the temporary variable to the
-     * track filename string.
-     */
-     szFilename = szTempFilename;
-
   /* Return the converted filename. */
-  return szFilename;
+  return szTempFilename;
 }
 
 
@@ -1252,113 +1978,37 @@ fnCDDB_StoreFilenames(void *pvDiscInformation)
   pstCDDBinformation  = pstDiscInformation->pstCDDBinformation;
   pstTrackInformation = pstDiscInformation->pstTrackData;
 
-  if (! (szFilename_title = 
-         fnCDDB_ConvertTitleToFilename(pstCDDBinformation->szDiscTitle, 1))) {
+  if (! (szFilename_title = fnCDDB_ConvertTitleToFilename(pstDiscInformation->pstArena,
+                                                         pstCDDBinformation->szDiscTitle, 1))) {
     return -1;
   }
 
   for (iCounter=1; iCounter <= pstTOCheader->ending_track; iCounter++) {
     if (! (szFilename_track = 
-	   fnCDDB_ConvertTitleToFilename(pstCDDBinformation->szTrackTitle[iCounter - 1], 0))) {
+	   fnCDDB_ConvertTitleToFilename(pstDiscInformation->pstArena,
+                                         pstCDDBinformation->szTrackTitle[iCounter - 1], 0))) {
       return -1;
     }
 
     /* Store the current track's CDDB-derived filename. */
-    if (snprintf(szFilename_temp, kiMaxStringLength, "%s-%02d-%s.wav", 
-                 szFilename_title, iCounter, szFilename_track) > MAX_FILENAME_LENGTH) {
+    if (snprintf(szFilename_temp, kiMaxStringLength, "%s-%02d-%s.%s",
+                 szFilename_title, iCounter, szFilename_track,
+                 pstDiscInformation->pstOptions->pstWriter->szExtension) > MAX_FILENAME_LENGTH) {
       fprintf(stderr, "DAEX: Maximum filename length exceeded.\n");
       return -1;
     }
 
-    if (! (pstTrackInformation[iCounter - 1].szTrackFilename = (char *)
-	   calloc(1, MAX_FILENAME_LENGTH + 1))) {
+    if (! (pstTrackInformation[iCounter - 1].szTrackFilename =
+	   fnArena_Strdup(pstDiscInformation->pstArena, szFilename_temp))) {
       fprintf(stderr, "Unable to allocate sufficient memory for the track filename.\n");
       return -1;
     }
-
-    memcpy(pstTrackInformation[iCounter - 1].szTrackFilename, szFilename_temp,
-           strlen(szFilename_temp));
-
-    free(szFilename_track);
   }
 
-  free(szFilename_title);
   return 0;
 }
 
 
-/*========================================================================*/
-void
-fnCDDB_FreeCDDBInformationStruct(void **pvCDDBinfo, int iTracksExpected)
-/*
- * Free up the memory used by the CDDB information structure.
- *
- *   Input:  pvCDDBinfo     - CDDB information structure.
- *           iTrackExpected - Number of tracks on the disc, used to free
- *                            the track frame offsets, total seconds, and
- *                            file names.
- *
- * Returns:  None.
- */
-/*========================================================================*/
-{
-  int iCounter;                           /* Current track counter.      */
-  struct CDDBinformation_t *pstCDDBinfo;  /* CDDB information structure. */
-
-
-  pstCDDBinfo = (struct CDDBinformation_t *) *pvCDDBinfo;
-
-  /* Dispose of the CDDB query string. */
-  if (pstCDDBinfo->szCDDBquery) {
-    free(pstCDDBinfo->szCDDBquery);
-    pstCDDBinfo->szCDDBquery = NULL;
-  }
-
-  /* Dispose of the CDDB disc category. */
-  if (pstCDDBinfo->szDiscCategory) {
-    free(pstCDDBinfo->szDiscCategory);
-    pstCDDBinfo->szDiscCategory = NULL;
-  }
-
-  /* Free the frame offset array. */
-  if (pstCDDBinfo->iTrackFrameOffset) {
-    free(pstCDDBinfo->iTrackFrameOffset);
-    pstCDDBinfo->iTrackFrameOffset = NULL;
-  }
-
-  /* Free the track play time array. */
-  if (pstCDDBinfo->iTrackSeconds) {
-    free(pstCDDBinfo->iTrackSeconds);
-    pstCDDBinfo->iTrackSeconds = NULL;
-  }
-
-  /* Cycle through the disc's tracks and free the track titles. */
-  for(iCounter=0; iCounter < iTracksExpected; iCounter++)
-    if (pstCDDBinfo->szTrackTitle[iCounter]) {
-      free(pstCDDBinfo->szTrackTitle[iCounter]);
-      pstCDDBinfo->szTrackTitle[iCounter] = NULL;
-    }
-
-  /* Free the track title array. */
-  if (pstCDDBinfo->szTrackTitle) {
-    free(pstCDDBinfo->szTrackTitle);
-    pstCDDBinfo->szTrackTitle = NULL;
-  }
-
-  /* Free the disc title. */
-  if (pstCDDBinfo->szDiscTitle) {
-    free(pstCDDBinfo->szDiscTitle);
-    pstCDDBinfo->szDiscTitle = NULL;
-  }
-
-  /* Free the CDDB information structure. */
-  if (pstCDDBinfo) {
-    free(pstCDDBinfo);
-    pstCDDBinfo = NULL;
-  }
-}
-
-
 /*========================================================================*/
 int
 fnCDDB_DumpCDDBInfo(void *pvDiscInformation, char *szFilename)
@@ -1513,15 +2163,13 @@ fnCDDB_DumpCDDBInfo(void *pvDiscInformation, char *szFilename)
 
 /*========================================================================*/
 int
-fnCDDB_DoCDDBQuery(void *pvDiscInformation, char *szCDDB_RemoteHost, int iCDDB_RemotePort,
-                   int iCDDB_SkipFilenames)
+fnCDDB_DoCDDBQuery(void *pvDiscInformation, char *szCDDB_Servers, int iCDDB_SkipFilenames)
 /*
  * Handle the connection to the CDDB server, the retrieval of disc info,
  * and the conversion of the disc and track titles.
  *
  *   Input:  pvDiscInformation   - Disc information structure.
- *           szCDDB_RemoteHost   - The remote hostname or IP of the CDDB server.
- *           szCDDB_RemotePort   - The port the CDDB server is listening on.
+ *           szCDDB_Servers      - The CDDB servers to try, "hostname:port[,...]".
  *           iCDDB_SkipFilenames - Flag which determines whether or not to use
  *                                 CDDB filenames in the extraction.
  *
@@ -1529,7 +2177,8 @@ fnCDDB_DoCDDBQuery(void *pvDiscInformation, char *szCDDB_RemoteHost, int iCDDB_R
  */
 /*========================================================================*/
 {
-  int iSocketFD, iReturnValue;
+  int iReturnValue;
+  struct CDDBconnection_t stConnection;
   struct DiscInformation_t *pstDiscInformation;
   struct ioc_toc_header    *pstTOCheader;
   int iTerminationType = 1; /* 1 == send quit */
@@ -1540,18 +2189,16 @@ fnCDDB_DoCDDBQuery(void *pvDiscInformation, char *szCDDB_RemoteHost, int iCDDB_R
 
   fprintf(stderr, "DAEX: Establishing connection with CDDB server.\n");
 
-  /* Connect to the remote CDDB server. Return with error on error. */
-  if ((iSocketFD = fnCDDB_ConnectToServer(szCDDB_RemoteHost, iCDDB_RemotePort)) < 0) {
+  /* Connect to the first of the CDDB servers to answer. Return with error on error. */
+  if (fnCDDB_OpenSession(pstDiscInformation, szCDDB_Servers, &stConnection) < 0) {
     fprintf(stderr, "DAEX: Connection failed.\n\n");
     return -1;
   }
 
-  fprintf(stderr, "DAEX: Connection established.\n");
-
   /* Handle the lookup and retrieval of the disc's title and track information. */
-  iReturnValue = fnCDDB_SessionWrapper(iSocketFD, pstDiscInformation, &iTerminationType);
+  iReturnValue = fnCDDB_SessionWrapper(&stConnection, pstDiscInformation, &iTerminationType);
   /* Terminate the session. */
-  fnCDDB_SessionTerminate(iSocketFD, iTerminationType);
+  fnCDDB_SessionTerminate(&stConnection, iTerminationType);
 
   /* If there was an error, exit. */
   if (iReturnValue < 0) {
@@ -1571,3 +2218,435 @@ fnCDDB_DoCDDBQuery(void *pvDiscInformation, char *szCDDB_RemoteHost, int iCDDB_R
   fprintf(stderr, "\n");
   return 0;
 }
+
+
+/*========================================================================*/
+int
+fnCDDB_ReadCache(void *pvDiscInformation, char *szFilename, time_t *pltModified)
+/*
+ * Take the disc's titles and category from its entry in the metadata
+ * cache, in place of a query.  The entry is laid out as an xmcd file, with
+ * the category added.
+ *
+ *   Input:  pvDiscInformation - Disc information structure.
+ *           szFilename        - The disc's entry.
+ *           pltModified       - Set to when the entry was written.
+ *
+ * Returns:  -1 if there is no complete entry (see errno), 0 otherwise.
+ *
+ *           pvDiscInformation - The disc and track titles, and category.
+ *           pltModified       - When the entry was last written.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInfo;     /* Disc information structure.           */
+  struct CDDBinformation_t *pstCDDBinfo;     /* CDDB information structure            */
+  struct stat stStatus;                      /* The entry's status                    */
+  FILE   *fCache;                            /* The entry                             */
+  char   szLine[MAX_CDDB_LINE_LENGTH],       /* A line of it                          */
+         szValue[MAX_CDDB_LINE_LENGTH];      /* ... and its value                     */
+  int    iTrack,                             /* A title's track, from 0               */
+         iTitles = 0;                        /* Track titles read                     */
+
+
+  pstDiscInfo = (struct DiscInformation_t *) pvDiscInformation;
+  pstCDDBinfo = pstDiscInfo->pstCDDBinformation;
+
+  if (! (fCache = fopen(szFilename, "r")))
+    return -1;
+
+  if ((fstat(fileno(fCache), &stStatus) < 0) ||
+      ! (pstCDDBinfo->szTrackTitle = (char **)
+         fnArena_Alloc(pstDiscInfo->pstArena,
+                       pstDiscInfo->pstTOCheader->ending_track * sizeof(char *)))) {
+    fclose(fCache);
+    return -1;
+  }
+
+  *pltModified = stStatus.st_mtime;
+
+  while (fgets(szLine, sizeof(szLine), fCache)) {
+    szValue[0] = '\0';
+
+    if (sscanf(szLine, "DCATEGORY=%255[^\r\n]", szValue) == 1) {
+      pstCDDBinfo->szDiscCategory = fnArena_Strdup(pstDiscInfo->pstArena, szValue);
+
+    } else if (sscanf(szLine, "DTITLE=%255[^\r\n]", szValue) == 1) {
+      pstCDDBinfo->szDiscTitle = fnArena_Strdup(pstDiscInfo->pstArena, szValue);
+
+    } else if ((sscanf(szLine, "TTITLE%d=%255[^\r\n]", &iTrack, szValue) == 2) &&
+               (iTrack >= 0) && (iTrack < pstDiscInfo->pstTOCheader->ending_track) &&
+               !pstCDDBinfo->szTrackTitle[iTrack]) {
+      if ((pstCDDBinfo->szTrackTitle[iTrack] = fnArena_Strdup(pstDiscInfo->pstArena, szValue)))
+        iTitles++;
+    }
+  }
+
+  fclose(fCache);
+
+  if (pstCDDBinfo->szDiscTitle && pstCDDBinfo->szDiscCategory &&
+      (iTitles == pstDiscInfo->pstTOCheader->ending_track))
+    return 0;
+
+  /* An incomplete entry is ignored, and the disc queried as if it weren't
+   * there.  What was read of it stays in the arena until the disc is
+   * disposed of.
+   */
+  pstCDDBinfo->szTrackTitle   = NULL;
+  pstCDDBinfo->szDiscTitle    = NULL;
+  pstCDDBinfo->szDiscCategory = NULL;
+
+  errno = ENOENT;
+  return -1;
+}
+
+
+/*========================================================================*/
+int
+fnCDDB_WriteCache(void *pvDiscInformation, char *szFilename)
+/*
+ * Write the disc's titles and category to its entry in the metadata
+ * cache.  The entry is replaced in one step, so that a reader never sees
+ * half of it.
+ *
+ *   Input:  pvDiscInformation - Disc information structure, queried.
+ *           szFilename        - The disc's entry.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInfo;     /* Disc information structure.           */
+  struct CDDBinformation_t *pstCDDBinfo;     /* CDDB information structure            */
+  FILE   *fCache;                            /* The entry                             */
+  char   szTemporary[kiMaxStringLength],     /* The entry, until renamed              */
+         *pSlash;                            /* The end of the cache's directory      */
+  int    iCounter;                           /* Current track counter                 */
+
+
+  pstDiscInfo = (struct DiscInformation_t *) pvDiscInformation;
+  pstCDDBinfo = pstDiscInfo->pstCDDBinformation;
+
+  if (!pstCDDBinfo->szDiscTitle || !pstCDDBinfo->szDiscCategory || !pstCDDBinfo->szTrackTitle) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* Create the cache, if this is its first entry. */
+  snprintf(szTemporary, sizeof(szTemporary), "%s", szFilename);
+
+  if ((pSlash = strrchr(szTemporary, '/'))) {
+    *pSlash = '\0';
+
+    if ((mkdir(szTemporary, 0755) < 0) && (errno != EEXIST))
+      return -1;
+  }
+
+  snprintf(szTemporary, sizeof(szTemporary), "%s.%i", szFilename, (int) getpid());
+
+  if (! (fCache = fopen(szTemporary, "w")))
+    return -1;
+
+  fprintf(fCache, "# xmcd\n");
+  fprintf(fCache, "#\n");
+  fprintf(fCache, "# Cached by DAEX v%s from the CDDB query:\n", kszVersion);
+  fprintf(fCache, "# %s\n", pstCDDBinfo->szCDDBquery);
+  fprintf(fCache, "#\n");
+  fprintf(fCache, "DISCID=%s\n", pstCDDBinfo->szDiscID);
+  fprintf(fCache, "DCATEGORY=%s\n", pstCDDBinfo->szDiscCategory);
+  fprintf(fCache, "DTITLE=%s\n", pstCDDBinfo->szDiscTitle);
+
+  for (iCounter = 0; iCounter < pstDiscInfo->pstTOCheader->ending_track; iCounter++)
+    fprintf(fCache, "TTITLE%d=%s\n", iCounter, pstCDDBinfo->szTrackTitle[iCounter]);
+
+  if ((fclose(fCache) != 0) || (rename(szTemporary, szFilename) < 0)) {
+    unlink(szTemporary);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCDDB_ReadIndex(void *pvDiscInformation, char *szFilename)
+/*
+ * Take the disc's titles and category from a freedb index (see
+ * daex-index(1)), in place of a query.  Of the entries under the disc's
+ * ID, those for another number of tracks are passed over, and the one
+ * whose frame offsets are nearest the disc's is taken.  Its titles go
+ * through the parser used on a server's reply.
+ *
+ *   Input:  pvDiscInformation - Disc information structure, with the
+ *                               query string built.
+ *           szFilename        - The index.
+ *
+ * Returns:  -1 if the disc isn't in the index, or on error (see errno;
+ *           ENOENT if it isn't there, EINVAL for a damaged index), 0
+ *           otherwise.
+ *
+ *           pvDiscInformation - The disc and track titles, and category.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInfo;     /* Disc information structure.           */
+  struct CDDBinformation_t *pstCDDBinfo;     /* CDDB information structure            */
+  struct FreeDB_t      stIndex;              /* The index                             */
+  struct FreeDBentry_t *pstEntry,            /* An entry for the disc ID              */
+                       *pstBest = NULL;      /* ... and the nearest the disc          */
+  char   szLine[MAX_CDDB_LINE_LENGTH];       /* A title, as an xmcd line              */
+  u_int32_t lFirst,                          /* The disc ID's first entry             */
+            lTrack;                          /* Current track                         */
+  u_long lDistance,                          /* How far an entry's offsets are out    */
+         lBestDistance = 0;                  /* ... and the nearest's                 */
+  int    iEntries,                           /* Entries under the disc ID             */
+         iEntry,                             /* Current entry                         */
+         iTrackTitleIndex = 1;               /* Index for the track title array       */
+
+
+  pstDiscInfo = (struct DiscInformation_t *) pvDiscInformation;
+  pstCDDBinfo = pstDiscInfo->pstCDDBinformation;
+
+  if (fnFreeDB_Map(&stIndex, szFilename) < 0)
+    return -1;
+
+  iEntries = fnFreeDB_Find(&stIndex, strtoul(pstCDDBinfo->szDiscID, NULL, 16), &lFirst);
+
+  for (iEntry = 0; iEntry < iEntries; iEntry++) {
+    if (! (pstEntry = fnFreeDB_Entry(&stIndex, lFirst + iEntry))) {
+      fnFreeDB_Unmap(&stIndex);
+      return -1;
+    }
+
+    if (pstEntry->lTracks != (u_int32_t) pstDiscInfo->pstTOCheader->ending_track)  continue;
+
+    for (lDistance = 0, lTrack = 0; lTrack < pstEntry->lTracks; lTrack++)
+      lDistance += labs((long) stIndex.alTOC[pstEntry->lTOC + lTrack] -
+                        pstCDDBinfo->iTrackFrameOffset[lTrack]);
+
+    if (!pstBest || (lDistance < lBestDistance)) {
+      pstBest       = pstEntry;
+      lBestDistance = lDistance;
+    }
+  }
+
+  if (!pstBest) {
+    fnFreeDB_Unmap(&stIndex);
+    errno = ENOENT;
+    return -1;
+  }
+
+  if (! (pstCDDBinfo->szTrackTitle = (char **)
+         fnArena_Alloc(pstDiscInfo->pstArena, pstBest->lTracks * sizeof(char *))) ||
+      ! (pstCDDBinfo->szDiscCategory =
+         fnArena_Strdup(pstDiscInfo->pstArena, fnFreeDB_String(&stIndex, pstBest->lCategory)))) {
+    fnFreeDB_Unmap(&stIndex);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  snprintf(szLine, sizeof(szLine), "DTITLE=%s", fnFreeDB_String(&stIndex, pstBest->lDiscTitle));
+
+  if (fnCDDB_ParseEntryLine(pstDiscInfo, szLine, &iTrackTitleIndex) < 0) {
+    fnFreeDB_Unmap(&stIndex);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (lTrack = 0; lTrack < pstBest->lTracks; lTrack++) {
+    snprintf(szLine, sizeof(szLine), "TTITLE%u=%s", lTrack,
+             fnFreeDB_String(&stIndex, stIndex.alTOC[pstBest->lTOC + pstBest->lTracks + lTrack]));
+
+    if (fnCDDB_ParseEntryLine(pstDiscInfo, szLine, &iTrackTitleIndex) < 0) {
+      fnFreeDB_Unmap(&stIndex);
+      errno = ENOMEM;
+      return -1;
+    }
+  }
+
+  fnFreeDB_Unmap(&stIndex);
+
+  /* An entry without a disc title is of no use for naming the tracks. */
+  if (!pstCDDBinfo->szDiscTitle) {
+    pstCDDBinfo->szTrackTitle   = NULL;
+    pstCDDBinfo->szDiscCategory = NULL;
+
+    errno = ENOENT;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void *
+fnCDDB_Lookup(void *pvLookup)
+/*
+ * Look the disc up, and cache what is found: the body of a lookup thread.
+ *
+ *   Input:  pvLookup - The lookup.
+ *
+ * Returns:  NULL.  The result is left in the lookup.
+ */
+/*========================================================================*/
+{
+  struct CDDBlookup_t *pstLookup;		/* The lookup                */
+
+
+  pstLookup = (struct CDDBlookup_t *) pvLookup;
+
+  pstLookup->iResult = fnCDDB_DoCDDBQuery(pstLookup->pvDiscInformation, pstLookup->szServers, 1);
+
+  if ((pstLookup->iResult == 0) && pstLookup->szCacheFilename[0] &&
+      (fnCDDB_WriteCache(pstLookup->pvDiscInformation, pstLookup->szCacheFilename) < 0))
+    fprintf(stderr, "DAEX: Unable to cache the disc information: %s.\n\n", strerror(errno));
+
+  return NULL;
+}
+
+
+/*========================================================================*/
+struct CDDBlookup_t *
+fnCDDB_StartLookup(void *pvDiscInformation, char *szCDDB_Servers, char *szCacheFilename)
+/*
+ * Start looking the disc up in a thread of its own, so that its tracks
+ * may be extracted in the meantime.  The thread works on a copy of the
+ * disc's information; nothing of the disc's own is touched until
+ * fnCDDB_FinishLookup().
+ *
+ *   Input:  pvDiscInformation - Disc information structure.
+ *           szCDDB_Servers    - The CDDB servers to try.
+ *           szCacheFilename   - The disc's metadata cache entry, to be
+ *                               written with what is found, or NULL.
+ *
+ * Returns:  The lookup, or NULL if it couldn't be started (see errno).
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInformation,	/* The disc                  */
+                           *pstCopy;		/* ... and the thread's copy */
+  struct CDDBlookup_t *pstLookup;		/* The lookup                */
+
+
+  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
+
+  if (! (pstLookup = (struct CDDBlookup_t *) calloc(1, sizeof(struct CDDBlookup_t))))
+    return NULL;
+
+  if (! (pstCopy = (struct DiscInformation_t *) malloc(sizeof(struct DiscInformation_t)))) {
+    free(pstLookup);
+    return NULL;
+  }
+
+  *pstCopy = *pstDiscInformation;
+  pstLookup->stCDDBinformation = *pstDiscInformation->pstCDDBinformation;
+
+  fnArena_Initialize(&pstLookup->stArena);
+  pstCopy->pstCDDBinformation = &pstLookup->stCDDBinformation;
+  pstCopy->pstArena           = &pstLookup->stArena;
+
+  pstLookup->pvDiscInformation = pstCopy;
+  pstLookup->szServers         = szCDDB_Servers;
+
+  if (szCacheFilename)
+    snprintf(pstLookup->szCacheFilename, sizeof(pstLookup->szCacheFilename), "%s",
+             szCacheFilename);
+
+  if ((errno = pthread_create(&pstLookup->tThread, NULL, fnCDDB_Lookup, pstLookup)) != 0) {
+    free(pstCopy);
+    free(pstLookup);
+    return NULL;
+  }
+
+  return pstLookup;
+}
+
+
+/*========================================================================*/
+int
+fnCDDB_FinishLookup(void *pvDiscInformation, struct CDDBlookup_t *pstLookup)
+/*
+ * Wait for a lookup to finish, and give the disc what it found.  The
+ * lookup is freed.
+ *
+ *   Input:  pvDiscInformation - Disc information structure.
+ *           pstLookup         - The lookup.
+ *
+ * Returns:  -1 if the disc couldn't be looked up, 0 otherwise.
+ *
+ *           pvDiscInformation - Its CDDB information filled in.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInformation;	/* The disc                  */
+  int    iResult;				/* The lookup's              */
+
+
+  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
+
+  pthread_join(pstLookup->tThread, NULL);
+
+  if ((iResult = pstLookup->iResult) == 0) {
+    *pstDiscInformation->pstCDDBinformation = pstLookup->stCDDBinformation;
+    fnArena_Adopt(pstDiscInformation->pstArena, &pstLookup->stArena);
+  } else
+    fnArena_Release(&pstLookup->stArena);
+
+  free(pstLookup->pvDiscInformation);
+  free(pstLookup);
+
+  return iResult;
+}
+
+
+/*========================================================================*/
+pid_t
+fnCDDB_RefreshCache(void *pvDiscInformation, char *szFilename, char *szCDDB_Servers)
+/*
+ * Query the CDDB server again for a disc taken from the metadata cache,
+ * and rewrite its entry, in a process of its own so that extraction
+ * needn't wait.  The titles in use aren't changed; the next run sees the
+ * new entry.  The process is left to finish on its own, quietly.
+ *
+ *   Input:  pvDiscInformation - Disc information structure.
+ *           szFilename        - The disc's entry.
+ *           szCDDB_Servers    - The CDDB servers to try.
+ *
+ * Returns:  The process, or -1 if it couldn't be started.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInfo;     /* Disc information structure.           */
+  struct CDDBinformation_t *pstCDDBinfo;     /* CDDB information structure            */
+  pid_t  tProcess;                           /* The process                           */
+  int    iNull;                              /* /dev/null                             */
+
+
+  pstDiscInfo = (struct DiscInformation_t *) pvDiscInformation;
+  pstCDDBinfo = pstDiscInfo->pstCDDBinformation;
+
+  fflush(NULL);
+
+  if ((tProcess = fork()) != 0)
+    return tProcess;
+
+  if ((iNull = open("/dev/null", O_WRONLY)) >= 0) {
+    dup2(iNull, STDERR_FILENO);
+    close(iNull);
+  }
+
+  /* The titles are this process's own copy; they're replaced by the reply. */
+  pstCDDBinfo->szDiscTitle    = NULL;
+  pstCDDBinfo->szDiscCategory = NULL;
+  pstCDDBinfo->szTrackTitle   = NULL;
+
+  if ((fnCDDB_DoCDDBQuery(pstDiscInfo, szCDDB_Servers, 1) < 0) ||
+      (fnCDDB_WriteCache(pstDiscInfo, szFilename) < 0))
+    _exit(kiExitStatus_General);
+
+  _exit(0);
+}
+
+/* EOF */
@@ -34,6 +34,7 @@
 #include <sys/cdio.h>
 #include <sys/types.h>
 #include <sys/param.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -46,10 +47,47 @@
 #include <ctype.h>
 #include <time.h>
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 
 #undef  CDDB_DEBUG                    /* Define for CDDB DEBUG */
 #define MAX_CDDB_LINE_LENGTH 256      /* Maximum CDDB line length as defined in the CDDB
                                        * specifications. */
+#define kiCDDB_CacheAge (7 * 24 * 60 * 60) /* A cached entry is refreshed once it is
+                                       * older than this (seconds). */
+
+#define kiCDDB_ReadBuffer 4096        /* Bytes of a connection's input buffered */
+
+#define kiCDDB_MaxServers     8       /* CDDB servers which may be listed         */
+#define kiCDDB_ConnectTimeout 10      /* Seconds allowed to look a server up,
+                                       * connect and shake hands */
+#define kiCDDB_ReadTimeout    30      /* Seconds allowed for each read after that */
+
+/* How far an attempt on a server has got */
+#define kiCDDB_Resolving  0           /* Looking up its address           */
+#define kiCDDB_Connecting 1           /* Connecting                       */
+#define kiCDDB_Greeting   2           /* Waiting for its banner           */
+#define kiCDDB_Greeted    3           /* Waiting for the reply to "hello" */
+#define kiCDDB_Ready      4           /* Handshake complete               */
+#define kiCDDB_Failed     5           /* Given up on                      */
+
+/* CDDB over HTTP (cddb.cgi) */
+#define kiCDDB_MaxPath      256       /* Longest cddb.cgi path                    */
+#define kszCDDB_DefaultPath "/~cddb/cddb.cgi" /* Path used if a URL names none   */
+#define kiCDDB_HTTPPort     80        /* Port used if a URL names none            */
+#define kiCDDB_HTTPRequest  2048      /* Longest HTTP request                     */
+
+/* How a connection's input is delimited */
+#define kiCDDB_Stream     0           /* Not at all; it runs until closed          */
+#define kiCDDB_Length     1           /* An HTTP body of Content-Length bytes      */
+#define kiCDDB_Chunked    2           /* An HTTP body in chunks                    */
+
+/* Where a chunked body has got to */
+#define kiCDDB_ChunkData    0         /* In a chunk's data                         */
+#define kiCDDB_ChunkEnd     1         /* At the "\r\n" after it                    */
+#define kiCDDB_ChunkSize    2         /* At the next chunk's size                  */
+#define kiCDDB_ChunkTrailer 3         /* In the trailer, after the last chunk      */
+#define kiCDDB_ChunkDone    4         /* Past the end of the body                  */
 
 /* Session status flags */
 #define SESSION_CONNECTING  0         /* Session is currently connecting. */
@@ -73,11 +111,82 @@ struct CDDBinformation_t {
   char *szCDDBquery;                  /* CDDB query string                        */
 };
 
+/* A CDDB server, as listed with -c. */
+struct CDDBserver_t {
+  char szHost[MAXHOSTNAMELEN];        /* Hostname or IP                           */
+  int  iPort;                         /* Port it listens on                       */
+  char szPath[kiCDDB_MaxPath];        /* cddb.cgi's path, or "" for cddbp         */
+};
+
+/* A connection to a CDDB server, and the input read from it but not yet
+ * handed back, aBuffer[iStart] up to aBuffer[iEnd].  Over HTTP, what has
+ * been read but not yet taken out of its framing follows, up to
+ * aBuffer[iRaw].
+ */
+struct CDDBconnection_t {
+  int    iSocketFD;                   /* The connected socket                     */
+  int    iTimeout;                    /* Milliseconds a read may wait, or -1      */
+  struct CDDBserver_t stServer;       /* The server                               */
+  struct sockaddr_in stAddress;       /* ... and its address                      */
+  int    iRequests;                   /* HTTP requests answered on it             */
+  int    iKeepAlive;                  /* It stays open after this reply (flag)    */
+  int    iFraming;                    /* How the input ends (kiCDDB_Stream...)    */
+  int    iChunkState;                 /* Where a chunked body is (kiCDDB_Chunk...) */
+  long   lBodyLeft;                   /* Bytes left in the body, or its chunk     */
+  size_t iStart,                      /* The first byte not yet handed back       */
+         iEnd,                        /* ... and the end of the data read         */
+         iRaw;                        /* ... and of the input read                */
+  char   aBuffer[kiCDDB_ReadBuffer + 1]; /* Input, with room for a final NULL     */
+};
+
+/* A hostname lookup, handed to the thread doing it. */
+struct CDDBresolve_t {
+  struct CDDBserver_t stServer;       /* The server to look up                    */
+  int    iReply;                      /* Socket to send its address down          */
+};
+
+/* An attempt to connect to one of the servers. */
+struct CDDBattempt_t {
+  struct CDDBserver_t stServer;       /* The server                               */
+  int    iState;                      /* How far we've got (kiCDDB_Resolving...)  */
+  int    iResolver;                   /* Socket its address arrives on, or -1     */
+  struct CDDBconnection_t stConnection; /* The connection, once there is one      */
+};
+
+/* A lookup of the disc, run while its tracks are extracted.  The thread
+ * doing it has its own copy of the disc's information, and allocates the
+ * titles from its own arena; they are handed over when it is done.
+ */
+struct CDDBlookup_t {
+  pthread_t tThread;                  /* The thread doing the lookup              */
+  void   *pvDiscInformation;          /* Its copy of the disc's information       */
+  struct CDDBinformation_t stCDDBinformation; /* ... and of the CDDB information  */
+  struct Arena_t stArena;             /* What it allocates from                   */
+  char   *szServers;                  /* The CDDB servers to try                  */
+  char   szCacheFilename[MAXPATHLEN]; /* Metadata cache entry to write, or ""     */
+  int    iResult;                     /* fnCDDB_DoCDDBQuery()'s                   */
+};
+
 /* CDDB function prototypes. */
 int  fnCDDB_BuildQueryString(void *pvDiscInformation);
-int  fnCDDB_DoCDDBQuery(void *pvDiscInformation, char *szCDDB_RemoteHost,
-                        int CDDB_RemotePort, int iCDDB_StoreFilenames);
+void fnCDDB_InitConnection(struct CDDBconnection_t *pstConnection, int iSocketFD);
+int  fnCDDB_ReadLine(struct CDDBconnection_t *pstConnection, char **pszLine);
+int  fnCDDB_SendCommand(struct CDDBconnection_t *pstConnection, char *szCommand);
+int  fnCDDB_SendRequest(struct CDDBconnection_t *pstConnection, void *pvDiscInformation,
+                        int *iSessionState, char *szBuffer);
+int  fnCDDB_ParseServers(char *szServers, struct CDDBserver_t *astServers, int iMaxServers);
+int  fnCDDB_OpenSession(void *pvDiscInformation, char *szServers,
+                        struct CDDBconnection_t *pstConnection);
+int  fnCDDB_DoCDDBQuery(void *pvDiscInformation, char *szCDDB_Servers,
+                        int iCDDB_StoreFilenames);
 int  fnCDDB_DumpCDDBInfo(void *pvDiscInformation, char *szFilename);
-void fnCDDB_FreeCDDBInformationStruct(void **pvCDDBinfo, int iTracksExpected);
+int  fnCDDB_StoreFilenames(void *pvDiscInformation);
+int  fnCDDB_ReadCache(void *pvDiscInformation, char *szFilename, time_t *pltModified);
+int  fnCDDB_WriteCache(void *pvDiscInformation, char *szFilename);
+int  fnCDDB_ReadIndex(void *pvDiscInformation, char *szFilename);
+struct CDDBlookup_t *fnCDDB_StartLookup(void *pvDiscInformation, char *szCDDB_Servers,
+                                       char *szCacheFilename);
+int  fnCDDB_FinishLookup(void *pvDiscInformation, struct CDDBlookup_t *pstLookup);
+pid_t fnCDDB_RefreshCache(void *pvDiscInformation, char *szFilename, char *szCDDB_Servers);
 
 /* EOF */
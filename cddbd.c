@@ -0,0 +1,623 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * cddbd.c - daex-cddbd: a stand-in CDDB server, which answers any query
+ *           with one canned xmcd entry, and can be told to misbehave (to
+ *           greet late or not at all, to turn clients away, or to send a
+ *           byte at a time), so that DAEX's CDDB client can be tried out
+ *           without a real server, against the failures a real one has.
+ *           It speaks CDDBP, or plays cddb.cgi behind an HTTP server, with
+ *           the reply framed by length, in chunks, or by closing.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "net.h"
+#include "cddbd.h"
+
+
+/*========================================================================*/
+void
+fnCDDBD_Usage(void)
+/*
+ * Displays information on how to use daex-cddbd from the command line.
+ *
+ *   Input:  None.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  fprintf(stderr, "usage: daex-cddbd [-1] [-b seconds] [-d] [-H framing] [-n] [-p port] [-r]\n");
+  fprintf(stderr, "                  [-t title]\n\n");
+
+  fprintf(stderr, "   -1               :  Exit once the first connection closes.\n");
+  fprintf(stderr, "   -b seconds       :  Wait this long before sending the banner.\n");
+  fprintf(stderr, "   -d               :  Dribble: send replies a byte at a time.\n");
+  fprintf(stderr, "   -H framing       :  Serve cddb.cgi over HTTP, framing each reply by:\n");
+  fprintf(stderr, "                       length, chunked, close (HTTP/1.0), or drop (a\n");
+  fprintf(stderr, "                       length, then the connection is closed).\n");
+  fprintf(stderr, "   -n               :  Never send the banner.\n");
+  fprintf(stderr, "   -p port          :  Listen on the specified port. (default: %i)\n",
+          kiCDDBD_DefaultPort);
+  fprintf(stderr, "   -r               :  Refuse every connection.\n");
+  fprintf(stderr, "   -t title         :  The entry's title, \"Artist / Disc\".\n\n");
+
+  exit(kiExitStatus_General);
+}
+
+
+/*========================================================================*/
+int
+fnCDDBD_Send(struct CDDBDSession_t *pstSession, struct CDDBDOptions_t *pstOptions,
+             const char *szData, size_t iLength)
+/*
+ * Send data to the client, all at once, or a byte at a time with a pause
+ * after each if dribbling.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  ssize_t iSent;				/* Bytes sent by one call    */
+  size_t  iChunk;				/* Bytes to send in one call */
+
+
+  while (iLength > 0) {
+    iChunk = (pstOptions->iFlags & kiCDDBD_Dribble) ? 1 : iLength;
+
+    if ((iSent = write(pstSession->iSocket, szData, iChunk)) < 0) {
+      if (errno == EINTR)  continue;
+      return -1;
+    }
+
+    szData  += iSent;
+    iLength -= iSent;
+
+    if (pstOptions->iFlags & kiCDDBD_Dribble)
+      usleep(kiCDDBD_DribbleDelay);
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCDDBD_ReadLine(struct CDDBDSession_t *pstSession, char *szLine, size_t iSize)
+/*
+ * Read a command from the client, a byte at a time.  The line ending is
+ * dropped, as is anything past iSize - 1 bytes.
+ *
+ * Returns:  -1 on error (see errno), 0 if the client closed the
+ *           connection, 1 otherwise.
+ */
+/*========================================================================*/
+{
+  size_t  iLength = 0;				/* Bytes in the line         */
+  ssize_t iRead;				/* Bytes read by one call    */
+  char    cByte;				/* The byte read             */
+
+
+  for (;;) {
+    if ((iRead = read(pstSession->iSocket, &cByte, 1)) < 0) {
+      if (errno == EINTR)  continue;
+      return -1;
+    }
+
+    if (iRead == 0)  return 0;
+
+    if (cByte == '\n')  break;
+
+    if ((cByte != '\r') && (iLength + 1 < iSize))
+      szLine[iLength++] = cByte;
+  }
+
+  szLine[iLength] = '\0';
+
+  return 1;
+}
+
+
+/*========================================================================*/
+int
+fnCDDBD_Append(char *szReply, size_t iSize, const char *szFormat, ...)
+/*
+ * Add a line, and its "\r\n", to a reply.
+ *
+ * Returns:  -1 if the reply would be too long, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  va_list stArguments;				/* The line's arguments      */
+  size_t  iLength;				/* Bytes in the reply so far */
+  int     iAdded;				/* ... and in the line       */
+
+
+  iLength = strlen(szReply);
+
+  va_start(stArguments, szFormat);
+  iAdded = vsnprintf(szReply + iLength, iSize - iLength, szFormat, stArguments);
+  va_end(stArguments);
+
+  if ((iAdded < 0) || (iLength + iAdded + 2 >= iSize)) {
+    szReply[iLength] = '\0';
+    return -1;
+  }
+
+  strcpy(szReply + iLength + iAdded, "\r\n");
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCDDBD_Answer(struct CDDBDSession_t *pstSession, struct CDDBDOptions_t *pstOptions,
+               char *szCommand, char *szReply, size_t iSize)
+/*
+ * Answer a command.  Any disc queried is found, and its entry is the
+ * canned one: the title given, and "Track 1", "Track 2" and so on for as
+ * many tracks as the disc ID says the disc has (its last byte).
+ *
+ *   Input:  pstSession - The client's session.
+ *           pstOptions - How the server behaves.
+ *           szCommand  - The command.
+ *           szReply    - Where to put the reply.
+ *           iSize      - Bytes it has room for.
+ *
+ * Returns:  -1 if the reply didn't fit, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  char szCategory[32],				/* The category read         */
+       szDiscID[16];				/* The disc ID queried, or read */
+  int  iTracks,					/* Tracks in the disc read   */
+       iTrack,					/* Current track             */
+       iLevel,					/* Protocol level asked for  */
+       iResult = 0;				/* Result of the appends     */
+
+
+  szReply[0] = '\0';
+
+  if (strncasecmp(szCommand, "cddb hello ", 11) == 0)
+    return fnCDDBD_Append(szReply, iSize, "200 Hello and welcome %s running daex-cddbd v%s.",
+                          szCommand + 11, kszVersion);
+
+  if (sscanf(szCommand, "proto %d", &iLevel) == 1)
+    return fnCDDBD_Append(szReply, iSize, "201 OK, CDDB protocol level now: %d", iLevel);
+
+  if ((strncasecmp(szCommand, "cddb query ", 11) == 0) &&
+      (sscanf(szCommand + 11, "%8s", szDiscID) == 1))
+    return fnCDDBD_Append(szReply, iSize, "200 misc %s %s", szDiscID, pstOptions->szTitle);
+
+  if ((strncasecmp(szCommand, "cddb read ", 10) == 0) &&
+      (sscanf(szCommand + 10, "%31s %8s", szCategory, szDiscID) == 2)) {
+    iTracks = strtoul(szDiscID, NULL, 16) & 0xff;
+    iTracks = (iTracks < 1) ? 1 : (iTracks > kiCDDBD_MaxTracks) ? kiCDDBD_MaxTracks : iTracks;
+
+    iResult |= fnCDDBD_Append(szReply, iSize,
+                              "210 %s %s CD database entry follows (until terminating `.')",
+                              szCategory, szDiscID);
+    iResult |= fnCDDBD_Append(szReply, iSize, "# xmcd");
+    iResult |= fnCDDBD_Append(szReply, iSize, "#");
+    iResult |= fnCDDBD_Append(szReply, iSize, "DISCID=%s", szDiscID);
+    iResult |= fnCDDBD_Append(szReply, iSize, "DTITLE=%s", pstOptions->szTitle);
+
+    for (iTrack = 0; iTrack < iTracks; iTrack++)
+      iResult |= fnCDDBD_Append(szReply, iSize, "TTITLE%d=Track %d", iTrack, iTrack + 1);
+
+    iResult |= fnCDDBD_Append(szReply, iSize, "EXTD=");
+
+    for (iTrack = 0; iTrack < iTracks; iTrack++)
+      iResult |= fnCDDBD_Append(szReply, iSize, "EXTT%d=", iTrack);
+
+    iResult |= fnCDDBD_Append(szReply, iSize, "PLAYORDER=");
+    iResult |= fnCDDBD_Append(szReply, iSize, ".");
+
+    return iResult;
+  }
+
+  if (strcasecmp(szCommand, "quit") == 0) {
+    pstSession->iQuit = 1;
+
+    return fnCDDBD_Append(szReply, iSize, "230 daex-cddbd Closing connection.  Goodbye.");
+  }
+
+  return fnCDDBD_Append(szReply, iSize, "500 Unrecognized command.");
+}
+
+
+/*========================================================================*/
+void
+fnCDDBD_Decode(char *szValue)
+/*
+ * Decode a URL encoded value, in place: "+" is a space, and "%xx" the
+ * character with that code.
+ */
+/*========================================================================*/
+{
+  char *szOut;					/* Where the next one goes   */
+  int  iCode;					/* A "%xx" character         */
+
+
+  for (szOut = szValue; *szValue; szValue++) {
+    if (*szValue == '+')
+      *szOut++ = ' ';
+    else if ((*szValue == '%') && (sscanf(szValue + 1, "%2x", &iCode) == 1) &&
+             isxdigit((u_char) szValue[1]) && isxdigit((u_char) szValue[2])) {
+      *szOut++ = (char) iCode;
+      szValue += 2;
+    } else
+      *szOut++ = *szValue;
+  }
+
+  *szOut = '\0';
+}
+
+
+/*========================================================================*/
+int
+fnCDDBD_Frame(struct CDDBDOptions_t *pstOptions, const char *szBody, char *szReply,
+              size_t iSize)
+/*
+ * Put an HTTP reply around a body, framed as asked.
+ *
+ *   Input:  pstOptions - How the server behaves.
+ *           szBody     - The body.
+ *           szReply    - Where to put the reply.
+ *           iSize      - Bytes it has room for.
+ *
+ * Returns:  -1 if the reply didn't fit, its length otherwise.
+ */
+/*========================================================================*/
+{
+  size_t iLength,				/* Bytes in the reply        */
+         iBody,					/* ... and in the body       */
+         iChunk,				/* Bytes in the next chunk   */
+         iAt;					/* Bytes of the body framed  */
+  int    iAdded;				/* Bytes added by a call     */
+
+
+  iBody = strlen(szBody);
+
+  switch (pstOptions->iFraming) {
+    case kiCDDBD_Close:
+      iAdded = snprintf(szReply, iSize, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\n%s",
+                        szBody);
+      break;
+
+    case kiCDDBD_Chunked:
+      iAdded = snprintf(szReply, iSize, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n");
+
+      for (iAt = 0; (iAdded >= 0) && ((size_t) iAdded < iSize) && (iAt < iBody); iAt += iChunk) {
+        iLength = iAdded;
+        iChunk  = (iBody - iAt > kiCDDBD_ChunkLength) ? kiCDDBD_ChunkLength : iBody - iAt;
+        iAdded  = snprintf(szReply + iLength, iSize - iLength, "%lx\r\n%.*s\r\n",
+                           (u_long) iChunk, (int) iChunk, szBody + iAt);
+        iAdded  = (iAdded < 0) ? -1 : (int) (iLength + iAdded);
+      }
+
+      /* The last chunk, and a trailer for the client to skip. */
+      if ((iAdded >= 0) && ((size_t) iAdded < iSize)) {
+        iLength = iAdded;
+        iAdded  = snprintf(szReply + iLength, iSize - iLength,
+                           "0\r\nX-Served-By: daex-cddbd\r\n\r\n");
+        iAdded  = (iAdded < 0) ? -1 : (int) (iLength + iAdded);
+      }
+      break;
+
+    default:
+      iAdded = snprintf(szReply, iSize, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+                        "Content-Length: %lu\r\n\r\n%s", (u_long) iBody, szBody);
+      break;
+  }
+
+  return ((iAdded < 0) || ((size_t) iAdded >= iSize)) ? -1 : iAdded;
+}
+
+
+/*========================================================================*/
+int
+fnCDDBD_ServeHTTP(struct CDDBDSession_t *pstSession, struct CDDBDOptions_t *pstOptions)
+/*
+ * Serve a client as cddb.cgi would, behind an HTTP server: each request
+ * carries one CDDB command, as its "cmd" parameter, and gets that
+ * command's reply.  The client's "hello" and "proto" parameters are taken
+ * as given.  A connection is kept open for more requests, unless the
+ * framing says otherwise.
+ *
+ * Returns:  -1 if the connection failed, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  char   szLine[kiCDDBD_LineLength],		/* The request line          */
+         szHeader[kiCDDBD_LineLength],		/* A header line, ignored    */
+         szBody[kiCDDBD_ReplyLength],		/* The CDDB reply            */
+         szReply[kiCDDBD_ReplyLength * 4],	/* ... as an HTTP reply      */
+         *szCommand;				/* The "cmd" parameter       */
+  int    iRead,					/* Result of a read          */
+         iLength;				/* Bytes in the reply        */
+
+
+  for (;;) {
+    if ((iRead = fnCDDBD_ReadLine(pstSession, szLine, sizeof(szLine))) <= 0)
+      return iRead;
+
+    while ((iRead = fnCDDBD_ReadLine(pstSession, szHeader, sizeof(szHeader))) > 0)
+      if (szHeader[0] == '\0')  break;
+
+    if (iRead <= 0)  return iRead;
+
+    fprintf(stderr, "daex-cddbd: %s\n", szLine);
+
+    if (pstOptions->iBannerDelay)
+      sleep(pstOptions->iBannerDelay);
+
+    if (pstOptions->iFlags & kiCDDBD_Refuse) {
+      strcpy(szReply, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n"
+                      "Connection: close\r\n\r\n");
+
+      return fnCDDBD_Send(pstSession, pstOptions, szReply, strlen(szReply));
+    }
+
+    /* The command is the "cmd" parameter of the query string. */
+    szCommand = strchr(szLine, '?');
+
+    while (szCommand && strncmp(szCommand + 1, "cmd=", 4))
+      szCommand = strchr(szCommand + 1, '&');
+
+    if (szCommand) {
+      szCommand += 5;
+      szCommand[strcspn(szCommand, "& ")] = '\0';
+      fnCDDBD_Decode(szCommand);
+    } else
+      szCommand = "";
+
+    if ((strncasecmp(szCommand, "cddb query ", 11) == 0) ||
+        (strncasecmp(szCommand, "cddb read ", 10) == 0)) {
+      if (fnCDDBD_Answer(pstSession, pstOptions, szCommand, szBody, sizeof(szBody)) < 0)
+        strcpy(szBody, "402 Server error.\r\n");
+    } else
+      strcpy(szBody, "500 Command syntax error.\r\n");
+
+    if ((iLength = fnCDDBD_Frame(pstOptions, szBody, szReply, sizeof(szReply))) < 0)
+      return -1;
+
+    if (fnCDDBD_Send(pstSession, pstOptions, szReply, iLength) < 0)
+      return -1;
+
+    if ((pstOptions->iFraming == kiCDDBD_Close) || (pstOptions->iFraming == kiCDDBD_Drop))
+      return 0;
+  }
+}
+
+
+/*========================================================================*/
+int
+fnCDDBD_Serve(int iSocket, struct CDDBDOptions_t *pstOptions)
+/*
+ * Serve a client, until it quits or closes the connection.
+ *
+ *   Input:  iSocket    - The connection.
+ *           pstOptions - How the server behaves.
+ *
+ * Returns:  -1 if the connection failed, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct CDDBDSession_t stSession;		/* The client's session      */
+  char   szLine[kiCDDBD_LineLength],		/* A command                 */
+         szReply[kiCDDBD_ReplyLength];		/* ... and its reply         */
+  int    iRead;					/* Result of a read          */
+
+
+  memset(&stSession, 0, sizeof(stSession));
+
+  stSession.iSocket = iSocket;
+
+  /* Silent, the client is left to give up; whatever it sends is ignored. */
+  if (pstOptions->iFlags & kiCDDBD_Silent) {
+    while ((iRead = fnCDDBD_ReadLine(&stSession, szLine, sizeof(szLine))) > 0)
+      ;
+
+    return iRead;
+  }
+
+  if (pstOptions->iFraming != kiCDDBD_CDDBP)
+    return fnCDDBD_ServeHTTP(&stSession, pstOptions);
+
+  if (pstOptions->iBannerDelay)
+    sleep(pstOptions->iBannerDelay);
+
+  if (pstOptions->iFlags & kiCDDBD_Refuse) {
+    strcpy(szReply, "432 No connections allowed: permission denied.\r\n");
+
+    return fnCDDBD_Send(&stSession, pstOptions, szReply, strlen(szReply));
+  }
+
+  snprintf(szReply, sizeof(szReply), "201 localhost daex-cddbd v%s ready, read only.\r\n",
+           kszVersion);
+
+  if (fnCDDBD_Send(&stSession, pstOptions, szReply, strlen(szReply)) < 0)
+    return -1;
+
+  while (!stSession.iQuit) {
+    if ((iRead = fnCDDBD_ReadLine(&stSession, szLine, sizeof(szLine))) <= 0)
+      return iRead;
+
+    fprintf(stderr, "daex-cddbd: %s\n", szLine);
+
+    if (fnCDDBD_Answer(&stSession, pstOptions, szLine, szReply, sizeof(szReply)) < 0)
+      strcpy(szReply, "402 Server error.\r\n");
+
+    if (fnCDDBD_Send(&stSession, pstOptions, szReply, strlen(szReply)) < 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  extern int  optind;		/* The current argument number - getopt()    */
+  extern char *optarg;		/* Current option's arg. string - getopt()   */
+
+  struct CDDBDOptions_t stOptions;		/* How to behave             */
+  struct sockaddr_in stAddress;			/* Where to listen           */
+  int    iArgument,				/* Current getopt() argument */
+         iListener,				/* The listening socket      */
+         iSocket,				/* A connection              */
+         iPort = kiCDDBD_DefaultPort,		/* The port                  */
+         iOnce = 0,				/* Exit after one connection */
+         iOn = 1,				/* Option value              */
+         iReturnValue = 0;			/* Result of the last one    */
+
+
+  memset(&stOptions, 0, sizeof(stOptions));
+  stOptions.szTitle = "Various / Stand-in Disc";
+
+  while ((iArgument = getopt(argc, argv, "1b:dH:np:rt:")) != -1) {
+    switch (iArgument) {
+      case '1':					/* One connection            */
+        iOnce = 1;
+        break;
+
+      case 'b':					/* Banner delay              */
+        if ((stOptions.iBannerDelay = atoi(optarg)) < 0)  fnCDDBD_Usage();
+        break;
+
+      case 'd':					/* Dribble                   */
+        stOptions.iFlags |= kiCDDBD_Dribble;
+        break;
+
+      case 'H':					/* HTTP                      */
+        if (strcmp(optarg, "length") == 0)
+          stOptions.iFraming = kiCDDBD_Length;
+        else if (strcmp(optarg, "chunked") == 0)
+          stOptions.iFraming = kiCDDBD_Chunked;
+        else if (strcmp(optarg, "close") == 0)
+          stOptions.iFraming = kiCDDBD_Close;
+        else if (strcmp(optarg, "drop") == 0)
+          stOptions.iFraming = kiCDDBD_Drop;
+        else
+          fnCDDBD_Usage();
+        break;
+
+      case 'n':					/* No banner                 */
+        stOptions.iFlags |= kiCDDBD_Silent;
+        break;
+
+      case 'p':					/* Port                      */
+        if (((iPort = atoi(optarg)) < 1) || (iPort > 65535)) {
+          fprintf(stderr, "daex-cddbd: The port must be from 1 to 65535.\n");
+          exit(kiExitStatus_General);
+        }
+        break;
+
+      case 'r':					/* Refuse                    */
+        stOptions.iFlags |= kiCDDBD_Refuse;
+        break;
+
+      case 't':					/* Title                     */
+        if (strlen(optarg) > kiCDDBD_LineLength) {
+          fprintf(stderr, "daex-cddbd: The title may be at most %i characters.\n",
+                  kiCDDBD_LineLength);
+          exit(kiExitStatus_General);
+        }
+
+        stOptions.szTitle = optarg;
+        break;
+
+      case '?':
+      default:
+        fnCDDBD_Usage();
+    }
+  }
+
+  if (argc != optind)  fnCDDBD_Usage();
+
+  signal(SIGPIPE, SIG_IGN);
+
+  /* Children are reaped by the system. */
+  signal(SIGCHLD, SIG_IGN);
+
+  memset(&stAddress, 0, sizeof(stAddress));
+
+  stAddress.sin_family      = AF_INET;
+  stAddress.sin_port        = htons(iPort);
+  stAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (((iListener = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+      (setsockopt(iListener, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn)) < 0) ||
+      (bind(iListener, (struct sockaddr *) &stAddress, sizeof(stAddress)) < 0) ||
+      (listen(iListener, kiCDDBD_Backlog) < 0)) {
+    fprintf(stderr, "daex-cddbd: Unable to listen on port %i: %s.\n", iPort, strerror(errno));
+    exit(kiExitStatus_General);
+  }
+
+  fprintf(stderr, "daex-cddbd: Listening on port %i.\n", iPort);
+
+  /* Each client is served by a process of its own, so that one kept
+   * waiting doesn't hold up the rest.  With -1, the first is served here.
+   */
+  for (;;) {
+    if ((iSocket = accept(iListener, NULL, NULL)) < 0) {
+      if (errno == EINTR)  continue;
+
+      fprintf(stderr, "daex-cddbd: Unable to accept a connection: %s.\n", strerror(errno));
+      exit(kiExitStatus_General);
+    }
+
+    if (iOnce) {
+      iReturnValue = fnCDDBD_Serve(iSocket, &stOptions);
+      close(iSocket);
+      break;
+    }
+
+    switch (fork()) {
+      case -1:
+        fprintf(stderr, "daex-cddbd: Unable to fork: %s.\n", strerror(errno));
+        break;
+
+      case 0:
+        close(iListener);
+        exit((fnCDDBD_Serve(iSocket, &stOptions) < 0) ? kiExitStatus_General : 0);
+    }
+
+    close(iSocket);
+  }
+
+  close(iListener);
+
+  return (iReturnValue < 0) ? kiExitStatus_General : 0;
+}
+
+/* EOF */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * cddbd.h - Header for daex-cddbd, a stand-in CDDB server.
+ *
+ * $Id$
+ */
+
+#include <signal.h>
+#include <ctype.h>
+
+#define kiCDDBD_DefaultPort	8880	/* The CDDBP port                          */
+#define kiCDDBD_Backlog		8	/* Connections waiting to be accepted      */
+#define kiCDDBD_LineLength	256	/* Longest command taken                   */
+#define kiCDDBD_ReplyLength	8192	/* Longest reply, a whole entry included   */
+#define kiCDDBD_MaxTracks	99	/* Most tracks an entry is given           */
+#define kiCDDBD_DribbleDelay	2000	/* Microseconds between bytes, dribbling   */
+#define kiCDDBD_ChunkLength	7	/* Bytes per chunk, when chunked (few, so  */
+					/* that lines are split across chunks)     */
+
+/* Misbehaviour asked for (struct CDDBDOptions_t's iFlags) */
+#define kiCDDBD_Silent		0x01	/* Never send the banner                   */
+#define kiCDDBD_Refuse		0x02	/* Turn every connection away (432)        */
+#define kiCDDBD_Dribble		0x04	/* Send a byte at a time                   */
+
+/* The protocol spoken (struct CDDBDOptions_t's iFraming) */
+#define kiCDDBD_CDDBP		0	/* CDDBP, a session per connection         */
+#define kiCDDBD_Length		1	/* cddb.cgi over HTTP/1.1, with a          */
+					/* Content-Length                          */
+#define kiCDDBD_Chunked		2	/* ... with the body chunked               */
+#define kiCDDBD_Close		3	/* ... over HTTP/1.0, the end of the body  */
+					/* being the end of the connection         */
+#define kiCDDBD_Drop		4	/* ... with a Content-Length, but the      */
+					/* connection closed after each reply      */
+
+/* How the server behaves, from the command line. */
+struct CDDBDOptions_t {
+  int   iFlags;                     /* Misbehaviour (kiCDDBD_*)                    */
+  int   iFraming;                   /* Protocol (kiCDDBD_CDDBP or an HTTP framing) */
+  int   iBannerDelay;               /* Seconds to wait before the banner           */
+  char  *szTitle;                   /* The canned entry's DTITLE                   */
+};
+
+/* A client's session. */
+struct CDDBDSession_t {
+  int   iSocket;                    /* The connection                              */
+  int   iQuit;                      /* The client said "quit" (flag)               */
+};
+
+/* EOF */
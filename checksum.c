@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * checksum.c - CRC-32 (ISO 3309 / ITU-T V.42, as used by zip and PNG) over
+ *              the extracted audio data.  The slicing-by-8 method is used so
+ *              that checksumming an archive is limited by the disk, not the
+ *              CPU.  Also MD5, which FLAC files carry of their samples.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "checksum.h"
+
+#define kiCRC_Polynomial	0xedb88320	/* Reflected CRC-32 polynomial   */
+
+u_int32_t alCRCtable[8][256];			/* Slicing-by-8 lookup tables    */
+
+/* MD5's per-step additive constants (the integer part of 2^32 |sin(i)|)
+ * and rotations, four rounds of sixteen steps.
+ */
+static const u_int32_t alMD5constants[64] = {
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+  0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+  0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+  0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+  0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+  0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int aiMD5shifts[4][4] = { { 7, 12, 17, 22 }, { 5, 9, 14, 20 },
+                                       { 4, 11, 16, 23 }, { 6, 10, 15, 21 } };
+
+
+/*========================================================================*/
+void
+fnCRC_Initialize(void)
+/*
+ * Build the CRC lookup tables.  Must be called once before fnCRC_Update(),
+ * and before any threads which use it are started.
+ *
+ *   Input:  None.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  u_int32_t lCRC;				/* Current table entry       */
+  int iIndex,					/* Current table index       */
+      iBit,					/* Current bit               */
+      iSlice;					/* Current slice table       */
+
+
+  /* The first table is the classic byte-at-a-time table. */
+  for (iIndex = 0; iIndex < 256; iIndex++) {
+    lCRC = iIndex;
+
+    for (iBit = 0; iBit < 8; iBit++)
+      lCRC = (lCRC & 1) ? (kiCRC_Polynomial ^ (lCRC >> 1)) : (lCRC >> 1);
+
+    alCRCtable[0][iIndex] = lCRC;
+  }
+
+  /* Each following table advances the previous one by another zero byte. */
+  for (iIndex = 0; iIndex < 256; iIndex++)
+    for (iSlice = 1; iSlice < 8; iSlice++)
+      alCRCtable[iSlice][iIndex] = (alCRCtable[iSlice - 1][iIndex] >> 8) ^
+                                   alCRCtable[0][alCRCtable[iSlice - 1][iIndex] & 0xff];
+}
+
+
+/*========================================================================*/
+u_int32_t
+fnCRC_Update(u_int32_t lCRC, const void *pvBuffer, size_t iLength)
+/*
+ * Continue a CRC-32 over the buffer specified.  Start with a CRC of 0;
+ * the value returned may be passed back in to checksum data in pieces.
+ *
+ *   Input:  lCRC     - The CRC of the data seen so far (0 to begin).
+ *           pvBuffer - The data to checksum.
+ *           iLength  - Number of bytes in pvBuffer.
+ *
+ * Returns:  The updated CRC.
+ */
+/*========================================================================*/
+{
+  const u_char *pBuffer;			/* Current position          */
+  u_int32_t lWord0,				/* First four bytes          */
+            lWord1;				/* Second four bytes         */
+
+
+  pBuffer = (const u_char *) pvBuffer;
+  lCRC = ~lCRC;
+
+  /* Eight bytes at a time.  The words are assembled byte-wise so that the
+   * result does not depend on the host's byte order or alignment rules.
+   */
+  while (iLength >= 8) {
+    lWord0 = CRC_LE32(pBuffer);
+    lWord1 = CRC_LE32(pBuffer + 4);
+
+    CRC_SLICE8(lCRC, lWord0, lWord1);
+
+    pBuffer += 8;
+    iLength -= 8;
+  }
+
+  /* ... and whatever is left, a byte at a time. */
+  while (iLength-- > 0)
+    lCRC = alCRCtable[0][(lCRC ^ *pBuffer++) & 0xff] ^ (lCRC >> 8);
+
+  return ~lCRC;
+}
+
+
+/*========================================================================*/
+void
+fnMD5_Initialize(struct MD5Context_t *pstContext)
+/*
+ * Start an MD5 digest.
+ *
+ *   Input:  pstContext - The digest.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  pstContext->alState[0] = 0x67452301;
+  pstContext->alState[1] = 0xefcdab89;
+  pstContext->alState[2] = 0x98badcfe;
+  pstContext->alState[3] = 0x10325476;
+  pstContext->llLength   = 0;
+}
+
+
+/*========================================================================*/
+static void
+fnMD5_Transform(u_int32_t *alState, const u_char *pBlock)
+/*
+ * Digest one 64 byte block.
+ */
+/*========================================================================*/
+{
+  u_int32_t alWords[16],			/* The block, little-endian  */
+            lA, lB, lC, lD,			/* Working state             */
+            lF,					/* Round function's result   */
+            lTemp;				/* Word being rotated out    */
+  int       iStep,				/* Current step              */
+            iWord;				/* Word used by the step     */
+
+
+  for (iStep = 0; iStep < 16; iStep++)
+    alWords[iStep] = CRC_LE32(pBlock + iStep * 4);
+
+  lA = alState[0];
+  lB = alState[1];
+  lC = alState[2];
+  lD = alState[3];
+
+  for (iStep = 0; iStep < 64; iStep++) {
+    switch (iStep / 16) {
+      case 0:   lF = (lB & lC) | (~lB & lD);  iWord = iStep;                 break;
+      case 1:   lF = (lD & lB) | (~lD & lC);  iWord = (5 * iStep + 1) % 16;  break;
+      case 2:   lF = lB ^ lC ^ lD;            iWord = (3 * iStep + 5) % 16;  break;
+      default:  lF = lC ^ (lB | ~lD);         iWord = (7 * iStep) % 16;      break;
+    }
+
+    lF   += lA + alMD5constants[iStep] + alWords[iWord];
+    lTemp = lD;
+    lD    = lC;
+    lC    = lB;
+    lB   += (lF << aiMD5shifts[iStep / 16][iStep % 4]) |
+            (lF >> (32 - aiMD5shifts[iStep / 16][iStep % 4]));
+    lA    = lTemp;
+  }
+
+  alState[0] += lA;
+  alState[1] += lB;
+  alState[2] += lC;
+  alState[3] += lD;
+}
+
+
+/*========================================================================*/
+void
+fnMD5_Update(struct MD5Context_t *pstContext, const void *pvBuffer, size_t iLength)
+/*
+ * Continue an MD5 digest over the buffer specified.
+ *
+ *   Input:  pstContext - The digest.
+ *           pvBuffer   - The data to digest.
+ *           iLength    - Number of bytes in pvBuffer.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  const u_char *pBuffer;			/* Current position          */
+  size_t iHeld,					/* Bytes already in aBlock   */
+         iCopy;					/* Bytes added to aBlock     */
+
+
+  pBuffer = (const u_char *) pvBuffer;
+  iHeld   = pstContext->llLength % 64;
+
+  pstContext->llLength += iLength;
+
+  /* Top up a partial block first ... */
+  if (iHeld > 0) {
+    iCopy = (iLength < 64 - iHeld) ? iLength : 64 - iHeld;
+
+    memcpy(pstContext->aBlock + iHeld, pBuffer, iCopy);
+
+    pBuffer += iCopy;
+    iLength -= iCopy;
+
+    if (iHeld + iCopy < 64)  return;
+
+    fnMD5_Transform(pstContext->alState, pstContext->aBlock);
+  }
+
+  /* ... then whole blocks straight from the buffer, and keep the rest. */
+  for (; iLength >= 64; pBuffer += 64, iLength -= 64)
+    fnMD5_Transform(pstContext->alState, pBuffer);
+
+  memcpy(pstContext->aBlock, pBuffer, iLength);
+}
+
+
+/*========================================================================*/
+void
+fnMD5_Final(struct MD5Context_t *pstContext, u_char *pDigest)
+/*
+ * Finish an MD5 digest: pad it with a 1 bit, zeroes and the length in
+ * bits.
+ *
+ *   Input:  pstContext - The digest.
+ *           pDigest    - 16 bytes for the result.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  u_char    aPadding[72];			/* Padding and length        */
+  u_int64_t llBits;				/* Bits digested             */
+  size_t    iPadding;				/* Bytes of padding          */
+  int       iByte;				/* Current byte              */
+
+
+  llBits   = pstContext->llLength * 8;
+  iPadding = 64 - (pstContext->llLength + 8) % 64;
+
+  memset(aPadding, 0, sizeof(aPadding));
+  aPadding[0] = 0x80;
+
+  for (iByte = 0; iByte < 8; iByte++)
+    aPadding[iPadding + iByte] = (llBits >> (iByte * 8)) & 0xff;
+
+  fnMD5_Update(pstContext, aPadding, iPadding + 8);
+
+  for (iByte = 0; iByte < 16; iByte++)
+    pDigest[iByte] = (pstContext->alState[iByte / 4] >> ((iByte % 4) * 8)) & 0xff;
+}
+
+/* EOF */
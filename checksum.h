@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * checksum.h - Header for the audio checksum routines.
+ *
+ * $Id$
+ */
+
+#define kiChecksumLineLength	(MAX_FILENAME_LENGTH + 16) /* Checksum file line   */
+
+/* Advance lCRC (already inverted) over eight bytes of data, held as two
+ * little-endian words.  Shared by fnCRC_Update() and the fused analysis
+ * kernel, which has the words in hand already.
+ */
+#define CRC_SLICE8(lCRC, lWord0, lWord1) do {                                         \
+  u_int32_t lSlice = (lCRC) ^ (lWord0);                                               \
+  (lCRC) = alCRCtable[7][lSlice & 0xff]           ^ alCRCtable[6][(lSlice >> 8) & 0xff] ^ \
+           alCRCtable[5][(lSlice >> 16) & 0xff]   ^ alCRCtable[4][lSlice >> 24] ^       \
+           alCRCtable[3][(lWord1) & 0xff]         ^ alCRCtable[2][((lWord1) >> 8) & 0xff] ^ \
+           alCRCtable[1][((lWord1) >> 16) & 0xff] ^ alCRCtable[0][(lWord1) >> 24];      \
+} while (0)
+
+/* Assemble a little-endian word from four bytes, whatever the host order. */
+#define CRC_LE32(pBuffer) ((u_int32_t) (pBuffer)[0]       | (u_int32_t) (pBuffer)[1] << 8 | \
+                           (u_int32_t) (pBuffer)[2] << 16 | (u_int32_t) (pBuffer)[3] << 24)
+
+extern u_int32_t alCRCtable[8][256];	/* Slicing-by-8 lookup tables      */
+
+/* A running MD5 digest (RFC 1321), as FLAC keeps of its samples. */
+struct MD5Context_t {
+  u_int32_t alState[4];             /* A, B, C and D                               */
+  u_int64_t llLength;               /* Bytes digested                              */
+  u_char    aBlock[64];             /* Bytes awaiting a whole block                */
+};
+
+/* Checksum function prototypes. */
+void      fnCRC_Initialize(void);
+u_int32_t fnCRC_Update(u_int32_t lCRC, const void *pvBuffer, size_t iLength);
+void      fnMD5_Initialize(struct MD5Context_t *pstContext);
+void      fnMD5_Update(struct MD5Context_t *pstContext, const void *pvBuffer, size_t iLength);
+void      fnMD5_Final(struct MD5Context_t *pstContext, u_char *pDigest);
+
+/* EOF */
@@ -0,0 +1,660 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX      - The Digital Audio EXtractor
+ *
+ * convert.c - Sample format conversion between the read and the write:
+ *             stereo to mono, 16 bit integers to 8, 24 or 32 bit integers
+ *             or 32 bit floats, with TPDF or noise shaped dither where the
+ *             word length is reduced, and a change of sample rate.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "resample.h"
+#include "convert.h"
+
+/* Error feedback filter for noise shaping: Lipshitz et al's 5 tap design
+ * for 44.1 kHz, which pushes the noise above ~15 kHz.
+ */
+static const float afShapingFilter[kiConvert_ShapingTaps] = {
+  2.033f, -2.165f, 1.959f, -1.590f, 0.6149f
+};
+
+
+/*========================================================================*/
+float
+fnConvert_Random(struct Converter_t *pstConverter)
+/*
+ * Generate TPDF dither from the first lane of the generator: the difference
+ * of two uniform values in [0, 1), 2 LSB peak to peak.
+ *
+ *   Input:  pstConverter - The converter.
+ * Returns:  The dither, in LSBs.
+ */
+/*========================================================================*/
+{
+  u_int32_t lSeed;				/* Generator state           */
+  float     fUniform;				/* First uniform value       */
+
+
+  lSeed  = pstConverter->alSeed[0];
+  lSeed ^= lSeed << 13;  lSeed ^= lSeed >> 17;  lSeed ^= lSeed << 5;
+  fUniform = (lSeed >> 8) * (1.0f / 16777216.0f);
+  lSeed ^= lSeed << 13;  lSeed ^= lSeed >> 17;  lSeed ^= lSeed << 5;
+  pstConverter->alSeed[0] = lSeed;
+
+  return fUniform - (lSeed >> 8) * (1.0f / 16777216.0f);
+}
+
+
+#ifdef __SSE2__
+/*========================================================================*/
+__m128
+fnConvert_Random4(__m128i *pvSeed)
+/*
+ * Generate four TPDF dither values at once, one from each lane of the
+ * generator.  (Xorshift needs only shifts and exclusive ors, which SSE2
+ * has for 32 bit lanes.)
+ *
+ *   Input:  pvSeed - The generator state.
+ * Returns:  The dither, in LSBs.
+ */
+/*========================================================================*/
+{
+  __m128i vSeed;				/* Generator state           */
+  __m128  vUniform;				/* First uniform values      */
+
+
+  vSeed    = *pvSeed;
+  vSeed    = _mm_xor_si128(vSeed, _mm_slli_epi32(vSeed, 13));
+  vSeed    = _mm_xor_si128(vSeed, _mm_srli_epi32(vSeed, 17));
+  vSeed    = _mm_xor_si128(vSeed, _mm_slli_epi32(vSeed, 5));
+  vUniform = _mm_cvtepi32_ps(_mm_srli_epi32(vSeed, 8));
+  vSeed    = _mm_xor_si128(vSeed, _mm_slli_epi32(vSeed, 13));
+  vSeed    = _mm_xor_si128(vSeed, _mm_srli_epi32(vSeed, 17));
+  vSeed    = _mm_xor_si128(vSeed, _mm_slli_epi32(vSeed, 5));
+  *pvSeed  = vSeed;
+
+  return _mm_mul_ps(_mm_sub_ps(vUniform, _mm_cvtepi32_ps(_mm_srli_epi32(vSeed, 8))),
+                    _mm_set1_ps(1.0f / 16777216.0f));
+}
+#endif
+
+
+/*========================================================================*/
+long
+fnConvert_Quantize(float fSample, long lMinimum, long lMaximum)
+/*
+ * Round a sample to the nearest integer, and clip it to the range given.
+ */
+/*========================================================================*/
+{
+  long lSample = lrintf(fSample);
+
+  return (lSample < lMinimum) ? lMinimum : (lSample > lMaximum) ? lMaximum : lSample;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Mix kernels: CDDA in, floats out.                                      */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+void
+fnConvert_MixStereo(const u_char *pInput, float *afOutput, int iFrames)
+/*
+ * Convert CDDA to stereo floats.  Eight samples at a time with SSE2.
+ */
+/*========================================================================*/
+{
+  int iSample = 0;				/* Current sample            */
+#ifdef __SSE2__
+  __m128i vSamples;				/* Eight 16 bit samples      */
+  __m128  vScale = _mm_set1_ps(1.0f / 32768.0f);	/* Full scale        */
+
+
+  for (; iSample + 8 <= iFrames * 2; iSample += 8) {
+    vSamples = _mm_loadu_si128((const __m128i *) (pInput + iSample * 2));
+
+    _mm_storeu_ps(afOutput + iSample, _mm_mul_ps(vScale,
+                  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vSamples, vSamples), 16))));
+    _mm_storeu_ps(afOutput + iSample + 4, _mm_mul_ps(vScale,
+                  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vSamples, vSamples), 16))));
+  }
+#endif
+
+  for (; iSample < iFrames * 2; iSample++)
+    afOutput[iSample] = (int16_t) (pInput[iSample * 2] | pInput[iSample * 2 + 1] << 8) *
+                        (1.0f / 32768.0f);
+}
+
+
+/*========================================================================*/
+void
+fnConvert_MixMono(const u_char *pInput, float *afOutput, int iFrames)
+/*
+ * Mix CDDA down to mono floats, (left + right) / 2.  With SSE2, one
+ * multiply-add sums the channels of four frames.
+ */
+/*========================================================================*/
+{
+  int iFrame = 0;				/* Current frame             */
+#ifdef __SSE2__
+  __m128  vScale = _mm_set1_ps(1.0f / 65536.0f);	/* Full scale, x 2   */
+
+
+  for (; iFrame + 4 <= iFrames; iFrame += 4)
+    _mm_storeu_ps(afOutput + iFrame, _mm_mul_ps(vScale, _mm_cvtepi32_ps(
+                  _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (pInput + iFrame * 4)),
+                                 _mm_set1_epi16(1)))));
+#endif
+
+  for (; iFrame < iFrames; iFrame++)
+    afOutput[iFrame] = ((int16_t) (pInput[iFrame * 4]     | pInput[iFrame * 4 + 1] << 8) +
+                        (int16_t) (pInput[iFrame * 4 + 2] | pInput[iFrame * 4 + 3] << 8)) *
+                       (1.0f / 65536.0f);
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Store kernels: floats in, little-endian output samples out.            */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+void
+fnConvert_StoreFloat(struct Converter_t *pstConverter, const float *afInput,
+                     u_char *pOutput, int iSamples)
+/*
+ * Store 32 bit IEEE floats.
+ */
+/*========================================================================*/
+{
+  union { float f; u_int32_t l; } uSample;	/* Sample, as bits           */
+  int iSample;					/* Current sample            */
+
+
+  for (iSample = 0; iSample < iSamples; iSample++, pOutput += 4) {
+    uSample.f  = afInput[iSample];
+    pOutput[0] = uSample.l & 0xff;
+    pOutput[1] = (uSample.l >> 8) & 0xff;
+    pOutput[2] = (uSample.l >> 16) & 0xff;
+    pOutput[3] = uSample.l >> 24;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnConvert_Store32(struct Converter_t *pstConverter, const float *afInput,
+                  u_char *pOutput, int iSamples)
+/*
+ * Store 32 bit integers.  No dither is needed at this word length.  The
+ * samples are clipped before they are converted, as fnConvert_Quantize()
+ * clips them, since a resampled full scale signal overshoots; the top of
+ * the range is the largest float below 2^31, 2^31 - 128.
+ */
+/*========================================================================*/
+{
+  u_int32_t lSample;				/* Current sample            */
+  int iSample = 0;				/* Current sample number     */
+#ifdef __SSE2__
+  __m128 vScale   = _mm_set1_ps(2147483648.0f),	/* Full scale                */
+         vMinimum = _mm_set1_ps(-2147483648.0f),	/* Smallest output sample    */
+         vMaximum = _mm_set1_ps(2147483520.0f);	/* Largest output sample     */
+
+
+  for (; iSample + 4 <= iSamples; iSample += 4)
+    _mm_storeu_si128((__m128i *) (pOutput + iSample * 4),
+                     _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(afInput + iSample),
+                                                                      vScale), vMinimum), vMaximum)));
+#endif
+
+  for (; iSample < iSamples; iSample++) {
+    lSample = (u_int32_t) fnConvert_Quantize(afInput[iSample] * 2147483648.0f,
+                                             -2147483647L - 1, 2147483647L);
+
+    pOutput[iSample * 4]     = lSample & 0xff;
+    pOutput[iSample * 4 + 1] = (lSample >> 8) & 0xff;
+    pOutput[iSample * 4 + 2] = (lSample >> 16) & 0xff;
+    pOutput[iSample * 4 + 3] = lSample >> 24;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnConvert_Store24(struct Converter_t *pstConverter, const float *afInput,
+                  u_char *pOutput, int iSamples)
+/*
+ * Store packed 24 bit integers, clipped as above.  SSE2 has no byte
+ * shuffle, so the samples are converted four at a time and packed into
+ * three bytes each from there.
+ */
+/*========================================================================*/
+{
+  int32_t alSamples[4];				/* Converted samples         */
+  int iSample = 0,				/* Current sample number     */
+      iLane;					/* Current lane              */
+#ifdef __SSE2__
+  __m128 vScale   = _mm_set1_ps(8388608.0f),	/* Full scale                */
+         vMinimum = _mm_set1_ps(-8388608.0f),	/* Smallest output sample    */
+         vMaximum = _mm_set1_ps(8388607.0f);	/* Largest output sample     */
+
+
+  for (; iSample + 4 <= iSamples; iSample += 4) {
+    _mm_storeu_si128((__m128i *) alSamples,
+                     _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(afInput + iSample),
+                                                                      vScale), vMinimum), vMaximum)));
+
+    for (iLane = 0; iLane < 4; iLane++, pOutput += 3) {
+      pOutput[0] = alSamples[iLane] & 0xff;
+      pOutput[1] = (alSamples[iLane] >> 8) & 0xff;
+      pOutput[2] = (alSamples[iLane] >> 16) & 0xff;
+    }
+  }
+#endif
+
+  for (; iSample < iSamples; iSample++, pOutput += 3) {
+    alSamples[0] = fnConvert_Quantize(afInput[iSample] * 8388608.0f, -8388608L, 8388607L);
+
+    pOutput[0] = alSamples[0] & 0xff;
+    pOutput[1] = (alSamples[0] >> 8) & 0xff;
+    pOutput[2] = (alSamples[0] >> 16) & 0xff;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnConvert_Store16(struct Converter_t *pstConverter, const float *afInput,
+                  u_char *pOutput, int iSamples)
+/*
+ * Store 16 bit integers, rounded (a mono mix has 17 bits).
+ */
+/*========================================================================*/
+{
+  long lSample;					/* Current sample            */
+  int  iSample = 0;				/* Current sample number     */
+#ifdef __SSE2__
+  __m128  vScale = _mm_set1_ps(32768.0f);	/* Full scale                */
+  __m128i vRounded;				/* Rounded samples           */
+
+
+  for (; iSample + 4 <= iSamples; iSample += 4) {
+    vRounded = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(afInput + iSample), vScale));
+    _mm_storel_epi64((__m128i *) (pOutput + iSample * 2), _mm_packs_epi32(vRounded, vRounded));
+  }
+#endif
+
+  for (; iSample < iSamples; iSample++) {
+    lSample = fnConvert_Quantize(afInput[iSample] * 32768.0f, -32768L, 32767L);
+
+    pOutput[iSample * 2]     = lSample & 0xff;
+    pOutput[iSample * 2 + 1] = (lSample >> 8) & 0xff;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnConvert_Store16TPDF(struct Converter_t *pstConverter, const float *afInput,
+                      u_char *pOutput, int iSamples)
+/*
+ * Store 16 bit integers, with TPDF dither.
+ */
+/*========================================================================*/
+{
+  long lSample;					/* Current sample            */
+  int  iSample = 0;				/* Current sample number     */
+#ifdef __SSE2__
+  __m128  vScale = _mm_set1_ps(32768.0f);	/* Full scale                */
+  __m128i vRounded,				/* Rounded samples           */
+          vSeed;				/* Dither generator          */
+
+
+  vSeed = _mm_loadu_si128((__m128i *) pstConverter->alSeed);
+
+  for (; iSample + 4 <= iSamples; iSample += 4) {
+    vRounded = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(afInput + iSample), vScale),
+                                          fnConvert_Random4(&vSeed)));
+    _mm_storel_epi64((__m128i *) (pOutput + iSample * 2), _mm_packs_epi32(vRounded, vRounded));
+  }
+
+  _mm_storeu_si128((__m128i *) pstConverter->alSeed, vSeed);
+#endif
+
+  for (; iSample < iSamples; iSample++) {
+    lSample = fnConvert_Quantize(afInput[iSample] * 32768.0f + fnConvert_Random(pstConverter),
+                                 -32768L, 32767L);
+
+    pOutput[iSample * 2]     = lSample & 0xff;
+    pOutput[iSample * 2 + 1] = (lSample >> 8) & 0xff;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnConvert_Store8(struct Converter_t *pstConverter, const float *afInput,
+                 u_char *pOutput, int iSamples)
+/*
+ * Store 8 bit (offset binary) integers, rounded.
+ */
+/*========================================================================*/
+{
+  int iSample = 0;				/* Current sample number     */
+#ifdef __SSE2__
+  __m128  vScale = _mm_set1_ps(128.0f);		/* Full scale                */
+  __m128i vRounded;				/* Rounded samples           */
+  int     iPacked;				/* Four 8 bit samples        */
+
+
+  for (; iSample + 4 <= iSamples; iSample += 4) {
+    vRounded = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(afInput + iSample), vScale));
+    vRounded = _mm_packs_epi32(vRounded, vRounded);
+    iPacked  = _mm_cvtsi128_si32(_mm_xor_si128(_mm_packs_epi16(vRounded, vRounded),
+                                               _mm_set1_epi8((char) 0x80)));
+    memcpy(pOutput + iSample, &iPacked, 4);
+  }
+#endif
+
+  for (; iSample < iSamples; iSample++)
+    pOutput[iSample] = fnConvert_Quantize(afInput[iSample] * 128.0f, -128L, 127L) + 128;
+}
+
+
+/*========================================================================*/
+void
+fnConvert_Store8TPDF(struct Converter_t *pstConverter, const float *afInput,
+                     u_char *pOutput, int iSamples)
+/*
+ * Store 8 bit (offset binary) integers, with TPDF dither.
+ */
+/*========================================================================*/
+{
+  int iSample = 0;				/* Current sample number     */
+#ifdef __SSE2__
+  __m128  vScale = _mm_set1_ps(128.0f);		/* Full scale                */
+  __m128i vRounded,				/* Rounded samples           */
+          vSeed;				/* Dither generator          */
+  int     iPacked;				/* Four 8 bit samples        */
+
+
+  vSeed = _mm_loadu_si128((__m128i *) pstConverter->alSeed);
+
+  for (; iSample + 4 <= iSamples; iSample += 4) {
+    vRounded = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(afInput + iSample), vScale),
+                                          fnConvert_Random4(&vSeed)));
+    vRounded = _mm_packs_epi32(vRounded, vRounded);
+    iPacked  = _mm_cvtsi128_si32(_mm_xor_si128(_mm_packs_epi16(vRounded, vRounded),
+                                               _mm_set1_epi8((char) 0x80)));
+    memcpy(pOutput + iSample, &iPacked, 4);
+  }
+
+  _mm_storeu_si128((__m128i *) pstConverter->alSeed, vSeed);
+#endif
+
+  for (; iSample < iSamples; iSample++)
+    pOutput[iSample] = fnConvert_Quantize(afInput[iSample] * 128.0f + fnConvert_Random(pstConverter),
+                                          -128L, 127L) + 128;
+}
+
+
+/*========================================================================*/
+void
+fnConvert_StoreShaped(struct Converter_t *pstConverter, const float *afInput,
+                      u_char *pOutput, int iSamples)
+/*
+ * Store 16 or 8 bit integers with noise shaped TPDF dither.  Each sample's
+ * quantisation error is fed back through afShapingFilter, so the kernel
+ * is serial within a channel and is not vectorised.
+ */
+/*========================================================================*/
+{
+  float *afError;				/* Channel's error history   */
+  float fScale,					/* Full scale                */
+        fShaped;				/* Sample, less the error    */
+  long  lMinimum,				/* Smallest output sample    */
+        lMaximum,				/* Largest output sample     */
+        lRounded;				/* Sample, rounded           */
+  int   iSample,				/* Current sample            */
+        iChannel = 0,				/* Current channel           */
+        iTap;					/* Current filter tap        */
+
+
+  fScale   = (pstConverter->stFormat.iBitsPerSample == 8) ? 128.0f : 32768.0f;
+  lMinimum = -(long) fScale;
+  lMaximum = (long) fScale - 1;
+
+  for (iSample = 0; iSample < iSamples; iSample++) {
+    afError = pstConverter->afError[iChannel];
+
+    for (fShaped = afInput[iSample] * fScale, iTap = 0; iTap < kiConvert_ShapingTaps; iTap++)
+      fShaped -= afShapingFilter[iTap] * afError[iTap];
+
+    /* The error is taken before clipping, so a clipped sample can't make
+     * the filter run away.
+     */
+    lRounded = lrintf(fShaped + fnConvert_Random(pstConverter));
+
+    for (iTap = kiConvert_ShapingTaps - 1; iTap > 0; iTap--)
+      afError[iTap] = afError[iTap - 1];
+
+    afError[0] = lRounded - fShaped;
+
+    lRounded = (lRounded < lMinimum) ? lMinimum : (lRounded > lMaximum) ? lMaximum : lRounded;
+
+    if (pstConverter->stFormat.iBitsPerSample == 8)
+      *pOutput++ = lRounded + 128;
+    else {
+      *pOutput++ = lRounded & 0xff;
+      *pOutput++ = (lRounded >> 8) & 0xff;
+    }
+
+    if (++iChannel == pstConverter->stFormat.iChannels)  iChannel = 0;
+  }
+}
+
+
+/*========================================================================*/
+int
+fnConvert_Initialize(struct Converter_t *pstConverter, struct SampleFormat_t *pstFormat,
+                     int iDither, int iQuality)
+/*
+ * Set up a conversion from CDDA to the format specified, and pick the
+ * kernels which will do it.  fnConvert_Dispose() must be called when done.
+ *
+ *   Input:  pstConverter - The converter.
+ *           pstFormat    - The output format.
+ *           iDither      - Dither to apply when the word length is reduced
+ *                          (kiDither_*).
+ *           iQuality     - Resampling quality (kiResample_*), if the rate
+ *                          changes.
+ *
+ * Returns:  -1 if the format is not supported, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  int iLane;					/* Current generator lane    */
+
+
+  memset(pstConverter, 0, sizeof(struct Converter_t));
+
+  if ((pstFormat->iChannels < 1) || (pstFormat->iChannels > 2))  return -1;
+
+  pstConverter->stFormat     = *pstFormat;
+  pstConverter->iDither      = iDither;
+  pstConverter->iFrameLength = pstFormat->iChannels * pstFormat->iBitsPerSample / 8;
+  pstConverter->pfnMix       = (pstFormat->iChannels == 1) ? fnConvert_MixMono : fnConvert_MixStereo;
+
+  /* Dither only matters where bits are lost: 8 bit output, or a 16 bit
+   * mono mix or resampled signal.  Widening is exact.
+   */
+  switch (pstFormat->iBitsPerSample) {
+    case 8:
+      pstConverter->pfnStore = (iDither == kiDither_Shaped) ? fnConvert_StoreShaped :
+                               (iDither == kiDither_TPDF)   ? fnConvert_Store8TPDF  :
+                                                              fnConvert_Store8;
+      break;
+
+    case 16:
+      pstConverter->pfnStore = (iDither == kiDither_Shaped) ? fnConvert_StoreShaped :
+                               (iDither == kiDither_TPDF)   ? fnConvert_Store16TPDF :
+                                                              fnConvert_Store16;
+      break;
+
+    case 24:
+      pstConverter->pfnStore = fnConvert_Store24;
+      break;
+
+    case 32:
+      pstConverter->pfnStore = pstFormat->iFloat ? fnConvert_StoreFloat : fnConvert_Store32;
+      break;
+
+    default:
+      return -1;
+  }
+
+  if (pstFormat->iFloat && (pstFormat->iBitsPerSample != 32))  return -1;
+
+  /* Xorshift must not start at zero. */
+  for (iLane = 0; iLane < 4; iLane++)
+    pstConverter->alSeed[iLane] = 0x9e3779b9 * (iLane + 1);
+
+  if (pstFormat->iSampleRate != CDDA_SAMPLE_RATE) {
+    if (fnResample_Initialize(&pstConverter->stResampler, CDDA_SAMPLE_RATE, pstFormat->iSampleRate,
+                              pstFormat->iChannels, iQuality, CDDA_DATA_LENGTH / 4) < 0)
+      return -1;
+
+    pstConverter->iResample = 1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+u_char *
+fnConvert_ProcessBuffer(struct Converter_t *pstConverter, const void *pvInput,
+                        int iFrames, size_t *piLength)
+/*
+ * Convert up to one block of CDDA.  The result is kept in the converter,
+ * and is good until the next call.  When resampling, the output lags the
+ * input, and may be empty; see fnConvert_Flush().
+ *
+ *   Input:  pstConverter - The converter.
+ *           pvInput      - The audio data.
+ *           iFrames      - Frames in pvInput (at most one block's worth).
+ *
+ * Returns:  The converted audio.
+ *
+ *           piLength     - Bytes of converted audio.
+ */
+/*========================================================================*/
+{
+  float *afSamples;				/* Samples to be stored      */
+
+
+  pstConverter->pfnMix((const u_char *) pvInput, pstConverter->afSamples, iFrames);
+  afSamples = pstConverter->afSamples;
+
+  if (pstConverter->iResample) {
+    iFrames   = fnResample_ProcessBuffer(&pstConverter->stResampler, afSamples, iFrames,
+                                         pstConverter->afResampled);
+    afSamples = pstConverter->afResampled;
+  }
+
+  pstConverter->pfnStore(pstConverter, afSamples, pstConverter->aOutput,
+                         iFrames * pstConverter->stFormat.iChannels);
+
+  *piLength = (size_t) iFrames * pstConverter->iFrameLength;
+
+  return pstConverter->aOutput;
+}
+
+
+/*========================================================================*/
+u_char *
+fnConvert_Flush(struct Converter_t *pstConverter, size_t *piLength)
+/*
+ * Convert whatever audio is still held back at the end of a track.  Only
+ * the resampler holds any back.
+ *
+ *   Input:  pstConverter - The converter.
+ *
+ * Returns:  The converted audio.
+ *
+ *           piLength     - Bytes of converted audio.
+ */
+/*========================================================================*/
+{
+  int iFrames = 0;				/* Frames converted          */
+
+
+  if (pstConverter->iResample) {
+    iFrames = fnResample_Flush(&pstConverter->stResampler, pstConverter->afResampled);
+
+    pstConverter->pfnStore(pstConverter, pstConverter->afResampled, pstConverter->aOutput,
+                           iFrames * pstConverter->stFormat.iChannels);
+  }
+
+  *piLength = (size_t) iFrames * pstConverter->iFrameLength;
+
+  return pstConverter->aOutput;
+}
+
+
+/*========================================================================*/
+u_long
+fnConvert_Frames(struct Converter_t *pstConverter, u_long lFrames)
+/*
+ * Output frames which the CDDA frames given become.
+ *
+ *   Input:  pstConverter - The converter.
+ *           lFrames      - CDDA frames from the start of the track.
+ *
+ * Returns:  Output frames, once flushed.
+ */
+/*========================================================================*/
+{
+  return pstConverter->iResample ? fnResample_Frames(&pstConverter->stResampler, lFrames) : lFrames;
+}
+
+
+/*========================================================================*/
+void
+fnConvert_Dispose(struct Converter_t *pstConverter)
+/*
+ * Free anything the converter allocated.
+ */
+/*========================================================================*/
+{
+  if (pstConverter->iResample)
+    fnResample_Dispose(&pstConverter->stResampler);
+}
+
+/* EOF */
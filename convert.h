@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX      - The Digital Audio EXtractor
+ *
+ * convert.h - Header for the sample format conversion stage.
+ *
+ * $Id$
+ */
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Dither applied when the word length is reduced */
+#define kiDither_None		0	/* Round to nearest                        */
+#define kiDither_TPDF		1	/* Triangular PDF, 2 LSB peak to peak      */
+#define kiDither_Shaped		2	/* TPDF, with the error shaped out of the  */
+					/* ear's most sensitive band               */
+
+#define kiConvert_ShapingTaps	5	/* Taps in the noise shaping filter        */
+
+/* Most frames one block can become, at the highest output rate. */
+#define kiConvert_MaximumFrames	(CDDA_DATA_LENGTH / 4 * kiResample_MaximumRate / CDDA_SAMPLE_RATE + 2)
+
+/* An output sample format.  CDDA is 2 channels of 16 bit integers at
+ * 44.1 kHz.
+ */
+struct SampleFormat_t {
+  int iChannels;                    /* 1 = mono, 2 = stereo                        */
+  int iBitsPerSample;               /* 8, 16, 24 or 32                             */
+  int iFloat;                       /* 1 = IEEE float (32 bits only)               */
+  int iSampleRate;                  /* Frames per second                           */
+};
+
+/* A conversion from CDDA to another sample format.  The audio passes through
+ * two kernels, picked once when the conversion is set up: the first mixes
+ * it down (or not) to floating point, and the second stores it in the
+ * output format, with whichever dither was chosen.  Neither decides
+ * anything per sample.  If the rate changes, the resampler runs between
+ * the two, on the mixed channels.  Requires resample.h.
+ */
+struct Converter_t {
+  struct SampleFormat_t stFormat;   /* Output format                               */
+  int   iDither;                    /* Dither (kiDither_*)                         */
+  int   iFrameLength;               /* Bytes per output frame                      */
+
+  void  (*pfnMix)(const u_char *pInput, float *afOutput, int iFrames);
+  void  (*pfnStore)(struct Converter_t *pstConverter, const float *afInput,
+                    u_char *pOutput, int iSamples);
+
+  int   iResample;                  /* The rate changes (flag)                     */
+  struct Resampler_t stResampler;   /* Rate conversion, if iResample               */
+
+  float afSamples[CDDA_DATA_LENGTH / 2]; /* One block, mixed, 1.0 == full scale   */
+  float afResampled[kiConvert_MaximumFrames * 2]; /* ... and resampled           */
+  u_char aOutput[kiConvert_MaximumFrames * 8];    /* One block, converted        */
+
+  u_int32_t alSeed[4];              /* Dither generator state, one per lane        */
+  float afError[2][kiConvert_ShapingTaps]; /* Quantisation error history, per channel */
+};
+
+/* Conversion function prototypes. */
+int    fnConvert_Initialize(struct Converter_t *pstConverter, struct SampleFormat_t *pstFormat,
+                            int iDither, int iQuality);
+u_char *fnConvert_ProcessBuffer(struct Converter_t *pstConverter, const void *pvInput,
+                                int iFrames, size_t *piLength);
+u_char *fnConvert_Flush(struct Converter_t *pstConverter, size_t *piLength);
+u_long fnConvert_Frames(struct Converter_t *pstConverter, u_long lFrames);
+void   fnConvert_Dispose(struct Converter_t *pstConverter);
+
+/* EOF */
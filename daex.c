@@ -34,7 +34,19 @@
 
 #include "daex.h"
 #include "format.h"
+#include "arena.h"
 #include "cddb.h"
+#include "checksum.h"
+#include "loudness.h"
+#include "analysis.h"
+#include "emphasis.h"
+#include "resample.h"
+#include "convert.h"
+#include "writer.h"
+#include "encoder.h"
+#include "ring.h"
+#include "net.h"
+#include "cache.h"
 
 
 /*========================================================================*/
@@ -91,16 +103,96 @@ fnUsage(char **pArguments)
   fprintf(stderr, "FUNCTION: fnUsage()\n");
 #endif
 
-  fprintf(stderr, "usage: daex [-c hostname:port] [-d device] [-i filename] [-o outfile]\n");
-  fprintf(stderr, "            [-s drive_speed] [-t track_no] [-y]\n\n");
+  fprintf(stderr, "usage: daex [-a analyses] [-b bits] [-c hostname:port] [-C directory]\n");
+  fprintf(stderr, "            [-d device] [-D directory] [-e] [-E command] [-f rate] [-F index]\n");
+  fprintf(stderr, "            [-g filename] [-i filename] [-j jobs[:Mbytes]] [-k filename]\n");
+  fprintf(stderr, "            [-l level] [-m] [-M name[:Mbytes[:policy]]] [-n dither]\n");
+  fprintf(stderr, "            [-N host[:port[:Mbytes]]] [-o outfile] [-p policy]\n");
+  fprintf(stderr, "            [-q quality] [-r edges] [-s drive_speed] [-t track_no] [-u]\n");
+  fprintf(stderr, "            [-w format] [-x] [-y] [-z]\n\n");
+
+  fprintf(stderr, "   -a analyses      :  Analyse the audio as it is extracted.  A comma\n");
+  fprintf(stderr, "                       separated list of: checksum, peak, silence,\n");
+  fprintf(stderr, "                       loudness, or all.\n\n");
+
+  fprintf(stderr, "   -b bits          :  Sample format written: 8, 16, 24, 32, or float.\n");
+  fprintf(stderr, "                       (default: 16)\n\n");
+
+  fprintf(stderr, "   -c hostname:port :  Enable CD Disc Database (CDDB) querying.  Up to\n");
+  fprintf(stderr, "                       %i comma separated servers may be given; all are\n", kiCDDB_MaxServers);
+  fprintf(stderr, "                       tried at once, and the first to answer is used.\n");
+  fprintf(stderr, "                       A server given as http://hostname[:port][/path]\n");
+  fprintf(stderr, "                       is queried through its cddb.cgi over HTTP.\n\n");
+  fprintf(stderr, "   -C directory     :  Keep the output files in a rip cache, and take\n");
+  fprintf(stderr, "                       them from it when the disc is seen again.\n");
+  fprintf(stderr, "                       (must be on the same filesystem)\n\n");
 
-  fprintf(stderr, "   -c hostname:port :  Enable CD Disc Database (CDDB) querying.\n");
   fprintf(stderr, "   -d device        :  ATAPI CD-ROM device. (default: /dev/wcd0c)\n");
+  fprintf(stderr, "   -D directory     :  Keep CDDB replies in a cache, and take a disc's\n");
+  fprintf(stderr, "                       titles from it when the disc is seen again.\n");
+  fprintf(stderr, "                       (requires the -c option)\n\n");
+
+  fprintf(stderr, "   -e               :  De-emphasise tracks flagged as pre-emphasised.\n");
+  fprintf(stderr, "   -E command       :  Pipe each track to its own run of the command (by\n");
+  fprintf(stderr, "                       /bin/sh, with DAEX_TRACK and DAEX_FILENAME set)\n");
+  fprintf(stderr, "                       instead of writing it to a file.\n\n");
+
+  fprintf(stderr, "   -f rate          :  Sample rate written, in Hz, from 8000 to 48000.\n");
+  fprintf(stderr, "                       (default: 44100)\n\n");
+
+  fprintf(stderr, "   -F index         :  Look the disc up in a freedb index (built by\n");
+  fprintf(stderr, "                       daex-index), and only ask the CDDB servers (-c)\n");
+  fprintf(stderr, "                       if it isn't there.\n\n");
+
+  fprintf(stderr, "   -g filename      :  Append the loudness and ReplayGain of each track,\n");
+  fprintf(stderr, "                       and of the album with -t 0, to the specified\n");
+  fprintf(stderr, "                       filename.\n");
   fprintf(stderr, "   -i filename      :  Dump CDDB information to the specified\n");
   fprintf(stderr, "                       filename. (requires the -c option)\n\n");
 
+  fprintf(stderr, "   -j jobs[:Mbytes] :  Encoders (-E) run at once, and the audio held\n");
+  fprintf(stderr, "                       while they are all busy. (default: one per CPU,\n");
+  fprintf(stderr, "                       %i Mbytes)\n\n", kiEncoder_DefaultBudget);
+
+  fprintf(stderr, "   -k filename      :  Append the CRC-32 of each extracted track to the\n");
+  fprintf(stderr, "                       specified filename. (see daex-verify(1))\n\n");
+
+  fprintf(stderr, "   -l level         :  Count audio at or below level (in dBFS, ie -60) as\n");
+  fprintf(stderr, "                       silence. (default: digital silence only)\n\n");
+
+  fprintf(stderr, "   -m               :  Mix the audio down to mono.\n");
+  fprintf(stderr, "   -M name[:Mbytes[:policy]]\n");
+  fprintf(stderr, "                    :  Publish the tracks to a shared memory ring of that\n");
+  fprintf(stderr, "                       name (ie /daex) instead of writing files, for\n");
+  fprintf(stderr, "                       programs on this host to read in place.  The\n");
+  fprintf(stderr, "                       policy is block (wait for slow readers) or drop\n");
+  fprintf(stderr, "                       (never wait). (default: %i Mbytes, block)\n\n",
+          kiRing_DefaultLength);
+  fprintf(stderr, "   -n dither        :  Dither used when bits are lost (8 bits, or 16 bit\n");
+  fprintf(stderr, "                       mono or resampled): none, tpdf, or shaped.\n");
+  fprintf(stderr, "                       (default: tpdf)\n\n");
+
+  fprintf(stderr, "   -N host[:port[:Mbytes]]\n");
+  fprintf(stderr, "                    :  Send the tracks to daex-recv(1) on that host\n");
+  fprintf(stderr, "                       instead of writing files, with that much sent\n");
+  fprintf(stderr, "                       ahead of its acknowledgements. (default: port\n");
+  fprintf(stderr, "                       %i, %i Mbytes)\n\n", kiNet_DefaultPort, kiNet_DefaultWindow);
+
   fprintf(stderr, "   -o outfile       :  The name of the recorded track. (default: track-NN.wav\n");
-  fprintf(stderr, "                       where 'NN' is the specified track number)\n\n");
+  fprintf(stderr, "                       where 'NN' is the specified track number, and the\n");
+  fprintf(stderr, "                       extension follows the output format)  Use - for\n");
+  fprintf(stderr, "                       the standard output.\n\n");
+
+  fprintf(stderr, "   -p policy        :  When to flush output files to disk: none, track\n");
+  fprintf(stderr, "                       (once each is complete), or a number of Mbytes\n");
+  fprintf(stderr, "                       (as each is written, and when complete).\n");
+  fprintf(stderr, "                       (default: none)\n\n");
+
+  fprintf(stderr, "   -q quality       :  Resampling quality (with -f): low, medium, or\n");
+  fprintf(stderr, "                       high. (default: medium)\n\n");
+
+  fprintf(stderr, "   -r edges         :  Trim silence from the extracted audio.  One of:\n");
+  fprintf(stderr, "                       lead, trail, or both.\n\n");
 
   fprintf(stderr, "   -s drive_speed   :  The speed at which the CD audio will be read.\n");
   fprintf(stderr, "                       (default: don't attempt to set drive speed)\n\n");
@@ -116,9 +208,22 @@ fnUsage(char **pArguments)
   fprintf(stderr, "   -t track_no      :  The track number to extract. A value of 0\n");
   fprintf(stderr, "                       indicates we should copy every track.\n\n");
 
+  fprintf(stderr, "   -u               :  Write output files around the page cache\n");
+  fprintf(stderr, "                       (O_DIRECT), where the file system allows.\n\n");
+
+  fprintf(stderr, "   -w format        :  Output file format: wav, aiff, rf64, w64, raw, flac,\n");
+  fprintf(stderr, "                       or bin (with -t 0, one image of the disc and a cue\n");
+  fprintf(stderr, "                       sheet). (default: wav)\n\n");
+
+  fprintf(stderr, "   -x               :  Queue writes to output files (aio), so that\n");
+  fprintf(stderr, "                       extraction never waits on the disk.\n\n");
+
   fprintf(stderr, "   -y               :  Skip tracks with problems (instead of exiting) when\n");
   fprintf(stderr, "                       extracting more than one track.\n\n");
 
+  fprintf(stderr, "   -z               :  Map output files into memory, and read the disc\n");
+  fprintf(stderr, "                       straight into them where no conversion is needed.\n\n");
+
   exit(kiExitStatus_General);
 }
 
@@ -127,8 +232,9 @@ fnUsage(char **pArguments)
 void
 fnRetrieveArguments(int iArgc, char **szArgv, char **szDeviceName, 
                     char **szOutputFilename, int *iTrackNumber, 
-                    int *iDriveSpeed, int *iCDDBquerying, char **szCDDB_RemoteHost,
-                    int *iCDDB_RemotePort, int *iSkipTracksWithErrors, char **szInfoFilename)
+                    int *iDriveSpeed, int *iCDDBquerying, char **szCDDB_Servers,
+                    int *iSkipTracksWithErrors, char **szInfoFilename,
+                    struct ExtractionOptions_t *pstOptions)
 /*
  * Parse the user arguments, and store them in the appropriate variables.
  *
@@ -139,20 +245,23 @@ fnRetrieveArguments(int iArgc, char **szArgv, char **szDeviceName,
  *           iTrackNumber          - Track number to extract.
  *           iDriveSpeed           - Device read speed indicator.
  *           iCDDBquerying         - CDDB querying flag.
- *           szCDDB_RemoteHost     - Remote hostname used in CDDB queries.
- *           iCDDB_RemotePort      - Remote port number used in CDDB queries.
+ *           szCDDB_Servers        - CDDB servers used in queries.
  *           iSkipTracksWithErrors - Skip tracks with errors when extracting more
  *                                   than one track (flag).
  *           szInfoFilename        - Disc information output filename.
+ *           pstOptions            - Extraction options structure.
  *
  * Returns:  szDeviceName, szOutputFilename, iTrackNumber, iDriveSpeed, iCDDBquerying
- *           szCDDB_RemoteHost, iCDDB_RemotePort, iSkipTracksWithErrors
+ *           szCDDB_Servers, iSkipTracksWithErrors, pstOptions
  */
 /*========================================================================*/
 {
   extern int  optind;		/* The current argument number - getopt()    */
   extern char *optarg;		/* Current option's arg. string - getopt()   */
+  struct CDDBserver_t astServers[kiCDDB_MaxServers]; /* Servers named by -c     */
   int iArgument;		/* Current argument in getopt()'s arg list   */
+  int iAnalysisFlags;		/* Analyses named by the -a option           */
+  double dLevel;		/* Silence level named by the -l option      */
 
 
 #ifdef DEBUG
@@ -168,7 +277,7 @@ fnRetrieveArguments(int iArgc, char **szArgv, char **szDeviceName,
   }
 
   /* Get the command line arguments */
-  while ((iArgument = getopt(iArgc, szArgv, "c:d:i:o:s:t:y")) != -1) {
+  while ((iArgument = getopt(iArgc, szArgv, "a:b:c:C:d:D:eE:f:F:g:i:j:k:l:mM:n:N:o:p:q:r:s:t:uw:xyz")) != -1) {
 
 #ifdef DEBUG
   fprintf(stderr, "DEBUG   : Argument value:  \"%c\" (%i)\n", iArgument, iArgument);
@@ -181,27 +290,42 @@ fnRetrieveArguments(int iArgc, char **szArgv, char **szDeviceName,
       fnError(kiExitStatus_General, "The argument specified, \"%s\", exceeds the maximum string length (%i characters).", optarg, kiMaxStringLength);
 
     switch(iArgument) {
+      case 'a':                         /* Analyses                           */
+        if ((iAnalysisFlags = fnAnalysis_ParseFlags(optarg)) < 0)
+          fnError(kiExitStatus_General, "Unknown analysis in \"%s\".  Choose from checksum, peak, silence, loudness, or all.", optarg);
+
+        pstOptions->iAnalysisFlags |= iAnalysisFlags;
+        break;
+
+      case 'b':                         /* Bits per sample                    */
+        pstOptions->iOutputFloat = (strcmp(optarg, "float") == 0);
+        pstOptions->iOutputBits  = pstOptions->iOutputFloat ? 32 : atoi(optarg);
+
+        if ((pstOptions->iOutputBits != 8)  && (pstOptions->iOutputBits != 16) &&
+            (pstOptions->iOutputBits != 24) && (pstOptions->iOutputBits != 32))
+          fnError(kiExitStatus_General, "The sample format must be one of 8, 16, 24, 32, or float.");
+
+        break;
+
       case 'c':                         /* CDDB querying                      */
         *iCDDBquerying = 1;
 
-        /* Store the remote hostname. */
-        *szCDDB_RemoteHost = strdup(strsep(&optarg, ":"));
-
-        /* If the separating character ":" does not exist, notify the user,
-         * display the usage banner, and exit.
-	 */
-        if (!optarg) {
-          fprintf(stderr, "daex: -c option requires an argument in the form \"hostname:port\"\n");
+        /* Store the server list, once we know it makes sense: each server
+         * a "hostname:port", with a port between 1 and 65535.
+         */
+        if (fnCDDB_ParseServers(optarg, astServers, kiCDDB_MaxServers) < 0) {
+          fprintf(stderr, "daex: -c option requires an argument in the form \"hostname:port[,hostname:port...]\" or \"http://hostname[:port][/path]\" (at most %i servers)\n", kiCDDB_MaxServers);
           fnUsage(szArgv);
         }
 
-        /* Store the remote port. */
-        *iCDDB_RemotePort = atoi(optarg);
+        if ((*szCDDB_Servers = strdup(optarg)) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the CDDB server list.");
 
-        /* Don't allow wacked port numbers. */
-        if ((*iCDDB_RemotePort < 1) || (*iCDDB_RemotePort > 65535))
-          fnError(kiExitStatus_General, "The port number must be a positive integer between 1 and 65535.");
+        break;
 
+      case 'C':                         /* Rip cache                          */
+        if ((pstOptions->szCacheDirectory = strdup(optarg)) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the cache directory.");
         break;
 
       case 'd':				/* Device name                        */
@@ -209,11 +333,123 @@ fnRetrieveArguments(int iArgc, char **szArgv, char **szDeviceName,
           fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the device name.");
         break;
 
+      case 'D':                         /* Metadata cache                     */
+        if ((pstOptions->szMetaDirectory = strdup(optarg)) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the cache directory.");
+        break;
+
+      case 'e':                         /* De-emphasis                        */
+        pstOptions->iDeemphasis = 1;
+        break;
+
+      case 'E':                         /* Encoder command                    */
+        if ((pstOptions->szEncoderCommand = strdup(optarg)) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the encoder command.");
+        break;
+
+      case 'F':                         /* freedb index                       */
+        *iCDDBquerying = 1;
+
+        if ((pstOptions->szIndexFilename = strdup(optarg)) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the index filename.");
+        break;
+
+      case 'f':                         /* Sample rate                        */
+        pstOptions->iOutputRate = atoi(optarg);
+
+        if ((pstOptions->iOutputRate < kiResample_MinimumRate) ||
+            (pstOptions->iOutputRate > kiResample_MaximumRate))
+          fnError(kiExitStatus_General, "The sample rate must be from %i to %i Hz.",
+                  kiResample_MinimumRate, kiResample_MaximumRate);
+
+        break;
+
+      case 'g':                         /* Loudness filename                  */
+        if ((pstOptions->szLoudnessFilename = strdup(optarg)) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the loudness filename.");
+
+        pstOptions->iAnalysisFlags |= kiAnalysis_Loudness;
+        break;
+
       case 'i':
         if ((*szInfoFilename = strdup(optarg)) == NULL)
           fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the info filename.");
         break;
 
+      case 'j':                         /* Encoder jobs                       */
+        pstOptions->iEncoderJobs = atoi(strsep(&optarg, ":"));
+
+        if (optarg)
+          pstOptions->iEncoderBudget = (size_t) atoi(optarg) * 1024 * 1024;
+
+        if ((pstOptions->iEncoderJobs < 1) || (optarg && (pstOptions->iEncoderBudget == 0)))
+          fnError(kiExitStatus_General, "The encoder jobs must be a positive integer, optionally followed by \":Mbytes\".");
+
+        break;
+
+      case 'k':                         /* Checksum filename                  */
+        if ((pstOptions->szChecksumFilename = strdup(optarg)) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the checksum filename.");
+
+        pstOptions->iAnalysisFlags |= kiAnalysis_Checksum;
+        break;
+
+      case 'l':                         /* Silence threshold                  */
+        if ((dLevel = atof(optarg)) > 0)
+          fnError(kiExitStatus_General, "The silence level must be given in dBFS, 0 or less (ie -60).");
+
+        pstOptions->iSilenceThreshold  = fnAnalysis_Threshold(dLevel);
+        pstOptions->iAnalysisFlags    |= kiAnalysis_Silence;
+        break;
+
+      case 'm':                         /* Mono                               */
+        pstOptions->iOutputChannels = 1;
+        break;
+
+      case 'M':                         /* Shared memory ring                 */
+        if ((pstOptions->szRingName = strdup(strsep(&optarg, ":"))) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the ring name.");
+
+        if ((pstOptions->szRingName[0] != '/') || strchr(pstOptions->szRingName + 1, '/') ||
+            (pstOptions->szRingName[1] == '\0'))
+          fnError(kiExitStatus_General, "The ring name must be a / followed by a name (ie /daex).");
+
+        if (optarg && ((pstOptions->iRingLength = (size_t) atoi(strsep(&optarg, ":")) * 1024 * 1024) == 0))
+          fnError(kiExitStatus_General, "The ring's size must be a positive number of Mbytes.");
+
+        if (!optarg || (strcmp(optarg, "block") == 0))  pstOptions->iRingPolicy = kiRing_Block;
+        else if (strcmp(optarg, "drop") == 0)           pstOptions->iRingPolicy = kiRing_Drop;
+        else
+          fnError(kiExitStatus_General, "Unknown ring policy \"%s\".  Choose from block or drop.", optarg);
+
+        break;
+
+      case 'n':                         /* Dither                             */
+        if (strcmp(optarg, "none") == 0)         pstOptions->iDither = kiDither_None;
+        else if (strcmp(optarg, "tpdf") == 0)    pstOptions->iDither = kiDither_TPDF;
+        else if (strcmp(optarg, "shaped") == 0)  pstOptions->iDither = kiDither_Shaped;
+        else
+          fnError(kiExitStatus_General, "Unknown dither \"%s\".  Choose from none, tpdf, or shaped.", optarg);
+
+        break;
+
+      case 'N':                         /* Network sink                       */
+        if ((pstOptions->szSinkHost = strdup(strsep(&optarg, ":"))) == NULL)
+          fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the host name.");
+
+        if (pstOptions->szSinkHost[0] == '\0')
+          fnError(kiExitStatus_General, "You must specify the host daex-recv runs on (ie archive:%i).",
+                  kiNet_DefaultPort);
+
+        if (optarg && (((pstOptions->iSinkPort = atoi(strsep(&optarg, ":"))) < 1) ||
+                       (pstOptions->iSinkPort > 65535)))
+          fnError(kiExitStatus_General, "The port must be from 1 to 65535.");
+
+        if (optarg && ((pstOptions->iSinkWindow = (size_t) atoi(optarg) * 1024 * 1024) == 0))
+          fnError(kiExitStatus_General, "The window must be a positive number of Mbytes.");
+
+        break;
+
       case 'o':				/* Output filename                    */
         if (strlen(optarg) > MAX_FILENAME_LENGTH)
           fnError(kiExitStatus_General, "The output filename specified exceeds the maximum allowable length (%i characters).\n", MAX_FILENAME_LENGTH);
@@ -222,6 +458,39 @@ fnRetrieveArguments(int iArgc, char **szArgv, char **szDeviceName,
           fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the output file name.");
         break;
 
+      case 'p':                         /* Sync policy                        */
+        if (strcmp(optarg, "none") == 0) {
+          pstOptions->iWriterPolicy &= ~kiWriter_SyncTrack;
+          pstOptions->llSyncInterval = 0;
+        } else if (strcmp(optarg, "track") == 0)
+          pstOptions->iWriterPolicy |= kiWriter_SyncTrack;
+        else if (atoi(optarg) > 0) {
+          pstOptions->iWriterPolicy |= kiWriter_SyncTrack;
+          pstOptions->llSyncInterval = (u_int64_t) atoi(optarg) * 1024 * 1024;
+        } else
+          fnError(kiExitStatus_General, "Unknown sync policy \"%s\".  Choose from none, track, or a number of Mbytes.", optarg);
+
+        break;
+
+      case 'q':                         /* Resampling quality                 */
+        if (strcmp(optarg, "low") == 0)          pstOptions->iResampleQuality = kiResample_Low;
+        else if (strcmp(optarg, "medium") == 0)  pstOptions->iResampleQuality = kiResample_Medium;
+        else if (strcmp(optarg, "high") == 0)    pstOptions->iResampleQuality = kiResample_High;
+        else
+          fnError(kiExitStatus_General, "Unknown quality \"%s\".  Choose from low, medium, or high.", optarg);
+
+        break;
+
+      case 'r':                         /* Silence trimming                   */
+        if (strcmp(optarg, "lead") == 0)        pstOptions->iTrimFlags = kiTrim_Leading;
+        else if (strcmp(optarg, "trail") == 0)  pstOptions->iTrimFlags = kiTrim_Trailing;
+        else if (strcmp(optarg, "both") == 0)   pstOptions->iTrimFlags = kiTrim_Leading | kiTrim_Trailing;
+        else
+          fnError(kiExitStatus_General, "Unknown edge \"%s\".  Choose from lead, trail, or both.", optarg);
+
+        pstOptions->iAnalysisFlags |= kiAnalysis_Silence;
+        break;
+
       case 's':				/* Drive speed                        */
         *iDriveSpeed = atoi(optarg);
 
@@ -240,10 +509,32 @@ fnRetrieveArguments(int iArgc, char **szArgv, char **szDeviceName,
 
         break;
 
+      case 'u':                         /* Bypass the page cache              */
+        pstOptions->iWriterPolicy |= kiWriter_Uncached;
+        break;
+
+      case 'w':                         /* Output file format                 */
+        if ((pstOptions->pstWriter = fnWriter_Find(optarg)) == NULL) {
+          fprintf(stderr, "Unknown output format \"%s\".  Choose from:\n\n", optarg);
+          fnWriter_List(stderr);
+          fprintf(stderr, "\n");
+          exit(kiExitStatus_General);
+        }
+
+        break;
+
+      case 'x':                         /* Asynchronous output                */
+        pstOptions->iWriterPolicy |= kiWriter_Async;
+        break;
+
     case 'y':                           /* Skip tracks with errors            */
         *iSkipTracksWithErrors = 1;
         break;
 
+      case 'z':                         /* Memory-mapped output               */
+        pstOptions->iWriterPolicy |= kiWriter_Mapped;
+        break;
+
       case '?':
       default:
         fnUsage(szArgv);		/* Display the usage banner, and exit */
@@ -385,11 +676,13 @@ fnOpenDevice(char *szDeviceName)
 
 /*========================================================================*/
 void *
-fnReadTOCheader(int iFileDesc)
+fnReadTOCheader(int iFileDesc, struct Arena_t *pstArena)
 /*
  * Attempt to read the disc's Table Of Contents. Exit upon failure.
  *
  *   Input:  iFileDesc   - CD-ROM device file descriptor.
+ *           pstArena    - The disc's arena, to keep the header in.
+ *
  * Returns:  A pointer to "struct ioc_toc_header".  (TOC header)
  */
 /*========================================================================*/
@@ -400,7 +693,10 @@ fnReadTOCheader(int iFileDesc)
   fprintf(stderr, "FUNCTION: fnReadTOCheader()\n");
 #endif
 
-  pstTOCheader = (struct ioc_toc_header *) calloc(1, sizeof(struct ioc_toc_header));
+  pstTOCheader = (struct ioc_toc_header *) fnArena_Alloc(pstArena, sizeof(struct ioc_toc_header));
+
+  if (!pstTOCheader)
+    fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the TOC header.");
 
   /* Attempt to read the disc's Table Of Contents.  Exit upon failure. */
   if (ioctl(iFileDesc, CDIOREADTOCHEADER, pstTOCheader) < 0)
@@ -415,12 +711,13 @@ fnReadTOCheader(int iFileDesc)
 
 /*========================================================================*/
 void *
-fnReadTOCentries(int iFileDesc, void *pvTOCheader)
+fnReadTOCentries(int iFileDesc, void *pvTOCheader, struct Arena_t *pstArena)
 /*
  * Attempt to read the TOC entries for each track into an array.
  *
  *   Input:  iFileDesc   - CD-ROM device file descriptor.
  *           pvTOCheader - Pointer to the Table of Contents header.
+ *           pstArena    - The disc's arena, to keep the entries in.
  *
  * Returns:  Pointer to "struct ioc_read_toc_entry".  (TOC entries)
  */
@@ -436,7 +733,11 @@ fnReadTOCentries(int iFileDesc, void *pvTOCheader)
 #endif
 
   pstTOCheader  = (struct ioc_toc_header *) pvTOCheader;
-  pstTOCentries = (struct ioc_read_toc_entry *) calloc(1, sizeof(struct ioc_read_toc_entry));
+  pstTOCentries = (struct ioc_read_toc_entry *)
+                  fnArena_Alloc(pstArena, sizeof(struct ioc_read_toc_entry));
+
+  if (!pstTOCentries)
+    fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the TOC entries.");
 
   /* Setup the TOC entry structure to return data in the Logical Block
    * Address format.  Include the starting and finishing tracks on return.
@@ -449,7 +750,7 @@ fnReadTOCentries(int iFileDesc, void *pvTOCheader)
   /* Attempt to allocate space for the individual track information.
    * If there's no enough memory available, exit.
    */
-  pstTOCentries->data = (struct cd_toc_entry *) calloc(1, pstTOCentries->data_len);
+  pstTOCentries->data = (struct cd_toc_entry *) fnArena_Alloc(pstArena, pstTOCentries->data_len);
 
   if (!pstTOCentries->data)
    fnError(kiExitStatus_General, "Unable to allocate sufficient memory for TOC entry data.");
@@ -545,147 +846,130 @@ fnSetSpeed(int iFileDesc, int iSpeed)
 
 
 /*========================================================================*/
-void 
-fnSetupWAVEheader(void *pvWavHeader, u_long lFileLength, u_long lBytesWritten)
+void
+fnWriteAudio(struct AudioOutput_t *pstOutput, u_char *pOutput, size_t iLength,
+             u_long lSoundEnd, u_long *plFramesWritten, u_int32_t *plCRC,
+             u_int32_t *plCRCatSound)
 /*
- * Create the Wave header.  If "lFileLength" and "lTotalBytesWritten" are
- * both 0, we'll assume we're just initializing the structure.  Otherwise,
- * we've (hopefully) finished recording the audio, and need to tidy up the
- * header so Wave decoders will actually process the file.
+ * Write audio to the output file, and checksum it (as it is stored in the
+ * file) if asked to.  The CRC at the end of the last sound is noted, in
+ * case the silence after it is trimmed.  Exits on a write error.
  *
- *   Input:  pvWavHeader   - Pointer to a structure containing the Wave header
- *                           fields.
- *           lFileLength   - The total file length of the output file, 
- *                           including the Wave header.
- *           lBytesWritten - The number of bytes of raw audio written
- *                           to the output file.
+ *   Input:  pstOutput       - The output file.
+ *           pOutput         - The audio, in the output format.  Converted
+ *                             to the file's byte order in place.
+ *           iLength         - Bytes of audio.
+ *           lSoundEnd       - Output frame at which the trailing silence
+ *                             begins, so far.
+ *           plFramesWritten - Output frames written before this audio.
+ *           plCRC           - CRC of the audio written so far, or NULL.
+ *           plCRCatSound    - ... up to lSoundEnd.
  *
  * Returns:  None.
+ *
+ *           plFramesWritten - Updated.
+ *           plCRC           - Updated.
+ *           plCRCatSound    - Updated, if lSoundEnd falls in this audio.
  */
 /*========================================================================*/
 {
-  struct WavFormat_t *pstWavHeader;		/* Wave header               */
-
-#ifdef DEBUG
-  fprintf(stderr, "FUNCTION: fnSetupWAVEheader()\n");
-#endif
-
-  pstWavHeader = (struct WavFormat_t *) pvWavHeader;
-
-  if ((lFileLength == 0) && (lBytesWritten == 0)) {
-    strncpy(pstWavHeader->sRiffHeader,   "RIFF", 4);
-    strncpy(pstWavHeader->sWavHeader,    "WAVE", 4);
-    strncpy(pstWavHeader->sFormatHeader, "fmt ", 4);
-    strncpy(pstWavHeader->sDataHeader,   "data", 4);
+  int    iBytesWritten;		/* Number of bytes written on a write()      */
+  u_long lFrames;		/* Frames in this audio                      */
+  size_t iSoundEnd;		/* Bytes of this audio before lSoundEnd      */
 
-    pstWavHeader->lFileLength     = 0;     /* We don't know the filelength   */
-    pstWavHeader->lFormatLength   = 0x10;  /* Length of the format data (16) */
-    pstWavHeader->nFormatTag      = 0x01;  /* PCM header                     */
-    pstWavHeader->nChannels       = 2;     /* 1 = mono, 2 = stereo           */
-    pstWavHeader->lSampleRate     = 44100; /* Sample rate in Khz             */
-    pstWavHeader->nBitsPerSample  = 16;    /* Bits per sample 8,12,16        */
 
-    /* Block alignment */
-    pstWavHeader->nBlockAlign     = (pstWavHeader->nChannels *
-                                     pstWavHeader->nBitsPerSample / 8);
-    /* Bytes per second */
-    pstWavHeader->lBytesPerSecond = (pstWavHeader->lSampleRate * 
-                                     pstWavHeader->nBlockAlign);
-    /* Length of the data block */
-    pstWavHeader->lSampleLength   = 0;
+  if (iLength == 0)  return;
 
-  } else {
-
-   /* We have the final file length information, so we'll fill that in
-    * here.  We subtract 8 bytes from lTotalFileLength to account for the 
-    * RIFF file header, and the RIFF file length field.
-    */
-
-    pstWavHeader->lFileLength   = lFileLength - 8;
-    pstWavHeader->lSampleLength = lBytesWritten;
+  /* If the file system is full, or if not all the bytes were written to
+   * disk, display an error message and exit.
+   */
+  if ((iBytesWritten = fnWriter_Write(pstOutput, &pOutput, iLength)) != (int) iLength) {
+    if (errno == ENOSPC)
+      fnError(kiExitStatus_General, "\nUnable to write output file.  No space left on device.");
+    else
+      fnError(kiExitStatus_General, "\nIncorrect number of bytes written to output file (%i of %i).", iBytesWritten, (int) iLength);
   }
-}
-
-
-/*========================================================================*/
-void
-fnWriteAudioHeader(int iFileDesc, int iType, void *pvHeader, u_long lArg1, 
-                   u_long lArg2)
-/*
- * Attempt to write an audio header to the output file.  Exit upon error.
- *
- *   Input:  iFileDesc - The output file's file descriptor.
- *           iType     - The type of header being written.
- *           pvHeader  - Pointer to the audio header structure.
- *           lArg1     - Usually the total output file length (including 
- *                       the header)
- *           lArg2     - Usually the total number of data bytes written.
- *
- * Returns:  None.
- */
-/*========================================================================*/
-{ 
-  struct  WavFormat_t  *pstWavHeader;		/* Wave header               */
-
-#ifdef DEBUG
-  fprintf(stderr, "\nFUNCTION: fnWriteAudioHeader()\n");
-#endif
-
-  switch (iType) {
-    case kiHeaderWAVE:			/* Wave header specified     */
-     pstWavHeader = (struct WavFormat_t *) pvHeader;
-
-     /* Initialize the Wave header */
-     fnSetupWAVEheader(pstWavHeader, lArg1, lArg2);
-
-     /* If it appears the extraction has been completed (the file length
-      * and data bytes written are greater than 0), seek to the beginning of 
-      * the output file.
-      */
-
-     if ((lArg1 > 0) && (lArg2 > 0))
-      if (lseek(iFileDesc, 0, SEEK_SET) < 0)
-        fnError(kiExitStatus_General, "Unable to seek beginning of output file.");
 
-     /* ... and write the audio header */
-     if (write(iFileDesc, pstWavHeader, sizeof(struct WavFormat_t)) != sizeof(struct WavFormat_t))
-       fnError(kiExitStatus_General, "Unable to write audio header.");
-
-     break;
+  lFrames = iLength / pstOutput->iFrameLength;
 
-    default:
-      fnError(kiExitStatus_General, "Unknown audio type.  Hmm.  You shouldn't be seeing this.");
+  if (plCRC) {
+    if ((lSoundEnd >= *plFramesWritten) && (lSoundEnd <= *plFramesWritten + lFrames)) {
+      iSoundEnd     = (lSoundEnd - *plFramesWritten) * pstOutput->iFrameLength;
+      *plCRCatSound = fnCRC_Update(*plCRC, pOutput, iSoundEnd);
+      *plCRC        = fnCRC_Update(*plCRCatSound, pOutput + iSoundEnd, iLength - iSoundEnd);
+    } else
+      *plCRC = fnCRC_Update(*plCRC, pOutput, iLength);
   }
+
+  *plFramesWritten += lFrames;
 }
 
 
 /*========================================================================*/
 int
-fnExtractAudio(int iDeviceDesc, int iOutfileDesc, int iLBAstart, int iLBAend)
+fnExtractAudio(int iDeviceDesc, int iOutfileDesc, int iLBAstart, int iLBAend,
+               struct AudioAnalysis_t *pstAnalysis, int iTrimFlags,
+               struct EmphasisFilter_t *pstEmphasis, struct Converter_t *pstConverter,
+               struct AudioWriter_t *pstWriter, int iWriterPolicy, u_int64_t llSyncInterval,
+               struct SharedRing_t *pstRing, struct NetSink_t *pstSink, int iTrackNumber)
 /*
  * Copy the digital audio from the track specified to the output file
  * specified.  Write headers to the output file if appropriate, and deal with 
  * any errors we may run into.
  *
+ * Leading silence is trimmed by not writing it, to the frame, and trailing
+ * silence by truncating the file once the end of the track is reached.
+ * When trimming or converting, the checksum is kept here rather than by the
+ * analyses, so that it covers the audio as written.
+ *
  *   Input:  iDeviceDesc  - Descriptor of the CD-ROM device.
  *           iOutfileDesc - File descriptor for the output file.
  *           iLBAstart  - The starting LBA for the current track.
  *           iLBAend    - The ending LBA for the current track.
+ *           pstAnalysis  - The track's analyses, already initialized.  The
+ *                          silence analysis must be enabled to trim.
+ *           iTrimFlags   - Silence to trim (kiTrim_*), or 0.
+ *           pstEmphasis  - De-emphasis filter, already initialized, or NULL
+ *                          to leave the audio as it is.
+ *           pstConverter - Sample format converter, already initialized, or
+ *                          NULL to write CDDA as it is.
+ *           pstWriter    - Output file format.
+ *           iWriterPolicy  - How the file is written (kiWriter_*).
+ *           llSyncInterval - Bytes between fdatasync()s, or 0.
+ *           pstRing      - Publish the audio to this ring instead of the
+ *                          file (-1), or NULL.
+ *           pstSink      - Send the audio to daex-recv instead of the file
+ *                          (-1), its track started, or NULL.
+ *           iTrackNumber - The track, as the ring's readers are told.
  *
- * Returns:  None.
+ * Returns:  0 on success, -1 if the output file could not be written, -2 if
+ *           the track could not be read.  iOutfileDesc is left open, for
+ *           the caller to close.
+ *
+ *           pstAnalysis  - The results of the analyses.
  */
 /*========================================================================*/
 {
   struct  ioc_read_cdda	stReadCDDA;  	/* CDDA (raw audio) structure        */
-  struct  WavFormat_t	stWavHeader; 	/* Wave header                       */
+  struct  AudioOutput_t	stOutput; 	/* Output file                       */
 
-  char    *szBuffer;		/* Raw CDDA buffer                           */
+  char    *szBuffer,		/* Raw CDDA buffer                           */
+          *pBlock;		/* Where each block is read to               */
   char    szTotalBytesWritten[512]; /* String used to display the status     */
 
   int     iBlocksToExtract,	/* Number of blocks a track will span        */
-          iBytesWritten,	/* Number of bytes written on a write()      */
           iCount,		/* Temporary counter                         */
-          iErrorRecoveryCount;	/* Counter for the error recovery mechanism  */
+          iErrorRecoveryCount,	/* Counter for the error recovery mechanism  */
+          iFirstFrame,		/* First frame of the block to be written    */
+          iHeardSound,		/* Sound had been heard before this block    */
+          iWriterChecksum = 0;	/* Checksum kept here, over the output       */
+
+  u_char  *pOutput;		/* Audio to be written                       */
+  size_t  iWriteLength;		/* Bytes of audio to be written              */
+  u_int64_t llTrackLength;	/* Bytes of audio the track will become      */
+
+  static struct SampleFormat_t stCDDAformat = { 2, 16, 0, CDDA_SAMPLE_RATE }; /* CDDA as is */
+  struct  SampleFormat_t *pstFormat;	/* Format of the audio written       */
 
   int     iCurrentBlock = 0;	/* The block number we're current reading    */
 
@@ -696,9 +980,14 @@ fnExtractAudio(int iDeviceDesc, int iOutfileDesc, int iLBAstart, int iLBAend)
   int     iCurrentPercentComplete,   /* Current % of extractration complete  */
           iLastPercentComplete = -1; /* Last percent complete (marker)       */
 
-  u_long  lTotalFileLength;	/* The total file length, including headers  */
+  u_long  lFramesAnalysed,	/* Frames analysed before this block         */
+          lFramesFed = 0,	/* CDDA frames passed on to be written       */
+          lFramesWritten = 0,	/* Output frames written                     */
+          lSoundEnd = 0,	/* Output frame the trailing silence starts  */
+          lTrimmed = 0;		/* Frames of trailing silence trimmed        */
 
-  u_long  lTotalBytesWritten = 0; /* Total bytes written thus far            */
+  u_int32_t lCRC = 0,		/* CRC of the data written                   */
+          lCRCatSound = 0;	/* ... up to the end of the last sound       */
 
 
 #ifdef DEBUG
@@ -711,24 +1000,94 @@ fnExtractAudio(int iDeviceDesc, int iOutfileDesc, int iLBAstart, int iLBAend)
   if ((szBuffer = (char *) calloc(1, CDDA_DATA_LENGTH)) == NULL)
     fnError(kiExitStatus_General, "DAEX: Unable to allocate sufficient memory for CDDA buffer.");
 
-  /* Write the inital header - we don't know the total file length or the
-   * number of bytes written, so we specify 0... (see fnWriteAudioHeader).
+  pstFormat = pstConverter ? &pstConverter->stFormat : &stCDDAformat;
+
+  /* The length of the audio is known from the TOC before the first block
+   * is read, unless silence is to be trimmed.  It's only used when the
+   * header can't be rewritten at the end (see fnWriter_Open).
    */
-  fnWriteAudioHeader(iOutfileDesc, kiHeaderWAVE, &stWavHeader, 0, 0);
+  llTrackLength = (u_int64_t) (iLBAend - iLBAstart + 1) * (CDDA_DATA_LENGTH / 4);
+
+  if (pstConverter)
+    llTrackLength = fnConvert_Frames(pstConverter, (u_long) llTrackLength);
+
+  llTrackLength *= pstFormat->iChannels * pstFormat->iBitsPerSample / 8;
+
+  /* Write the inital header. */
+  if (fnWriter_Open(&stOutput, pstWriter, iOutfileDesc, pstFormat,
+                    iTrimFlags ? kllWriter_Unknown : llTrackLength) < 0) {
+    fprintf(stderr, "DAEX: Unable to write the %s header: %s.\n", pstWriter->szName,
+            errno ? strerror(errno) : "unsupported sample format");
+    fnWriter_Dispose(&stOutput);
+    free(szBuffer);
+    return -1;
+  }
+
+  /* Lay the whole track out on disk before the first block is written. */
+  fnWriter_Policy(&stOutput, iWriterPolicy, llSyncInterval);
+
+  if (!(iWriterPolicy & kiWriter_Mapped) || (fnWriter_Map(&stOutput, llTrackLength) < 0))
+    fnWriter_Reserve(&stOutput, llTrackLength);
+
+  if (pstRing && (fnWriter_Ring(&stOutput, pstRing, iTrackNumber) < 0)) {
+    fprintf(stderr, "DAEX: Unable to publish to the ring: %s.\n", strerror(errno));
+    fnWriter_Dispose(&stOutput);
+    free(szBuffer);
+    return -1;
+  }
+
+  if (pstSink)
+    fnWriter_Sink(&stOutput, pstSink);
+
+  /* Trailing silence is cut off once it has been written, which a pipe
+   * won't allow.
+   */
+  if ((iTrimFlags & kiTrim_Trailing) && !stOutput.iSeekable) {
+    fprintf(stderr, "DAEX: Trailing silence can't be trimmed when writing to a pipe.\n");
+    fnWriter_Dispose(&stOutput);
+    free(szBuffer);
+    return -1;
+  }
+
+  /* ... nor, once it's been compressed, from a file. */
+  if ((iTrimFlags & kiTrim_Trailing) && (pstWriter->iFlags & kiWriter_Encoded)) {
+    fprintf(stderr, "DAEX: Trailing silence can't be trimmed when writing %s.\n",
+            pstWriter->szName);
+    fnWriter_Dispose(&stOutput);
+    free(szBuffer);
+    return -1;
+  }
 
   /* Setup the CDDA-read structure. */
   stReadCDDA.frames = 1;              /* Number of 2352 byte blocks to read */
-  stReadCDDA.buffer = szBuffer;       /* Copy the buffer pointer            */
 
   /* Initialize the status variables for use during extraction */
   iBlocksToExtract = (iLBAend - iLBAstart);
 
+  /* When trimming, converting or byte swapping, the analyses' checksum
+   * would not match the audio written.
+   */
+  if ((iTrimFlags || pstConverter || stOutput.pfnEncode) &&
+      (pstAnalysis->iFlags & kiAnalysis_Checksum)) {
+    pstAnalysis->iFlags &= ~kiAnalysis_Checksum;
+    iWriterChecksum = 1;
+  }
+
   /* Read the individual blocks for the specified track.  Display a status
    * line, and attempt to recover from any errors we run into.
    */
 
   for (stReadCDDA.lba=iLBAstart; stReadCDDA.lba <= iLBAend; stReadCDDA.lba++) {
-    szBuffer[0] = '\0';
+    /* When the file is mapped, or a ring's slot has room, and the CDDA is
+     * written as it is, the block is read straight into its place.
+     */
+    pBlock = szBuffer;
+
+    if (!pstConverter && !stOutput.pfnEncode && fnWriter_Buffer(&stOutput))
+      pBlock = (char *) fnWriter_Buffer(&stOutput);
+
+    stReadCDDA.buffer = pBlock;
+    pBlock[0] = '\0';
 
     /* Reset the error recovery count for each block read */
     iErrorRecoveryCount = 0;
@@ -765,23 +1124,55 @@ fnExtractAudio(int iDeviceDesc, int iOutfileDesc, int iLBAstart, int iLBAend)
 #endif
 
       fprintf(stderr, "DAEX: Too many errors encountered reading track.\n");
+      fnWriter_Dispose(&stOutput);
+      free(szBuffer);
       return -2;
     }
 
-    /* Write the returned buffer of raw data to disk.  If the file system is
-     * full, or if not all 2352 bytes were written to disk, display an error
-     * message and exit... otherwise, increment the "iTotalBytesWritten"
-     * counter. 
+    /* De-emphasise the block in place, so that the analyses see the audio
+     * as it will be written.
      */
+    if (pstEmphasis)
+      fnEmphasis_ProcessBuffer(pstEmphasis, pBlock, CDDA_DATA_LENGTH);
 
-    if ((iBytesWritten = write(iOutfileDesc, szBuffer, CDDA_DATA_LENGTH)) != CDDA_DATA_LENGTH) {
-      if (errno == ENOSPC)
-        fnError(kiExitStatus_General, "\nUnable to write output file.  No space left on device.");
-      else
-        fnError(kiExitStatus_General, "\nIncorrect number of bytes written to output file (%i of %i).", iBytesWritten, CDDA_DATA_LENGTH);
-    }
+    /* Run the block through the enabled analyses, while it's still in the
+     * cache, and before it is written so that silence may be trimmed.
+     */
+    lFramesAnalysed = pstAnalysis->lFrames;
+    iHeardSound     = pstAnalysis->iHeardSound;
+
+    fnAnalysis_ProcessBuffer(pstAnalysis, pBlock, CDDA_DATA_LENGTH);
+
+    /* Skip the leading silence, up to the first frame of sound. */
+    iFirstFrame = 0;
+
+    if ((iTrimFlags & kiTrim_Leading) && !iHeardSound)
+      iFirstFrame = pstAnalysis->iHeardSound ?
+                    (int) (pstAnalysis->lLeadingSilence - lFramesAnalysed) : CDDA_DATA_LENGTH / 4;
+
+    /* Write the returned buffer of raw data to disk, converted if need be,
+     * and increment the "iTotalBytesWritten" counter.  The end of the last
+     * sound is found in CDDA frames, then carried over to output frames
+     * (which differ when resampling).
+     */
+
+    if (iFirstFrame < CDDA_DATA_LENGTH / 4) {
+      lFramesFed += CDDA_DATA_LENGTH / 4 - iFirstFrame;
+      lSoundEnd   = (pstAnalysis->lTrailingSilence < lFramesFed) ?
+                    lFramesFed - pstAnalysis->lTrailingSilence : 0;
+
+      if (pstConverter) {
+        lSoundEnd = fnConvert_Frames(pstConverter, lSoundEnd);
+        pOutput   = fnConvert_ProcessBuffer(pstConverter, pBlock + iFirstFrame * 4,
+                                            CDDA_DATA_LENGTH / 4 - iFirstFrame, &iWriteLength);
+      } else {
+        pOutput      = (u_char *) pBlock + iFirstFrame * 4;
+        iWriteLength = CDDA_DATA_LENGTH - iFirstFrame * 4;
+      }
 
-    lTotalBytesWritten += iBytesWritten;
+      fnWriteAudio(&stOutput, pOutput, iWriteLength, lSoundEnd, &lFramesWritten,
+                   iWriterChecksum ? &lCRC : NULL, &lCRCatSound);
+    }
 
     /* Determine how far into the file we are (percentage wise).  We use the:
      * [(x / 100) = (# blocks / total blocks) => percent complete = (x * 100)]
@@ -824,23 +1215,54 @@ fnExtractAudio(int iDeviceDesc, int iOutfileDesc, int iLBAstart, int iLBAend)
   /* Dispose of the raw audio buffer */
   free(szBuffer); 
 
-  /* Calculate the total file length written, including the audio
-   * header.
-   */
-  lTotalFileLength = lTotalBytesWritten + sizeof(struct WavFormat_t);
+  /* Write out whatever the converter has held back. */
+  if (pstConverter) {
+    pOutput = fnConvert_Flush(pstConverter, &iWriteLength);
+
+    fnWriteAudio(&stOutput, pOutput, iWriteLength, lSoundEnd, &lFramesWritten,
+                 iWriterChecksum ? &lCRC : NULL, &lCRCatSound);
+  }
+
+  /* Cut the trailing silence off the end of the file. */
+  if ((iTrimFlags & kiTrim_Trailing) && (lSoundEnd < lFramesWritten)) {
+    lTrimmed = lFramesWritten - lSoundEnd;
+
+    if (fnWriter_Truncate(&stOutput, (u_int64_t) lSoundEnd * stOutput.iFrameLength) < 0)
+      fnError(kiExitStatus_General, "\nUnable to trim output file: %s.", strerror(errno));
+  }
+
+  if (iWriterChecksum) {
+    pstAnalysis->lChecksum = (iTrimFlags & kiTrim_Trailing) ? lCRCatSound : lCRC;
+    pstAnalysis->iFlags   |= kiAnalysis_Checksum;
+  }
 
   /* Rewrite the audio header with the now known values of the total file
    * length, and total number of bytes written.
    */
-  fnWriteAudioHeader(iOutfileDesc, kiHeaderWAVE, &stWavHeader, 
-                     lTotalFileLength, lTotalBytesWritten);
+  if (fnWriter_Finalize(&stOutput) < 0)
+    fnError(kiExitStatus_General, "\nUnable to finalize output file: %s.%s", strerror(errno),
+            (errno == EFBIG) ? "  (Try -w rf64 or -w w64.)" : "");
 
-  /* Close the output file */
-  close(iOutfileDesc);
+  fnWriter_Dispose(&stOutput);
 
   /* Display the amount of data written to the output file. */
-  fprintf(stderr, "\nFile Size ....... [ %ld bytes (%ld kbytes) ]\n\n",
-          lTotalFileLength, lTotalFileLength / 1024);
+  fprintf(stderr, "\nFile Size ....... [ %llu bytes (%llu kbytes) ]\n",
+          (unsigned long long) stOutput.llFileLength,
+          (unsigned long long) stOutput.llFileLength / 1024);
+
+  if (iTrimFlags)
+    fprintf(stderr, "Trimmed ......... [ %.2f sec lead-in, %.2f sec run-out ]\n",
+            (iTrimFlags & kiTrim_Leading) ?
+              pstAnalysis->lLeadingSilence / (double) CDDA_SAMPLE_RATE : 0.0,
+            lTrimmed / (double) pstFormat->iSampleRate);
+
+  if (pstEmphasis)
+    fprintf(stderr, "De-emphasis ..... [ 50/15 us removed, %lu samples clipped ]\n",
+            pstEmphasis->lClippedSamples);
+
+  /* ... and the results of the analyses. */
+  fnAnalysis_Report(pstAnalysis);
+  fprintf(stderr, "\n");
 
   return 0;
 }
@@ -848,95 +1270,512 @@ fnExtractAudio(int iDeviceDesc, int iOutfileDesc, int iLBAstart, int iLBAend)
 
 /*========================================================================*/
 int
-fnProcessTrack(int iDeviceDesc, void *pvDiscInformation, int iTrackNumber)
+fnWriteChecksum(char *szChecksumFilename, char *szTrackFilename, u_int32_t lChecksum)
 /*
- * Validate and extract the specified track.  If the track is not within
- * the specified range, or is a data track, return an error.  Handle
- * duplicate filenames, and if all is well, extract the audio.
+ * Append a track's checksum to the checksum file.  Each line holds the
+ * CRC-32 in hex, two spaces, and the track's filename -- the format read
+ * by daex-verify(1).
  *
- *   Input:  iDeviceDesc       - The CD-ROM device descriptor.
- *           pvDiscInformation - Disc information struct.
- *           iTrackNumber      - The track to extract.
+ *   Input:  szChecksumFilename - The checksum file.
+ *           szTrackFilename    - The track's output filename.
+ *           lChecksum          - The track's CRC-32.
  *
- * Returns:   0 - No error.
- *           -1 - Unrecoverable error.  DAEX should quit.
- *           -2 - Recoverable error.  DAEX should continue with the next track.
+ * Returns:  -1 on error, 0 otherwise.
  */
 /*========================================================================*/
 {
-  struct DiscInformation_t *pstDiscInformation;  /* Disc information structure            */
-  struct ioc_toc_header *pstTOCheader;           /* Table of Contents header              */
-  struct ioc_read_toc_entry *pstTOCentries;      /* Entries' Header                       */
-  char   szTrackFilename_temp[MAX_CDDB_LINE_LENGTH]; /* Temporary filename used for dupes */
-  char   *szTrackFilename_ptr;                   /* Pointer to temp filename -- for dupes */
-  static int iFilenameDupeCount;                 /* Current duplicate filename count      */
-  int iOutfileDesc;                              /* Audio output file (audio) descriptor  */
-  int iReturnValue = 0;                          /* Return value for this function.       */
+  FILE *fChecksumFile;				/* Checksum file stream      */
 
 
 #ifdef DEBUG
-  fprintf(stderr, "FUNCTION: fnProcessTrack()\n");
+  fprintf(stderr, "FUNCTION: fnWriteChecksum()\n");
 #endif
 
-  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
-  pstTOCheader  = (struct ioc_toc_header *) pstDiscInformation->pstTOCheader;
-  pstTOCentries = (struct ioc_read_toc_entry *) pstDiscInformation->pstTOCentries;
+  if (! (fChecksumFile = fopen(szChecksumFilename, "a"))) {
+    fprintf(stderr, "DAEX: Unable to open checksum file: %s.\n", strerror(errno));
+    return -1;
+  }
 
-  iFilenameDupeCount = 0;
+  fprintf(fChecksumFile, "%08x  %s\n", lChecksum, szTrackFilename);
 
-  /* If the track number specified is not within the range of tracks on
-   * the disc, we return an error.
-   */
-  if ((iTrackNumber < pstTOCheader->starting_track) ||
-      (iTrackNumber > pstTOCheader->ending_track)) {
-    fprintf(stderr, "DAEX: The track number you specified is not within the proper range.\n");
+  if (fclose(fChecksumFile) != 0) {
+    fprintf(stderr, "DAEX: Unable to write checksum file: %s.\n", strerror(errno));
     return -1;
   }
 
-  /* If the specified track is a data track, alert the user and exit. */
-  if (pstTOCentries->data[iTrackNumber - 1].control & CDIO_DATA_TRACK) {
-    fprintf(stderr, "DAEX: The track you specified appears to be a data track.\n");
-    return -2;
-  }
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriteLoudness(char *szLoudnessFilename, void *pvDiscInformation, int iTrackNumber)
+/*
+ * Append a track's loudness, or the album's, to the loudness file.  The
+ * album is measured over the gating blocks of every track extracted, so
+ * its values are not an average of the tracks'.  A header describing the
+ * fields is written when the file is created.
+ *
+ *   Input:  szLoudnessFilename - The loudness file.
+ *           pvDiscInformation  - Disc information structure.
+ *           iTrackNumber       - The track, or 0 for the album.
+ *
+ * Returns:  -1 on error, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInformation;	/* Disc information          */
+  struct LoudnessMeter_t   **apstMeters;	/* Meters to combine         */
+  struct LoudnessResult_t  stLoudness;		/* Their results             */
+  FILE *fLoudnessFile;				/* Loudness file stream      */
+  int  iMeters = 0,				/* Number of meters          */
+       iTrackIndex;				/* Current track             */
+
 
 #ifdef DEBUG
-  fprintf(stderr, "Start block : %i\n", 
-          pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_start);
-  fprintf(stderr, "End block   : %i\n\n", 
-          pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_end);
+  fprintf(stderr, "FUNCTION: fnWriteLoudness()\n");
 #endif
 
-  extract_audio:
+  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
 
-  /* Open the output file.  Exit upon failure. */
-  if ((iOutfileDesc = open(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename, 
-                           O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
+  if (! (apstMeters = (struct LoudnessMeter_t **)
+         calloc(pstDiscInformation->pstTOCheader->ending_track, sizeof(struct LoudnessMeter_t *)))) {
+    fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the loudness meters.\n");
+    return -1;
+  }
 
-    /* If the output file exists, determine an alternate filename. */
-    if (errno == EEXIST) {
+  /* Tracks which were skipped have no analysis, and aren't part of the album. */
+  for (iTrackIndex = pstDiscInformation->pstTOCheader->starting_track;
+       iTrackIndex <= pstDiscInformation->pstTOCheader->ending_track;
+       iTrackIndex++)
+    if (((iTrackNumber == 0) || (iTrackNumber == iTrackIndex)) &&
+        pstDiscInformation->pstTrackData[iTrackIndex - 1].pstAnalysis)
+      apstMeters[iMeters++] = &pstDiscInformation->pstTrackData[iTrackIndex - 1].pstAnalysis->stLoudness;
 
-      /* If there are more than 10 dupes, exit. */
-      if (iFilenameDupeCount >= 10) {
-        fprintf(stderr, "DAEX: Too many attempts at finding a new name for track #%i.\n",
-                iTrackNumber);
-        return -2;
-      }
+  fnLoudness_Result(apstMeters, iMeters, &stLoudness);
+  free(apstMeters);
 
-      /* If our attempt(s) at finding a new filename was unsuccessful, determine the
-       * location of the period at the end of the filename (the dupe extention).
-       */
-      if (iFilenameDupeCount > 0) {
-        szTrackFilename_ptr =
-          strrchr(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename, '.');
+  if (! (fLoudnessFile = fopen(szLoudnessFilename, "a"))) {
+    fprintf(stderr, "DAEX: Unable to open loudness file: %s.\n", strerror(errno));
+    return -1;
+  }
 
-        /* If we're unable to locate the dupe extention (period -- '.'), exit. */
-        if (!szTrackFilename_ptr) {
-          fprintf(stderr, "DAEX: Unable to locate the dupe extention in the track filename.\n");
-          return -1;
-        }
+  if (ftell(fLoudnessFile) == 0) {
+    fprintf(fLoudnessFile, "# DAEX v%s - The Digital Audio EXtractor.\n", kszVersion);
+    fprintf(fLoudnessFile, "#\n");
+    fprintf(fLoudnessFile, "# Loudness per EBU R128, gain per ReplayGain 2.0 (%.0f LUFS reference).\n",
+            kdLoudness_ReplayGainReference);
+    fprintf(fLoudnessFile, "#\n");
+    fprintf(fLoudnessFile, "# Track   Loudness (LUFS)   Range (LU)   True peak (dBTP)   Gain (dB)   File\n");
+    fprintf(fLoudnessFile, "#\n");
+  }
 
-        /* Reset the track filename pointer. */
-        *szTrackFilename_ptr = 0;
+  if (iTrackNumber == 0)
+    fprintf(fLoudnessFile, "album   %15.2f   %10.2f   %16.2f   %+9.2f\n",
+            stLoudness.dIntegrated, stLoudness.dRange,
+            fnAnalysis_Decibels(stLoudness.dTruePeak), stLoudness.dGain);
+  else
+    fprintf(fLoudnessFile, "%02d      %15.2f   %10.2f   %16.2f   %+9.2f   %s\n", iTrackNumber,
+            stLoudness.dIntegrated, stLoudness.dRange,
+            fnAnalysis_Decibels(stLoudness.dTruePeak), stLoudness.dGain,
+            pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename);
+
+  if (fclose(fLoudnessFile) != 0) {
+    fprintf(stderr, "DAEX: Unable to write loudness file: %s.\n", strerror(errno));
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnWriteCueString(FILE *fCueFile, char *szCommand, char *szText, char *szSuffix)
+/*
+ * Write a cue sheet command with a quoted string.  Double quotes can't be
+ * escaped in a cue sheet, so any in the string become single quotes.
+ *
+ *   Input:  fCueFile  - The cue sheet.
+ *           szCommand - The command, indented as it is to be written.
+ *           szText    - The string.
+ *           szSuffix  - Written after the string, before the newline.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  fprintf(fCueFile, "%s \"", szCommand);
+
+  for (; *szText; szText++)
+    putc((*szText == '"') ? '\'' : *szText, fCueFile);
+
+  fprintf(fCueFile, "\"%s\n", szSuffix);
+}
+
+
+/*========================================================================*/
+int
+fnWriteCueSheet(FILE *fCueFile, char *szImageFilename, void *pvDiscInformation,
+                int iFirstTrack, int iLastTrack)
+/*
+ * Write the cue sheet describing a disc image, and close it.  Each track
+ * starts (INDEX 01) where the TOC says it does; the TOC doesn't give the
+ * pre-gaps, so they are left at the end of the track before.  The TOC's
+ * pre-emphasis, copy and four channel flags are carried over, and the
+ * titles too if the disc was found in the CDDB.
+ *
+ *   Input:  fCueFile          - The cue sheet, open for writing.
+ *           szImageFilename   - The image, in the same directory.
+ *           pvDiscInformation - Disc information structure.
+ *           iFirstTrack       - The first track in the image.
+ *           iLastTrack        - ... and the last.
+ *
+ * Returns:  -1 on error, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInformation;	/* Disc information          */
+  struct CDDBinformation_t *pstCDDBinformation;	/* Titles, or NULL           */
+  char szTitle[kiMaxStringLength],		/* Disc title, then artist   */
+       *szArtist,				/* ... split off             */
+       *szImageBasename;			/* Image, less its directory */
+  int  iTrackIndex,				/* Current track             */
+       iControl,				/* Its TOC control flags     */
+       iOffset;					/* Its start in the image    */
+
+
+#ifdef DEBUG
+  fprintf(stderr, "FUNCTION: fnWriteCueSheet()\n");
+#endif
+
+  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
+  pstCDDBinformation = pstDiscInformation->pstCDDBinformation;
+
+  fprintf(fCueFile, "REM COMMENT \"DAEX v%s\"\n", kszVersion);
+
+  /* The CDDB's disc title is the artist and the title, split by a "/". */
+  if (pstCDDBinformation && pstCDDBinformation->szDiscTitle) {
+    fprintf(fCueFile, "REM DISCID %s\n", pstCDDBinformation->szDiscID);
+
+    snprintf(szTitle, sizeof(szTitle), "%s", pstCDDBinformation->szDiscTitle);
+
+    if ((szArtist = strstr(szTitle, " / ")) != NULL) {
+      *szArtist = 0;
+      fnWriteCueString(fCueFile, "PERFORMER", szTitle, "");
+      fnWriteCueString(fCueFile, "TITLE", szArtist + 3, "");
+    } else
+      fnWriteCueString(fCueFile, "TITLE", szTitle, "");
+  }
+
+  szImageBasename = strrchr(szImageFilename, '/') ? strrchr(szImageFilename, '/') + 1 :
+                                                    szImageFilename;
+
+  fnWriteCueString(fCueFile, "FILE", szImageBasename, " BINARY");
+
+  for (iTrackIndex = iFirstTrack; iTrackIndex <= iLastTrack; iTrackIndex++) {
+    iControl = pstDiscInformation->pstTOCentries->data[iTrackIndex - 1].control;
+    iOffset  = pstDiscInformation->pstTrackData[iTrackIndex - 1].iFixedLBA_start -
+               pstDiscInformation->pstTrackData[iFirstTrack - 1].iFixedLBA_start;
+
+    fprintf(fCueFile, "  TRACK %02d AUDIO\n", iTrackIndex);
+
+    if (pstCDDBinformation && pstCDDBinformation->szTrackTitle &&
+        pstCDDBinformation->szTrackTitle[iTrackIndex - 1])
+      fnWriteCueString(fCueFile, "    TITLE", pstCDDBinformation->szTrackTitle[iTrackIndex - 1], "");
+
+    if (iControl & (CDIO_COPY_PERMITTED | CDIO_FOUR_CHANNEL | CDIO_PRE_EMPHASIS))
+      fprintf(fCueFile, "    FLAGS%s%s%s\n", (iControl & CDIO_COPY_PERMITTED) ? " DCP" : "",
+              (iControl & CDIO_FOUR_CHANNEL) ? " 4CH" : "",
+              (iControl & CDIO_PRE_EMPHASIS) ? " PRE" : "");
+
+    fprintf(fCueFile, "    INDEX 01 %02d:%02d:%02d\n", iOffset / (60 * 75), (iOffset / 75) % 60,
+            iOffset % 75);
+  }
+
+  if (fclose(fCueFile) != 0) {
+    fprintf(stderr, "DAEX: Unable to write cue sheet: %s.\n", strerror(errno));
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnRenameTrack(char *szFrom, char *szTo)
+/*
+ * Rename a track's file, in one step, without replacing a file already
+ * there.
+ *
+ *   Input:  szFrom - The file.
+ *           szTo   - Its new name.
+ *
+ * Returns:  -1 on error (errno is EEXIST if the name is taken), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  if (link(szFrom, szTo) == 0)
+    return unlink(szFrom);
+
+  if (errno == EEXIST)
+    return -1;
+
+  /* Without hard links, rename() it is; it would replace the file, though. */
+  if (access(szTo, F_OK) == 0) {
+    errno = EEXIST;
+    return -1;
+  }
+
+  return rename(szFrom, szTo);
+}
+
+
+/*========================================================================*/
+int
+fnTakeTitles(void *pvDiscInformation)
+/*
+ * Wait for the disc's lookup to finish, and name its tracks for the titles
+ * found.  Tracks already written whole, under their provisional names,
+ * are renamed (to "name.1", "name.2", ... should the name be taken); if
+ * the disc couldn't be looked up, they keep them.  A track which failed,
+ * or was cut short, is left under its provisional name, so that it isn't
+ * mistaken for a finished one; should it be extracted again, it's under
+ * its title.
+ *
+ *   Input:  pvDiscInformation - Disc information struct.
+ *
+ * Returns:  -1 on error, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInformation;  /* Disc information structure            */
+  struct TrackInformation_t *pstTrack;           /* Current track                         */
+  struct CDDBlookup_t *pstLookup;                /* The lookup                            */
+  char   **aszProvisional;                       /* Each track's provisional filename     */
+  char   szFilename[MAX_CDDB_LINE_LENGTH];       /* A new filename                        */
+  int    iTracks,                                /* Tracks on the disc                    */
+         iTrackIndex,                            /* Current track                         */
+         iDupe;                                  /* Current duplicate filename count      */
+
+
+#ifdef DEBUG
+  fprintf(stderr, "FUNCTION: fnTakeTitles()\n");
+#endif
+
+  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
+
+  if (! (pstLookup = pstDiscInformation->pstLookup))
+    return 0;
+
+  pstDiscInformation->pstLookup = NULL;
+
+  if (fnCDDB_FinishLookup(pstDiscInformation, pstLookup) < 0) {
+    fprintf(stderr, "DAEX: The disc couldn't be looked up; its tracks keep their provisional names.\n\n");
+    return 0;
+  }
+
+  iTracks = pstDiscInformation->pstTOCheader->ending_track;
+
+  if (! (aszProvisional = (char **) fnArena_Alloc(pstDiscInformation->pstArena,
+                                                  iTracks * sizeof(char *)))) {
+    fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the track filenames.\n");
+    return -1;
+  }
+
+  for (iTrackIndex = 0; iTrackIndex < iTracks; iTrackIndex++)
+    aszProvisional[iTrackIndex] = pstDiscInformation->pstTrackData[iTrackIndex].szTrackFilename;
+
+  if (fnCDDB_StoreFilenames(pstDiscInformation) < 0)
+    return -1;
+
+  for (iTrackIndex = 0; iTrackIndex < iTracks; iTrackIndex++) {
+    pstTrack = &pstDiscInformation->pstTrackData[iTrackIndex];
+
+    if (!pstTrack->iProvisional)
+      continue;
+
+    pstTrack->iProvisional = 0;
+
+    if (!pstTrack->iFinished) {
+      fprintf(stderr, "DAEX: Track #%i wasn't finished; it's left as \"%s\".\n", iTrackIndex + 1,
+              aszProvisional[iTrackIndex]);
+      continue;
+    }
+
+    snprintf(szFilename, sizeof(szFilename), "%s", pstTrack->szTrackFilename);
+
+    for (iDupe = 1; fnRenameTrack(aszProvisional[iTrackIndex], szFilename) < 0; iDupe++) {
+      if ((errno != EEXIST) || (iDupe > 10)) {
+        fprintf(stderr, "DAEX: Unable to rename \"%s\" to \"%s\": %s.\n",
+                aszProvisional[iTrackIndex], pstTrack->szTrackFilename, strerror(errno));
+        pstTrack->szTrackFilename = aszProvisional[iTrackIndex];
+        break;
+      }
+
+      snprintf(szFilename, sizeof(szFilename), "%s.%i", pstTrack->szTrackFilename, iDupe);
+    }
+
+    if (pstTrack->szTrackFilename == aszProvisional[iTrackIndex])
+      continue;
+
+    if (! (pstTrack->szTrackFilename = fnArena_Strdup(pstDiscInformation->pstArena, szFilename))) {
+      fprintf(stderr, "DAEX: Unable to allocate sufficient memory for track #%i's filename.\n",
+              iTrackIndex + 1);
+      return -1;
+    }
+
+    fprintf(stderr, "DAEX: Renamed \"%s\" to \"%s\".\n", aszProvisional[iTrackIndex],
+            pstTrack->szTrackFilename);
+  }
+
+  fprintf(stderr, "\n");
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnProcessTrack(int iDeviceDesc, void *pvDiscInformation, int iTrackNumber)
+/*
+ * Validate and extract the specified track.  If the track is not within
+ * the specified range, or is a data track, return an error.  Handle
+ * duplicate filenames, and if all is well, extract the audio, removing
+ * pre-emphasis if requested.
+ *
+ *   Input:  iDeviceDesc       - The CD-ROM device descriptor.
+ *           pvDiscInformation - Disc information struct.
+ *           iTrackNumber      - The track to extract.
+ *
+ * Returns:   0 - No error.
+ *           -1 - Unrecoverable error.  DAEX should quit.
+ *           -2 - Recoverable error.  DAEX should continue with the next track.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInformation;  /* Disc information structure            */
+  struct ioc_toc_header *pstTOCheader;           /* Table of Contents header              */
+  struct ioc_read_toc_entry *pstTOCentries;      /* Entries' Header                       */
+  struct EmphasisFilter_t stEmphasis,            /* De-emphasis filter                    */
+                          *pstEmphasis;          /* ... if the track needs it             */
+  struct SampleFormat_t stFormat;                /* Format to write                       */
+  struct Converter_t *pstConverter = NULL;       /* Converter, unless writing CDDA        */
+  char   szTrackFilename_temp[MAX_CDDB_LINE_LENGTH]; /* Temporary filename used for dupes */
+  char   *szTrackFilename_ptr;                   /* Pointer to temp filename -- for dupes */
+  static int iFilenameDupeCount;                 /* Current duplicate filename count      */
+  int iOutfileDesc;                              /* Audio output file (audio) descriptor  */
+  struct stat stOutfileStatus;                   /* Type of an existing output file       */
+  struct CacheEntry_t stCacheEntry;              /* The track's file in the rip cache     */
+  char   szCacheFormat[kiMaxStringLength];       /* ... and its format                    */
+  int iCacheable = 0,                            /* The output may be cached (flag)       */
+      iCached = 0;                               /* ... and was taken from it (flag)      */
+  int iReturnValue = 0;                          /* Return value for this function.       */
+
+
+#ifdef DEBUG
+  fprintf(stderr, "FUNCTION: fnProcessTrack()\n");
+#endif
+
+  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
+  pstTOCheader  = (struct ioc_toc_header *) pstDiscInformation->pstTOCheader;
+  pstTOCentries = (struct ioc_read_toc_entry *) pstDiscInformation->pstTOCentries;
+
+  iFilenameDupeCount = 0;
+
+  /* If the track number specified is not within the range of tracks on
+   * the disc, we return an error.
+   */
+  if ((iTrackNumber < pstTOCheader->starting_track) ||
+      (iTrackNumber > pstTOCheader->ending_track)) {
+    fprintf(stderr, "DAEX: The track number you specified is not within the proper range.\n");
+    return -1;
+  }
+
+  /* If the specified track is a data track, alert the user and exit. */
+  if (pstTOCentries->data[iTrackNumber - 1].control & CDIO_DATA_TRACK) {
+    fprintf(stderr, "DAEX: The track you specified appears to be a data track.\n");
+    return -2;
+  }
+
+#ifdef DEBUG
+  fprintf(stderr, "Start block : %i\n", 
+          pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_start);
+  fprintf(stderr, "End block   : %i\n\n", 
+          pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_end);
+#endif
+
+  extract_audio:
+
+  /* An output filename of "-" is the standard output, which had better not
+   * be a terminal.  An existing FIFO (or device) is written to as it is; the
+   * header then can't be rewritten, so it's written up front instead.
+   */
+  iOutfileDesc = -1;
+
+  /* With a ring, the track is published to it and no file is written;
+   * likewise with a network sink.  With an encoder command, the track goes
+   * down a pipe to its encoder.
+   */
+  if (pstDiscInformation->pstOptions->pstRing || pstDiscInformation->pstOptions->pstSink)
+    ;
+  else if (pstDiscInformation->pstOptions->pstEncoders) {
+    if ((iOutfileDesc = fnEncoder_Start(pstDiscInformation->pstOptions->pstEncoders, iTrackNumber,
+                                        pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename)) < 0) {
+      fprintf(stderr, "DAEX: Unable to queue track #%i for encoding: %s.\n", iTrackNumber,
+              strerror(errno));
+      return -1;
+    }
+  } else if (strcmp(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename, "-") == 0) {
+    if (isatty(STDOUT_FILENO)) {
+      fprintf(stderr, "DAEX: Refusing to write audio to a terminal.\n");
+      return -1;
+    }
+
+    if ((iOutfileDesc = dup(STDOUT_FILENO)) < 0) {
+      fprintf(stderr, "DAEX: Unable to write to the standard output: %s.\n", strerror(errno));
+      return -1;
+    }
+  } else if ((stat(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename,
+                   &stOutfileStatus) == 0) &&
+             (S_ISFIFO(stOutfileStatus.st_mode) || S_ISCHR(stOutfileStatus.st_mode)))
+    iOutfileDesc = open(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename,
+                        O_WRONLY);
+
+  /* Open the output file.  Exit upon failure.  A file that is to be mapped
+   * must be readable as well.
+   */
+  if ((iOutfileDesc < 0) && !pstDiscInformation->pstOptions->pstRing &&
+      !pstDiscInformation->pstOptions->pstSink &&
+      ((iOutfileDesc = open(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename, 
+                            ((pstDiscInformation->pstOptions->iWriterPolicy & kiWriter_Mapped) ?
+                             O_RDWR : O_WRONLY) | O_CREAT | O_EXCL, 0644)) < 0)) {
+
+    /* If the output file exists, determine an alternate filename. */
+    if (errno == EEXIST) {
+
+      /* If there are more than 10 dupes, exit. */
+      if (iFilenameDupeCount >= 10) {
+        fprintf(stderr, "DAEX: Too many attempts at finding a new name for track #%i.\n",
+                iTrackNumber);
+        return -2;
+      }
+
+      /* If our attempt(s) at finding a new filename was unsuccessful, determine the
+       * location of the period at the end of the filename (the dupe extention).
+       */
+      if (iFilenameDupeCount > 0) {
+        szTrackFilename_ptr =
+          strrchr(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename, '.');
+
+        /* If we're unable to locate the dupe extention (period -- '.'), exit. */
+        if (!szTrackFilename_ptr) {
+          fprintf(stderr, "DAEX: Unable to locate the dupe extention in the track filename.\n");
+          return -1;
+        }
+
+        /* Reset the track filename pointer. */
+        *szTrackFilename_ptr = 0;
       }
 
       /* Increase the dupe count, and create the alternate filename. */
@@ -944,12 +1783,11 @@ fnProcessTrack(int iDeviceDesc, void *pvDiscInformation, int iTrackNumber)
                pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename,
                ++iFilenameDupeCount);
 
-      /* Free the previous filename. */
-      free(pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename);
-
-      /* ... and store the alternate. */
+      /* Store the alternate.  The previous filename stays in the arena until
+       * the disc is disposed of.
+       */
       if (! (pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename =
-	     strdup(szTrackFilename_temp))) {
+	     fnArena_Strdup(pstDiscInformation->pstArena, szTrackFilename_temp))) {
         fprintf(stderr, "DAEX: Unable to allocate sufficient memory for track #%i's filename.\n",
                 iTrackNumber);
         return -1;
@@ -966,28 +1804,353 @@ fnProcessTrack(int iDeviceDesc, void *pvDiscInformation, int iTrackNumber)
     }
   }
 
+  /* Until the disc has been looked up, the track has a provisional name. */
+  pstDiscInformation->pstTrackData[iTrackNumber - 1].iProvisional =
+    (pstDiscInformation->pstLookup != NULL);
+  pstDiscInformation->pstTrackData[iTrackNumber - 1].iFinished = 0;
+
   /* Display the first part of the status. */
   fprintf(stderr, "Current Track ... [ %i ]\n", iTrackNumber);
-  fprintf(stderr, "Filename ........ [ %s ]\n",
-          pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename);
+
+  if (pstDiscInformation->pstOptions->pstRing)
+    fprintf(stderr, "Ring ............ [ %s ]\n", pstDiscInformation->pstOptions->szRingName);
+  else if (pstDiscInformation->pstOptions->pstSink)
+    fprintf(stderr, "Sending ......... [ %s to %s:%i ]\n",
+            pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename,
+            pstDiscInformation->pstOptions->szSinkHost, pstDiscInformation->pstOptions->iSinkPort);
+  else
+    fprintf(stderr, "Filename ........ [ %s ]\n",
+            pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename);
   fprintf(stderr, "Drive Speed ..... [ %s ]\n", pstDiscInformation->szDriveSpeed);
 
+  /* Tracks mastered with pre-emphasis are flagged in the TOC.  Undo it if the
+   * user asked us to, otherwise let them know it's there.
+   */
+  pstEmphasis = NULL;
+
+  if (pstTOCentries->data[iTrackNumber - 1].control & CDIO_PRE_EMPHASIS) {
+    if (pstDiscInformation->pstOptions->iDeemphasis) {
+      fnEmphasis_Initialize(&stEmphasis, CDDA_SAMPLE_RATE);
+      pstEmphasis = &stEmphasis;
+    } else
+      fprintf(stderr, "Emphasis ........ [ 50/15 us pre-emphasis, not removed (see -e) ]\n");
+  }
+
+  /* Set up the sample format conversion, unless CDDA is to be written as is. */
+  stFormat.iChannels      = pstDiscInformation->pstOptions->iOutputChannels;
+  stFormat.iBitsPerSample = pstDiscInformation->pstOptions->iOutputBits;
+  stFormat.iFloat         = pstDiscInformation->pstOptions->iOutputFloat;
+  stFormat.iSampleRate    = pstDiscInformation->pstOptions->iOutputRate;
+
+  if ((stFormat.iChannels != 2) || (stFormat.iBitsPerSample != 16) ||
+      (stFormat.iSampleRate != CDDA_SAMPLE_RATE)) {
+    if (! (pstConverter = (struct Converter_t *) malloc(sizeof(struct Converter_t)))) {
+      fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the sample converter.\n");
+      close(iOutfileDesc);
+      return -1;
+    }
+
+    if (fnConvert_Initialize(pstConverter, &stFormat, pstDiscInformation->pstOptions->iDither,
+                             pstDiscInformation->pstOptions->iResampleQuality) < 0) {
+      fprintf(stderr, "DAEX: Unsupported sample format.\n");
+      fnConvert_Dispose(pstConverter);
+      free(pstConverter);
+      close(iOutfileDesc);
+      return -1;
+    }
+
+    fprintf(stderr, "Format .......... [ %s, %i bit%s, %i Hz ]\n",
+            (stFormat.iChannels == 1) ? "Mono" : "Stereo", stFormat.iBitsPerSample,
+            stFormat.iFloat ? " float" : "", stFormat.iSampleRate);
+  }
+
+  /* Allocate the track's analysis results, if this is the first attempt. */
+  if (!pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis)
+    if (! (pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis =
+           (struct AudioAnalysis_t *) calloc(1, sizeof(struct AudioAnalysis_t)))) {
+      fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the track analysis.\n");
+      if (pstConverter) {
+        fnConvert_Dispose(pstConverter);
+        free(pstConverter);
+      }
+      close(iOutfileDesc);
+      return -1;
+    }
+
+  pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis->iSilenceThreshold =
+    pstDiscInformation->pstOptions->iSilenceThreshold;
+
+  fnAnalysis_Initialize(pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis,
+                        pstDiscInformation->pstOptions->iAnalysisFlags);
+
+  /* Tell daex-recv which file is coming.  Whatever it already holds of it,
+   * from a transfer that was cut off, isn't sent again.
+   */
+  if (pstDiscInformation->pstOptions->pstSink) {
+    if (fnNet_StartTrack(pstDiscInformation->pstOptions->pstSink, iTrackNumber,
+                         pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename) < 0) {
+      fprintf(stderr, "DAEX: Unable to send track #%i: %s.\n", iTrackNumber, strerror(errno));
+      if (pstConverter) {
+        fnConvert_Dispose(pstConverter);
+        free(pstConverter);
+      }
+      return -1;
+    }
+
+    if (pstDiscInformation->pstOptions->pstSink->llSkip > 0)
+      fprintf(stderr, "Resuming ........ [ %llu bytes already received ]\n",
+              (unsigned long long) pstDiscInformation->pstOptions->pstSink->llSkip);
+  }
+
+  /* A track in the rip cache is checked against a few of the disc's
+   * sectors, and put in place rather than read again; unless analyses only
+   * an extraction can give were asked for.  Only output files are cached.
+   */
+  if (pstDiscInformation->pstOptions->pstCache && (fstat(iOutfileDesc, &stOutfileStatus) == 0) &&
+      S_ISREG(stOutfileStatus.st_mode)) {
+    iCacheable = 1;
+
+    fnCache_Describe(szCacheFormat, sizeof(szCacheFormat), pstDiscInformation->pstOptions,
+                     pstDiscInformation->pstOptions->pstWriter->szName, pstEmphasis != NULL);
+
+    if (!(pstDiscInformation->pstOptions->iAnalysisFlags & kiCache_Uncached) &&
+        (fnCache_Fetch(pstDiscInformation->pstOptions->pstCache, &stCacheEntry, iDeviceDesc,
+                       iTrackNumber, pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_start,
+                       pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_end,
+                       szCacheFormat, pstDiscInformation->pstOptions->pstWriter->szExtension,
+                       pstDiscInformation->pstOptions->iAnalysisFlags & kiAnalysis_Checksum,
+                       iOutfileDesc, pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename) == 0)) {
+      fprintf(stderr, "Cache ........... [ %i sectors verified, %s ]\n", kiCache_Samples,
+              (stCacheEntry.iHow == kiCache_Reflinked) ? "cloned" : "hard linked");
+      fprintf(stderr, "File Size ....... [ %llu bytes (%llu kbytes) ]\n\n",
+              (unsigned long long) stCacheEntry.llLength,
+              (unsigned long long) stCacheEntry.llLength / 1024);
+
+      pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis->lChecksum =
+        stCacheEntry.lChecksum;
+      iCached = 1;
+    } else if (errno == ESTALE)
+      fprintf(stderr, "Cache ........... [ changed since it was cached, reading the disc ]\n");
+  }
+
   /* Copy the audio to disk. */
-  iReturnValue = fnExtractAudio(iDeviceDesc, iOutfileDesc,
+  if (!iCached)
+    iReturnValue = fnExtractAudio(iDeviceDesc, iOutfileDesc,
                   pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_start,
-		  pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_end);
+		  pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_end,
+                  pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis,
+                  pstDiscInformation->pstOptions->iTrimFlags, pstEmphasis, pstConverter,
+                  pstDiscInformation->pstOptions->pstWriter,
+                  pstDiscInformation->pstOptions->iWriterPolicy,
+                  pstDiscInformation->pstOptions->llSyncInterval,
+                  pstDiscInformation->pstOptions->pstRing,
+                  pstDiscInformation->pstOptions->pstSink, iTrackNumber);
+
+  /* Cache what was extracted.  A track which can't be cached is still good. */
+  if ((iReturnValue == 0) && iCacheable && !iCached) {
+    stCacheEntry.iChecksum = pstDiscInformation->pstOptions->iAnalysisFlags & kiAnalysis_Checksum;
+    stCacheEntry.lChecksum = pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis->lChecksum;
+
+    if (fnCache_Store(pstDiscInformation->pstOptions->pstCache, &stCacheEntry, iDeviceDesc,
+                      iTrackNumber, pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_start,
+                      pstDiscInformation->pstTrackData[iTrackNumber - 1].iFixedLBA_end,
+                      szCacheFormat, pstDiscInformation->pstOptions->pstWriter->szExtension,
+                      pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename) < 0)
+      fprintf(stderr, "DAEX: Unable to add track #%i to the rip cache: %s.\n\n", iTrackNumber,
+              strerror(errno));
+  }
+
+  /* daex-recv keeps the file only if it got all of it, intact.  One which
+   * didn't match may be extracted again.
+   */
+  if ((iReturnValue == 0) && pstDiscInformation->pstOptions->pstSink &&
+      (fnNet_EndTrack(pstDiscInformation->pstOptions->pstSink) < 0)) {
+    fprintf(stderr, "DAEX: daex-recv didn't keep track #%i: %s.\n", iTrackNumber,
+            (errno == EIO) ? "it arrived damaged" : strerror(errno));
+    iReturnValue = (errno == EIO) ? -2 : -1;
+  }
+
+  if (pstConverter) {
+    fnConvert_Dispose(pstConverter);
+    free(pstConverter);
+  }
 
-  /* Close the outfile descriptor. */
+  /* Close the outfile descriptor, here and nowhere else: the encoders' pump
+   * thread opens pipes meanwhile, and the lookup thread its connections to
+   * the servers, and a second close could shut one of theirs.
+   */
   close(iOutfileDesc);
+
+  pstDiscInformation->pstTrackData[iTrackNumber - 1].iFinished = (iReturnValue == 0);
+
+  /* The first track to be finished waits for the disc's titles, and takes
+   * its name (along with everything written before it has its checksum or
+   * loudness recorded).
+   */
+  if (pstDiscInformation->pstLookup && (fnTakeTitles(pstDiscInformation) < 0))
+    return -1;
+
+  /* Record the track's checksum, if the user asked for it. */
+  if ((iReturnValue == 0) && pstDiscInformation->pstOptions->szChecksumFilename)
+    if (fnWriteChecksum(pstDiscInformation->pstOptions->szChecksumFilename,
+                        pstDiscInformation->pstTrackData[iTrackNumber - 1].szTrackFilename,
+                        pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis->lChecksum) < 0)
+      return -1;
+
+  /* ... and its loudness. */
+  if ((iReturnValue == 0) && pstDiscInformation->pstOptions->szLoudnessFilename)
+    if (fnWriteLoudness(pstDiscInformation->pstOptions->szLoudnessFilename,
+                        pstDiscInformation, iTrackNumber) < 0)
+      return -1;
+
+  /* A track which failed is left out of the album's results. */
+  if (iReturnValue < 0) {
+    fnAnalysis_Dispose(pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis);
+    free(pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis);
+    pstDiscInformation->pstTrackData[iTrackNumber - 1].pstAnalysis = NULL;
+  }
+
   return iReturnValue;
 }
 
 
+/*========================================================================*/
+int
+fnProcessImage(int iDeviceDesc, void *pvDiscInformation)
+/*
+ * Extract the whole disc into one image of raw CDDA, in a single pass,
+ * and write a cue sheet beside it describing its tracks.  The image runs
+ * from the first track to the end of the last audio track before any
+ * data track.  It is named for the -o option, or "disc.bin"; the cue
+ * sheet takes its name with ".cue" in place of the extension.  Neither
+ * file may already exist.
+ *
+ *   Input:  iDeviceDesc       - The CD-ROM device descriptor.
+ *           pvDiscInformation - Disc information struct.
+ *
+ * Returns:   0 - No error.
+ *           -1 - Unrecoverable error.  DAEX should quit.
+ */
+/*========================================================================*/
+{
+  struct DiscInformation_t *pstDiscInformation;  /* Disc information structure            */
+  struct ExtractionOptions_t *pstOptions;        /* User's extraction options             */
+  struct AudioAnalysis_t stAnalysis;             /* The image's analyses                  */
+  char   szImageFilename[kiMaxStringLength],     /* The image                             */
+         szCueFilename[kiMaxStringLength],       /* ... and its cue sheet                 */
+         *pExtension;                            /* Image's extension, in szCueFilename   */
+  FILE   *fCueFile;                              /* Cue sheet stream                      */
+  int    iFirstTrack,                            /* First track in the image              */
+         iLastTrack,                             /* ... and the last                      */
+         iCueDesc,                               /* Cue sheet descriptor                  */
+         iOutfileDesc;                           /* Image descriptor                      */
+  int    iReturnValue;                           /* Return value for this function.       */
+
+
+#ifdef DEBUG
+  fprintf(stderr, "FUNCTION: fnProcessImage()\n");
+#endif
+
+  pstDiscInformation = (struct DiscInformation_t *) pvDiscInformation;
+  pstOptions         = pstDiscInformation->pstOptions;
+
+  /* The image takes the audio tracks up to the first data track, such as
+   * a CD-EXTRA disc's last.
+   */
+  iFirstTrack = pstDiscInformation->pstTOCheader->starting_track;
+
+  if (pstDiscInformation->pstTOCentries->data[iFirstTrack - 1].control & CDIO_DATA_TRACK) {
+    fprintf(stderr, "DAEX: The disc begins with a data track, which can't be imaged.\n");
+    return -1;
+  }
+
+  for (iLastTrack = iFirstTrack; iLastTrack < pstDiscInformation->pstTOCheader->ending_track;
+       iLastTrack++)
+    if (pstDiscInformation->pstTOCentries->data[iLastTrack].control & CDIO_DATA_TRACK)
+      break;
+
+  /* Name the image and its cue sheet. */
+  if (pstOptions->szImageFilename)
+    snprintf(szImageFilename, sizeof(szImageFilename), "%s", pstOptions->szImageFilename);
+  else
+    snprintf(szImageFilename, sizeof(szImageFilename), "%s.%s", kszImage_Filename,
+             pstOptions->pstWriter->szExtension);
+
+  snprintf(szCueFilename, sizeof(szCueFilename), "%s", szImageFilename);
+
+  if (((pExtension = strrchr(szCueFilename, '.')) != NULL) && !strchr(pExtension, '/'))
+    *pExtension = 0;
+
+  if (strlen(szCueFilename) + 4 > MAX_FILENAME_LENGTH) {
+    fprintf(stderr, "DAEX: Maximum filename length exceeded.\n");
+    return -1;
+  }
+
+  strcat(szCueFilename, ".cue");
+
+  /* Create the cue sheet first, so as not to read the disc for nothing. */
+  if (((iCueDesc = open(szCueFilename, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) ||
+      ((fCueFile = fdopen(iCueDesc, "w")) == NULL)) {
+    fprintf(stderr, "DAEX: Unable to create cue sheet, \"%s\": %s.\n", szCueFilename,
+            strerror(errno));
+    return -1;
+  }
+
+  if ((iOutfileDesc = open(szImageFilename, ((pstOptions->iWriterPolicy & kiWriter_Mapped) ?
+                                             O_RDWR : O_WRONLY) | O_CREAT | O_EXCL, 0644)) < 0) {
+    fprintf(stderr, "DAEX: Unable to create image, \"%s\": %s.\n", szImageFilename,
+            strerror(errno));
+    fclose(fCueFile);
+    unlink(szCueFilename);
+    return -1;
+  }
+
+  /* Display the first part of the status. */
+  fprintf(stderr, "Current Tracks .. [ %i thru %i ]\n", iFirstTrack, iLastTrack);
+  fprintf(stderr, "Filename ........ [ %s ]\n", szImageFilename);
+  fprintf(stderr, "Cue Sheet ....... [ %s ]\n", szCueFilename);
+  fprintf(stderr, "Drive Speed ..... [ %s ]\n", pstDiscInformation->szDriveSpeed);
+
+  memset(&stAnalysis, 0, sizeof(stAnalysis));
+  stAnalysis.iSilenceThreshold = pstOptions->iSilenceThreshold;
+
+  fnAnalysis_Initialize(&stAnalysis, pstOptions->iAnalysisFlags);
+
+  /* Copy the audio to disk, in one go.  The last track ends the block
+   * before the next track (or the lead-out) starts.
+   */
+  iReturnValue = fnExtractAudio(iDeviceDesc, iOutfileDesc,
+                  pstDiscInformation->pstTrackData[iFirstTrack - 1].iFixedLBA_start,
+                  pstDiscInformation->pstTrackData[iLastTrack - 1].iFixedLBA_end - 1,
+                  &stAnalysis, 0, NULL, NULL, pstOptions->pstWriter,
+                  pstOptions->iWriterPolicy, pstOptions->llSyncInterval, NULL, NULL, 0);
+
+  close(iOutfileDesc);
+
+  /* Record the image's checksum, if the user asked for it. */
+  if ((iReturnValue == 0) && pstOptions->szChecksumFilename)
+    iReturnValue = fnWriteChecksum(pstOptions->szChecksumFilename, szImageFilename,
+                                   stAnalysis.lChecksum);
+
+  fnAnalysis_Dispose(&stAnalysis);
+
+  if (iReturnValue < 0) {
+    fclose(fCueFile);
+    unlink(szCueFilename);
+    return -1;
+  }
+
+  return fnWriteCueSheet(fCueFile, szImageFilename, pstDiscInformation, iFirstTrack,
+                         iLastTrack);
+}
+
+
 /*========================================================================*/
 void *
 fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
-                  int iCDDBquerying, int iInfoRequest, char *szCDDB_RemoteHost,
-                  int iCDDB_RemotePort, char *szOutputFilename)
+                  int iCDDBquerying, int iInfoRequest, char *szCDDB_Servers,
+                  char *szOutputFilename,
+                  struct ExtractionOptions_t *pstOptions)
 /*
  * Fill the disc information structure. 
  *
@@ -996,9 +2159,10 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
  *           iTrackNumber      - Track number user wishes to extract.
  *           iCDDBquerying     - CDDB querying flag (1 == CDDB queries, 0 == no CDDB)
  *           iInfoRequest      - Info file flag (1 == create info file, 0 == don't bother)
- *           szCDDB_RemoteHost - Remote CDDB server's hostname or IP.
- *           iCDDB_RemotePort  - Remote port the CDDB server is listening on.
+ *           szCDDB_Servers    - CDDB servers to try, "hostname:port[,...]", or
+ *                               NULL if the disc is only looked up in an index.
  *           szOutputFilename  - Filename for the user specified track.
+ *           pstOptions        - The user's extraction options.
  *
  * Returns:  The disc information structure. (DiscInformation_t)
  */
@@ -1009,9 +2173,16 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
 
   struct  DiscInformation_t  *pstDiscInformation;  /* Commonly used disc info  */
   struct  TrackInformation_t *pstTrackInformation; /* Commonly used track info */
+  struct  Arena_t            *pstArena;            /* Where it's all kept      */
 
   char    *szDriveSpeed;	                   /* Drive speed description  */
   char    szFilename_temp[kiMaxStringLength];      /* Temporary filename       */
+  char    szCacheKey[kiMaxStringLength],           /* The disc, in the cache   */
+          szCacheFilename[kiMaxStringLength],      /* ... and its entry        */
+          *szMetaFilename = NULL;                  /* ... if there's one       */
+  time_t  ltCached;                                /* When it was cached       */
+  int     iCached = 0;                             /* Cached or indexed?      */
+  int     iOverlap;                                /* Looked up meanwhile?     */
 
   int     iTrackIndex;                             /* Current track counter    */
 
@@ -1020,22 +2191,43 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
   fprintf(stderr, "FUNCTION: fnDiscInformation()\n");
 #endif
 
+  /* Tracks written to files can be extracted while the disc is looked up,
+   * and renamed afterwards.  Anything that is handed a track's name before
+   * it is extracted (an encoder, the ring, daex-recv), an image, or the
+   * info file, has to wait for the titles.
+   */
+  iOverlap = szCDDB_Servers && !iInfoRequest && (iTrackNumber >= 0) &&
+             (!szOutputFilename || (iTrackNumber == 0)) && !pstOptions->szEncoderCommand &&
+             !pstOptions->szRingName && !pstOptions->szSinkHost &&
+             !(pstOptions->pstWriter->iFlags & kiWriter_Image);
+
   /* Set the drive speed, and retrieve a string describing the current 
    * setting.
    */
   szDriveSpeed = (char *) fnSetSpeed(iDeviceDesc, iDriveSpeed);
 
+  /* Everything we learn about the disc is kept in its arena, and freed with
+   * it by fnDispose().
+   */
+  if (! (pstArena = (struct Arena_t *) malloc(sizeof(struct Arena_t)))) {
+    fprintf(stderr, "Unable to allocate sufficient memory for the disc's arena.\n");
+    return NULL;
+  }
+
+  fnArena_Initialize(pstArena);
+
   /* Read the Table of Contents header and retrieve starting and ending track numbers
    * so that we may determine the actual existance of the track specified by the user.
    */
-  pstTOCheader = (struct ioc_toc_header *) fnReadTOCheader(iDeviceDesc);
+  pstTOCheader = (struct ioc_toc_header *) fnReadTOCheader(iDeviceDesc, pstArena);
 
   /* Read the TOC entries, and grab the block information for the track. */
-  pstTOCentries = (struct ioc_read_toc_entry *) fnReadTOCentries(iDeviceDesc, pstTOCheader);
+  pstTOCentries = (struct ioc_read_toc_entry *) fnReadTOCentries(iDeviceDesc, pstTOCheader,
+                                                                 pstArena);
 
   /* Allocate memory for the disc information structure. */
   pstDiscInformation = (struct DiscInformation_t *)
-                       calloc(1, sizeof(struct DiscInformation_t));
+                       fnArena_Alloc(pstArena, sizeof(struct DiscInformation_t));
 
   if (!pstDiscInformation) {
     fprintf(stderr, "Unable to allocate sufficient memory for the disc information structure.\n");
@@ -1044,7 +2236,8 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
 
   /* Allocate memory for the track information array. */
   pstTrackInformation = (struct TrackInformation_t *)
-                        calloc(pstTOCheader->ending_track, sizeof(struct TrackInformation_t));
+                        fnArena_Alloc(pstArena, pstTOCheader->ending_track *
+                                                sizeof(struct TrackInformation_t));
 
   if (!pstTrackInformation) {
     fprintf(stderr,"Unable to allocate sufficient memory for the track information structure.\n");
@@ -1052,19 +2245,24 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
   }
 
   /* Fill the disc information structure. */
+  pstDiscInformation->pstArena      = pstArena;
   pstDiscInformation->pstTOCheader  = pstTOCheader;
   pstDiscInformation->pstTOCentries = pstTOCentries;
-  pstDiscInformation->szDriveSpeed  = strdup(szDriveSpeed);
+  pstDiscInformation->szDriveSpeed  = fnArena_Strdup(pstArena, szDriveSpeed);
+  pstDiscInformation->pstOptions    = pstOptions;
+
+  free(szDriveSpeed);
 
   if (!pstDiscInformation->szDriveSpeed) {
     fprintf(stderr, "DAEX: Unable to allocated sufficient memory for the drive speed string.\n");
     return NULL;
   }
 
-  if (iCDDBquerying) {
+  /* The rip cache is keyed by the CDDB disc ID, with or without a query. */
+  if (iCDDBquerying || pstOptions->szCacheDirectory) {
     /* Allocate memory for the CDDB information structure. */
     pstDiscInformation->pstCDDBinformation = (struct CDDBinformation_t *) 
-                                             calloc(1, sizeof(struct CDDBinformation_t));
+                                             fnArena_Alloc(pstArena, sizeof(struct CDDBinformation_t));
 
     if (!pstDiscInformation->pstCDDBinformation) {
       fprintf(stderr, "DAEX: Unable to allocate sufficient memory for the CDDB info structure.\n");
@@ -1095,29 +2293,26 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
      * not querying a CDDB server, generate the generic filename.
      *
      * We don't store the CDDB enhanced filenames when creating an info file, since we 
-     * assume the user will be doing this themselves.
+     * assume the user will be doing this themselves.  Tracks extracted while the disc
+     * is looked up are written under the generic filename until it's done.
      */
-    if ((iCDDBquerying && iInfoRequest) || (!iCDDBquerying)) { 
+    if ((iCDDBquerying && iInfoRequest) || (!iCDDBquerying) || iOverlap) { 
 
       /* Store the current track's generic filename.  If the filename will exceed the POSIX
        * limit, alert the user and exit.
        */
-      if (snprintf(szFilename_temp, kiMaxStringLength, "track-%02d.wav", iTrackIndex) >
-          MAX_FILENAME_LENGTH) {
+      if (snprintf(szFilename_temp, kiMaxStringLength, "track-%02d.%s", iTrackIndex,
+                   pstOptions->pstWriter->szExtension) > MAX_FILENAME_LENGTH) {
         fprintf(stderr, "DAEX: Maximum filename length exceeded.\n");
         return NULL;
       }
 
-      /* Allocate memory for the track's filename. Exit on error. */
-      if (! (pstTrackInformation[iTrackIndex - 1].szTrackFilename = (char *)
-             calloc(1, MAX_FILENAME_LENGTH + 1))) {
+      /* Copy the filename into the arena. Exit on error. */
+      if (! (pstTrackInformation[iTrackIndex - 1].szTrackFilename =
+             fnArena_Strdup(pstArena, szFilename_temp))) {
         fprintf(stderr, "Unable to allocate sufficient memory for the track filename.\n");
         return NULL;
       }
-
-      /* Copy the filename from the temporary variable the memory allocated above. */
-      memcpy(pstTrackInformation[iTrackIndex - 1].szTrackFilename, szFilename_temp,
-             strlen(szFilename_temp));
     }
  
     /* Subtract 150 frames from the track's starting and ending Logical Block Addresses 
@@ -1145,15 +2340,81 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
     }
   }
 
-  if (iCDDBquerying) {
+  /* A disc seen before takes its titles from the metadata cache, without
+   * waiting on the server.  An old entry is refreshed in the background.
+   */
+  if (iCDDBquerying && pstOptions->szMetaDirectory) {
+    fnCache_Key(szCacheKey, sizeof(szCacheKey), pstDiscInformation->pstCDDBinformation->szDiscID,
+                pstTOCheader, pstTOCentries);
+
+    if (snprintf(szCacheFilename, sizeof(szCacheFilename), "%s/%s.cddb", pstOptions->szMetaDirectory,
+                 szCacheKey) < (int) sizeof(szCacheFilename))
+      szMetaFilename = szCacheFilename;
+    else
+      fprintf(stderr, "DAEX: Unable to use the disc information cache: %s.\n\n",
+              strerror(ENAMETOOLONG));
+  }
+
+  if (szMetaFilename) {
+    if (fnCDDB_ReadCache(pstDiscInformation, szMetaFilename, &ltCached) == 0) {
+      fprintf(stderr, "DAEX: Disc information taken from the cache.\n\n");
+
+      if (!iInfoRequest && (fnCDDB_StoreFilenames(pstDiscInformation) < 0))
+        return NULL;
+
+      if ((time(NULL) - ltCached > kiCDDB_CacheAge) &&
+          (fnCDDB_RefreshCache(pstDiscInformation, szMetaFilename,
+                               szCDDB_Servers) < 0))
+        fprintf(stderr, "DAEX: Unable to refresh the cached disc information: %s.\n\n",
+                strerror(errno));
+
+      iCached = 1;
+    }
+  }
+
+  /* A disc in the freedb index is taken from it, without the network.
+   * Should it not be there, the servers are asked, if there are any.
+   */
+  if (!iCached && pstOptions->szIndexFilename) {
+    if (fnCDDB_ReadIndex(pstDiscInformation, pstOptions->szIndexFilename) == 0) {
+      fprintf(stderr, "DAEX: Disc information taken from the index (%s).\n\n",
+              pstDiscInformation->pstCDDBinformation->szDiscCategory);
+
+      if (!iInfoRequest && (fnCDDB_StoreFilenames(pstDiscInformation) < 0))
+        return NULL;
+
+      iCached = 1;
+
+    } else {
+      fprintf(stderr, "DAEX: Unable to find the disc (%s) in %s: %s.\n\n",
+              pstDiscInformation->pstCDDBinformation->szDiscID, pstOptions->szIndexFilename,
+              strerror(errno));
+
+      if (!szCDDB_Servers)  return NULL;
+    }
+  }
+
+  if (iCDDBquerying && !iCached && iOverlap) {
+    if ((pstDiscInformation->pstLookup =
+         fnCDDB_StartLookup(pstDiscInformation, szCDDB_Servers,
+                            szMetaFilename)))
+      fprintf(stderr, "DAEX: Looking the disc up while its tracks are extracted.\n\n");
+    else
+      fprintf(stderr, "DAEX: Unable to look the disc up in the background: %s.\n\n",
+              strerror(errno));
+  }
+
+  if (iCDDBquerying && !iCached && !pstDiscInformation->pstLookup) {
 #ifdef DEBUG
     fprintf(stderr, "DAEX: Attempting to query the CDDB server.\n");
 #endif
-    if (fnCDDB_DoCDDBQuery(pstDiscInformation, szCDDB_RemoteHost, iCDDB_RemotePort,
-        iInfoRequest) < 0) {
+    if (fnCDDB_DoCDDBQuery(pstDiscInformation, szCDDB_Servers, iInfoRequest) < 0) {
       /* Handle errors... */
       return NULL;
     }
+
+    if (szMetaFilename && (fnCDDB_WriteCache(pstDiscInformation, szMetaFilename) < 0))
+      fprintf(stderr, "DAEX: Unable to cache the disc information: %s.\n\n", strerror(errno));
   }
 
  /* If we're going to be extracting the entire disc (ie, the track specified is 0), 
@@ -1165,13 +2426,16 @@ fnDiscInformation(int iDeviceDesc, int iDriveSpeed, int iTrackNumber,
   * filename stored above for the track specified by the user (or assigned by default).
   */
 
-  if (iTrackNumber == 0) {
-    if (szOutputFilename)  free(szOutputFilename);
-  } else
-      if (szOutputFilename) {
-        free(pstTrackInformation[iTrackNumber - 1].szTrackFilename);
-        pstTrackInformation[iTrackNumber - 1].szTrackFilename = szOutputFilename;
-      }
+  if (szOutputFilename) {
+    if ((iTrackNumber != 0) &&
+        ! (pstTrackInformation[iTrackNumber - 1].szTrackFilename =
+           fnArena_Strdup(pstArena, szOutputFilename))) {
+      fprintf(stderr, "Unable to allocate sufficient memory for the track filename.\n");
+      return NULL;
+    }
+
+    free(szOutputFilename);
+  }
 
   return pstDiscInformation;
 }
@@ -1193,6 +2457,7 @@ fnDispose(int iDeviceDesc, char **szDeviceName, void **pvDiscInformation)
 /*========================================================================*/
 {
   struct DiscInformation_t *pstDiscInformation;  /* Disc information struct. */
+  struct Arena_t *pstArena;                      /* ... and its arena.       */
   int iTrackIndex;                               /* Current track count.     */
 
 
@@ -1202,46 +2467,71 @@ fnDispose(int iDeviceDesc, char **szDeviceName, void **pvDiscInformation)
   fprintf(stderr, "FUNCTION: fnDispose()\n");
 #endif
 
-  /* If CDDB information exists, free it. */
-  if (pstDiscInformation->pstCDDBinformation)
-    fnCDDB_FreeCDDBInformationStruct((void *) &pstDiscInformation->pstCDDBinformation,
-                                     pstDiscInformation->pstTOCheader->ending_track);
-
-  /* NOTE: If the output filename was specified (szOutputFilename), it will be freed 
-   * along with the track filenames (see fnDiscInformation() for more info).
-   */
-
-  /* Dispose of the track filenames. */
+  /* Dispose of the tracks' analysis results, which aren't kept in the arena. */
   for (iTrackIndex = pstDiscInformation->pstTOCheader->starting_track;
        iTrackIndex <= pstDiscInformation->pstTOCheader->ending_track;
        iTrackIndex++) {
-    free(pstDiscInformation->pstTrackData[iTrackIndex - 1].szTrackFilename);
-    pstDiscInformation->pstTrackData[iTrackIndex - 1].szTrackFilename = NULL;
+    if (pstDiscInformation->pstTrackData[iTrackIndex - 1].pstAnalysis) {
+      fnAnalysis_Dispose(pstDiscInformation->pstTrackData[iTrackIndex - 1].pstAnalysis);
+      free(pstDiscInformation->pstTrackData[iTrackIndex - 1].pstAnalysis);
+      pstDiscInformation->pstTrackData[iTrackIndex - 1].pstAnalysis = NULL;
+    }
   }
 
-  /* Dispose of the track data array. */
-  free(pstDiscInformation->pstTrackData);
-  pstDiscInformation->pstTrackData = NULL;
+  /* Dispose of the option strings. */
+  if (pstDiscInformation->pstOptions->szChecksumFilename) {
+    free(pstDiscInformation->pstOptions->szChecksumFilename);
+    pstDiscInformation->pstOptions->szChecksumFilename = NULL;
+  }
 
-  /* Dispose of the drive speed string. */
-  free(pstDiscInformation->szDriveSpeed);
-  pstDiscInformation->szDriveSpeed = NULL;
+  if (pstDiscInformation->pstOptions->szLoudnessFilename) {
+    free(pstDiscInformation->pstOptions->szLoudnessFilename);
+    pstDiscInformation->pstOptions->szLoudnessFilename = NULL;
+  }
 
-  /* Dispose of the TOC entries (the individual track information). */
-  free(pstDiscInformation->pstTOCentries->data);
-  pstDiscInformation->pstTOCentries->data = NULL;
+  if (pstDiscInformation->pstOptions->szImageFilename) {
+    free(pstDiscInformation->pstOptions->szImageFilename);
+    pstDiscInformation->pstOptions->szImageFilename = NULL;
+  }
 
-  /* Dispose of the TOC entries header. */
-  free(pstDiscInformation->pstTOCentries);
-  pstDiscInformation->pstTOCentries = NULL;
+  if (pstDiscInformation->pstOptions->szRingName) {
+    free(pstDiscInformation->pstOptions->szRingName);
+    pstDiscInformation->pstOptions->szRingName = NULL;
+  }
 
-  /* Dispose of the TOC header. */
-  free(pstDiscInformation->pstTOCheader);
-  pstDiscInformation->pstTOCheader = NULL;
+  if (pstDiscInformation->pstOptions->szSinkHost) {
+    free(pstDiscInformation->pstOptions->szSinkHost);
+    pstDiscInformation->pstOptions->szSinkHost = NULL;
+  }
+
+  if (pstDiscInformation->pstOptions->szCacheDirectory) {
+    free(pstDiscInformation->pstOptions->szCacheDirectory);
+    pstDiscInformation->pstOptions->szCacheDirectory = NULL;
+  }
 
-  /* Dispose of the disc information structure. */
-  free(pstDiscInformation);
-  pstDiscInformation = NULL;
+  if (pstDiscInformation->pstOptions->pstCache) {
+    free(pstDiscInformation->pstOptions->pstCache);
+    pstDiscInformation->pstOptions->pstCache = NULL;
+  }
+
+  if (pstDiscInformation->pstOptions->szMetaDirectory) {
+    free(pstDiscInformation->pstOptions->szMetaDirectory);
+    pstDiscInformation->pstOptions->szMetaDirectory = NULL;
+  }
+
+  if (pstDiscInformation->pstOptions->szIndexFilename) {
+    free(pstDiscInformation->pstOptions->szIndexFilename);
+    pstDiscInformation->pstOptions->szIndexFilename = NULL;
+  }
+
+  /* Dispose of the disc information structure, and with it the TOC, the
+   * track information, the CDDB information and the filenames, all of
+   * which are kept in its arena.
+   */
+  pstArena = pstDiscInformation->pstArena;
+  fnArena_Release(pstArena);
+  free(pstArena);
+  *pvDiscInformation = NULL;
 
   /* Dispose of the device name string. */
   free(*szDeviceName);
@@ -1256,10 +2546,12 @@ int
 main(int argc, char **argv)
 {
   struct DiscInformation_t *pstDiscInformation;  /* Disc information structure      */
+  struct ExtractionOptions_t stOptions;          /* User's extraction options       */
+  struct SampleFormat_t stRingFormat;            /* Format published to the ring    */
 
   char    *szDeviceName = NULL,	       /* Input device name                         */
           *szOutputFilename = NULL,    /* Output file name                          */
-          *szCDDB_RemoteHost = NULL,   /* Hostname used in CDDB queries             */
+          *szCDDB_Servers = NULL,      /* Servers used in CDDB queries              */
           *szInfoFilename = NULL;      /* Disc information output filename          */
 
   int     iDeviceDesc,		       /* File descriptor for the input device      */
@@ -1268,7 +2560,6 @@ main(int argc, char **argv)
   int     iDriveSpeed = -1,	       /* CD-ROM read speed (1 == 1x, 2 == 2x, etc) */
           iTrackNumber = -1,	       /* The current track number being extracted  */
           iCDDBquerying = 0,           /* CDDB querying flag (1 == yes, 0 == no)    */
-          iCDDB_RemotePort = 0,        /* Port number used in CDDB queries          */
           iSkipTracksWithErrors = 0;   /* Skip tracks with errors (don't exit)      */
 
   uid_t   utSavedUID;		       /* Saved UserID for the current process      */
@@ -1277,11 +2568,24 @@ main(int argc, char **argv)
   fprintf(stderr, "DAEX v%s - The Digital Audio EXtractor.\n", kszVersion);
   fprintf(stderr, "(c) Copyright 1998 Robert Mooney, All rights reserved.\n\n");
 
+  memset(&stOptions, 0, sizeof(stOptions));
+
+  stOptions.iOutputChannels  = 2;
+  stOptions.iOutputBits      = 16;
+  stOptions.iDither          = kiDither_TPDF;
+  stOptions.iOutputRate      = CDDA_SAMPLE_RATE;
+  stOptions.iResampleQuality = kiResample_Medium;
+  stOptions.pstWriter        = fnWriter_Find(NULL);
+  stOptions.iEncoderBudget   = (size_t) kiEncoder_DefaultBudget * 1024 * 1024;
+  stOptions.iRingLength      = (size_t) kiRing_DefaultLength * 1024 * 1024;
+  stOptions.iSinkPort        = kiNet_DefaultPort;
+  stOptions.iSinkWindow      = (size_t) kiNet_DefaultWindow * 1024 * 1024;
+
   /* Parse the user arguments and store in the appropriate variables. */
   fnRetrieveArguments(argc, argv, &szDeviceName, &szOutputFilename, 
                       &iTrackNumber, &iDriveSpeed, &iCDDBquerying, 
-                      &szCDDB_RemoteHost, &iCDDB_RemotePort, &iSkipTracksWithErrors,
-                      &szInfoFilename);
+                      &szCDDB_Servers, &iSkipTracksWithErrors,
+                      &szInfoFilename, &stOptions);
 
 #ifdef DEBUG
   fprintf(stderr, "Device               (user) : %s\n", szDeviceName);
@@ -1289,19 +2593,90 @@ main(int argc, char **argv)
   fprintf(stderr, "Drive speed          (user) : %i\n", iDriveSpeed);
   fprintf(stderr, "Track number         (user) : %i\n", iTrackNumber);
   fprintf(stderr, "CDDB querying        (user) : %i\n", iCDDBquerying);
-  fprintf(stderr, "CDDB remote host     (user) : %s\n", szCDDB_RemoteHost);
-  fprintf(stderr, "CDDB remote port     (user) : %i\n", iCDDB_RemotePort);
+  fprintf(stderr, "CDDB servers         (user) : %s\n", szCDDB_Servers);
   fprintf(stderr, "Skip tracks w/errors (user) : %i\n", iSkipTracksWithErrors);
-  fprintf(stderr, "Disc info filename   (user) : %s\n\n", szInfoFilename);
+  fprintf(stderr, "Disc info filename   (user) : %s\n", szInfoFilename);
+  fprintf(stderr, "Checksum filename    (user) : %s\n", stOptions.szChecksumFilename);
+  fprintf(stderr, "Loudness filename    (user) : %s\n", stOptions.szLoudnessFilename);
+  fprintf(stderr, "Analysis flags       (user) : %#x\n", stOptions.iAnalysisFlags);
+  fprintf(stderr, "Silence threshold    (user) : %i\n", stOptions.iSilenceThreshold);
+  fprintf(stderr, "Trim flags           (user) : %#x\n", stOptions.iTrimFlags);
+  fprintf(stderr, "De-emphasis          (user) : %i\n", stOptions.iDeemphasis);
+  fprintf(stderr, "Output format        (user) : %i ch, %i bits%s, dither %i\n",
+          stOptions.iOutputChannels, stOptions.iOutputBits,
+          stOptions.iOutputFloat ? " (float)" : "", stOptions.iDither);
+  fprintf(stderr, "Output rate          (user) : %i Hz, quality %i\n",
+          stOptions.iOutputRate, stOptions.iResampleQuality);
+  fprintf(stderr, "Output writer        (user) : %s, policy %#x, sync every %llu bytes\n\n",
+          stOptions.pstWriter->szName, stOptions.iWriterPolicy,
+          (unsigned long long) stOptions.llSyncInterval);
 #endif
 
 
   if (szInfoFilename && !iCDDBquerying)
     fnError(kiExitStatus_General, "You must specify CDDB querying to dump CDDB information.");
 
+  if (stOptions.szMetaDirectory && !szCDDB_Servers)
+    fnError(kiExitStatus_General, "You must specify CDDB servers (-c) to cache CDDB information.");
+
+  if (stOptions.iEncoderJobs && !stOptions.szEncoderCommand)
+    fnError(kiExitStatus_General, "You must specify an encoder command (-E) to run encoder jobs.");
+
   if ((iTrackNumber < 0) && (! (szInfoFilename && iCDDBquerying)))
     fnError(kiExitStatus_General, "You must specify a track number to extract.");
 
+  /* A disc image holds every track as it is on the disc, and the cue sheet
+   * says where each one starts.  The output filename names the image.
+   */
+  if (stOptions.pstWriter->iFlags & kiWriter_Image) {
+    if (iTrackNumber > 0)
+      fnError(kiExitStatus_General, "A disc image (-w %s) holds the whole disc.  Use -t 0.",
+              stOptions.pstWriter->szName);
+
+    if ((stOptions.iOutputChannels != 2) || (stOptions.iOutputBits != 16) ||
+        (stOptions.iOutputRate != CDDA_SAMPLE_RATE) || stOptions.iDeemphasis)
+      fnError(kiExitStatus_General, "A disc image is written as it is on the disc (no -b, -e, -f or -m).");
+
+    if (stOptions.iTrimFlags || stOptions.szLoudnessFilename || stOptions.szEncoderCommand)
+      fnError(kiExitStatus_General, "A disc image has no separate tracks to trim (-r), measure (-g) or encode (-E).");
+
+    if (szOutputFilename && (strcmp(szOutputFilename, "-") == 0))
+      fnError(kiExitStatus_General, "A disc image must be written to a file, beside its cue sheet.");
+
+    stOptions.szImageFilename = szOutputFilename;
+    szOutputFilename          = NULL;
+  }
+
+  /* A ring takes the tracks one after another, as a pipe would, in place
+   * of the output files.
+   */
+  if (stOptions.szRingName) {
+    if (stOptions.szEncoderCommand || (stOptions.pstWriter->iFlags & kiWriter_Image))
+      fnError(kiExitStatus_General, "A ring (-M) takes the place of output files; it can't be used with -E or -w %s.",
+              stOptions.pstWriter->szName);
+
+    if (stOptions.iTrimFlags & kiTrim_Trailing)
+      fnError(kiExitStatus_General, "Trailing silence can't be trimmed (-r) when publishing to a ring.");
+  }
+
+  /* ... and so does a network sink. */
+  if (stOptions.szSinkHost) {
+    if (stOptions.szEncoderCommand || stOptions.szRingName ||
+        (stOptions.pstWriter->iFlags & kiWriter_Image))
+      fnError(kiExitStatus_General, "A network sink (-N) takes the place of output files; it can't be used with -E, -M or -w %s.",
+              stOptions.pstWriter->szName);
+
+    if (stOptions.iTrimFlags & kiTrim_Trailing)
+      fnError(kiExitStatus_General, "Trailing silence can't be trimmed (-r) when sending to daex-recv.");
+  }
+
+  /* The rip cache holds output files, linked beside them. */
+  if (stOptions.szCacheDirectory &&
+      (stOptions.szEncoderCommand || stOptions.szRingName || stOptions.szSinkHost ||
+       (stOptions.pstWriter->iFlags & kiWriter_Image)))
+    fnError(kiExitStatus_General, "The rip cache (-C) keeps output files; it can't be used with -E, -M, -N or -w %s.",
+            stOptions.pstWriter->szName);
+
   /* Setup the defaults if we're missing information. */
   fnSanitizeArguments(&szDeviceName);
 
@@ -1318,17 +2693,85 @@ main(int argc, char **argv)
   /* Relinquish superuser privileges */
   fnSetPrivileges(kiRelPrivilege, &utSavedUID);
 
+  /* Build the checksum tables before the first track is read, or the disc
+   * looked up in the metadata cache.
+   */
+  fnCRC_Initialize();
+
   /* Gather information about the disc, and the track(s) we are going to extract 
    * and store it in the pstDiscInformation structure.
    */
   pstDiscInformation = 
     (struct DiscInformation_t *) fnDiscInformation(iDeviceDesc, iDriveSpeed,
-    iTrackNumber, iCDDBquerying, szInfoFilename ? 1 : 0, szCDDB_RemoteHost, iCDDB_RemotePort, 
-    szOutputFilename);
+    iTrackNumber, iCDDBquerying, szInfoFilename ? 1 : 0, szCDDB_Servers, 
+    szOutputFilename, &stOptions);
 
   if (!pstDiscInformation)
     fnError(kiExitStatus_General, "Unable to retrieve disc information.");
 
+  /* Start the encoder pool, which takes each track as it is extracted. */
+  if (stOptions.szEncoderCommand && (iTrackNumber >= 0)) {
+    if (! (stOptions.pstEncoders = (struct EncoderPool_t *) malloc(sizeof(struct EncoderPool_t))))
+      fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the encoders.");
+
+    if (fnEncoder_Initialize(stOptions.pstEncoders, stOptions.szEncoderCommand,
+                             stOptions.iEncoderJobs, stOptions.iEncoderBudget) < 0)
+      fnError(kiExitStatus_General, "Unable to start the encoders: %s.", strerror(errno));
+  }
+
+  /* Create the ring, and let a reader attach before the first track. */
+  if (stOptions.szRingName && (iTrackNumber >= 0)) {
+    stRingFormat.iChannels      = stOptions.iOutputChannels;
+    stRingFormat.iBitsPerSample = stOptions.iOutputBits;
+    stRingFormat.iFloat         = stOptions.iOutputFloat;
+    stRingFormat.iSampleRate    = stOptions.iOutputRate;
+
+    if (! (stOptions.pstRing = (struct SharedRing_t *) malloc(sizeof(struct SharedRing_t))))
+      fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the ring.");
+
+    if (fnRing_Create(stOptions.pstRing, stOptions.szRingName, stOptions.iRingLength,
+                      stOptions.iRingPolicy, &stRingFormat, stOptions.pstWriter->szName) < 0)
+      fnError(kiExitStatus_General, "Unable to create the ring \"%s\": %s.", stOptions.szRingName,
+              strerror(errno));
+
+    if (stOptions.iRingPolicy == kiRing_Block) {
+      fprintf(stderr, "DAEX: Waiting for a reader to attach to the ring \"%s\".\n",
+              stOptions.szRingName);
+      fnRing_WaitForReader(stOptions.pstRing);
+    }
+  }
+
+  /* Find the disc's entry in the rip cache. */
+  if (stOptions.szCacheDirectory && (iTrackNumber >= 0)) {
+    if (! (stOptions.pstCache = (struct RipCache_t *) malloc(sizeof(struct RipCache_t))))
+      fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the rip cache.");
+
+    if (fnCache_Open(stOptions.pstCache, stOptions.szCacheDirectory,
+                     pstDiscInformation->pstCDDBinformation->szDiscID,
+                     pstDiscInformation->pstTOCheader, pstDiscInformation->pstTOCentries) < 0) {
+      /* A name too long for the cache only means the cache goes unused. */
+      if (errno != ENAMETOOLONG)
+        fnError(kiExitStatus_General, "Unable to open the rip cache \"%s\": %s.",
+                stOptions.szCacheDirectory, strerror(errno));
+
+      fprintf(stderr, "DAEX: Unable to use the rip cache \"%s\": %s.\n\n",
+              stOptions.szCacheDirectory, strerror(errno));
+      free(stOptions.pstCache);
+      stOptions.pstCache = NULL;
+    }
+  }
+
+  /* Connect to daex-recv before the first track is read. */
+  if (stOptions.szSinkHost && (iTrackNumber >= 0)) {
+    if (! (stOptions.pstSink = (struct NetSink_t *) malloc(sizeof(struct NetSink_t))))
+      fnError(kiExitStatus_General, "Unable to allocate sufficient memory for the network sink.");
+
+    if (fnNet_Initialize(stOptions.pstSink, stOptions.szSinkHost, stOptions.iSinkPort,
+                         stOptions.iSinkWindow) < 0)
+      fnError(kiExitStatus_General, "Unable to connect to daex-recv at %s:%i: %s.",
+              stOptions.szSinkHost, stOptions.iSinkPort, strerror(errno));
+  }
+
   /* If the user requested CDDB querying and a CDDB dump file, dump the information
    * gather from fnDiscInformation().  Exit on error.
    */
@@ -1342,8 +2785,13 @@ main(int argc, char **argv)
   if (iTrackNumber >= 0) {
     fprintf(stderr, "DAEX: Beginning the extraction process.\n\n");
 
+    /* A disc image is extracted in one pass. */
+    if (stOptions.pstWriter->iFlags & kiWriter_Image) {
+      if (fnProcessImage(iDeviceDesc, pstDiscInformation) < 0)
+        fnError(kiExitStatus_General, "DAEX: Unrecoverable error.");
+
     /* If the track number specified was 0, we must be extracting the whole disc. */
-    if (iTrackNumber == 0) {
+    } else if (iTrackNumber == 0) {
 
      /* Cycle through the available tracks and extract them. */
      for (iTrackIndex = pstDiscInformation->pstTOCheader->starting_track; 
@@ -1373,12 +2821,50 @@ main(int argc, char **argv)
          fnError(kiExitStatus_General, "DAEX: Unrecoverable error.");
        }
 
+     /* With every track in hand, the album's loudness can be measured. */
+     if (stOptions.szLoudnessFilename)
+       if (fnWriteLoudness(stOptions.szLoudnessFilename, pstDiscInformation, 0) < 0)
+         fnError(kiExitStatus_General, "DAEX: Unrecoverable error.");
+
     } else
       /* Extract the specified track. */
       if (fnProcessTrack(iDeviceDesc, pstDiscInformation, iTrackNumber) < 0)
         fnError(kiExitStatus_General, "DAEX: Unrecoverable error.");
   }
 
+  /* Should no track have been finished, the lookup is still to be waited for. */
+  if (pstDiscInformation->pstLookup && (fnTakeTitles(pstDiscInformation) < 0))
+    fnError(kiExitStatus_General, "DAEX: Unrecoverable error.");
+
+  /* Nothing more goes in the ring, but its readers may still be busy. */
+  if (stOptions.pstRing) {
+    if (stOptions.iRingPolicy == kiRing_Block)
+      fprintf(stderr, "DAEX: Waiting for the ring's readers to finish.\n");
+
+    fnRing_Close(stOptions.pstRing);
+    free(stOptions.pstRing);
+  }
+
+  if (stOptions.pstSink) {
+    fnNet_Dispose(stOptions.pstSink);
+    free(stOptions.pstSink);
+  }
+
+  /* The disc is done with, but the encoders may not be. */
+  if (stOptions.pstEncoders) {
+    fprintf(stderr, "DAEX: Waiting for the encoders to finish.\n");
+
+    iReturnValue = fnEncoder_Finish(stOptions.pstEncoders);
+
+    fnEncoder_Dispose(stOptions.pstEncoders);
+    free(stOptions.pstEncoders);
+    free(stOptions.szEncoderCommand);
+
+    if (iReturnValue > 0)
+      fnError(kiExitStatus_General, "DAEX: %i encoder%s failed.", iReturnValue,
+              (iReturnValue == 1) ? "" : "s");
+  }
+
   /* Reset the drive speed to the maximum attainable speed, assuming
    * we actually set it above.
    */
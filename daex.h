@@ -44,6 +44,7 @@
 #undef  DEBUG				/* Define for DEBUG mode                   */
 
 #define CDDA_DATA_LENGTH	2352	/* CDDA data segment size                  */
+#define CDDA_SAMPLE_RATE	44100	/* CDDA sample rate (Hz)                    */
 #define MAX_FILENAME_LENGTH     255     /* Max filename length defined by POSIX    */
 
 #define CDIO_PRE_EMPHASIS       0x01    /* ON: premphasis, OFF: no premphasis      */
@@ -54,7 +55,10 @@
 #define kiExitStatus_General	1	/* Exit with this code upon error          */
 #define kiMaxStringLength	1024	/* Maximum string length                   */
 
-#define kiHeaderWAVE		0	/* Wave header flag                        */
+#define kiTrim_Leading		0x01	/* Trim silence before the first sound     */
+#define kiTrim_Trailing		0x02	/* Trim silence after the last sound       */
+
+#define kszImage_Filename	"disc"	/* Disc image's name, unless given by -o   */
 
 #define kiSetPrivilege		0	/* Internal set privilege flags            */
 #define kiRelPrivilege		1	/* Internal release priv. flag             */
@@ -81,7 +85,13 @@ struct DiscInformation_t {
   struct CDDBinformation_t  *pstCDDBinformation; /* Disc information structure     */
   struct TrackInformation_t *pstTrackData;   /* Individual track information       */
 
+  struct ExtractionOptions_t *pstOptions;    /* User selected extraction options   */
+
   char *szDriveSpeed;                        /* Drive speed description string     */
+
+  struct Arena_t *pstArena;                  /* Where all of the above is kept     */
+
+  struct CDDBlookup_t *pstLookup;            /* A lookup still running, or NULL    */
 };
 
 /* Track structure which contains various information used in the extraction
@@ -90,9 +100,51 @@ struct DiscInformation_t {
 struct TrackInformation_t {
   int iTrackNumber;                 /* The track number to extract                 */
   char *szTrackFilename;            /* Track's output file name                    */
+  int  iProvisional;                /* ... which awaits the disc's titles (flag)   */
+  int  iFinished;                   /* ... and was written whole (flag)            */
 
   int iFixedLBA_start,              /* Track's starting LBA                        */
       iFixedLBA_end;                /* Track's ending LBA                          */
+
+  struct AudioAnalysis_t *pstAnalysis; /* Results of the track's analyses         */
+};
+
+/* Extraction options structure which contains the user's choices that affect
+ * how the audio is processed and where it ends up.
+ */
+struct ExtractionOptions_t {
+  char *szChecksumFilename;         /* Append track checksums to this file         */
+  char *szLoudnessFilename;         /* Append track/album loudness to this file    */
+  int  iAnalysisFlags;              /* Analyses to run on each track (kiAnalysis_*) */
+  int  iSilenceThreshold;           /* Largest sample counted as silence           */
+  int  iTrimFlags;                  /* Silence to trim from the output (kiTrim_*)  */
+  int  iDeemphasis;                 /* De-emphasise pre-emphasised tracks (flag)   */
+  int  iOutputChannels,             /* Channels written: 1 = mono, 2 = stereo      */
+       iOutputBits,                 /* Bits per sample written                     */
+       iOutputFloat,                /* Samples written as IEEE floats (flag)       */
+       iDither;                     /* Dither when reducing bits (kiDither_*)      */
+  int  iOutputRate,                 /* Sample rate written (Hz)                    */
+       iResampleQuality;            /* Resampling quality (kiResample_*)           */
+  struct AudioWriter_t *pstWriter;  /* Output file format                          */
+  int  iWriterPolicy;               /* How output files are written (kiWriter_*)   */
+  u_int64_t llSyncInterval;         /* Bytes between fdatasync()s, or 0            */
+  char *szEncoderCommand;           /* Pipe each track to this command, or NULL    */
+  int  iEncoderJobs;                /* Encoders run at once, or 0 for one per CPU  */
+  size_t iEncoderBudget;            /* Bytes held while the encoders are busy      */
+  struct EncoderPool_t *pstEncoders; /* The encoders, with szEncoderCommand        */
+  char *szImageFilename;            /* Whole-disc image (-w bin), or NULL          */
+  char *szRingName;                 /* Publish to this shared memory ring, or NULL */
+  size_t iRingLength;               /* Bytes of the ring's slots                   */
+  int  iRingPolicy;                 /* When the ring is full (kiRing_*)            */
+  struct SharedRing_t *pstRing;     /* The ring, with szRingName                   */
+  char *szSinkHost;                 /* Send the tracks to daex-recv here, or NULL  */
+  int  iSinkPort;                   /* ... on this port                            */
+  size_t iSinkWindow;               /* Bytes sent ahead of its acknowledgements    */
+  struct NetSink_t *pstSink;        /* The connection, with szSinkHost             */
+  char *szCacheDirectory;           /* Rip cache directory, or NULL                */
+  struct RipCache_t *pstCache;      /* This disc's entry in it                     */
+  char *szMetaDirectory;            /* Cache CDDB replies here, or NULL            */
+  char *szIndexFilename;            /* Look discs up in this freedb index, or NULL */
 };
 
 /* EOF */
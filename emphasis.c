@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * emphasis.c - De-emphasis of tracks mastered with 50/15 us pre-emphasis
+ *              (flagged by CDIO_PRE_EMPHASIS in the TOC), applied in place
+ *              to each block as it is read.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "emphasis.h"
+
+
+/*========================================================================*/
+void
+fnEmphasis_Initialize(struct EmphasisFilter_t *pstFilter, int iSampleRate)
+/*
+ * Design the de-emphasis filter and clear its state.  A first order
+ * bilinear transform of the 50/15 us network is off by up to 1 dB in the
+ * top octave at 44.1 kHz, so a second order shelf fitted to the analog
+ * curve is used instead (Audio EQ Cookbook form).
+ *
+ *   Input:  pstFilter   - The filter.
+ *           iSampleRate - Sample rate of the audio, in Hz.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  double dA,					/* Amplitude (sqrt of gain)  */
+         dOmega,				/* Shelf frequency (radians) */
+         dAlpha,				/* Shelf slope term          */
+         dCos,					/* cos(dOmega)               */
+         dNorm;					/* Normalisation (1 / a0)    */
+
+
+  memset(pstFilter, 0, sizeof(struct EmphasisFilter_t));
+
+  dA     = pow(10.0, kdEmphasis_ShelfGain / 40.0);
+  dOmega = 2.0 * M_PI * kdEmphasis_ShelfFrequency / iSampleRate;
+  dCos   = cos(dOmega);
+  dAlpha = sin(dOmega) / 2.0 *
+           sqrt((dA + 1.0 / dA) * (1.0 / kdEmphasis_ShelfSlope - 1.0) + 2.0);
+  dNorm  = 1.0 / ((dA + 1.0) - (dA - 1.0) * dCos + 2.0 * sqrt(dA) * dAlpha);
+
+  pstFilter->adB[0] = dA * ((dA + 1.0) + (dA - 1.0) * dCos + 2.0 * sqrt(dA) * dAlpha) * dNorm;
+  pstFilter->adB[1] = -2.0 * dA * ((dA - 1.0) + (dA + 1.0) * dCos) * dNorm;
+  pstFilter->adB[2] = dA * ((dA + 1.0) + (dA - 1.0) * dCos - 2.0 * sqrt(dA) * dAlpha) * dNorm;
+  pstFilter->adA[0] = 1.0;
+  pstFilter->adA[1] = 2.0 * ((dA - 1.0) - (dA + 1.0) * dCos) * dNorm;
+  pstFilter->adA[2] = ((dA + 1.0) - (dA - 1.0) * dCos - 2.0 * sqrt(dA) * dAlpha) * dNorm;
+}
+
+
+/*========================================================================*/
+void
+fnEmphasis_ProcessBuffer(struct EmphasisFilter_t *pstFilter, void *pvBuffer, size_t iLength)
+/*
+ * De-emphasise a buffer of 16 bit, little-endian, stereo CDDA in place.
+ * With SSE2 the left and right samples of each frame are filtered as one
+ * vector, and converted back to 16 bits with rounding and saturation in
+ * two instructions.
+ *
+ *   Input:  pstFilter - The filter.
+ *           pvBuffer  - The audio data.
+ *           iLength   - Bytes in pvBuffer (a multiple of 4).
+ *
+ * Returns:  pvBuffer  - The de-emphasised audio.
+ */
+/*========================================================================*/
+{
+  u_char *pBuffer;				/* Current frame             */
+  size_t iFrame;				/* Current frame number      */
+
+#ifdef __SSE2__
+  __m128d vInput,				/* [left, right] input       */
+          vOutput,				/* [left, right] output      */
+          vZ1, vZ2,				/* Filter state              */
+          vB0, vB1, vB2,			/* Numerator                 */
+          vA1, vA2;				/* Denominator               */
+  __m128i vRounded;				/* Output as 32 bit integers */
+  int     iLeft,				/* Rounded left sample       */
+          iRight,				/* Rounded right sample      */
+          iPacked;				/* Both samples, saturated   */
+
+
+  vB0 = _mm_set1_pd(pstFilter->adB[0]);
+  vB1 = _mm_set1_pd(pstFilter->adB[1]);
+  vB2 = _mm_set1_pd(pstFilter->adB[2]);
+  vA1 = _mm_set1_pd(pstFilter->adA[1]);
+  vA2 = _mm_set1_pd(pstFilter->adA[2]);
+  vZ1 = _mm_loadu_pd(pstFilter->adState[0]);
+  vZ2 = _mm_loadu_pd(pstFilter->adState[1]);
+
+  for (pBuffer = (u_char *) pvBuffer, iFrame = 0; iFrame < iLength / 4; iFrame++, pBuffer += 4) {
+    vInput = _mm_set_pd((int16_t) (pBuffer[2] | pBuffer[3] << 8),
+                        (int16_t) (pBuffer[0] | pBuffer[1] << 8));
+
+    /* Transposed direct form II. */
+    vOutput = _mm_add_pd(_mm_mul_pd(vB0, vInput), vZ1);
+    vZ1     = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(vB1, vInput), _mm_mul_pd(vA1, vOutput)), vZ2);
+    vZ2     = _mm_sub_pd(_mm_mul_pd(vB2, vInput), _mm_mul_pd(vA2, vOutput));
+
+    /* Round (the default rounding mode is to nearest) and saturate. */
+    vRounded = _mm_cvtpd_epi32(vOutput);
+    iPacked  = _mm_cvtsi128_si32(_mm_packs_epi32(vRounded, vRounded));
+
+    iLeft  = _mm_cvtsi128_si32(vRounded);
+    iRight = _mm_cvtsi128_si32(_mm_srli_si128(vRounded, 4));
+
+    pstFilter->lClippedSamples += (iLeft  > 32767) || (iLeft  < -32768);
+    pstFilter->lClippedSamples += (iRight > 32767) || (iRight < -32768);
+
+    pBuffer[0] = iPacked & 0xff;
+    pBuffer[1] = (iPacked >> 8) & 0xff;
+    pBuffer[2] = (iPacked >> 16) & 0xff;
+    pBuffer[3] = (iPacked >> 24) & 0xff;
+  }
+
+  _mm_storeu_pd(pstFilter->adState[0], vZ1);
+  _mm_storeu_pd(pstFilter->adState[1], vZ2);
+
+#else
+  double dInput,				/* Current input sample      */
+         dOutput;				/* Current output sample     */
+  long   lOutput;				/* Rounded output sample     */
+  int    iChannel;				/* Current channel           */
+
+
+  for (pBuffer = (u_char *) pvBuffer, iFrame = 0; iFrame < iLength / 4; iFrame++)
+    for (iChannel = 0; iChannel < 2; iChannel++, pBuffer += 2) {
+      dInput  = (int16_t) (pBuffer[0] | pBuffer[1] << 8);
+      dOutput = pstFilter->adB[0] * dInput + pstFilter->adState[0][iChannel];
+
+      pstFilter->adState[0][iChannel] = pstFilter->adB[1] * dInput -
+                                        pstFilter->adA[1] * dOutput +
+                                        pstFilter->adState[1][iChannel];
+      pstFilter->adState[1][iChannel] = pstFilter->adB[2] * dInput -
+                                        pstFilter->adA[2] * dOutput;
+
+      lOutput = lrint(dOutput);
+
+      if (lOutput > 32767)   { lOutput = 32767;   pstFilter->lClippedSamples++; }
+      if (lOutput < -32768)  { lOutput = -32768;  pstFilter->lClippedSamples++; }
+
+      pBuffer[0] = lOutput & 0xff;
+      pBuffer[1] = (lOutput >> 8) & 0xff;
+    }
+#endif
+}
+
+/* EOF */
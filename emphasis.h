@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * emphasis.h - Header for the de-emphasis filter.
+ *
+ * $Id$
+ */
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* A high shelf fitted to the 50/15 us de-emphasis curve at 44.1 kHz, which
+ * it follows to within 0.07 dB from DC to 20 kHz.
+ */
+#define kdEmphasis_ShelfFrequency	5283.0	/* Hz                                      */
+#define kdEmphasis_ShelfGain		-9.477	/* dB                                      */
+#define kdEmphasis_ShelfSlope		0.4845	/* Shelf slope (1.0 == steepest monotonic) */
+
+/* State of the de-emphasis filter for one track.  Coefficients and state are
+ * kept so that both channels are filtered together.
+ */
+struct EmphasisFilter_t {
+  double adB[3],                    /* Numerator                                   */
+         adA[3];                    /* Denominator (adA[0] == 1)                   */
+  double adState[2][2];             /* [z1, z2][channel]                           */
+  u_long lClippedSamples;           /* Samples clipped to full scale               */
+};
+
+/* De-emphasis function prototypes. */
+void fnEmphasis_Initialize(struct EmphasisFilter_t *pstFilter, int iSampleRate);
+void fnEmphasis_ProcessBuffer(struct EmphasisFilter_t *pstFilter, void *pvBuffer, size_t iLength);
+
+/* EOF */
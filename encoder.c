@@ -0,0 +1,620 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX      - The Digital Audio EXtractor
+ *
+ * encoder.c - External encoder pool.  Each track is written into a pipe
+ *             as if to an encoder reading the standard output; a pump
+ *             thread reads the pipes into memory and feeds each track to
+ *             its own encoder (/bin/sh -c command), several at once.  The
+ *             drive keeps reading while the encoders are busy, until the
+ *             memory budget is spent.
+ *
+ * $Id$
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE			/* pipe2()                           */
+#endif
+
+#include "daex.h"
+#include "encoder.h"
+
+extern char **environ;
+
+
+/*========================================================================*/
+int
+fnEncoder_Spawn(struct EncoderJob_t *pstJob, char *szCommand)
+/*
+ * Start a job's encoder, with the track's number and filename in its
+ * environment (DAEX_TRACK and DAEX_FILENAME) and a pipe from us as its
+ * standard input.  Everything else is inherited.
+ *
+ *   Input:  pstJob    - The job.
+ *           szCommand - The command, for /bin/sh.
+ *
+ * Returns:  -1 if the encoder could not be started (see errno), 0
+ *           otherwise.
+ */
+/*========================================================================*/
+{
+  char   **aszEnvironment,			/* The encoder's environment */
+         *aszArguments[4],			/* ... and arguments         */
+         szTrack[32],				/* DAEX_TRACK=               */
+         *szFilename;				/* DAEX_FILENAME=            */
+  int    aiPipe[2],				/* To the encoder            */
+         iCount,				/* Variables inherited       */
+         iError;				/* errno, kept across cleanup */
+
+
+  /* Built before the fork: the child may only exec. */
+  for (iCount = 0; environ[iCount]; iCount++);
+
+  if (! (aszEnvironment = (char **) malloc((iCount + 3) * sizeof(char *))))
+    return -1;
+
+  if (! (szFilename = (char *) malloc(strlen(pstJob->szFilename) + sizeof("DAEX_FILENAME=")))) {
+    free(aszEnvironment);
+    return -1;
+  }
+
+  memcpy(aszEnvironment, environ, iCount * sizeof(char *));
+
+  snprintf(szTrack, sizeof(szTrack), "DAEX_TRACK=%02i", pstJob->iTrack);
+  sprintf(szFilename, "DAEX_FILENAME=%s", pstJob->szFilename);
+
+  aszEnvironment[iCount++] = szTrack;
+  aszEnvironment[iCount++] = szFilename;
+  aszEnvironment[iCount]   = NULL;
+
+  aszArguments[0] = "sh";
+  aszArguments[1] = "-c";
+  aszArguments[2] = szCommand;
+  aszArguments[3] = NULL;
+
+  /* Close-on-exec, so that no encoder holds another's pipe open. */
+  if (pipe2(aiPipe, O_CLOEXEC) < 0) {
+    iError = errno;
+    free(szFilename);
+    free(aszEnvironment);
+    errno = iError;
+    return -1;
+  }
+
+  if ((pstJob->tProcess = fork()) == 0) {
+    dup2(aiPipe[0], STDIN_FILENO);
+    signal(SIGPIPE, SIG_DFL);
+    execve("/bin/sh", aszArguments, aszEnvironment);
+    _exit(127);
+  }
+
+  iError = errno;
+
+  free(szFilename);
+  free(aszEnvironment);
+  close(aiPipe[0]);
+
+  if (pstJob->tProcess < 0) {
+    close(aiPipe[1]);
+    errno = iError;
+    return -1;
+  }
+
+  /* Fed only as much as it will take at a time. */
+  fcntl(aiPipe[1], F_SETFL, fcntl(aiPipe[1], F_GETFL) | O_NONBLOCK);
+
+  pstJob->iOutput = aiPipe[1];
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnEncoder_Drop(struct EncoderPool_t *pstPool, struct EncoderJob_t *pstJob)
+/*
+ * Free a job's spooled audio.
+ */
+/*========================================================================*/
+{
+  struct EncoderChunk_t *pstChunk;		/* Current piece             */
+
+
+  while ((pstChunk = pstJob->pstHead) != NULL) {
+    pstJob->pstHead = pstChunk->pstNext;
+    pstPool->iSpooled -= pstChunk->iLength - pstChunk->iSent;
+
+    free(pstChunk->pData);
+    free(pstChunk);
+  }
+
+  pstJob->pstTail = NULL;
+}
+
+
+/*========================================================================*/
+void
+fnEncoder_Read(struct EncoderPool_t *pstPool, struct EncoderJob_t *pstJob)
+/*
+ * Read what DAEX has written of a track into its spool.  Should its
+ * encoder have failed, the audio is read and thrown away, so that DAEX
+ * can go on to the next track.
+ *
+ *   Input:  pstPool - The pool.
+ *           pstJob  - The job, with input waiting.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  struct EncoderChunk_t *pstChunk;		/* Piece being filled        */
+  u_char  aDiscard[16384];			/* Audio no-one wants        */
+  ssize_t iRead;				/* Bytes read                */
+
+
+  if ((pstJob->iState != kiEncoder_Queued) && (pstJob->iState != kiEncoder_Running))
+    iRead = read(pstJob->iInput, aDiscard, sizeof(aDiscard));
+  else {
+    if (!pstJob->pstTail || (pstJob->pstTail->iLength == kiEncoder_ChunkLength)) {
+      if (! (pstChunk = (struct EncoderChunk_t *) calloc(1, sizeof(struct EncoderChunk_t))))
+        return;
+
+      if (! (pstChunk->pData = (u_char *) malloc(kiEncoder_ChunkLength))) {
+        free(pstChunk);
+        return;
+      }
+
+      if (pstJob->pstTail)  pstJob->pstTail->pstNext = pstChunk;
+      else                  pstJob->pstHead = pstChunk;
+
+      pstJob->pstTail = pstChunk;
+    }
+
+    pstChunk = pstJob->pstTail;
+
+    if ((iRead = read(pstJob->iInput, pstChunk->pData + pstChunk->iLength,
+                      kiEncoder_ChunkLength - pstChunk->iLength)) > 0) {
+      pstChunk->iLength += iRead;
+      pstPool->iSpooled += iRead;
+    }
+  }
+
+  /* The end of the track (or of DAEX). */
+  if ((iRead == 0) || ((iRead < 0) && (errno != EAGAIN) && (errno != EINTR))) {
+    close(pstJob->iInput);
+    pstJob->iInput = -1;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnEncoder_Feed(struct EncoderPool_t *pstPool, struct EncoderJob_t *pstJob)
+/*
+ * Give a job's encoder as much of its spool as it will take.  An encoder
+ * which has gone away is given no more.
+ *
+ *   Input:  pstPool - The pool.
+ *           pstJob  - The job, running, with audio spooled.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  struct EncoderChunk_t *pstChunk;		/* Oldest piece              */
+  ssize_t iWritten;				/* Bytes written             */
+
+
+  while ((pstChunk = pstJob->pstHead) != NULL) {
+    iWritten = write(pstJob->iOutput, pstChunk->pData + pstChunk->iSent,
+                     pstChunk->iLength - pstChunk->iSent);
+
+    if (iWritten < 0) {
+      if ((errno == EAGAIN) || (errno == EINTR))  return;
+
+      fnEncoder_Drop(pstPool, pstJob);
+      close(pstJob->iOutput);
+
+      pstJob->iOutput = -1;
+      pstJob->iState  = kiEncoder_Closed;
+      return;
+    }
+
+    pstChunk->iSent   += iWritten;
+    pstPool->iSpooled -= iWritten;
+
+    /* The piece being filled stays, even once it has all been sent. */
+    if ((pstChunk->iSent < pstChunk->iLength) || (pstChunk == pstJob->pstTail))
+      return;
+
+    pstJob->pstHead = pstChunk->pstNext;
+
+    free(pstChunk->pData);
+    free(pstChunk);
+  }
+}
+
+
+/*========================================================================*/
+void *
+fnEncoder_Pump(void *pvPool)
+/*
+ * The pump thread.  Each time round: collect the encoders which have
+ * exited, start encoders for queued jobs while there are slots free (in
+ * track order), close the input of those fed in full, then wait for DAEX
+ * to write or an encoder to read.  It returns once every job is done and
+ * no more will be added.
+ *
+ *   Input:  pvPool - The pool.
+ * Returns:  NULL.
+ */
+/*========================================================================*/
+{
+  struct EncoderPool_t *pstPool;		/* The pool                  */
+  struct EncoderJob_t  *pstJob,			/* Current job               */
+                       **apstPolled = NULL;	/* Job of each descriptor    */
+  struct pollfd        *astPoll = NULL,		/* Descriptors to wait on    */
+                       *astMore;		/* ... enlarged              */
+  void   *pvMore;				/* apstPolled, enlarged      */
+  int    iPolled,				/* Descriptors in astPoll    */
+         iAllocated = 0,			/* Entries allocated         */
+         iWaiting,				/* An exit is awaited (flag) */
+         iDone,					/* Jobs done                 */
+         iStatus,				/* An encoder's exit status  */
+         iIndex;				/* Current job or descriptor */
+  char   cWake;					/* Byte from aiWake          */
+
+
+  pstPool = (struct EncoderPool_t *) pvPool;
+
+  pthread_mutex_lock(&pstPool->stLock);
+
+  for (;;) {
+    iWaiting = iDone = 0;
+
+    for (iIndex = 0; iIndex < pstPool->iJobs; iIndex++) {
+      pstJob = pstPool->apstJobs[iIndex];
+
+      if ((pstJob->iState == kiEncoder_Closed) &&
+          (waitpid(pstJob->tProcess, &iStatus, WNOHANG) == pstJob->tProcess)) {
+        pstJob->iStatus = iStatus;
+        pstJob->iState  = kiEncoder_Done;
+        pstPool->iRunning--;
+      }
+
+      if ((pstJob->iState == kiEncoder_Queued) && (pstPool->iRunning < pstPool->iMaxJobs)) {
+        if (fnEncoder_Spawn(pstJob, pstPool->szCommand) < 0) {
+          fnEncoder_Drop(pstPool, pstJob);
+          pstJob->iStatus = -1;
+          pstJob->iState  = kiEncoder_Done;
+        } else {
+          pstJob->iState = kiEncoder_Running;
+          pstPool->iRunning++;
+        }
+      }
+
+      if ((pstJob->iState == kiEncoder_Running) && (pstJob->iInput < 0) &&
+          (!pstJob->pstHead || ((pstJob->pstHead == pstJob->pstTail) &&
+                                (pstJob->pstHead->iSent == pstJob->pstHead->iLength)))) {
+        fnEncoder_Drop(pstPool, pstJob);
+        close(pstJob->iOutput);
+
+        pstJob->iOutput = -1;
+        pstJob->iState  = kiEncoder_Closed;
+      }
+
+      if (pstJob->iState == kiEncoder_Closed)  iWaiting = 1;
+      if ((pstJob->iState == kiEncoder_Done) && (pstJob->iInput < 0))  iDone++;
+    }
+
+    if (pstPool->iFinishing && (iDone == pstPool->iJobs))  break;
+
+    /* Room for the wake-up pipe, and both ends of every job.  Short of
+     * memory, those which don't fit wait their turn.
+     */
+    if (iAllocated < 2 * pstPool->iJobs + 1) {
+      if ((astMore = (struct pollfd *) realloc(astPoll, (2 * pstPool->iAllocated + 1) *
+                                                        sizeof(struct pollfd))) != NULL)
+        astPoll = astMore;
+
+      if ((pvMore = realloc(apstPolled, (2 * pstPool->iAllocated + 1) * sizeof(void *))) != NULL)
+        apstPolled = (struct EncoderJob_t **) pvMore;
+
+      if (astMore && pvMore)  iAllocated = 2 * pstPool->iAllocated + 1;
+    }
+
+    iPolled = 0;
+
+    if (iAllocated > 0) {
+      astPoll[0].fd     = pstPool->aiWake[0];
+      astPoll[0].events = POLLIN;
+      iPolled           = 1;
+    }
+
+    /* Audio is only taken from DAEX while there's room for it. */
+    for (iIndex = 0; iIndex < pstPool->iJobs; iIndex++) {
+      pstJob = pstPool->apstJobs[iIndex];
+
+      if (iPolled + 2 > iAllocated)  break;
+
+      if ((pstJob->iInput >= 0) &&
+          ((pstPool->iSpooled + kiEncoder_ChunkLength <= pstPool->iBudget) ||
+           (pstJob->iState > kiEncoder_Running))) {
+        astPoll[iPolled].fd     = pstJob->iInput;
+        astPoll[iPolled].events = POLLIN;
+        apstPolled[iPolled++]   = pstJob;
+      }
+
+      if ((pstJob->iState == kiEncoder_Running) && pstJob->pstHead) {
+        astPoll[iPolled].fd     = pstJob->iOutput;
+        astPoll[iPolled].events = POLLOUT;
+        apstPolled[iPolled++]   = pstJob;
+      }
+    }
+
+    pthread_mutex_unlock(&pstPool->stLock);
+
+    if (poll(astPoll, iPolled, (iWaiting || !iPolled) ? kiEncoder_ReapInterval : -1) < 0)
+      iPolled = 0;
+
+    pthread_mutex_lock(&pstPool->stLock);
+
+    if (iPolled && astPoll[0].revents)
+      while (read(pstPool->aiWake[0], &cWake, 1) > 0);
+
+    for (iIndex = 1; iIndex < iPolled; iIndex++) {
+      if (!astPoll[iIndex].revents)  continue;
+
+      pstJob = apstPolled[iIndex];
+
+      if (astPoll[iIndex].events == POLLIN)
+        fnEncoder_Read(pstPool, pstJob);
+      else if (pstJob->iState == kiEncoder_Running)
+        fnEncoder_Feed(pstPool, pstJob);
+    }
+  }
+
+  pthread_mutex_unlock(&pstPool->stLock);
+
+  free(astPoll);
+  free(apstPolled);
+
+  return NULL;
+}
+
+
+/*========================================================================*/
+void
+fnEncoder_Wake(struct EncoderPool_t *pstPool)
+/*
+ * Have the pump look at the jobs again.
+ */
+/*========================================================================*/
+{
+  char cWake = 0;				/* Anything will do          */
+
+
+  write(pstPool->aiWake[1], &cWake, 1);
+}
+
+
+/*========================================================================*/
+int
+fnEncoder_Initialize(struct EncoderPool_t *pstPool, char *szCommand, int iMaxJobs,
+                     size_t iBudget)
+/*
+ * Set up the pool, and start the pump.  A write to an encoder which has
+ * exited is an error, rather than SIGPIPE, from here on.
+ *
+ *   Input:  pstPool   - The pool.
+ *           szCommand - Run by /bin/sh for each track.  Must outlive the
+ *                       pool.
+ *           iMaxJobs  - Encoders run at once; 0 for one per CPU.
+ *           iBudget   - Bytes of audio to hold, at most.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  memset(pstPool, 0, sizeof(struct EncoderPool_t));
+
+  pstPool->szCommand = szCommand;
+  pstPool->iMaxJobs  = iMaxJobs ? iMaxJobs : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  pstPool->iBudget   = (iBudget < kiEncoder_ChunkLength) ? kiEncoder_ChunkLength : iBudget;
+  pstPool->aiWake[0] = pstPool->aiWake[1] = -1;
+
+  if (pstPool->iMaxJobs < 1)  pstPool->iMaxJobs = 1;
+
+  signal(SIGPIPE, SIG_IGN);
+
+  pthread_mutex_init(&pstPool->stLock, NULL);
+
+  if (pipe2(pstPool->aiWake, O_CLOEXEC | O_NONBLOCK) < 0)
+    return -1;
+
+  if ((errno = pthread_create(&pstPool->tPump, NULL, fnEncoder_Pump, pstPool)) != 0)
+    return -1;
+
+  pstPool->iStarted = 1;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnEncoder_Start(struct EncoderPool_t *pstPool, int iTrack, char *szFilename)
+/*
+ * Add a track.  Its encoder is started as soon as a slot is free; until
+ * then, what is written is held in memory.
+ *
+ *   Input:  pstPool    - The pool.
+ *           iTrack     - The track number.
+ *           szFilename - The file the track would have been written to.
+ *
+ * Returns:  A descriptor to write the track to, closed at the end of the
+ *           track; or -1 on error (see errno).
+ */
+/*========================================================================*/
+{
+  struct EncoderJob_t *pstJob,			/* The new job               */
+                      **apstJobs;		/* Jobs, enlarged            */
+  int    aiPipe[2];				/* From DAEX                 */
+
+
+  if (! (pstJob = (struct EncoderJob_t *) calloc(1, sizeof(struct EncoderJob_t))))
+    return -1;
+
+  if (! (pstJob->szFilename = strdup(szFilename))) {
+    free(pstJob);
+    return -1;
+  }
+
+  if (pipe2(aiPipe, O_CLOEXEC) < 0) {
+    free(pstJob->szFilename);
+    free(pstJob);
+    return -1;
+  }
+
+  fcntl(aiPipe[0], F_SETFL, fcntl(aiPipe[0], F_GETFL) | O_NONBLOCK);
+
+  pstJob->iTrack  = iTrack;
+  pstJob->iState  = kiEncoder_Queued;
+  pstJob->iInput  = aiPipe[0];
+  pstJob->iOutput = -1;
+
+  pthread_mutex_lock(&pstPool->stLock);
+
+  if (pstPool->iJobs == pstPool->iAllocated) {
+    if (! (apstJobs = (struct EncoderJob_t **)
+           realloc(pstPool->apstJobs, (2 * pstPool->iAllocated + 8) * sizeof(void *)))) {
+      pthread_mutex_unlock(&pstPool->stLock);
+      close(aiPipe[0]);
+      close(aiPipe[1]);
+      free(pstJob->szFilename);
+      free(pstJob);
+      errno = ENOMEM;
+      return -1;
+    }
+
+    pstPool->apstJobs    = apstJobs;
+    pstPool->iAllocated  = 2 * pstPool->iAllocated + 8;
+  }
+
+  pstPool->apstJobs[pstPool->iJobs++] = pstJob;
+
+  pthread_mutex_unlock(&pstPool->stLock);
+
+  fnEncoder_Wake(pstPool);
+
+  return aiPipe[1];
+}
+
+
+/*========================================================================*/
+int
+fnEncoder_Finish(struct EncoderPool_t *pstPool)
+/*
+ * Wait for every encoder to finish, and report those which failed.  Every
+ * track's descriptor must have been closed.
+ *
+ *   Input:  pstPool - The pool.
+ * Returns:  The number of encoders which failed.
+ */
+/*========================================================================*/
+{
+  struct EncoderJob_t *pstJob;			/* Current job               */
+  int    iFailed = 0,				/* Encoders which failed     */
+         iIndex;				/* Current job               */
+
+
+  if (!pstPool->iStarted)  return 0;
+
+  pthread_mutex_lock(&pstPool->stLock);
+  pstPool->iFinishing = 1;
+  pthread_mutex_unlock(&pstPool->stLock);
+
+  fnEncoder_Wake(pstPool);
+  pthread_join(pstPool->tPump, NULL);
+
+  pstPool->iStarted = 0;
+
+  for (iIndex = 0; iIndex < pstPool->iJobs; iIndex++) {
+    pstJob = pstPool->apstJobs[iIndex];
+
+    if (pstJob->iStatus == -1)
+      fprintf(stderr, "DAEX: Unable to start the encoder for track #%i.\n", pstJob->iTrack);
+    else if (WIFSIGNALED(pstJob->iStatus))
+      fprintf(stderr, "DAEX: The encoder for track #%i was killed by signal %i.\n",
+              pstJob->iTrack, WTERMSIG(pstJob->iStatus));
+    else if (WEXITSTATUS(pstJob->iStatus) != 0)
+      fprintf(stderr, "DAEX: The encoder for track #%i exited with status %i.\n",
+              pstJob->iTrack, WEXITSTATUS(pstJob->iStatus));
+    else
+      continue;
+
+    iFailed++;
+  }
+
+  return iFailed;
+}
+
+
+/*========================================================================*/
+void
+fnEncoder_Dispose(struct EncoderPool_t *pstPool)
+/*
+ * Free the pool, once fnEncoder_Finish() has waited for it.
+ */
+/*========================================================================*/
+{
+  struct EncoderJob_t *pstJob;			/* Current job               */
+  int    iIndex;				/* Current job               */
+
+
+  for (iIndex = 0; iIndex < pstPool->iJobs; iIndex++) {
+    pstJob = pstPool->apstJobs[iIndex];
+
+    fnEncoder_Drop(pstPool, pstJob);
+
+    if (pstJob->iInput >= 0)   close(pstJob->iInput);
+    if (pstJob->iOutput >= 0)  close(pstJob->iOutput);
+
+    free(pstJob->szFilename);
+    free(pstJob);
+  }
+
+  if (pstPool->aiWake[0] >= 0)  close(pstPool->aiWake[0]);
+  if (pstPool->aiWake[1] >= 0)  close(pstPool->aiWake[1]);
+
+  free(pstPool->apstJobs);
+
+  pthread_mutex_destroy(&pstPool->stLock);
+
+  memset(pstPool, 0, sizeof(struct EncoderPool_t));
+}
+
+/* EOF */
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX      - The Digital Audio EXtractor
+ *
+ * encoder.h - Header for the external encoder pool.
+ *
+ * $Id$
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#define kiEncoder_ChunkLength	(256 * 1024)	/* Audio spooled at a time            */
+#define kiEncoder_DefaultBudget	256		/* Mbytes spooled, at most, by default */
+#define kiEncoder_ReapInterval	50		/* ms between checks for exits        */
+
+/* Job states (struct EncoderJob_t's iState) */
+#define kiEncoder_Queued	0	/* Waiting for an encoder slot              */
+#define kiEncoder_Running	1	/* Its encoder is being fed                 */
+#define kiEncoder_Closed	2	/* Fed in full, waiting for it to exit      */
+#define kiEncoder_Done		3	/* Its encoder has exited                   */
+
+/* A piece of a track's audio, waiting for its encoder. */
+struct EncoderChunk_t {
+  struct EncoderChunk_t *pstNext;   /* The next piece, or NULL                     */
+  size_t iLength,                   /* Bytes in the piece                          */
+         iSent;                     /* ... already given to the encoder            */
+  u_char *pData;                    /* The audio (kiEncoder_ChunkLength bytes)     */
+};
+
+/* A track on its way to an encoder.  DAEX writes it into a pipe as usual;
+ * the pool reads the pipe into memory, and feeds it to the encoder once
+ * one is free.
+ */
+struct EncoderJob_t {
+  int    iTrack;                    /* The track number                            */
+  char   *szFilename;               /* The file DAEX would have written            */
+  int    iState;                    /* kiEncoder_Queued, _Running, _Closed or _Done */
+  int    iInput,                    /* Pipe DAEX writes to (our end), or -1        */
+         iOutput;                   /* The encoder's standard input, or -1         */
+  pid_t  tProcess;                  /* The encoder                                 */
+  int    iStatus;                   /* How it exited (see waitpid(2))              */
+  struct EncoderChunk_t *pstHead,   /* Audio waiting, oldest first                 */
+                        *pstTail;   /* ... and newest                              */
+};
+
+/* A pool of encoders, one per track, no more than iMaxJobs at once.  A
+ * single thread moves the audio from DAEX to the encoders; it stops
+ * reading from DAEX while iBudget bytes are held, so that a run of slow
+ * encoders eventually holds up the drive rather than filling memory.
+ */
+struct EncoderPool_t {
+  char   *szCommand;                /* Run by /bin/sh for each track               */
+  int    iMaxJobs;                  /* Encoders run at once                        */
+  size_t iBudget,                   /* Bytes of audio held, at most                */
+         iSpooled;                  /* ... held now                                */
+
+  pthread_mutex_t stLock;           /* Protects the jobs                           */
+  pthread_t tPump;                  /* Moves the audio                             */
+  int    aiWake[2];                 /* Wakes it when a job is added                */
+  int    iStarted,                  /* tPump is running (flag)                     */
+         iFinishing;                /* No more jobs will be added (flag)           */
+
+  struct EncoderJob_t **apstJobs;   /* Every job, in track order                   */
+  int    iJobs,                     /* Jobs added                                  */
+         iAllocated,                /* Entries in apstJobs                         */
+         iRunning;                  /* Encoders running                            */
+};
+
+/* Encoder pool function prototypes. */
+int  fnEncoder_Initialize(struct EncoderPool_t *pstPool, char *szCommand, int iMaxJobs,
+                          size_t iBudget);
+int  fnEncoder_Start(struct EncoderPool_t *pstPool, int iTrack, char *szFilename);
+int  fnEncoder_Finish(struct EncoderPool_t *pstPool);
+void fnEncoder_Dispose(struct EncoderPool_t *pstPool);
+
+/* EOF */
@@ -0,0 +1,1355 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX   - The Digital Audio EXtractor
+ *
+ * flac.c - FLAC encoder.  Blocks of 4096 frames are encoded by a pool of
+ *          worker threads while the disc is still being read, and written
+ *          out in order as they are finished.  Each channel (and, for
+ *          stereo, the mid and side channels) is tried as a constant, as
+ *          a fixed polynomial prediction and as a linear prediction from a
+ *          windowed autocorrelation; whichever codes smallest is kept.
+ *          The streams are within the FLAC subset, so any decoder will
+ *          play them.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "checksum.h"
+#include "flac.h"
+
+u_char    aFlacCRC8[256];			/* Frame header CRC table    */
+u_int16_t aiFlacCRC16[256];			/* Frame CRC table           */
+
+
+/*------------------------------------------------------------------------*/
+/* Bits.                                                                  */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+void
+fnFlac_PutBits(struct FlacBits_t *pstBits, u_int32_t lValue, int iCount)
+/*
+ * Append the low bits of a value, most significant first.
+ *
+ *   Input:  pstBits - The frame being written.
+ *           lValue  - The value.  Signed values are stored two's
+ *                     complement, in iCount bits.
+ *           iCount  - Bits to store, 0 to 32.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  pstBits->llAccumulator = (pstBits->llAccumulator << iCount) |
+                           (lValue & (((u_int64_t) 1 << iCount) - 1));
+  pstBits->iBits        += iCount;
+
+  while (pstBits->iBits >= 8) {
+    pstBits->iBits -= 8;
+    pstBits->pData[pstBits->iBytes++] = (pstBits->llAccumulator >> pstBits->iBits) & 0xff;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnFlac_PutRice(struct FlacBits_t *pstBits, int iValue, int iParameter)
+/*
+ * Append a Rice code: the value folded to unsigned (0, -1, 1, -2, ...),
+ * its high bits in unary, then its low iParameter bits.
+ */
+/*========================================================================*/
+{
+  u_int32_t lFolded,				/* The value, folded         */
+            lQuotient;				/* Its high bits             */
+
+
+  lFolded   = ((u_int32_t) iValue << 1) ^ (u_int32_t) (iValue >> 31);
+  lQuotient = lFolded >> iParameter;
+
+  /* Almost always, the whole code goes in at once. */
+  if (lQuotient + 1 + iParameter <= 32) {
+    fnFlac_PutBits(pstBits, (u_int32_t) (((u_int64_t) 1 << iParameter) |
+                                         (lFolded & (((u_int64_t) 1 << iParameter) - 1))),
+                   lQuotient + 1 + iParameter);
+    return;
+  }
+
+  for (; lQuotient >= 32; lQuotient -= 32)
+    fnFlac_PutBits(pstBits, 0, 32);
+
+  fnFlac_PutBits(pstBits, 1, lQuotient + 1);
+  fnFlac_PutBits(pstBits, lFolded, iParameter);
+}
+
+
+/*========================================================================*/
+void
+fnFlac_PutNumber(struct FlacBits_t *pstBits, u_int64_t llValue)
+/*
+ * Append a frame number, coded as UTF-8 is (extended to 36 bits).
+ */
+/*========================================================================*/
+{
+  int iBytes;					/* Bytes in the code         */
+
+
+  if (llValue < 0x80) {
+    fnFlac_PutBits(pstBits, (u_int32_t) llValue, 8);
+    return;
+  }
+
+  for (iBytes = 2; (iBytes < 7) && (llValue >> (5 * iBytes + 1)); iBytes++);
+
+  fnFlac_PutBits(pstBits, (0xff00 >> iBytes) | (u_int32_t) (llValue >> (6 * (iBytes - 1))), 8);
+
+  while (--iBytes > 0)
+    fnFlac_PutBits(pstBits, 0x80 | ((llValue >> (6 * (iBytes - 1))) & 0x3f), 8);
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Analysis: the cheapest subframe for each channel.                      */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+int
+fnFlac_Parameter(u_int64_t llSum, int iCount, u_int64_t *pllBits)
+/*
+ * Pick the Rice parameter for a partition, from the sum of its folded
+ * residual.  The bits counted are an upper bound: the sum shifted right
+ * is never less than the sum of the values shifted.
+ *
+ *   Input:  llSum   - Sum of the folded residual.
+ *           iCount  - Values in the partition.
+ *
+ * Returns:  The parameter.
+ *
+ *           pllBits - Bits the partition's codes take.
+ */
+/*========================================================================*/
+{
+  int iParameter = 0;				/* Parameter chosen          */
+
+
+  while ((iParameter < 30) && (((u_int64_t) iCount << (iParameter + 1)) <= llSum))
+    iParameter++;
+
+  *pllBits = (u_int64_t) iCount * (iParameter + 1) + (llSum >> iParameter);
+
+  /* The mean is a little below the power of two found, so one less may do. */
+  if ((iParameter > 0) &&
+      ((u_int64_t) iCount * iParameter + (llSum >> (iParameter - 1)) < *pllBits)) {
+    iParameter--;
+    *pllBits = (u_int64_t) iCount * (iParameter + 1) + (llSum >> iParameter);
+  }
+
+  return iParameter;
+}
+
+
+/*========================================================================*/
+u_int64_t
+fnFlac_Rice(struct FlacSubframe_t *pstSubframe, int iFrames)
+/*
+ * Choose how the subframe's residual is partitioned, and each partition's
+ * Rice parameter.  The sums for the finest partitioning allowed are found
+ * in one pass, then merged pairwise for each coarser one.
+ *
+ *   Input:  pstSubframe - The subframe, with its order and residual.
+ *           iFrames     - Frames in the block.
+ *
+ * Returns:  Bits the coded residual takes.
+ *
+ *           pstSubframe - iPartitionOrder, iParameterBits and
+ *                         aiParameters are set.
+ */
+/*========================================================================*/
+{
+  u_int64_t allSums[1 << kiFlac_MaxPartitions], /* Folded residual, per partition */
+            llPartitionBits,		/* Bits in one partition     */
+            llBits,			/* Bits at this order        */
+            llBest = ~(u_int64_t) 0;	/* Bits at the best order    */
+  int       aiParameters[1 << kiFlac_MaxPartitions], /* Parameters at this order */
+            iMaxOrder = 0,		/* Finest partitioning       */
+            iOrder,			/* Partition order           */
+            iPartition,			/* Current partition         */
+            iLargest,			/* Largest parameter         */
+            iStart,			/* First value in partition  */
+            iEnd,			/* Last value, plus one      */
+            iIndex;			/* Current value             */
+  const int *aiResidual = pstSubframe->aiResidual;
+
+
+  /* Partitions must divide the block evenly, and the first must reach
+   * past the warm-up samples.
+   */
+  while ((iMaxOrder < kiFlac_MaxPartitions) && (iFrames % (2 << iMaxOrder) == 0) &&
+         ((iFrames >> (iMaxOrder + 1)) > pstSubframe->iOrder))
+    iMaxOrder++;
+
+  for (iPartition = 0; iPartition < (1 << iMaxOrder); iPartition++) {
+    iStart = iPartition ? iPartition * (iFrames >> iMaxOrder) : pstSubframe->iOrder;
+    iEnd   = (iPartition + 1) * (iFrames >> iMaxOrder);
+
+    for (allSums[iPartition] = 0, iIndex = iStart; iIndex < iEnd; iIndex++)
+      allSums[iPartition] += ((u_int32_t) aiResidual[iIndex] << 1) ^
+                             (u_int32_t) (aiResidual[iIndex] >> 31);
+  }
+
+  for (iOrder = iMaxOrder; iOrder >= 0; iOrder--) {
+    llBits   = 2 + 4;
+    iLargest = 0;
+
+    for (iPartition = 0; iPartition < (1 << iOrder); iPartition++) {
+      aiParameters[iPartition] = fnFlac_Parameter(allSums[iPartition],
+                                                  (iFrames >> iOrder) -
+                                                  (iPartition ? 0 : pstSubframe->iOrder),
+                                                  &llPartitionBits);
+      llBits += llPartitionBits;
+
+      if (aiParameters[iPartition] > iLargest)  iLargest = aiParameters[iPartition];
+    }
+
+    /* Parameters past 14 need the 5 bit fields of RICE2. */
+    llBits += (u_int64_t) (1 << iOrder) * ((iLargest > 14) ? 5 : 4);
+
+    if (llBits < llBest) {
+      llBest = llBits;
+
+      pstSubframe->iPartitionOrder = iOrder;
+      pstSubframe->iParameterBits  = (iLargest > 14) ? 5 : 4;
+      memcpy(pstSubframe->aiParameters, aiParameters, sizeof(int) << iOrder);
+    }
+
+    for (iPartition = 0; iPartition < (1 << iOrder) / 2; iPartition++)
+      allSums[iPartition] = allSums[2 * iPartition] + allSums[2 * iPartition + 1];
+  }
+
+  return llBest;
+}
+
+
+/*========================================================================*/
+void
+fnFlac_Fixed(const int *aiSamples, int iFrames, int iBitsPerSample,
+             struct FlacSubframe_t *pstSubframe)
+/*
+ * Fixed polynomial prediction.  The order is picked by the sum of the
+ * absolute residual of each, found in one pass; only that order's residual
+ * is Rice coded.
+ *
+ *   Input:  aiSamples      - The channel.
+ *           iFrames        - Samples in the channel; more than 4.
+ *           iBitsPerSample - Bits per sample in the channel.
+ *           pstSubframe    - The subframe, with aiResidual set.
+ *
+ * Returns:  None.
+ *
+ *           pstSubframe    - The subframe, with its residual and size.
+ */
+/*========================================================================*/
+{
+  u_int64_t allTotals[5] = { 0, 0, 0, 0, 0 }; /* Absolute residual, per order */
+  int64_t   llError0, llError1, llError2, llError3, llError4; /* Residual, per order */
+  int       iOrder = 0,				/* Order chosen              */
+            iIndex;				/* Current sample            */
+
+
+  for (iIndex = 4; iIndex < iFrames; iIndex++) {
+    llError0 = aiSamples[iIndex];
+    llError1 = llError0 - aiSamples[iIndex - 1];
+    llError2 = llError1 - (aiSamples[iIndex - 1] - (int64_t) aiSamples[iIndex - 2]);
+    llError3 = llError2 - (aiSamples[iIndex - 1] - 2 * (int64_t) aiSamples[iIndex - 2] +
+                           aiSamples[iIndex - 3]);
+    llError4 = llError3 - (aiSamples[iIndex - 1] - 3 * (int64_t) aiSamples[iIndex - 2] +
+                           3 * (int64_t) aiSamples[iIndex - 3] - aiSamples[iIndex - 4]);
+
+    allTotals[0] += (llError0 < 0) ? -llError0 : llError0;
+    allTotals[1] += (llError1 < 0) ? -llError1 : llError1;
+    allTotals[2] += (llError2 < 0) ? -llError2 : llError2;
+    allTotals[3] += (llError3 < 0) ? -llError3 : llError3;
+    allTotals[4] += (llError4 < 0) ? -llError4 : llError4;
+  }
+
+  for (iIndex = 1; iIndex < 5; iIndex++)
+    if (allTotals[iIndex] < allTotals[iOrder])  iOrder = iIndex;
+
+  for (iIndex = iOrder; iIndex < iFrames; iIndex++)
+    switch (iOrder) {
+      case 0:  pstSubframe->aiResidual[iIndex] = aiSamples[iIndex];  break;
+      case 1:  pstSubframe->aiResidual[iIndex] = aiSamples[iIndex] - aiSamples[iIndex - 1];  break;
+      case 2:  pstSubframe->aiResidual[iIndex] = aiSamples[iIndex] - 2 * aiSamples[iIndex - 1] +
+                                                 aiSamples[iIndex - 2];  break;
+      case 3:  pstSubframe->aiResidual[iIndex] = aiSamples[iIndex] - 3 * aiSamples[iIndex - 1] +
+                                                 3 * aiSamples[iIndex - 2] - aiSamples[iIndex - 3];
+               break;
+      default: pstSubframe->aiResidual[iIndex] = aiSamples[iIndex] - 4 * aiSamples[iIndex - 1] +
+                                                 6 * aiSamples[iIndex - 2] -
+                                                 4 * aiSamples[iIndex - 3] + aiSamples[iIndex - 4];
+               break;
+    }
+
+  pstSubframe->iType  = kiFlac_Fixed;
+  pstSubframe->iOrder = iOrder;
+  pstSubframe->llBits = 8 + (u_int64_t) iOrder * iBitsPerSample +
+                        fnFlac_Rice(pstSubframe, iFrames);
+}
+
+
+/*========================================================================*/
+void
+fnFlac_Window(double *adWindow, int iFrames)
+/*
+ * A Tukey window, tapering a quarter of the block at each end with half a
+ * cosine.  Being flat through the middle, it loses less of the signal than
+ * a Hann window would.
+ */
+/*========================================================================*/
+{
+  int iTaper,					/* Samples in each taper     */
+      iIndex;					/* Current sample            */
+
+
+  iTaper = iFrames / 4;
+
+  for (iIndex = 0; iIndex < iFrames; iIndex++)
+    adWindow[iIndex] = 1.0;
+
+  for (iIndex = 0; iIndex < iTaper; iIndex++) {
+    adWindow[iIndex] = 0.5 - 0.5 * cos(M_PI * (iIndex + 0.5) / iTaper);
+    adWindow[iFrames - 1 - iIndex] = adWindow[iIndex];
+  }
+}
+
+
+/*========================================================================*/
+void
+fnFlac_Autocorrelate(const double *adSamples, int iFrames, int iLags, double *adResult)
+/*
+ * Autocorrelation of a windowed channel, for lags 0 to iLags.  With SSE2,
+ * two products at a time.
+ */
+/*========================================================================*/
+{
+  double dSum;					/* The sum for this lag      */
+  int    iLag,					/* Current lag               */
+         iIndex;				/* Current sample            */
+#ifdef __SSE2__
+  __m128d vSum;					/* Two partial sums          */
+  double  adSums[2];				/* ... stored                */
+#endif
+
+
+  for (iLag = 0; iLag <= iLags; iLag++) {
+    dSum   = 0.0;
+    iIndex = iLag;
+
+#ifdef __SSE2__
+    vSum = _mm_setzero_pd();
+
+    for (; iIndex + 2 <= iFrames; iIndex += 2)
+      vSum = _mm_add_pd(vSum, _mm_mul_pd(_mm_loadu_pd(adSamples + iIndex),
+                                         _mm_loadu_pd(adSamples + iIndex - iLag)));
+
+    _mm_storeu_pd(adSums, vSum);
+    dSum = adSums[0] + adSums[1];
+#endif
+
+    for (; iIndex < iFrames; iIndex++)
+      dSum += adSamples[iIndex] * adSamples[iIndex - iLag];
+
+    adResult[iLag] = dSum;
+  }
+}
+
+
+/*========================================================================*/
+int
+fnFlac_Quantise(const double *adCoefficients, int iOrder, int iPrecision,
+                struct FlacSubframe_t *pstSubframe)
+/*
+ * Quantise predictor coefficients to iPrecision bits, carrying each one's
+ * rounding error into the next.
+ *
+ *   Input:  adCoefficients - The coefficients.
+ *           iOrder         - How many.
+ *           iPrecision     - Bits per quantised coefficient.
+ *           pstSubframe    - The subframe.
+ *
+ * Returns:  -1 if the coefficients are too large to quantise, 0 otherwise.
+ *
+ *           pstSubframe    - aiCoefficients, iPrecision and iShift are set.
+ */
+/*========================================================================*/
+{
+  double dLargest = 0.0,			/* Largest coefficient       */
+         dError = 0.0;				/* Rounding error carried    */
+  int    iExponent,				/* Its binary exponent       */
+         iShift,				/* Shift applied to the sum  */
+         iLimit,				/* Largest quantised value   */
+         iValue,				/* Current quantised value   */
+         iIndex;				/* Current coefficient       */
+
+
+  for (iIndex = 0; iIndex < iOrder; iIndex++)
+    if (fabs(adCoefficients[iIndex]) > dLargest)  dLargest = fabs(adCoefficients[iIndex]);
+
+  if (dLargest <= 0.0)  return -1;
+
+  frexp(dLargest, &iExponent);
+
+  /* The shift is a 5 bit signed field, and decoders need it positive. */
+  if ((iShift = iPrecision - 1 - iExponent) < 0)  return -1;
+  if (iShift > 15)  iShift = 15;
+
+  iLimit = (1 << (iPrecision - 1)) - 1;
+
+  for (iIndex = 0; iIndex < iOrder; iIndex++) {
+    dError += adCoefficients[iIndex] * (1 << iShift);
+    iValue  = (int) lround(dError);
+
+    if (iValue > iLimit)            iValue = iLimit;
+    else if (iValue < -iLimit - 1)  iValue = -iLimit - 1;
+
+    dError -= iValue;
+    pstSubframe->aiCoefficients[iIndex] = iValue;
+  }
+
+  pstSubframe->iPrecision = iPrecision;
+  pstSubframe->iShift     = iShift;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnFlac_Predict(const int *aiSamples, int iFrames, struct FlacSubframe_t *pstSubframe)
+/*
+ * The residual of a linear predictor, exactly as a decoder will undo it.
+ *
+ *   Input:  aiSamples   - The channel.
+ *           iFrames     - Samples in the channel.
+ *           pstSubframe - The subframe, with its order, coefficients and
+ *                         aiResidual set.
+ *
+ * Returns:  -1 if the residual would not fit a Rice code, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  int64_t llSum;				/* The prediction            */
+  int64_t llResidual;				/* What it misses by         */
+  int     iIndex,				/* Current sample            */
+          iTap;					/* Current coefficient       */
+
+
+  for (iIndex = pstSubframe->iOrder; iIndex < iFrames; iIndex++) {
+    for (llSum = 0, iTap = 0; iTap < pstSubframe->iOrder; iTap++)
+      llSum += (int64_t) pstSubframe->aiCoefficients[iTap] * aiSamples[iIndex - 1 - iTap];
+
+    llResidual = aiSamples[iIndex] - (llSum >> pstSubframe->iShift);
+
+    if ((llResidual > (1 << 30)) || (llResidual < -(1 << 30)))  return -1;
+
+    pstSubframe->aiResidual[iIndex] = (int) llResidual;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnFlac_LPC(const int *aiSamples, int iFrames, int iBitsPerSample, const double *adWindow,
+           double *adWindowed, struct FlacSubframe_t *pstSubframe)
+/*
+ * Linear prediction.  The coefficients for every order come out of one
+ * Levinson-Durbin recursion over the windowed autocorrelation, along with
+ * each order's prediction error; the order whose error promises the fewest
+ * bits, coefficients included, is quantised and coded.
+ *
+ *   Input:  aiSamples      - The channel.
+ *           iFrames        - Samples in the channel.
+ *           iBitsPerSample - Bits per sample in the channel.
+ *           adWindow       - The analysis window, iFrames long.
+ *           adWindowed     - Room for the windowed channel.
+ *           pstSubframe    - The subframe, with aiResidual set.
+ *
+ * Returns:  None.
+ *
+ *           pstSubframe    - The subframe, with its residual and size, or
+ *                            with iType 0 if no predictor could be found.
+ */
+/*========================================================================*/
+{
+  double adCorrelation[kiFlac_MaxOrder + 1],	/* Autocorrelation           */
+         adPredictor[kiFlac_MaxOrder],		/* Predictor being built     */
+         adCoefficients[kiFlac_MaxOrder][kiFlac_MaxOrder], /* ... of each order */
+         adError[kiFlac_MaxOrder],		/* Each order's error        */
+         dError,				/* Current error             */
+         dReflection,				/* Reflection coefficient    */
+         dTemp,					/* Coefficient being swapped */
+         dBits,					/* Bits promised by an order */
+         dBest = HUGE_VAL;			/* ... by the best order     */
+  int    iMaxOrder,				/* Highest order tried       */
+         iPrecision,				/* Coefficient width         */
+         iOrder,				/* Current order             */
+         iIndex;				/* Current sample or coefficient */
+
+
+  pstSubframe->iType = 0;
+
+  iMaxOrder = (iFrames - 1 < kiFlac_MaxOrder) ? iFrames - 1 : kiFlac_MaxOrder;
+
+  /* As the reference encoder does, coefficients are narrower for shorter
+   * blocks, where they are a larger share of the frame.
+   */
+  if (iBitsPerSample > 17)    iPrecision = kiFlac_MaxPrecision;
+  else if (iFrames <= 192)    iPrecision = 7;
+  else if (iFrames <= 384)    iPrecision = 8;
+  else if (iFrames <= 576)    iPrecision = 9;
+  else if (iFrames <= 1152)   iPrecision = 10;
+  else if (iFrames <= 2304)   iPrecision = 11;
+  else                        iPrecision = 12;
+
+  for (iIndex = 0; iIndex < iFrames; iIndex++)
+    adWindowed[iIndex] = aiSamples[iIndex] * adWindow[iIndex];
+
+  fnFlac_Autocorrelate(adWindowed, iFrames, iMaxOrder, adCorrelation);
+
+  if (adCorrelation[0] <= 0.0)  return;
+
+  dError = adCorrelation[0];
+
+  for (iOrder = 0; iOrder < iMaxOrder; iOrder++) {
+    dReflection = -adCorrelation[iOrder + 1];
+
+    for (iIndex = 0; iIndex < iOrder; iIndex++)
+      dReflection -= adPredictor[iIndex] * adCorrelation[iOrder - iIndex];
+
+    dReflection /= dError;
+
+    adPredictor[iOrder] = dReflection;
+
+    for (iIndex = 0; iIndex < iOrder / 2; iIndex++) {
+      dTemp = adPredictor[iIndex];
+      adPredictor[iIndex]              += dReflection * adPredictor[iOrder - 1 - iIndex];
+      adPredictor[iOrder - 1 - iIndex] += dReflection * dTemp;
+    }
+
+    if (iOrder & 1)
+      adPredictor[iIndex] += adPredictor[iIndex] * dReflection;
+
+    dError *= 1.0 - dReflection * dReflection;
+
+    for (iIndex = 0; iIndex <= iOrder; iIndex++)
+      adCoefficients[iOrder][iIndex] = -adPredictor[iIndex];
+
+    adError[iOrder] = dError;
+  }
+
+  /* Residual bits per sample follow from the error's variance. */
+  for (iOrder = 1; iOrder <= iMaxOrder; iOrder++) {
+    dBits = (adError[iOrder - 1] > 0.0) ?
+            0.5 * log(0.5 * adError[iOrder - 1] / iFrames) / M_LN2 : 0.0;
+
+    if (dBits < 0.0)  dBits = 0.0;
+
+    dBits = dBits * (iFrames - iOrder) + iOrder * (iBitsPerSample + iPrecision);
+
+    if (dBits < dBest) {
+      dBest = dBits;
+      pstSubframe->iOrder = iOrder;
+    }
+  }
+
+  if ((fnFlac_Quantise(adCoefficients[pstSubframe->iOrder - 1], pstSubframe->iOrder,
+                       iPrecision, pstSubframe) < 0) ||
+      (fnFlac_Predict(aiSamples, iFrames, pstSubframe) < 0))
+    return;
+
+  pstSubframe->iType  = kiFlac_LPC;
+  pstSubframe->llBits = 8 + (u_int64_t) pstSubframe->iOrder * (iBitsPerSample + iPrecision) +
+                        4 + 5 + fnFlac_Rice(pstSubframe, iFrames);
+}
+
+
+/*========================================================================*/
+void
+fnFlac_Analyse(struct FlacScratch_t *pstScratch, int iChannel, int iFrames,
+               int iBitsPerSample, const double *adWindow)
+/*
+ * Find the smallest subframe for one channel: constant, verbatim, fixed or
+ * LPC.  Each predictor's residual is built in the trial buffer, which
+ * trades places with the best one's when it wins.
+ *
+ *   Input:  pstScratch     - The worker's scratch space.
+ *           iChannel       - The channel (left, right, mid or side).
+ *           iFrames        - Frames in the block.
+ *           iBitsPerSample - Bits per sample in the channel.
+ *           adWindow       - The analysis window, iFrames long.
+ *
+ * Returns:  None.
+ *
+ *           pstScratch     - astSubframes[iChannel] is set.
+ */
+/*========================================================================*/
+{
+  struct FlacSubframe_t *pstBest,		/* Best subframe so far      */
+                        stTrial;		/* Subframe being tried      */
+  const int *aiSamples;				/* The channel               */
+  int       *aiSpare;				/* The buffer not in use     */
+  int       iIndex;				/* Current sample            */
+
+
+  pstBest   = &pstScratch->astSubframes[iChannel];
+  aiSamples = pstScratch->aiChannels[iChannel];
+
+  for (iIndex = 1; (iIndex < iFrames) && (aiSamples[iIndex] == aiSamples[0]); iIndex++);
+
+  if (iIndex == iFrames) {
+    pstBest->iType  = kiFlac_Constant;
+    pstBest->llBits = 8 + iBitsPerSample;
+    return;
+  }
+
+  pstBest->iType      = kiFlac_Verbatim;
+  pstBest->llBits     = 8 + (u_int64_t) iFrames * iBitsPerSample;
+  pstBest->aiResidual = pstScratch->aiResiduals[iChannel][0];
+  aiSpare             = pstScratch->aiResiduals[iChannel][1];
+
+  if (iFrames <= 4)  return;
+
+  stTrial.aiResidual = aiSpare;
+  fnFlac_Fixed(aiSamples, iFrames, iBitsPerSample, &stTrial);
+
+  if (stTrial.llBits < pstBest->llBits) {
+    aiSpare  = pstBest->aiResidual;
+    *pstBest = stTrial;
+  }
+
+  stTrial.aiResidual = aiSpare;
+  fnFlac_LPC(aiSamples, iFrames, iBitsPerSample, adWindow, pstScratch->adWindowed, &stTrial);
+
+  if (stTrial.iType && (stTrial.llBits < pstBest->llBits))
+    *pstBest = stTrial;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Frames.                                                                */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+void
+fnFlac_PutSubframe(struct FlacBits_t *pstBits, struct FlacSubframe_t *pstSubframe,
+                   const int *aiSamples, int iFrames, int iBitsPerSample)
+/*
+ * Write a subframe as chosen by fnFlac_Analyse().
+ */
+/*========================================================================*/
+{
+  int iPartition,				/* Current partition         */
+      iPartitionLength,				/* Values per partition      */
+      iIndex,					/* Current sample            */
+      iEnd;					/* Last sample in partition, plus one */
+
+
+  fnFlac_PutBits(pstBits, 0, 1);
+
+  switch (pstSubframe->iType) {
+    case kiFlac_Constant:
+      fnFlac_PutBits(pstBits, kiFlac_Constant, 6 + 1);
+      fnFlac_PutBits(pstBits, aiSamples[0], iBitsPerSample);
+      return;
+
+    case kiFlac_Verbatim:
+      fnFlac_PutBits(pstBits, kiFlac_Verbatim << 1, 6 + 1);
+
+      for (iIndex = 0; iIndex < iFrames; iIndex++)
+        fnFlac_PutBits(pstBits, aiSamples[iIndex], iBitsPerSample);
+
+      return;
+
+    case kiFlac_Fixed:
+      fnFlac_PutBits(pstBits, (kiFlac_Fixed | pstSubframe->iOrder) << 1, 6 + 1);
+      break;
+
+    default:
+      fnFlac_PutBits(pstBits, (kiFlac_LPC | (pstSubframe->iOrder - 1)) << 1, 6 + 1);
+      break;
+  }
+
+  /* The warm-up samples, then the predictor's coefficients if it has any. */
+  for (iIndex = 0; iIndex < pstSubframe->iOrder; iIndex++)
+    fnFlac_PutBits(pstBits, aiSamples[iIndex], iBitsPerSample);
+
+  if (pstSubframe->iType == kiFlac_LPC) {
+    fnFlac_PutBits(pstBits, pstSubframe->iPrecision - 1, 4);
+    fnFlac_PutBits(pstBits, pstSubframe->iShift, 5);
+
+    for (iIndex = 0; iIndex < pstSubframe->iOrder; iIndex++)
+      fnFlac_PutBits(pstBits, pstSubframe->aiCoefficients[iIndex], pstSubframe->iPrecision);
+  }
+
+  /* The residual, partition by partition. */
+  fnFlac_PutBits(pstBits, (pstSubframe->iParameterBits == 5) ? 1 : 0, 2);
+  fnFlac_PutBits(pstBits, pstSubframe->iPartitionOrder, 4);
+
+  iPartitionLength = iFrames >> pstSubframe->iPartitionOrder;
+
+  for (iPartition = 0; iPartition < (1 << pstSubframe->iPartitionOrder); iPartition++) {
+    fnFlac_PutBits(pstBits, pstSubframe->aiParameters[iPartition], pstSubframe->iParameterBits);
+
+    iIndex = iPartition ? iPartition * iPartitionLength : pstSubframe->iOrder;
+    iEnd   = (iPartition + 1) * iPartitionLength;
+
+    for (; iIndex < iEnd; iIndex++)
+      fnFlac_PutRice(pstBits, pstSubframe->aiResidual[iIndex],
+                     pstSubframe->aiParameters[iPartition]);
+  }
+}
+
+
+/*========================================================================*/
+void
+fnFlac_EncodeBlock(struct FlacScratch_t *pstScratch, struct FlacBlock_t *pstBlock)
+/*
+ * Encode a block as one frame.  For stereo, left, right, mid and side are
+ * each analysed, and the cheapest of the four pairings the format allows
+ * is written.
+ *
+ *   Input:  pstScratch - The worker's scratch space.
+ *           pstBlock   - The block, with its samples and number.
+ *
+ * Returns:  None.
+ *
+ *           pstBlock   - pFrame and iFrameLength are set.
+ */
+/*========================================================================*/
+{
+  static const int aiRates[] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000,
+                                 32000, 44100, 48000, 96000 }; /* Sample rate codes */
+  static const int aaiPairs[4][2] = { { 0, 1 }, { 0, 3 }, { 3, 1 }, { 2, 3 } };
+  static const int aiAssignments[4] = { 1, 8, 9, 10 }; /* Channel assignment codes */
+
+  struct FlacEncoder_t *pstEncoder;		/* The encoder               */
+  struct FlacBits_t stBits;			/* The frame being written   */
+  const double *adWindow;			/* Analysis window           */
+  u_int64_t llBits,				/* Bits in a pairing         */
+            llBest = ~(u_int64_t) 0;		/* ... in the best one       */
+  int       iFrames,				/* Frames in the block       */
+            iBitsPerSample,			/* Bits per sample           */
+            iRateCode,				/* Sample rate code          */
+            iSizeCode,				/* Sample size code          */
+            iPair = 0,				/* Pairing chosen            */
+            iChannel,				/* Current channel           */
+            iIndex;				/* Current sample            */
+  u_int16_t iCRC16 = 0;				/* Frame CRC                 */
+  u_char    cCRC8 = 0;				/* Header CRC                */
+
+
+  pstEncoder     = pstScratch->pstEncoder;
+  iFrames        = pstBlock->iFrames;
+  iBitsPerSample = pstEncoder->iBitsPerSample;
+
+  /* Only the last block is short, so its window needn't be kept. */
+  if (iFrames == kiFlac_BlockFrames)
+    adWindow = pstEncoder->adWindow;
+  else {
+    fnFlac_Window(pstScratch->adWindow, iFrames);
+    adWindow = pstScratch->adWindow;
+  }
+
+  pstScratch->aiChannels[0] = pstBlock->aiSamples[0];
+  pstScratch->aiChannels[1] = pstBlock->aiSamples[1];
+
+  if (pstEncoder->iChannels == 1)
+    fnFlac_Analyse(pstScratch, 0, iFrames, iBitsPerSample, adWindow);
+  else {
+    for (iIndex = 0; iIndex < iFrames; iIndex++) {
+      pstScratch->aiChannels[2][iIndex] = (pstBlock->aiSamples[0][iIndex] +
+                                           pstBlock->aiSamples[1][iIndex]) >> 1;
+      pstScratch->aiChannels[3][iIndex] = pstBlock->aiSamples[0][iIndex] -
+                                          pstBlock->aiSamples[1][iIndex];
+    }
+
+    for (iChannel = 0; iChannel < 4; iChannel++)
+      fnFlac_Analyse(pstScratch, iChannel, iFrames, iBitsPerSample + (iChannel == 3), adWindow);
+
+    for (iIndex = 0; iIndex < 4; iIndex++) {
+      llBits = pstScratch->astSubframes[aaiPairs[iIndex][0]].llBits +
+               pstScratch->astSubframes[aaiPairs[iIndex][1]].llBits;
+
+      if (llBits < llBest) {
+        llBest = llBits;
+        iPair  = iIndex;
+      }
+    }
+  }
+
+  for (iRateCode = 1; (iRateCode < 12) && (aiRates[iRateCode] != pstEncoder->iSampleRate);
+       iRateCode++);
+
+  if (iRateCode == 12)
+    iRateCode = ((pstEncoder->iSampleRate % 1000 == 0) && (pstEncoder->iSampleRate <= 255000)) ?
+                12 : 13;
+
+  iSizeCode = (iBitsPerSample == 8) ? 1 : (iBitsPerSample == 16) ? 4 : 6;
+
+  /* The header: sync code, block size, rate, channels, sample size and
+   * frame number, the odd sizes after.
+   */
+  stBits.pData         = pstBlock->pFrame;
+  stBits.iBytes        = 0;
+  stBits.llAccumulator = 0;
+  stBits.iBits         = 0;
+
+  fnFlac_PutBits(&stBits, 0xfff8, 16);
+  fnFlac_PutBits(&stBits, (iFrames == kiFlac_BlockFrames) ? 12 : (iFrames <= 256) ? 6 : 7, 4);
+  fnFlac_PutBits(&stBits, iRateCode, 4);
+  fnFlac_PutBits(&stBits, (pstEncoder->iChannels == 1) ? 0 : aiAssignments[iPair], 4);
+  fnFlac_PutBits(&stBits, iSizeCode << 1, 3 + 1);
+  fnFlac_PutNumber(&stBits, pstBlock->llNumber);
+
+  if (iFrames != kiFlac_BlockFrames)
+    fnFlac_PutBits(&stBits, iFrames - 1, (iFrames <= 256) ? 8 : 16);
+
+  if (iRateCode == 12)
+    fnFlac_PutBits(&stBits, pstEncoder->iSampleRate / 1000, 8);
+  else if (iRateCode == 13)
+    fnFlac_PutBits(&stBits, pstEncoder->iSampleRate, 16);
+
+  for (iIndex = 0; iIndex < (int) stBits.iBytes; iIndex++)
+    cCRC8 = aFlacCRC8[cCRC8 ^ stBits.pData[iIndex]];
+
+  fnFlac_PutBits(&stBits, cCRC8, 8);
+
+  /* The subframes, padded to a byte, and the CRC of the whole frame. */
+  if (pstEncoder->iChannels == 1)
+    fnFlac_PutSubframe(&stBits, &pstScratch->astSubframes[0], pstScratch->aiChannels[0],
+                       iFrames, iBitsPerSample);
+  else
+    for (iIndex = 0; iIndex < 2; iIndex++) {
+      iChannel = aaiPairs[iPair][iIndex];
+
+      fnFlac_PutSubframe(&stBits, &pstScratch->astSubframes[iChannel],
+                         pstScratch->aiChannels[iChannel], iFrames,
+                         iBitsPerSample + (iChannel == 3));
+    }
+
+  fnFlac_PutBits(&stBits, 0, (8 - stBits.iBits) % 8);
+
+  for (iIndex = 0; iIndex < (int) stBits.iBytes; iIndex++)
+    iCRC16 = (iCRC16 << 8) ^ aiFlacCRC16[(iCRC16 >> 8) ^ stBits.pData[iIndex]];
+
+  fnFlac_PutBits(&stBits, iCRC16, 16);
+
+  pstBlock->iFrameLength = stBits.iBytes;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* The worker pool.                                                       */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+void *
+fnFlac_Worker(void *pvScratch)
+/*
+ * Worker thread.  Encode the blocks in the order they were queued, until
+ * told to quit with none left.
+ *
+ *   Input:  pvScratch - The worker's scratch space.
+ * Returns:  NULL.
+ */
+/*========================================================================*/
+{
+  struct FlacScratch_t *pstScratch;		/* Scratch space             */
+  struct FlacEncoder_t *pstEncoder;		/* The encoder               */
+  struct FlacBlock_t   *pstBlock;		/* Block taken               */
+
+
+  pstScratch = (struct FlacScratch_t *) pvScratch;
+  pstEncoder = pstScratch->pstEncoder;
+
+  pthread_mutex_lock(&pstEncoder->stLock);
+
+  for (;;) {
+    while ((pstEncoder->llTaken == pstEncoder->llQueued) && !pstEncoder->iQuit)
+      pthread_cond_wait(&pstEncoder->stQueued, &pstEncoder->stLock);
+
+    if (pstEncoder->llTaken == pstEncoder->llQueued)  break;
+
+    pstBlock = &pstEncoder->pstBlocks[pstEncoder->llTaken++ % pstEncoder->iBlocks];
+
+    pthread_mutex_unlock(&pstEncoder->stLock);
+
+    fnFlac_EncodeBlock(pstScratch, pstBlock);
+
+    pthread_mutex_lock(&pstEncoder->stLock);
+
+    pstBlock->iState = kiFlac_Done;
+    pthread_cond_broadcast(&pstEncoder->stDone);
+  }
+
+  pthread_mutex_unlock(&pstEncoder->stLock);
+
+  return NULL;
+}
+
+
+/*========================================================================*/
+void
+fnFlac_Queue(struct FlacEncoder_t *pstEncoder)
+/*
+ * Hand the block being filled to the workers.
+ */
+/*========================================================================*/
+{
+  struct FlacBlock_t *pstBlock;			/* The block                 */
+
+
+  pthread_mutex_lock(&pstEncoder->stLock);
+
+  pstBlock = &pstEncoder->pstBlocks[pstEncoder->llQueued % pstEncoder->iBlocks];
+
+  pstBlock->llNumber = pstEncoder->llQueued++;
+  pstBlock->iState   = kiFlac_Queued;
+
+  pthread_cond_signal(&pstEncoder->stQueued);
+  pthread_mutex_unlock(&pstEncoder->stLock);
+}
+
+
+/*========================================================================*/
+int
+fnFlac_Emit(struct FlacEncoder_t *pstEncoder, u_int64_t llKeep,
+            int (*pfnEmit)(void *pvContext, const u_char *pFrame, size_t iLength),
+            void *pvContext)
+/*
+ * Write out the frames encoded so far, in order, and wait for more until
+ * no more than llKeep blocks are outstanding.
+ *
+ *   Input:  pstEncoder - The encoder.
+ *           llKeep     - Blocks which may be left queued.
+ *           pfnEmit    - Called with each frame.
+ *           pvContext  - Passed to pfnEmit.
+ *
+ * Returns:  -1 if pfnEmit fails, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct FlacBlock_t *pstBlock;			/* Oldest block outstanding  */
+  int iDone;					/* It has been encoded       */
+
+
+  while (pstEncoder->llWritten < pstEncoder->llQueued) {
+    pstBlock = &pstEncoder->pstBlocks[pstEncoder->llWritten % pstEncoder->iBlocks];
+
+    pthread_mutex_lock(&pstEncoder->stLock);
+
+    while ((pstBlock->iState != kiFlac_Done) &&
+           (pstEncoder->llQueued - pstEncoder->llWritten > llKeep))
+      pthread_cond_wait(&pstEncoder->stDone, &pstEncoder->stLock);
+
+    iDone = (pstBlock->iState == kiFlac_Done);
+
+    pthread_mutex_unlock(&pstEncoder->stLock);
+
+    if (!iDone)  break;
+
+    if (pfnEmit(pvContext, pstBlock->pFrame, pstBlock->iFrameLength) < 0)
+      return -1;
+
+    if (!pstEncoder->iMinimumFrame || (pstBlock->iFrameLength < pstEncoder->iMinimumFrame))
+      pstEncoder->iMinimumFrame = pstBlock->iFrameLength;
+
+    if (pstBlock->iFrameLength > pstEncoder->iMaximumFrame)
+      pstEncoder->iMaximumFrame = pstBlock->iFrameLength;
+
+    pstBlock->iFrames = 0;
+    pstBlock->iState  = kiFlac_Free;
+
+    pstEncoder->llWritten++;
+  }
+
+  return 0;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* The encoder.                                                           */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+int
+fnFlac_Initialize(struct FlacEncoder_t *pstEncoder, int iChannels, int iBitsPerSample,
+                  int iSampleRate)
+/*
+ * Start a FLAC stream, and the workers which encode it: one per processor.
+ *
+ *   Input:  pstEncoder     - The encoder.
+ *           iChannels      - 1 or 2.
+ *           iBitsPerSample - 8, 16 or 24 (integer samples).
+ *           iSampleRate    - Frames per second.
+ *
+ * Returns:  -1 if the format isn't supported (errno 0), or if memory or
+ *           threads could not be had (see errno), 0 otherwise.  Either
+ *           way, fnFlac_Dispose() should be called.
+ */
+/*========================================================================*/
+{
+  struct FlacScratch_t *pstScratch;		/* A worker's scratch space  */
+  struct FlacBlock_t   *pstBlock;		/* Current block             */
+  u_int32_t lCRC;				/* Current table entry       */
+  int iThreads,					/* Workers wanted            */
+      iIndex,					/* Current block or entry    */
+      iChannel,					/* Current channel           */
+      iBit;					/* Current bit               */
+
+
+  memset(pstEncoder, 0, sizeof(struct FlacEncoder_t));
+
+  if ((iChannels < 1) || (iChannels > 2) ||
+      ((iBitsPerSample != 8) && (iBitsPerSample != 16) && (iBitsPerSample != 24)) ||
+      (iSampleRate < 1) || (iSampleRate > 655350))
+    return -1;
+
+  pstEncoder->iChannels      = iChannels;
+  pstEncoder->iBitsPerSample = iBitsPerSample;
+  pstEncoder->iSampleRate    = iSampleRate;
+
+  pthread_mutex_init(&pstEncoder->stLock, NULL);
+  pthread_cond_init(&pstEncoder->stQueued, NULL);
+  pthread_cond_init(&pstEncoder->stDone, NULL);
+
+  fnMD5_Initialize(&pstEncoder->stMD5);
+  fnFlac_Window(pstEncoder->adWindow, kiFlac_BlockFrames);
+
+  /* CRC-8 (x^8 + x^2 + x + 1) and CRC-16 (x^16 + x^15 + x^2 + 1), both
+   * unreflected.
+   */
+  for (iIndex = 0; iIndex < 256; iIndex++) {
+    for (lCRC = iIndex, iBit = 0; iBit < 8; iBit++)
+      lCRC = (lCRC & 0x80) ? ((lCRC << 1) ^ 0x07) & 0xff : (lCRC << 1) & 0xff;
+
+    aFlacCRC8[iIndex] = lCRC;
+
+    for (lCRC = iIndex << 8, iBit = 0; iBit < 8; iBit++)
+      lCRC = (lCRC & 0x8000) ? ((lCRC << 1) ^ 0x8005) & 0xffff : (lCRC << 1) & 0xffff;
+
+    aiFlacCRC16[iIndex] = lCRC;
+  }
+
+  iThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (iThreads < 1)  iThreads = 1;
+  if (iThreads > kiFlac_MaxThreads)  iThreads = kiFlac_MaxThreads;
+
+  /* A frame is never longer than its samples stored verbatim. */
+  pstEncoder->iBlocks = iThreads * kiFlac_BlocksPerThread;
+
+  if (! (pstEncoder->pstBlocks  = calloc(pstEncoder->iBlocks, sizeof(struct FlacBlock_t))) ||
+      ! (pstEncoder->pstScratch = calloc(iThreads, sizeof(struct FlacScratch_t))))
+    return -1;
+
+  for (iIndex = 0; iIndex < pstEncoder->iBlocks; iIndex++) {
+    pstBlock = &pstEncoder->pstBlocks[iIndex];
+
+    for (iChannel = 0; iChannel < iChannels; iChannel++)
+      if (! (pstBlock->aiSamples[iChannel] = malloc(kiFlac_BlockFrames * sizeof(int))))
+        return -1;
+
+    if (! (pstBlock->pFrame = malloc(iChannels * (kiFlac_BlockFrames * 4 + 8) + 32)))
+      return -1;
+  }
+
+  for (iIndex = 0; iIndex < iThreads; iIndex++) {
+    pstScratch = &pstEncoder->pstScratch[iIndex];
+    pstScratch->pstEncoder = pstEncoder;
+
+    for (iChannel = 0; iChannel < 4; iChannel++)
+      if (((iChannel >= 2) &&
+           ! (pstScratch->aiChannels[iChannel] = malloc(kiFlac_BlockFrames * sizeof(int)))) ||
+          ! (pstScratch->aiResiduals[iChannel][0] = malloc(kiFlac_BlockFrames * sizeof(int))) ||
+          ! (pstScratch->aiResiduals[iChannel][1] = malloc(kiFlac_BlockFrames * sizeof(int))))
+        return -1;
+
+    if (! (pstScratch->adWindowed = malloc(kiFlac_BlockFrames * sizeof(double))) ||
+        ! (pstScratch->adWindow   = malloc(kiFlac_BlockFrames * sizeof(double))))
+      return -1;
+  }
+
+  /* Make do with fewer workers if need be, but not none. */
+  for (iIndex = 0; iIndex < iThreads; iIndex++) {
+    if (pthread_create(&pstEncoder->atThreads[iIndex], NULL, fnFlac_Worker,
+                       &pstEncoder->pstScratch[iIndex]) != 0)
+      break;
+
+    pstEncoder->iThreads++;
+  }
+
+  if (pstEncoder->iThreads == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnFlac_Write(struct FlacEncoder_t *pstEncoder, const u_char *pSamples, size_t iLength,
+             int (*pfnEmit)(void *pvContext, const u_char *pFrame, size_t iLength),
+             void *pvContext)
+/*
+ * Add samples to the stream.  Each block is queued as it fills, and the
+ * frames encoded so far are passed to pfnEmit.  Should the workers fall
+ * behind, this waits until there's a block free to fill.
+ *
+ *   Input:  pstEncoder - The encoder.
+ *           pSamples   - Whole frames, little-endian (8 bit samples
+ *                        offset binary), as the converter produces them.
+ *           iLength    - Bytes of samples.
+ *           pfnEmit    - Called with each encoded frame, in order.
+ *           pvContext  - Passed to pfnEmit.
+ *
+ * Returns:  -1 if pfnEmit fails, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct FlacBlock_t *pstBlock;			/* Block being filled        */
+  u_char aSigned[256];				/* 8 bit samples, signed     */
+  int    iSampleLength,				/* Bytes per sample          */
+         iFrameLength,				/* Bytes per frame           */
+         iFrames,				/* Frames left to take       */
+         iTake,					/* Frames going in the block */
+         iFrame,				/* Current frame             */
+         iChannel,				/* Current channel           */
+         iIndex;				/* Current byte              */
+  int    *aiSamples;				/* Where the channel goes    */
+  const u_char *pSample;			/* Current sample            */
+
+
+  iSampleLength = pstEncoder->iBitsPerSample / 8;
+  iFrameLength  = iSampleLength * pstEncoder->iChannels;
+  iFrames       = iLength / iFrameLength;
+
+  /* The MD5 is of the samples signed, little-endian, as decoded. */
+  if (iSampleLength > 1)
+    fnMD5_Update(&pstEncoder->stMD5, pSamples, iLength);
+  else
+    for (iFrame = 0; iFrame < (int) iLength; iFrame += sizeof(aSigned)) {
+      for (iIndex = 0; (iIndex < (int) sizeof(aSigned)) && (iFrame + iIndex < (int) iLength); iIndex++)
+        aSigned[iIndex] = pSamples[iFrame + iIndex] ^ 0x80;
+
+      fnMD5_Update(&pstEncoder->stMD5, aSigned, iIndex);
+    }
+
+  pstEncoder->llFrames += iFrames;
+
+  while (iFrames > 0) {
+    pstBlock = &pstEncoder->pstBlocks[pstEncoder->llQueued % pstEncoder->iBlocks];
+    iTake    = kiFlac_BlockFrames - pstBlock->iFrames;
+
+    if (iTake > iFrames)  iTake = iFrames;
+
+    for (iChannel = 0; iChannel < pstEncoder->iChannels; iChannel++) {
+      aiSamples = pstBlock->aiSamples[iChannel] + pstBlock->iFrames;
+      pSample   = pSamples + iChannel * iSampleLength;
+
+      switch (iSampleLength) {
+        case 1:
+          for (iFrame = 0; iFrame < iTake; iFrame++, pSample += iFrameLength)
+            aiSamples[iFrame] = pSample[0] - 0x80;
+          break;
+
+        case 2:
+          for (iFrame = 0; iFrame < iTake; iFrame++, pSample += iFrameLength)
+            aiSamples[iFrame] = (int16_t) (pSample[0] | pSample[1] << 8);
+          break;
+
+        default:
+          for (iFrame = 0; iFrame < iTake; iFrame++, pSample += iFrameLength)
+            aiSamples[iFrame] = ((pSample[0] | pSample[1] << 8 | pSample[2] << 16) ^ 0x800000) -
+                                0x800000;
+          break;
+      }
+    }
+
+    pstBlock->iFrames += iTake;
+    pSamples          += iTake * iFrameLength;
+    iFrames           -= iTake;
+
+    /* Once queued, the next block in the ring must be written out before
+     * it can be filled.
+     */
+    if (pstBlock->iFrames == kiFlac_BlockFrames) {
+      fnFlac_Queue(pstEncoder);
+
+      if (fnFlac_Emit(pstEncoder, pstEncoder->iBlocks - 1, pfnEmit, pvContext) < 0)
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnFlac_Finish(struct FlacEncoder_t *pstEncoder,
+              int (*pfnEmit)(void *pvContext, const u_char *pFrame, size_t iLength),
+              void *pvContext)
+/*
+ * Encode the last, short block, wait for the workers and write out the
+ * rest of the frames.  The MD5 and frame lengths are then final.
+ *
+ *   Input:  pstEncoder - The encoder.
+ *           pfnEmit    - Called with each encoded frame, in order.
+ *           pvContext  - Passed to pfnEmit.
+ *
+ * Returns:  -1 if pfnEmit fails, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  if (pstEncoder->pstBlocks[pstEncoder->llQueued % pstEncoder->iBlocks].iFrames > 0)
+    fnFlac_Queue(pstEncoder);
+
+  if (fnFlac_Emit(pstEncoder, 0, pfnEmit, pvContext) < 0)
+    return -1;
+
+  fnMD5_Final(&pstEncoder->stMD5, pstEncoder->aDigest);
+
+  pstEncoder->iFinished = 1;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnFlac_StreamInfo(struct FlacEncoder_t *pstEncoder, u_char *pInfo, u_int64_t llFrames)
+/*
+ * Lay out the STREAMINFO block.  Until the stream is finished, the frame
+ * lengths and MD5 are left as unknown (0).
+ *
+ *   Input:  pstEncoder - The encoder.
+ *           pInfo      - Where to lay it out (kiFlac_StreamInfoLength
+ *                        bytes).
+ *           llFrames   - Frames in the stream, or 0 if not known.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  u_int64_t llFields;				/* Rate, channels, size, length */
+  int       iByte;				/* Current byte              */
+
+
+  memset(pInfo, 0, kiFlac_StreamInfoLength);
+
+  pInfo[0] = pInfo[2] = kiFlac_BlockFrames >> 8;
+  pInfo[1] = pInfo[3] = kiFlac_BlockFrames & 0xff;
+
+  if (pstEncoder->iFinished)
+    for (iByte = 0; iByte < 3; iByte++) {
+      pInfo[4 + iByte] = (pstEncoder->iMinimumFrame >> (16 - 8 * iByte)) & 0xff;
+      pInfo[7 + iByte] = (pstEncoder->iMaximumFrame >> (16 - 8 * iByte)) & 0xff;
+    }
+
+  llFields = (u_int64_t) pstEncoder->iSampleRate << 44 |
+             (u_int64_t) (pstEncoder->iChannels - 1) << 41 |
+             (u_int64_t) (pstEncoder->iBitsPerSample - 1) << 36 |
+             (llFrames & 0xfffffffffULL);
+
+  for (iByte = 0; iByte < 8; iByte++)
+    pInfo[10 + iByte] = (llFields >> (56 - 8 * iByte)) & 0xff;
+
+  if (pstEncoder->iFinished)
+    memcpy(pInfo + 18, pstEncoder->aDigest, 16);
+}
+
+
+/*========================================================================*/
+void
+fnFlac_Dispose(struct FlacEncoder_t *pstEncoder)
+/*
+ * Stop the workers and free the encoder's blocks.
+ */
+/*========================================================================*/
+{
+  int iIndex,					/* Current block or worker   */
+      iChannel;					/* Current channel           */
+
+
+  if (pstEncoder->iChannels == 0)  return;
+
+  pthread_mutex_lock(&pstEncoder->stLock);
+  pstEncoder->iQuit = 1;
+  pthread_cond_broadcast(&pstEncoder->stQueued);
+  pthread_mutex_unlock(&pstEncoder->stLock);
+
+  for (iIndex = 0; iIndex < pstEncoder->iThreads; iIndex++)
+    pthread_join(pstEncoder->atThreads[iIndex], NULL);
+
+  if (pstEncoder->pstBlocks)
+    for (iIndex = 0; iIndex < pstEncoder->iBlocks; iIndex++) {
+      for (iChannel = 0; iChannel < 2; iChannel++)
+        free(pstEncoder->pstBlocks[iIndex].aiSamples[iChannel]);
+
+      free(pstEncoder->pstBlocks[iIndex].pFrame);
+    }
+
+  if (pstEncoder->pstScratch)
+    for (iIndex = 0; iIndex < pstEncoder->iBlocks / kiFlac_BlocksPerThread; iIndex++) {
+      for (iChannel = 0; iChannel < 4; iChannel++) {
+        if (iChannel >= 2)
+          free(pstEncoder->pstScratch[iIndex].aiChannels[iChannel]);
+
+        free(pstEncoder->pstScratch[iIndex].aiResiduals[iChannel][0]);
+        free(pstEncoder->pstScratch[iIndex].aiResiduals[iChannel][1]);
+      }
+
+      free(pstEncoder->pstScratch[iIndex].adWindowed);
+      free(pstEncoder->pstScratch[iIndex].adWindow);
+    }
+
+  free(pstEncoder->pstBlocks);
+  free(pstEncoder->pstScratch);
+
+  pthread_mutex_destroy(&pstEncoder->stLock);
+  pthread_cond_destroy(&pstEncoder->stQueued);
+  pthread_cond_destroy(&pstEncoder->stDone);
+
+  pstEncoder->iChannels = 0;
+}
+
+/* EOF */
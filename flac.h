@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX   - The Digital Audio EXtractor
+ *
+ * flac.h - Header for the FLAC encoder.
+ *
+ * $Id$
+ */
+
+#include <math.h>
+#include <pthread.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define kiFlac_BlockFrames	4096	/* Frames per FLAC frame                   */
+#define kiFlac_MaxOrder		12	/* Highest LPC order (the subset's limit)  */
+#define kiFlac_MaxPrecision	15	/* Widest quantised LPC coefficient        */
+#define kiFlac_MaxPartitions	8	/* Highest Rice partition order            */
+#define kiFlac_MaxThreads	16	/* Upper bound on worker threads           */
+#define kiFlac_BlocksPerThread	4	/* Blocks in the ring, per worker          */
+#define kiFlac_StreamInfoLength	34	/* Bytes in a STREAMINFO block             */
+
+/* Block states (struct FlacBlock_t's iState) */
+#define kiFlac_Free		0	/* Being filled, or not yet used           */
+#define kiFlac_Queued		1	/* Waiting for, or with, a worker          */
+#define kiFlac_Done		2	/* Encoded, waiting to be written          */
+
+/* Subframe types (struct FlacSubframe_t's iType), as coded in the stream */
+#define kiFlac_Constant		0x00	/* One value throughout                    */
+#define kiFlac_Verbatim		0x01	/* The samples as they are                 */
+#define kiFlac_Fixed		0x08	/* Fixed polynomial predictor, plus order  */
+#define kiFlac_LPC		0x20	/* Linear predictor, plus order - 1        */
+
+/* Bits being written to a frame, most significant first. */
+struct FlacBits_t {
+  u_char    *pData;                 /* The frame                                   */
+  size_t    iBytes;                 /* Bytes completed                             */
+  u_int64_t llAccumulator;          /* Bits not yet stored                         */
+  int       iBits;                  /* ... how many                                */
+};
+
+/* A channel's subframe, as chosen: the predictor, and how its residual is
+ * Rice coded.
+ */
+struct FlacSubframe_t {
+  int       iType;                  /* kiFlac_Constant, _Verbatim, _Fixed or _LPC  */
+  int       iOrder;                 /* Predictor order                             */
+  int       aiCoefficients[kiFlac_MaxOrder]; /* Quantised LPC coefficients         */
+  int       iPrecision,             /* ... their width in bits                     */
+            iShift;                 /* ... and their shift                         */
+  int       iPartitionOrder;        /* Rice partitions are 2^this                  */
+  int       iParameterBits;         /* 4 (RICE) or 5 (RICE2)                       */
+  int       aiParameters[1 << kiFlac_MaxPartitions]; /* Rice parameter, per partition */
+  int       *aiResidual;            /* The residual                                */
+  u_int64_t llBits;                 /* Bits in the subframe                        */
+};
+
+/* A block of frames, from the writer to a worker and back. */
+struct FlacBlock_t {
+  int       *aiSamples[2];          /* The samples, per channel                    */
+  int       iFrames;                /* Frames in the block                         */
+  u_int64_t llNumber;               /* The frame's number in the stream            */
+  u_char    *pFrame;                /* The encoded frame                           */
+  size_t    iFrameLength;           /* Bytes in pFrame                             */
+  int       iState;                 /* kiFlac_Free, _Queued or _Done               */
+};
+
+struct FlacEncoder_t;
+
+/* A worker's space to try out predictors: for each channel (left, right,
+ * mid and side), the residual of the best subframe so far, and of the one
+ * being tried.
+ */
+struct FlacScratch_t {
+  struct FlacEncoder_t *pstEncoder; /* The encoder the worker belongs to           */
+  int       *aiChannels[4];         /* Left, right, mid and side                   */
+  int       *aiResiduals[4][2];     /* Best and trial residuals, per channel       */
+  double    *adWindowed;            /* The channel, windowed for LPC analysis      */
+  double    *adWindow;              /* Window for a short block                    */
+  struct FlacSubframe_t astSubframes[4]; /* Best subframe, per channel             */
+};
+
+/* A FLAC stream being encoded.  Blocks are filled in turn by the writer
+ * and encoded by a pool of workers, and the frames are written out in the
+ * order the blocks were filled.  Requires checksum.h.
+ */
+struct FlacEncoder_t {
+  int       iChannels,              /* 1 or 2                                      */
+            iBitsPerSample,         /* 8, 16 or 24                                 */
+            iSampleRate;            /* Frames per second                           */
+  double    adWindow[kiFlac_BlockFrames]; /* Tukey window for a whole block        */
+
+  pthread_mutex_t stLock;           /* Protects the counts and block states        */
+  pthread_cond_t  stQueued,         /* A block was queued, or the workers may quit */
+                  stDone;           /* A block was encoded                         */
+  pthread_t atThreads[kiFlac_MaxThreads]; /* The workers                           */
+  struct FlacScratch_t *pstScratch; /* One per worker                              */
+  int       iThreads,               /* Workers running                             */
+            iQuit;                  /* The workers are to quit (flag)              */
+
+  struct FlacBlock_t *pstBlocks;    /* The ring of blocks                          */
+  int       iBlocks;                /* Blocks in the ring                          */
+  u_int64_t llQueued,               /* Blocks queued so far                        */
+            llTaken,                /* ... taken by a worker                       */
+            llWritten;              /* ... and written out                         */
+
+  struct MD5Context_t stMD5;        /* MD5 of the samples                          */
+  u_char    aDigest[16];            /* ... once the stream is finished             */
+  int       iFinished;              /* aDigest and the frame lengths are final     */
+  u_int64_t llFrames;               /* Frames (samples per channel) so far         */
+  size_t    iMinimumFrame,          /* Shortest frame written, in bytes            */
+            iMaximumFrame;          /* Longest                                     */
+};
+
+/* FLAC encoder function prototypes. */
+int  fnFlac_Initialize(struct FlacEncoder_t *pstEncoder, int iChannels, int iBitsPerSample,
+                       int iSampleRate);
+int  fnFlac_Write(struct FlacEncoder_t *pstEncoder, const u_char *pSamples, size_t iLength,
+                  int (*pfnEmit)(void *pvContext, const u_char *pFrame, size_t iLength),
+                  void *pvContext);
+int  fnFlac_Finish(struct FlacEncoder_t *pstEncoder,
+                   int (*pfnEmit)(void *pvContext, const u_char *pFrame, size_t iLength),
+                   void *pvContext);
+void fnFlac_StreamInfo(struct FlacEncoder_t *pstEncoder, u_char *pInfo, u_int64_t llFrames);
+void fnFlac_Dispose(struct FlacEncoder_t *pstEncoder);
+
+/* EOF */
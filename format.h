@@ -30,24 +30,36 @@
  * $Id: format.h,v 0.1 1998/10/11 04:38:46 rmooney Exp $
  */
 
-/* WAV format */
+/* Lengths of the headers as stored on disk, before the audio data */
+#define WAV_HEADER_LENGTH	44	/* RIFF/WAVE, 16 byte format chunk          */
+#define RF64_HEADER_LENGTH	80	/* RF64/WAVE, with a ds64 chunk             */
+#define W64_HEADER_LENGTH	104	/* Sony Wave64, GUID chunk ids              */
+#define AIFF_HEADER_LENGTH	54	/* FORM/AIFF, integer samples               */
+#define AIFC_HEADER_LENGTH	72	/* FORM/AIFC, 32 bit float samples          */
+
+#define WAV_MAXIMUM_LENGTH	0xffffffffUL /* Largest RIFF chunk size      */
+
+/* WAV format.  The fields are fixed width, but the on-disk header is always
+ * read and written a field at a time, in little-endian byte order, never by
+ * overlaying this structure.
+ */
 struct WavFormat_t {
-  u_char   sRiffHeader[4];     /* RIFF chunk header                 */
-  u_long   lFileLength;        /* (lFileLength - 8)                 */
+  u_char    sRiffHeader[4];    /* RIFF chunk header                 */
+  u_int32_t lFileLength;       /* (lFileLength - 8)                 */
 
-  u_char   sWavHeader[4];      /* WAV chunk header                  */
+  u_char    sWavHeader[4];     /* WAV chunk header                  */
 
-  u_char   sFormatHeader[4];   /* Sample format header              */
-  u_long   lFormatLength;      /* Length of format data (16 bytes)  */
-  u_short  nFormatTag;         /* Format tag, 1 = PCM               */
-  u_short  nChannels;          /* Channels, 1 = mono, 2 = stereo    */
-  u_long   lSampleRate;        /* Sample rate (hz)                  */
-  u_long   lBytesPerSecond;    /* (lSampleRate * nBlockAlign)       */
-  u_short  nBlockAlign;        /* (nChannels * nBitsPerSample / 8 ) */
-  u_short  nBitsPerSample;     /* Bits per sample, 8 or 16          */
+  u_char    sFormatHeader[4];  /* Sample format header              */
+  u_int32_t lFormatLength;     /* Length of format data (16 bytes)  */
+  u_int16_t nFormatTag;        /* Format tag, 1 = PCM, 3 = float    */
+  u_int16_t nChannels;         /* Channels, 1 = mono, 2 = stereo    */
+  u_int32_t lSampleRate;       /* Sample rate (hz)                  */
+  u_int32_t lBytesPerSecond;   /* (lSampleRate * nBlockAlign)       */
+  u_int16_t nBlockAlign;       /* (nChannels * nBitsPerSample / 8 ) */
+  u_int16_t nBitsPerSample;    /* Bits per sample, 8 to 32          */
 
-  u_char   sDataHeader[4];     /* Data chunk header                 */
-  u_long   lSampleLength;      /* Sample data length                */
+  u_char    sDataHeader[4];    /* Data chunk header                 */
+  u_int32_t lSampleLength;     /* Sample data length                */
 };
 
 /* EOF */
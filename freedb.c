@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX     - The Digital Audio EXtractor
+ *
+ * freedb.c - The freedb index: mapping it into memory, and finding a disc
+ *            in it by its CDDB disc ID.  daex-index builds it.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "freedb.h"
+
+
+/*========================================================================*/
+int
+fnFreeDB_Map(struct FreeDB_t *pstIndex, char *szFilename)
+/*
+ * Map an index into memory, read only, and check that it is whole: its
+ * header, the length of each of its arrays, and the last of its strings.
+ * The rest is checked as it is used.
+ *
+ *   Input:  pstIndex   - The index, not mapped.
+ *           szFilename - The index's file.
+ *
+ * Returns:  -1 on error (see errno; EINVAL for a file which isn't an
+ *           index, or was built on a host of another byte order), 0
+ *           otherwise.
+ */
+/*========================================================================*/
+{
+  struct FreeDBheader_t *pstHeader;		/* The index's header        */
+  struct stat stStatus;				/* The file's status         */
+  u_int64_t   llLength;				/* Length its header implies */
+  int         iFileDesc;			/* The file                  */
+
+
+  if ((iFileDesc = open(szFilename, O_RDONLY)) < 0)
+    return -1;
+
+  if (fstat(iFileDesc, &stStatus) < 0) {
+    close(iFileDesc);
+    return -1;
+  }
+
+  if ((u_int64_t) stStatus.st_size < sizeof(struct FreeDBheader_t)) {
+    close(iFileDesc);
+    errno = EINVAL;
+    return -1;
+  }
+
+  pstIndex->iLength = stStatus.st_size;
+  pstIndex->pvMap   = mmap(NULL, pstIndex->iLength, PROT_READ, MAP_SHARED, iFileDesc, 0);
+
+  /* The mapping outlives the descriptor. */
+  close(iFileDesc);
+
+  if (pstIndex->pvMap == MAP_FAILED)
+    return -1;
+
+  pstHeader = (struct FreeDBheader_t *) pstIndex->pvMap;
+
+  llLength = sizeof(struct FreeDBheader_t) +
+             (u_int64_t) pstHeader->lEntries * (sizeof(u_int32_t) + sizeof(struct FreeDBentry_t)) +
+             (u_int64_t) pstHeader->lTOCwords * sizeof(u_int32_t) + pstHeader->lStrings;
+
+  if (memcmp(pstHeader->aMagic, kszFreeDB_Magic, sizeof(pstHeader->aMagic)) ||
+      (pstHeader->lByteOrder != kiFreeDB_ByteOrder) || (llLength != pstIndex->iLength) ||
+      (pstHeader->lStrings == 0) ||
+      ((char *) pstIndex->pvMap)[pstIndex->iLength - 1]) {
+    munmap(pstIndex->pvMap, pstIndex->iLength);
+    errno = EINVAL;
+    return -1;
+  }
+
+  pstIndex->lEntries   = pstHeader->lEntries;
+  pstIndex->alDiscIDs  = (u_int32_t *) (pstHeader + 1);
+  pstIndex->astEntries = (struct FreeDBentry_t *) (pstIndex->alDiscIDs + pstIndex->lEntries);
+  pstIndex->lTOCwords  = pstHeader->lTOCwords;
+  pstIndex->alTOC      = (u_int32_t *) (pstIndex->astEntries + pstIndex->lEntries);
+  pstIndex->lStrings   = pstHeader->lStrings;
+  pstIndex->szStrings  = (char *) (pstIndex->alTOC + pstIndex->lTOCwords);
+
+  /* A lookup touches a few pages, scattered across the file. */
+  madvise(pstIndex->pvMap, pstIndex->iLength, MADV_RANDOM);
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnFreeDB_Unmap(struct FreeDB_t *pstIndex)
+/*
+ * Unmap an index.  Nothing found in it may be used afterwards.
+ *
+ *   Input:  pstIndex - The index.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  munmap(pstIndex->pvMap, pstIndex->iLength);
+  pstIndex->pvMap = NULL;
+}
+
+
+/*========================================================================*/
+int
+fnFreeDB_Find(struct FreeDB_t *pstIndex, u_int32_t lDiscID, u_int32_t *plFirst)
+/*
+ * Find the entries listed under a disc ID.  They are next to each other,
+ * and are found by a binary search of the IDs alone, which are kept apart
+ * from the entries so that the search reads as few pages as it can.
+ *
+ *   Input:  pstIndex - The index.
+ *           lDiscID  - The CDDB disc ID.
+ *           plFirst  - Where to put the first entry's number.
+ *
+ * Returns:  The number of entries (0 if there are none).
+ *
+ *           plFirst  - The first of them.
+ */
+/*========================================================================*/
+{
+  u_int32_t lLow,				/* First ID which may match  */
+            lHigh,				/* ... and one past the last */
+            lMiddle;				/* The ID being tried        */
+
+
+  lLow  = 0;
+  lHigh = pstIndex->lEntries;
+
+  while (lLow < lHigh) {
+    lMiddle = lLow + (lHigh - lLow) / 2;
+
+    if (pstIndex->alDiscIDs[lMiddle] < lDiscID)
+      lLow = lMiddle + 1;
+    else
+      lHigh = lMiddle;
+  }
+
+  *plFirst = lLow;
+
+  for (lHigh = lLow; (lHigh < pstIndex->lEntries) && (pstIndex->alDiscIDs[lHigh] == lDiscID);
+       lHigh++)
+    ;
+
+  return lHigh - lLow;
+}
+
+
+/*========================================================================*/
+struct FreeDBentry_t *
+fnFreeDB_Entry(struct FreeDB_t *pstIndex, u_int32_t lEntry)
+/*
+ * Return an entry, once its TOC and strings are found to lie within the
+ * index.
+ *
+ *   Input:  pstIndex - The index.
+ *           lEntry   - The entry's number.
+ *
+ * Returns:  The entry, or NULL if it is damaged (errno is EINVAL).
+ */
+/*========================================================================*/
+{
+  struct FreeDBentry_t *pstEntry;		/* The entry                 */
+  u_int32_t lTrack;				/* Current track             */
+
+
+  pstEntry = &pstIndex->astEntries[lEntry];
+
+  if ((pstEntry->lTracks == 0) || (pstEntry->lTracks > kiFreeDB_MaxTracks) ||
+      (pstEntry->lTOC > pstIndex->lTOCwords) ||
+      (pstIndex->lTOCwords - pstEntry->lTOC < 2 * pstEntry->lTracks) ||
+      (pstEntry->lCategory >= pstIndex->lStrings) || (pstEntry->lDiscTitle >= pstIndex->lStrings)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  for (lTrack = 0; lTrack < pstEntry->lTracks; lTrack++)
+    if (pstIndex->alTOC[pstEntry->lTOC + pstEntry->lTracks + lTrack] >= pstIndex->lStrings) {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  return pstEntry;
+}
+
+
+/*========================================================================*/
+char *
+fnFreeDB_String(struct FreeDB_t *pstIndex, u_int32_t lOffset)
+/*
+ * Return one of the index's strings.  The offset must have been checked,
+ * as fnFreeDB_Entry() does; the last string ends the file, so every one is
+ * terminated.
+ *
+ *   Input:  pstIndex - The index.
+ *           lOffset  - The string's offset.
+ *
+ * Returns:  The string.
+ */
+/*========================================================================*/
+{
+  return pstIndex->szStrings + lOffset;
+}
+
+/* EOF */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX     - The Digital Audio EXtractor
+ *
+ * freedb.h - Header for the freedb index, a compact copy of an xmcd/freedb
+ *            dump which DAEX maps into memory and searches in place.
+ *
+ * $Id$
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* The index is a header, then four arrays, one after another:
+ *
+ *   u_int32_t        alDiscIDs[lEntries]   Disc IDs, in ascending order
+ *   FreeDBentry_t    astEntries[lEntries]  ... and the entry for each
+ *   u_int32_t        alTOC[lTOCwords]      Each disc's frame offsets, then
+ *                                          its track titles (as strings)
+ *   char             aStrings[lStrings]    NULL terminated strings, each
+ *                                          held once; the first is ""
+ *
+ * Everything is in the byte order of the host which built it; an index
+ * built on another is refused, not converted.  A disc listed under several
+ * disc IDs has an entry for each, all sharing its TOC.
+ */
+
+#define kszFreeDB_Magic		"DAEXFDB1"	/* First bytes of an index */
+#define kiFreeDB_ByteOrder	0x01020304	/* As written by its host  */
+#define kiFreeDB_MaxTracks	99		/* Tracks an entry may have */
+
+/* The index's header. */
+struct FreeDBheader_t {
+  char      aMagic[8];              /* kszFreeDB_Magic, without its NULL           */
+  u_int32_t lByteOrder;             /* kiFreeDB_ByteOrder                          */
+  u_int32_t lEntries;               /* Disc IDs listed                             */
+  u_int32_t lTOCwords;              /* Length of alTOC                             */
+  u_int32_t lStrings;               /* Bytes of aStrings                           */
+};
+
+/* A disc's entry.  Strings are given as offsets into aStrings. */
+struct FreeDBentry_t {
+  u_int32_t lCategory;              /* Its category (the dump's directory)         */
+  u_int32_t lDiscTitle;             /* DTITLE                                      */
+  u_int32_t lTracks;                /* Tracks on the disc                          */
+  u_int32_t lDiscSeconds;           /* Its length, from "Disc length:"             */
+  u_int32_t lTOC;                   /* Its frame offsets and titles, in alTOC      */
+};
+
+/* An index, mapped into memory. */
+struct FreeDB_t {
+  void      *pvMap;                 /* The mapping                                 */
+  size_t    iLength;                /* ... and its length                          */
+  u_int32_t lEntries;               /* Disc IDs listed                             */
+  u_int32_t *alDiscIDs;             /* ... and the IDs                             */
+  struct FreeDBentry_t *astEntries; /* Each one's entry                            */
+  u_int32_t lTOCwords;              /* Length of alTOC                             */
+  u_int32_t *alTOC;                 /* The discs' frame offsets and titles         */
+  u_int32_t lStrings;               /* Bytes of szStrings                          */
+  char      *szStrings;             /* The strings                                 */
+};
+
+/* freedb index function prototypes. */
+int  fnFreeDB_Map(struct FreeDB_t *pstIndex, char *szFilename);
+void fnFreeDB_Unmap(struct FreeDB_t *pstIndex);
+int  fnFreeDB_Find(struct FreeDB_t *pstIndex, u_int32_t lDiscID, u_int32_t *plFirst);
+struct FreeDBentry_t *fnFreeDB_Entry(struct FreeDB_t *pstIndex, u_int32_t lEntry);
+char *fnFreeDB_String(struct FreeDB_t *pstIndex, u_int32_t lOffset);
+
+/* EOF */
@@ -0,0 +1,737 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * index.c - daex-index: builds a freedb index from a dump of the freedb
+ *           database (a directory for each category, holding an xmcd file
+ *           for each disc), for DAEX to look discs up in without a server.
+ *           Also shows what the index holds for a disc ID.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "freedb.h"
+#include "index.h"
+
+
+/*========================================================================*/
+void
+fnIndex_Usage(void)
+/*
+ * Displays information on how to use daex-index from the command line.
+ *
+ *   Input:  None.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  fprintf(stderr, "usage: daex-index [-v] index directory ...\n");
+  fprintf(stderr, "       daex-index -q discid index\n\n");
+
+  fprintf(stderr, "   -q discid        :  Show the index's entries for a CDDB disc ID.\n");
+  fprintf(stderr, "   -v               :  Report on each category as it is read.\n\n");
+
+  exit(kiExitStatus_General);
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Grow(void **ppvArray, u_int32_t *plSize, u_int64_t llNeeded, size_t iElement)
+/*
+ * Make sure an array has room for so many elements, doubling it as often
+ * as need be.  The index counts everything in 32 bits.
+ *
+ *   Input:  ppvArray - The array (NULL if there isn't one yet).
+ *           plSize   - Elements it has room for.
+ *           llNeeded - Elements it must have room for.
+ *           iElement - Bytes in an element.
+ *
+ * Returns:  -1 on error (see errno; EFBIG if llNeeded will not fit in 32
+ *           bits), 0 otherwise.
+ *
+ *           ppvArray - The array, perhaps moved.
+ *           plSize   - Elements it now has room for.
+ */
+/*========================================================================*/
+{
+  u_int64_t llSize;				/* Elements to make room for */
+  void      *pvArray;				/* The array, reallocated    */
+
+
+  if (llNeeded <= *plSize)  return 0;
+
+  if (llNeeded > 0xffffffffULL) {
+    errno = EFBIG;
+    return -1;
+  }
+
+  for (llSize = *plSize ? *plSize : 1024; llSize < llNeeded; llSize *= 2)
+    ;
+
+  if (llSize > 0xffffffffULL)  llSize = 0xffffffffULL;
+
+  if (! (pvArray = realloc(*ppvArray, llSize * iElement)))
+    return -1;
+
+  *ppvArray = pvArray;
+  *plSize   = llSize;
+  return 0;
+}
+
+
+/*========================================================================*/
+u_int32_t
+fnIndex_Hash(char *szString)
+/*
+ * Hash a string for the string table (32 bit FNV-1a).
+ *
+ *   Input:  szString - The string.
+ * Returns:  Its hash.
+ */
+/*========================================================================*/
+{
+  u_int32_t lHash = 0x811c9dc5;			/* The hash so far           */
+
+
+  while (*szString)
+    lHash = (lHash ^ (u_char) *szString++) * 0x01000193;
+
+  return lHash;
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Intern(struct IndexBuilder_t *pstBuilder, char *szString, u_int32_t *plOffset)
+/*
+ * Find a string among those held, adding it if it is new.  The string
+ * table is doubled whenever it is half full.
+ *
+ *   Input:  pstBuilder - The index being built.
+ *           szString   - The string.
+ *           plOffset   - Where to put its offset.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ *
+ *           plOffset   - The string's offset.
+ */
+/*========================================================================*/
+{
+  u_int32_t *alTable,				/* The table, when doubled   */
+            lSize,				/* ... and its size          */
+            lSlot,				/* Current slot              */
+            lOld;				/* Current slot of the old   */
+  size_t    iLength;				/* Bytes in szString + NULL  */
+
+
+  /* The first string is always "". */
+  if (!*szString) {
+    *plOffset = 0;
+    return 0;
+  }
+
+  if ((pstBuilder->lTableUsed + 1) * 2 > pstBuilder->lTableSize) {
+    lSize = pstBuilder->lTableSize ? pstBuilder->lTableSize * 2 : kiIndex_FirstHash;
+
+    if (! (alTable = (u_int32_t *) calloc(lSize, sizeof(u_int32_t))))
+      return -1;
+
+    for (lOld = 0; lOld < pstBuilder->lTableSize; lOld++) {
+      if (!pstBuilder->alTable[lOld])  continue;
+
+      for (lSlot = fnIndex_Hash(pstBuilder->szStrings + pstBuilder->alTable[lOld] - 1) & (lSize - 1);
+           alTable[lSlot]; lSlot = (lSlot + 1) & (lSize - 1))
+        ;
+
+      alTable[lSlot] = pstBuilder->alTable[lOld];
+    }
+
+    free(pstBuilder->alTable);
+    pstBuilder->alTable    = alTable;
+    pstBuilder->lTableSize = lSize;
+  }
+
+  for (lSlot = fnIndex_Hash(szString) & (pstBuilder->lTableSize - 1); pstBuilder->alTable[lSlot];
+       lSlot = (lSlot + 1) & (pstBuilder->lTableSize - 1))
+    if (strcmp(pstBuilder->szStrings + pstBuilder->alTable[lSlot] - 1, szString) == 0) {
+      *plOffset = pstBuilder->alTable[lSlot] - 1;
+      return 0;
+    }
+
+  iLength = strlen(szString) + 1;
+
+  if (fnIndex_Grow((void **) &pstBuilder->szStrings, &pstBuilder->lStringsSize,
+                   (u_int64_t) pstBuilder->lStrings + iLength, 1) < 0)
+    return -1;
+
+  memcpy(pstBuilder->szStrings + pstBuilder->lStrings, szString, iLength);
+
+  *plOffset = pstBuilder->lStrings;
+  pstBuilder->alTable[lSlot] = pstBuilder->lStrings + 1;
+  pstBuilder->lStrings += iLength;
+  pstBuilder->lTableUsed++;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnIndex_Append(char *szTitle, char *szMore)
+/*
+ * Add a line of a title to what there is of it; a long title is spread
+ * over several lines of an xmcd file.  Whatever won't fit is dropped.
+ *
+ *   Input:  szTitle - The title so far (kiIndex_MaxTitle bytes).
+ *           szMore  - The line's value.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  size_t iLength;				/* Bytes of szTitle          */
+
+
+  iLength = strlen(szTitle);
+  snprintf(szTitle + iLength, kiIndex_MaxTitle - iLength, "%s", szMore);
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Parse(struct IndexDisc_t *pstDisc, char *szText, char *szName)
+/*
+ * Read a disc from its xmcd file: its frame offsets and length, from the
+ * comments at the top, its disc IDs, and its titles.  The file's text is
+ * cut up into lines as it is read.
+ *
+ *   Input:  pstDisc - Where to put the disc.
+ *           szText  - The file, NULL terminated.
+ *           szName  - The file's name, which is its disc ID if DISCID
+ *                     gives none.
+ *
+ * Returns:  -1 if it isn't an xmcd file with a usable TOC, 0 otherwise.
+ *
+ *           pstDisc - The disc.
+ */
+/*========================================================================*/
+{
+  char *szLine,					/* Current line              */
+       *pValue,					/* ... its value             */
+       *pEnd;					/* The end of a number       */
+  u_long lNumber;				/* A number read             */
+  int   iTrack,					/* Current track             */
+        iOffsets = 0;				/* 0 before the frame offsets,
+						 * 1 in them, 2 after        */
+
+
+  pstDisc->iDiscIDs       = 0;
+  pstDisc->iTracks        = 0;
+  pstDisc->lDiscSeconds   = 0;
+  pstDisc->szDiscTitle[0] = '\0';
+
+  for (iTrack = 0; iTrack < kiFreeDB_MaxTracks; iTrack++)
+    pstDisc->aszTrackTitle[iTrack][0] = '\0';
+
+  while ((szLine = strsep(&szText, "\n"))) {
+    if ((pEnd = strchr(szLine, '\r')))  *pEnd = '\0';
+
+    if (szLine[0] == '#') {
+      if ((iOffsets == 0) && strstr(szLine, "Track frame offsets:")) {
+        iOffsets = 1;
+        continue;
+      }
+
+      /* Each offset is on a line of its own, "#<whitespace><offset>". */
+      if (iOffsets == 1) {
+        for (pValue = szLine + 1; (*pValue == ' ') || (*pValue == '\t'); pValue++)
+          ;
+
+        if (isdigit((u_char) *pValue)) {
+          if (pstDisc->iTracks == kiFreeDB_MaxTracks)  return -1;
+
+          pstDisc->alOffsets[pstDisc->iTracks++] = strtoul(pValue, NULL, 10);
+          continue;
+        }
+
+        iOffsets = 2;
+      }
+
+      if (sscanf(szLine, "# Disc length: %lu", &lNumber) == 1)
+        pstDisc->lDiscSeconds = lNumber;
+
+      continue;
+    }
+
+    if (strncmp(szLine, "DISCID=", 7) == 0) {
+      for (pValue = szLine + 7; *pValue && (pstDisc->iDiscIDs < kiIndex_MaxIDs); pValue = pEnd) {
+        lNumber = strtoul(pValue, &pEnd, 16);
+
+        if (pEnd == pValue)  break;
+
+        pstDisc->alDiscIDs[pstDisc->iDiscIDs++] = lNumber;
+
+        while ((*pEnd == ',') || (*pEnd == ' '))  pEnd++;
+      }
+
+    } else if (strncmp(szLine, "DTITLE=", 7) == 0) {
+      fnIndex_Append(pstDisc->szDiscTitle, szLine + 7);
+
+    } else if (strncmp(szLine, "TTITLE", 6) == 0) {
+      lNumber = strtoul(szLine + 6, &pEnd, 10);
+
+      if ((pEnd != szLine + 6) && (*pEnd == '=') && (lNumber < kiFreeDB_MaxTracks))
+        fnIndex_Append(pstDisc->aszTrackTitle[lNumber], pEnd + 1);
+    }
+  }
+
+  if (pstDisc->iTracks == 0)  return -1;
+
+  /* An entry without a DISCID is known by its file's name. */
+  if (pstDisc->iDiscIDs == 0) {
+    lNumber = strtoul(szName, &pEnd, 16);
+
+    if ((pEnd - szName != 8) || *pEnd)  return -1;
+
+    pstDisc->alDiscIDs[pstDisc->iDiscIDs++] = lNumber;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Add(struct IndexBuilder_t *pstBuilder, struct IndexDisc_t *pstDisc, u_int32_t lCategory)
+/*
+ * Add a disc to the index, with an entry for each of its disc IDs.
+ *
+ *   Input:  pstBuilder - The index being built.
+ *           pstDisc    - The disc.
+ *           lCategory  - Its category's string.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct IndexEntry_t *pstEntry;		/* An entry                  */
+  u_int32_t lTOC,				/* Where the disc's TOC goes */
+            lDiscTitle;				/* Its title's string        */
+  int       iTrack,				/* Current track             */
+            iDiscID;				/* Current disc ID           */
+
+
+  lTOC = pstBuilder->lTOCwords;
+
+  if ((fnIndex_Grow((void **) &pstBuilder->alTOC, &pstBuilder->lTOCsize,
+                    (u_int64_t) lTOC + 2 * pstDisc->iTracks, sizeof(u_int32_t)) < 0) ||
+      (fnIndex_Intern(pstBuilder, pstDisc->szDiscTitle, &lDiscTitle) < 0))
+    return -1;
+
+  for (iTrack = 0; iTrack < pstDisc->iTracks; iTrack++) {
+    pstBuilder->alTOC[lTOC + iTrack] = pstDisc->alOffsets[iTrack];
+
+    if (fnIndex_Intern(pstBuilder, pstDisc->aszTrackTitle[iTrack],
+                       &pstBuilder->alTOC[lTOC + pstDisc->iTracks + iTrack]) < 0)
+      return -1;
+  }
+
+  pstBuilder->lTOCwords += 2 * pstDisc->iTracks;
+
+  for (iDiscID = 0; iDiscID < pstDisc->iDiscIDs; iDiscID++) {
+    if (fnIndex_Grow((void **) &pstBuilder->astEntries, &pstBuilder->lEntriesSize,
+                     (u_int64_t) pstBuilder->lEntries + 1, sizeof(struct IndexEntry_t)) < 0)
+      return -1;
+
+    pstEntry = &pstBuilder->astEntries[pstBuilder->lEntries++];
+
+    pstEntry->lDiscID              = pstDisc->alDiscIDs[iDiscID];
+    pstEntry->stEntry.lCategory    = lCategory;
+    pstEntry->stEntry.lDiscTitle   = lDiscTitle;
+    pstEntry->stEntry.lTracks      = pstDisc->iTracks;
+    pstEntry->stEntry.lDiscSeconds = pstDisc->lDiscSeconds;
+    pstEntry->stEntry.lTOC         = lTOC;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Category(struct IndexBuilder_t *pstBuilder, struct IndexDisc_t *pstDisc,
+                 char *szDirectory, char *szCategory)
+/*
+ * Add each of a category's discs to the index.  A file which can't be read
+ * as an xmcd file is passed over.
+ *
+ *   Input:  pstBuilder  - The index being built.
+ *           pstDisc     - Room to read a disc into.
+ *           szDirectory - The category's directory.
+ *           szCategory  - The category.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct dirent *pstFile;			/* Current file              */
+  struct stat   stStatus;			/* ... and its status        */
+  DIR       *pstDirectory;			/* The category              */
+  char      szFilename[MAXPATHLEN],		/* The file's path           */
+            *pText = NULL;			/* ... and its text          */
+  u_int32_t lTextSize = 0,			/* Bytes pText has room for  */
+            lCategory;				/* The category's string     */
+  ssize_t   iRead;				/* Bytes read by one call    */
+  size_t    iLength;				/* Bytes read of the file    */
+  int       iFileDesc,				/* The file                  */
+            iReturnValue = 0;			/* What to return            */
+
+
+  if (fnIndex_Intern(pstBuilder, szCategory, &lCategory) < 0)
+    return -1;
+
+  if (! (pstDirectory = opendir(szDirectory)))
+    return -1;
+
+  while ((pstFile = readdir(pstDirectory))) {
+    if (pstFile->d_name[0] == '.')  continue;
+
+    snprintf(szFilename, sizeof(szFilename), "%s/%s", szDirectory, pstFile->d_name);
+
+    if ((iFileDesc = open(szFilename, O_RDONLY)) < 0) {
+      fprintf(stderr, "daex-index: Unable to open %s: %s.\n", szFilename, strerror(errno));
+      pstBuilder->lRejected++;
+      continue;
+    }
+
+    if ((fstat(iFileDesc, &stStatus) < 0) || !S_ISREG(stStatus.st_mode)) {
+      close(iFileDesc);
+      continue;
+    }
+
+    pstBuilder->lFiles++;
+
+    if (fnIndex_Grow((void **) &pText, &lTextSize, (u_int64_t) stStatus.st_size + 1, 1) < 0) {
+      close(iFileDesc);
+      iReturnValue = -1;
+      break;
+    }
+
+    for (iLength = 0; iLength < (size_t) stStatus.st_size; iLength += iRead)
+      if ((iRead = read(iFileDesc, pText + iLength, stStatus.st_size - iLength)) <= 0)
+        break;
+
+    close(iFileDesc);
+
+    pText[iLength] = '\0';
+
+    if (fnIndex_Parse(pstDisc, pText, pstFile->d_name) < 0) {
+      pstBuilder->lRejected++;
+      continue;
+    }
+
+    if (fnIndex_Add(pstBuilder, pstDisc, lCategory) < 0) {
+      iReturnValue = -1;
+      break;
+    }
+  }
+
+  closedir(pstDirectory);
+  free(pText);
+
+  return iReturnValue;
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Compare(const void *pvEntry0, const void *pvEntry1)
+/*
+ * Order two entries by disc ID, then category (for qsort()).
+ */
+/*========================================================================*/
+{
+  const struct IndexEntry_t *pstEntry0,		/* The first entry           */
+                            *pstEntry1;		/* ... and the second        */
+
+
+  pstEntry0 = (const struct IndexEntry_t *) pvEntry0;
+  pstEntry1 = (const struct IndexEntry_t *) pvEntry1;
+
+  if (pstEntry0->lDiscID != pstEntry1->lDiscID)
+    return (pstEntry0->lDiscID < pstEntry1->lDiscID) ? -1 : 1;
+
+  if (pstEntry0->stEntry.lCategory != pstEntry1->stEntry.lCategory)
+    return (pstEntry0->stEntry.lCategory < pstEntry1->stEntry.lCategory) ? -1 : 1;
+
+  if (pstEntry0->stEntry.lTOC != pstEntry1->stEntry.lTOC)
+    return (pstEntry0->stEntry.lTOC < pstEntry1->stEntry.lTOC) ? -1 : 1;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Write(struct IndexBuilder_t *pstBuilder, char *szFilename)
+/*
+ * Sort the entries by disc ID and write the index.  A disc ID listed
+ * twice in one category (by a file of its own, and in another's DISCID)
+ * keeps the first of its entries.  The index is replaced in one step, so
+ * that DAEX never maps half of it.
+ *
+ *   Input:  pstBuilder - The index, built.
+ *           szFilename - The index's file.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct FreeDBheader_t stHeader;		/* The index's header        */
+  FILE      *fIndex;				/* The index                 */
+  char      szTemporary[MAXPATHLEN];		/* ... until renamed         */
+  u_int32_t lEntry,				/* Current entry             */
+            lKept = 0;				/* Entries kept so far       */
+  int       iFailed;				/* A write failed (flag)     */
+
+
+  qsort(pstBuilder->astEntries, pstBuilder->lEntries, sizeof(struct IndexEntry_t),
+        fnIndex_Compare);
+
+  for (lEntry = 0; lEntry < pstBuilder->lEntries; lEntry++) {
+    if ((lKept > 0) &&
+        (pstBuilder->astEntries[lKept - 1].lDiscID == pstBuilder->astEntries[lEntry].lDiscID) &&
+        (pstBuilder->astEntries[lKept - 1].stEntry.lCategory ==
+         pstBuilder->astEntries[lEntry].stEntry.lCategory))
+      continue;
+
+    pstBuilder->astEntries[lKept++] = pstBuilder->astEntries[lEntry];
+  }
+
+  pstBuilder->lEntries = lKept;
+
+  memset(&stHeader, 0, sizeof(stHeader));
+  memcpy(stHeader.aMagic, kszFreeDB_Magic, sizeof(stHeader.aMagic));
+
+  stHeader.lByteOrder = kiFreeDB_ByteOrder;
+  stHeader.lEntries   = pstBuilder->lEntries;
+  stHeader.lTOCwords  = pstBuilder->lTOCwords;
+  stHeader.lStrings   = pstBuilder->lStrings;
+
+  snprintf(szTemporary, sizeof(szTemporary), "%s.%i", szFilename, (int) getpid());
+
+  if (! (fIndex = fopen(szTemporary, "w")))
+    return -1;
+
+  iFailed = (fwrite(&stHeader, sizeof(stHeader), 1, fIndex) != 1);
+
+  for (lEntry = 0; !iFailed && (lEntry < pstBuilder->lEntries); lEntry++)
+    iFailed = (fwrite(&pstBuilder->astEntries[lEntry].lDiscID, sizeof(u_int32_t), 1, fIndex) != 1);
+
+  for (lEntry = 0; !iFailed && (lEntry < pstBuilder->lEntries); lEntry++)
+    iFailed = (fwrite(&pstBuilder->astEntries[lEntry].stEntry, sizeof(struct FreeDBentry_t), 1,
+                      fIndex) != 1);
+
+  if (!iFailed)
+    iFailed = (fwrite(pstBuilder->alTOC, sizeof(u_int32_t), pstBuilder->lTOCwords, fIndex) !=
+               pstBuilder->lTOCwords) ||
+              (fwrite(pstBuilder->szStrings, 1, pstBuilder->lStrings, fIndex) !=
+               pstBuilder->lStrings);
+
+  if ((fclose(fIndex) != 0) || iFailed || (rename(szTemporary, szFilename) < 0)) {
+    unlink(szTemporary);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnIndex_Query(char *szFilename, char *szDiscID)
+/*
+ * Show the entries an index holds for a disc ID, as DAEX would find them.
+ *
+ *   Input:  szFilename - The index's file.
+ *           szDiscID   - The CDDB disc ID, in hex.
+ *
+ * Returns:  -1 on error (see errno), the number of entries otherwise.
+ */
+/*========================================================================*/
+{
+  struct FreeDB_t      stIndex;			/* The index                 */
+  struct FreeDBentry_t *pstEntry;		/* Current entry             */
+  char      *pEnd;				/* The end of the disc ID    */
+  u_int32_t lDiscID,				/* The disc ID               */
+            lFirst,				/* Its first entry           */
+            lTrack;				/* Current track             */
+  int       iEntries,				/* Its entries               */
+            iEntry;				/* Current entry             */
+
+
+  lDiscID = strtoul(szDiscID, &pEnd, 16);
+
+  if ((pEnd == szDiscID) || *pEnd) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (fnFreeDB_Map(&stIndex, szFilename) < 0)
+    return -1;
+
+  iEntries = fnFreeDB_Find(&stIndex, lDiscID, &lFirst);
+
+  for (iEntry = 0; iEntry < iEntries; iEntry++) {
+    if (! (pstEntry = fnFreeDB_Entry(&stIndex, lFirst + iEntry))) {
+      fnFreeDB_Unmap(&stIndex);
+      return -1;
+    }
+
+    printf("%08x %s: %s (%u tracks, %u seconds)\n", lDiscID,
+           fnFreeDB_String(&stIndex, pstEntry->lCategory),
+           fnFreeDB_String(&stIndex, pstEntry->lDiscTitle),
+           pstEntry->lTracks, pstEntry->lDiscSeconds);
+
+    for (lTrack = 0; lTrack < pstEntry->lTracks; lTrack++)
+      printf("  %2u %7u  %s\n", lTrack + 1, stIndex.alTOC[pstEntry->lTOC + lTrack],
+             fnFreeDB_String(&stIndex, stIndex.alTOC[pstEntry->lTOC + pstEntry->lTracks + lTrack]));
+  }
+
+  fnFreeDB_Unmap(&stIndex);
+
+  return iEntries;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  extern int  optind;		/* The current argument number - getopt()    */
+  extern char *optarg;		/* Current option's arg. string - getopt()   */
+
+  struct IndexBuilder_t stBuilder;		/* The index                 */
+  struct IndexDisc_t    *pstDisc;		/* Room to read a disc into  */
+  struct dirent *pstCategory;			/* Current category          */
+  struct stat   stStatus;			/* ... and its status        */
+  DIR    *pstDump;				/* Current dump              */
+  char   szDirectory[MAXPATHLEN],		/* The category's directory  */
+         *szDiscID = NULL;			/* Disc ID to show, with -q  */
+  u_int32_t lFiles;				/* Files read before it      */
+  int    iArgument,				/* Current getopt() argument */
+         iVerbose = 0,				/* Report on each category   */
+         iEntries;				/* Entries shown by -q       */
+
+
+  while ((iArgument = getopt(argc, argv, "q:v")) != -1) {
+    switch (iArgument) {
+      case 'q':					/* Show a disc ID            */
+        szDiscID = optarg;
+        break;
+
+      case 'v':					/* Verbose                   */
+        iVerbose = 1;
+        break;
+
+      case '?':
+      default:
+        fnIndex_Usage();
+    }
+  }
+
+  if (szDiscID) {
+    if (argc - optind != 1)  fnIndex_Usage();
+
+    if ((iEntries = fnIndex_Query(argv[optind], szDiscID)) < 0) {
+      fprintf(stderr, "daex-index: Unable to search %s for %s: %s.\n", argv[optind], szDiscID,
+              strerror(errno));
+      exit(kiExitStatus_General);
+    }
+
+    return iEntries ? 0 : kiExitStatus_General;
+  }
+
+  if (argc - optind < 2)  fnIndex_Usage();
+
+  memset(&stBuilder, 0, sizeof(stBuilder));
+
+  if (! (pstDisc = (struct IndexDisc_t *) malloc(sizeof(struct IndexDisc_t))) ||
+      (fnIndex_Grow((void **) &stBuilder.szStrings, &stBuilder.lStringsSize, 1, 1) < 0)) {
+    fprintf(stderr, "daex-index: Unable to allocate sufficient memory for the index.\n");
+    exit(kiExitStatus_General);
+  }
+
+  /* The first string is "", which every missing title shares. */
+  stBuilder.szStrings[stBuilder.lStrings++] = '\0';
+
+  /* Each dump holds a directory for each category. */
+  for (iArgument = optind + 1; iArgument < argc; iArgument++) {
+    if (! (pstDump = opendir(argv[iArgument]))) {
+      fprintf(stderr, "daex-index: Unable to read %s: %s.\n", argv[iArgument], strerror(errno));
+      exit(kiExitStatus_General);
+    }
+
+    while ((pstCategory = readdir(pstDump))) {
+      if (pstCategory->d_name[0] == '.')  continue;
+
+      snprintf(szDirectory, sizeof(szDirectory), "%s/%s", argv[iArgument], pstCategory->d_name);
+
+      if ((stat(szDirectory, &stStatus) < 0) || !S_ISDIR(stStatus.st_mode))  continue;
+
+      lFiles = stBuilder.lFiles;
+
+      if (fnIndex_Category(&stBuilder, pstDisc, szDirectory, pstCategory->d_name) < 0) {
+        fprintf(stderr, "daex-index: Unable to index %s: %s.\n", szDirectory, strerror(errno));
+        exit(kiExitStatus_General);
+      }
+
+      if (iVerbose)
+        fprintf(stderr, "daex-index: %s: %u files.\n", szDirectory, stBuilder.lFiles - lFiles);
+    }
+
+    closedir(pstDump);
+  }
+
+  if (fnIndex_Write(&stBuilder, argv[optind]) < 0) {
+    fprintf(stderr, "daex-index: Unable to write %s: %s.\n", argv[optind], strerror(errno));
+    exit(kiExitStatus_General);
+  }
+
+  fprintf(stderr, "daex-index: %u disc IDs from %u files (%u passed over), %u bytes of titles.\n",
+          stBuilder.lEntries, stBuilder.lFiles, stBuilder.lRejected, stBuilder.lStrings);
+
+  free(pstDisc);
+  free(stBuilder.szStrings);
+  free(stBuilder.alTable);
+  free(stBuilder.alTOC);
+  free(stBuilder.astEntries);
+
+  return 0;
+}
+
+/* EOF */
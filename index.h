@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * index.h - Header for daex-index, which builds a freedb index from a dump.
+ *
+ * $Id$
+ */
+
+#include <sys/param.h>
+#include <dirent.h>
+#include <ctype.h>
+
+#define kiIndex_MaxIDs		16	/* Disc IDs an xmcd file may list          */
+#define kiIndex_MaxTitle	256	/* Longest title kept (with its NULL)      */
+#define kiIndex_FirstHash	(1 << 16) /* Slots in the string table at first    */
+
+/* A disc, as read from its xmcd file. */
+struct IndexDisc_t {
+  u_int32_t alDiscIDs[kiIndex_MaxIDs]; /* DISCID's disc IDs                        */
+  int       iDiscIDs;               /* ... and how many                            */
+  u_int32_t alOffsets[kiFreeDB_MaxTracks]; /* "Track frame offsets:"               */
+  int       iTracks;                /* ... and how many                            */
+  u_int32_t lDiscSeconds;           /* "Disc length:"                              */
+  char      szDiscTitle[kiIndex_MaxTitle]; /* DTITLE, its lines joined              */
+  char      aszTrackTitle[kiFreeDB_MaxTracks][kiIndex_MaxTitle]; /* ... and TTITLEs  */
+};
+
+/* A disc ID's entry, until the IDs are sorted and written apart. */
+struct IndexEntry_t {
+  u_int32_t lDiscID;                /* The disc ID                                 */
+  struct FreeDBentry_t stEntry;     /* ... and its entry                           */
+};
+
+/* The index, as it is built.  Each string is held once: the table holds
+ * the offset of each (plus one, so that 0 is an empty slot), by its hash.
+ */
+struct IndexBuilder_t {
+  char      *szStrings;             /* The strings                                 */
+  u_int32_t lStrings,               /* ... bytes used                              */
+            lStringsSize;           /* ... and allocated                           */
+  u_int32_t *alTable;               /* The string table                            */
+  u_int32_t lTableSize,             /* ... its slots (a power of two)              */
+            lTableUsed;             /* ... and those in use                        */
+  u_int32_t *alTOC;                 /* The discs' frame offsets and titles         */
+  u_int32_t lTOCwords,              /* ... words used                              */
+            lTOCsize;               /* ... and allocated                           */
+  struct IndexEntry_t *astEntries;  /* The entries                                 */
+  u_int32_t lEntries,               /* ... in use                                  */
+            lEntriesSize;           /* ... and allocated                           */
+  u_int32_t lFiles,                 /* xmcd files read                             */
+            lRejected;              /* ... and passed over                         */
+};
+
+/* EOF */
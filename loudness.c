@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * loudness.c - Loudness measurement per ITU-R BS.1770-4 and EBU Tech 3341
+ *              / 3342: K-weighted integrated loudness with gating, loudness
+ *              range, and 4x oversampled true peak.  ReplayGain 2.0 gains
+ *              are derived from the integrated loudness.  Both channels go
+ *              through the filters together, as a pair of lanes when SSE2
+ *              is available.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "loudness.h"
+
+/* BS.1770-4 Annex 2 true peak interpolator: 48 taps in 4 phases of 12. */
+static const double adTruePeakFIR[kiLoudness_TruePeakPhases][kiLoudness_TruePeakTaps] = {
+  {  0.0017089843750,  0.0109863281250, -0.0196533203125,  0.0332031250000,
+    -0.0594482421875,  0.1373291015625,  0.9721679687500, -0.1022949218750,
+     0.0476074218750, -0.0266113281250,  0.0148925781250, -0.0083007812500 },
+  { -0.0291748046875,  0.0292968750000, -0.0517578125000,  0.0891113281250,
+    -0.1665039062500,  0.4650878906250,  0.7797851562500, -0.2003173828125,
+     0.1015625000000, -0.0582275390625,  0.0330810546875, -0.0189208984375 },
+  { -0.0189208984375,  0.0330810546875, -0.0582275390625,  0.1015625000000,
+    -0.2003173828125,  0.7797851562500,  0.4650878906250, -0.1665039062500,
+     0.0891113281250, -0.0517578125000,  0.0292968750000, -0.0291748046875 },
+  { -0.0083007812500,  0.0148925781250, -0.0266113281250,  0.0476074218750,
+    -0.1022949218750,  0.9721679687500,  0.1373291015625, -0.0594482421875,
+     0.0332031250000, -0.0196533203125,  0.0109863281250,  0.0017089843750 }
+};
+
+
+/*========================================================================*/
+void
+fnLoudness_Initialize(struct LoudnessMeter_t *pstMeter, int iSampleRate)
+/*
+ * Reset the meter, and design the K-weighting filter for the sample rate
+ * specified.  The two stages (a high shelf modelling the head, and the
+ * RLB high pass) are derived by the bilinear transform from their analog
+ * prototypes, which reproduces the 48 kHz coefficients of BS.1770 exactly
+ * and gives the equivalent response at 44.1 kHz.
+ *
+ *   Input:  pstMeter    - The meter.
+ *           iSampleRate - Sample rate of the audio, in Hz.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  double dK,					/* Pre-warped frequency      */
+         dQ,					/* Filter Q                  */
+         dGainHigh,				/* Shelf gain (linear)       */
+         dGainBand,				/* Shelf band gain (linear)  */
+         dNorm;					/* Normalisation (1 / a0)    */
+
+
+  fnLoudness_Dispose(pstMeter);
+  memset(pstMeter, 0, sizeof(struct LoudnessMeter_t));
+
+  /* Stage 1: high shelf, +4 dB above ~1.7 kHz. */
+  dK        = tan(M_PI * 1681.974450955533 / iSampleRate);
+  dQ        = 0.7071752369554196;
+  dGainHigh = pow(10.0, 3.999843853973347 / 20.0);
+  dGainBand = pow(dGainHigh, 0.4996667741545416);
+  dNorm     = 1.0 / (1.0 + dK / dQ + dK * dK);
+
+  pstMeter->adFilterB[0][0] = (dGainHigh + dGainBand * dK / dQ + dK * dK) * dNorm;
+  pstMeter->adFilterB[0][1] = 2.0 * (dK * dK - dGainHigh) * dNorm;
+  pstMeter->adFilterB[0][2] = (dGainHigh - dGainBand * dK / dQ + dK * dK) * dNorm;
+  pstMeter->adFilterA[0][0] = 1.0;
+  pstMeter->adFilterA[0][1] = 2.0 * (dK * dK - 1.0) * dNorm;
+  pstMeter->adFilterA[0][2] = (1.0 - dK / dQ + dK * dK) * dNorm;
+
+  /* Stage 2: RLB weighting, a second order high pass at ~38 Hz. */
+  dK    = tan(M_PI * 38.13547087602444 / iSampleRate);
+  dQ    = 0.5003270373238773;
+  dNorm = 1.0 / (1.0 + dK / dQ + dK * dK);
+
+  pstMeter->adFilterB[1][0] = 1.0;
+  pstMeter->adFilterB[1][1] = -2.0;
+  pstMeter->adFilterB[1][2] = 1.0;
+  pstMeter->adFilterA[1][0] = 1.0;
+  pstMeter->adFilterA[1][1] = 2.0 * (dK * dK - 1.0) * dNorm;
+  pstMeter->adFilterA[1][2] = (1.0 - dK / dQ + dK * dK) * dNorm;
+
+  pstMeter->iFramesPerSubBlock = iSampleRate / 10;
+}
+
+
+/*========================================================================*/
+int
+fnLoudness_AppendBlock(struct LoudnessBlocks_t *pstBlocks, double dEnergy)
+/*
+ * Append an energy to a list of gating blocks or short-term windows.
+ *
+ *   Input:  pstBlocks - The list.
+ *           dEnergy   - The block's mean-square energy.
+ *
+ * Returns:  -1 on memory allocation error, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  double *adResized;				/* List after realloc()      */
+
+
+  if (pstBlocks->iCount == pstBlocks->iAllocated) {
+    if (! (adResized = (double *) realloc(pstBlocks->adEnergy,
+                       (pstBlocks->iAllocated + 1024) * sizeof(double))))
+      return -1;
+
+    pstBlocks->adEnergy    = adResized;
+    pstBlocks->iAllocated += 1024;
+  }
+
+  pstBlocks->adEnergy[pstBlocks->iCount++] = dEnergy;
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnLoudness_EndSubBlock(struct LoudnessMeter_t *pstMeter)
+/*
+ * Close the current 100 ms sub-block.  Every sub-block completes a 400 ms
+ * gating block (75% overlap) and a 3 s short-term window (10 Hz), once
+ * enough audio has been seen to fill them.
+ *
+ *   Input:  pstMeter - The meter.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  double dSum;					/* Sum of sub-block energies */
+  int    iIndex;				/* Current sub-block         */
+
+
+  pstMeter->adSubBlock[pstMeter->iSubBlocks % kiLoudness_SubBlocksPerShort] =
+    pstMeter->dSubBlockSum / pstMeter->iFramesPerSubBlock;
+
+  pstMeter->iSubBlocks++;
+  pstMeter->dSubBlockSum    = 0;
+  pstMeter->iSubBlockFrames = 0;
+
+  /* A failed allocation costs the block, not the extraction. */
+  if (pstMeter->iSubBlocks >= kiLoudness_SubBlocksPerBlock) {
+    for (dSum = 0, iIndex = 1; iIndex <= kiLoudness_SubBlocksPerBlock; iIndex++)
+      dSum += pstMeter->adSubBlock[(pstMeter->iSubBlocks - iIndex) % kiLoudness_SubBlocksPerShort];
+
+    fnLoudness_AppendBlock(&pstMeter->stGating, dSum / kiLoudness_SubBlocksPerBlock);
+  }
+
+  if (pstMeter->iSubBlocks >= kiLoudness_SubBlocksPerShort) {
+    for (dSum = 0, iIndex = 0; iIndex < kiLoudness_SubBlocksPerShort; iIndex++)
+      dSum += pstMeter->adSubBlock[iIndex];
+
+    fnLoudness_AppendBlock(&pstMeter->stShort, dSum / kiLoudness_SubBlocksPerShort);
+  }
+}
+
+
+/*========================================================================*/
+void
+fnLoudness_AddFrames(struct LoudnessMeter_t *pstMeter, const int *aiSamples, int iFrames)
+/*
+ * Run stereo frames through the true peak interpolator and the K-weighting
+ * filter, and accumulate the weighted energy.  Called from the analysis
+ * kernel with the frames it already has in hand.
+ *
+ *   Input:  pstMeter  - The meter.
+ *           aiSamples - Interleaved left/right 16 bit samples.
+ *           iFrames   - Number of frames in aiSamples.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  int iFrame,					/* Current frame             */
+      iPhase,					/* Interpolator phase        */
+      iTap;					/* Interpolator tap          */
+
+#ifdef __SSE2__
+  __m128d vInput,				/* [left, right] input       */
+          vOutput,				/* [left, right] output      */
+          vAccumulator,				/* Interpolator output       */
+          vPeak,				/* Largest magnitude         */
+          vZ1[2], vZ2[2],			/* Filter state, per stage   */
+          vSignMask;				/* Clears the sign bit       */
+  double  adPeak[2];				/* vPeak, unpacked           */
+  int     iStage;				/* Current filter stage      */
+
+
+  vSignMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+  vPeak     = _mm_set1_pd(pstMeter->dTruePeak);
+
+  for (iStage = 0; iStage < 2; iStage++) {
+    vZ1[iStage] = _mm_loadu_pd(pstMeter->adFilterState[iStage][0]);
+    vZ2[iStage] = _mm_loadu_pd(pstMeter->adFilterState[iStage][1]);
+  }
+
+  for (iFrame = 0; iFrame < iFrames; iFrame++) {
+    vInput = _mm_set_pd(aiSamples[iFrame * 2 + 1] / 32768.0, aiSamples[iFrame * 2] / 32768.0);
+
+    /* True peak: the history is kept twice over, so the newest twelve frames
+     * are always contiguous, newest first.
+     */
+    pstMeter->iHistory = (pstMeter->iHistory + kiLoudness_TruePeakTaps - 1) %
+                         kiLoudness_TruePeakTaps;
+    _mm_storeu_pd(pstMeter->adHistory[pstMeter->iHistory], vInput);
+    _mm_storeu_pd(pstMeter->adHistory[pstMeter->iHistory + kiLoudness_TruePeakTaps], vInput);
+
+    for (iPhase = 0; iPhase < kiLoudness_TruePeakPhases; iPhase++) {
+      vAccumulator = _mm_setzero_pd();
+
+      for (iTap = 0; iTap < kiLoudness_TruePeakTaps; iTap++)
+        vAccumulator = _mm_add_pd(vAccumulator,
+                         _mm_mul_pd(_mm_set1_pd(adTruePeakFIR[iPhase][iTap]),
+                                    _mm_loadu_pd(pstMeter->adHistory[pstMeter->iHistory + iTap])));
+
+      vPeak = _mm_max_pd(vPeak, _mm_and_pd(vAccumulator, vSignMask));
+    }
+
+    /* K-weighting, both stages in transposed direct form II. */
+    for (iStage = 0; iStage < 2; iStage++) {
+      vOutput = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(pstMeter->adFilterB[iStage][0]), vInput),
+                           vZ1[iStage]);
+      vZ1[iStage] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(pstMeter->adFilterB[iStage][1]), vInput),
+                                          _mm_mul_pd(_mm_set1_pd(pstMeter->adFilterA[iStage][1]), vOutput)),
+                               vZ2[iStage]);
+      vZ2[iStage] = _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(pstMeter->adFilterB[iStage][2]), vInput),
+                               _mm_mul_pd(_mm_set1_pd(pstMeter->adFilterA[iStage][2]), vOutput));
+      vInput = vOutput;
+    }
+
+    /* Energy of both channels. */
+    vOutput = _mm_mul_pd(vOutput, vOutput);
+    vOutput = _mm_add_sd(vOutput, _mm_unpackhi_pd(vOutput, vOutput));
+    pstMeter->dSubBlockSum += _mm_cvtsd_f64(vOutput);
+
+    if (++pstMeter->iSubBlockFrames == pstMeter->iFramesPerSubBlock)
+      fnLoudness_EndSubBlock(pstMeter);
+  }
+
+  for (iStage = 0; iStage < 2; iStage++) {
+    _mm_storeu_pd(pstMeter->adFilterState[iStage][0], vZ1[iStage]);
+    _mm_storeu_pd(pstMeter->adFilterState[iStage][1], vZ2[iStage]);
+  }
+
+  _mm_storeu_pd(adPeak, vPeak);
+  pstMeter->dTruePeak = (adPeak[0] > adPeak[1]) ? adPeak[0] : adPeak[1];
+
+#else
+  double dInput,				/* Current input sample      */
+         dOutput,				/* Current filter output     */
+         dAccumulator;				/* Interpolator output       */
+  int    iChannel,				/* Current channel           */
+         iStage;				/* Current filter stage      */
+
+
+  for (iFrame = 0; iFrame < iFrames; iFrame++) {
+    pstMeter->iHistory = (pstMeter->iHistory + kiLoudness_TruePeakTaps - 1) %
+                         kiLoudness_TruePeakTaps;
+
+    for (iChannel = 0; iChannel < 2; iChannel++) {
+      dInput = aiSamples[iFrame * 2 + iChannel] / 32768.0;
+
+      /* True peak. */
+      pstMeter->adHistory[pstMeter->iHistory][iChannel] = dInput;
+      pstMeter->adHistory[pstMeter->iHistory + kiLoudness_TruePeakTaps][iChannel] = dInput;
+
+      for (iPhase = 0; iPhase < kiLoudness_TruePeakPhases; iPhase++) {
+        for (dAccumulator = 0, iTap = 0; iTap < kiLoudness_TruePeakTaps; iTap++)
+          dAccumulator += adTruePeakFIR[iPhase][iTap] *
+                          pstMeter->adHistory[pstMeter->iHistory + iTap][iChannel];
+
+        if (fabs(dAccumulator) > pstMeter->dTruePeak)
+          pstMeter->dTruePeak = fabs(dAccumulator);
+      }
+
+      /* K-weighting. */
+      for (iStage = 0; iStage < 2; iStage++) {
+        dOutput = pstMeter->adFilterB[iStage][0] * dInput +
+                  pstMeter->adFilterState[iStage][0][iChannel];
+        pstMeter->adFilterState[iStage][0][iChannel] =
+                  pstMeter->adFilterB[iStage][1] * dInput -
+                  pstMeter->adFilterA[iStage][1] * dOutput +
+                  pstMeter->adFilterState[iStage][1][iChannel];
+        pstMeter->adFilterState[iStage][1][iChannel] =
+                  pstMeter->adFilterB[iStage][2] * dInput -
+                  pstMeter->adFilterA[iStage][2] * dOutput;
+        dInput = dOutput;
+      }
+
+      pstMeter->dSubBlockSum += dOutput * dOutput;
+    }
+
+    if (++pstMeter->iSubBlockFrames == pstMeter->iFramesPerSubBlock)
+      fnLoudness_EndSubBlock(pstMeter);
+  }
+#endif
+}
+
+
+/*========================================================================*/
+int
+fnLoudness_CompareDoubles(const void *pvValue1, const void *pvValue2)
+/*
+ * qsort() comparison function for doubles.
+ */
+/*========================================================================*/
+{
+  double dValue1 = *(const double *) pvValue1,
+         dValue2 = *(const double *) pvValue2;
+
+  return (dValue1 < dValue2) ? -1 : (dValue1 > dValue2);
+}
+
+
+/*========================================================================*/
+void
+fnLoudness_Result(struct LoudnessMeter_t **apstMeters, int iMeters,
+                  struct LoudnessResult_t *pstResult)
+/*
+ * Compute the gated loudness, loudness range, true peak and ReplayGain of
+ * one or more meters taken together.  A single meter gives the track
+ * values; every track's meter gives the album values, since gating is done
+ * over the blocks of the whole album rather than by averaging the tracks.
+ *
+ *   Input:  apstMeters - The meters.
+ *           iMeters    - Number of meters.
+ *           pstResult  - Where to store the results.
+ *
+ * Returns:  pstResult  - The results.  Silence measures -70 LUFS, with no
+ *                        gain applied.
+ */
+/*========================================================================*/
+{
+  struct LoudnessBlocks_t *pstBlocks;		/* Current block list        */
+  double dAbsolute,				/* Absolute gate (energy)    */
+         dRelative,				/* Relative gate (energy)    */
+         dSum,					/* Sum of gated energies     */
+         *adRange = NULL;			/* Short-term values kept    */
+  long   lCount,				/* Number of gated energies  */
+         lRange = 0,				/* Entries in adRange        */
+         lShortTotal = 0;			/* Short-term windows        */
+  int    iMeter,				/* Current meter             */
+         iBlock;				/* Current block             */
+
+
+  memset(pstResult, 0, sizeof(struct LoudnessResult_t));
+
+  dAbsolute = pow(10.0, (kdLoudness_AbsoluteGate + 0.691) / 10.0);
+
+  /* Integrated loudness: the mean of the blocks above the absolute gate sets
+   * the relative gate, and the mean of the blocks above both is the result.
+   */
+  for (dSum = 0, lCount = 0, iMeter = 0; iMeter < iMeters; iMeter++)
+    for (pstBlocks = &apstMeters[iMeter]->stGating, iBlock = 0; iBlock < pstBlocks->iCount; iBlock++)
+      if (pstBlocks->adEnergy[iBlock] > dAbsolute) {
+        dSum += pstBlocks->adEnergy[iBlock];
+        lCount++;
+      }
+
+  if (lCount == 0) {
+    pstResult->dIntegrated = kdLoudness_AbsoluteGate;
+
+  } else {
+    dRelative = dSum / lCount * pow(10.0, kdLoudness_RelativeGate / 10.0);
+
+    for (dSum = 0, lCount = 0, iMeter = 0; iMeter < iMeters; iMeter++)
+      for (pstBlocks = &apstMeters[iMeter]->stGating, iBlock = 0; iBlock < pstBlocks->iCount; iBlock++)
+        if ((pstBlocks->adEnergy[iBlock] > dAbsolute) && (pstBlocks->adEnergy[iBlock] > dRelative)) {
+          dSum += pstBlocks->adEnergy[iBlock];
+          lCount++;
+        }
+
+    pstResult->dIntegrated = -0.691 + 10.0 * log10(dSum / lCount);
+    pstResult->dGain       = kdLoudness_ReplayGainReference - pstResult->dIntegrated;
+  }
+
+  /* Loudness range: the spread between the 10th and 95th percentiles of the
+   * short-term loudness, gated 20 LU below its mean.
+   */
+  for (dSum = 0, lCount = 0, iMeter = 0; iMeter < iMeters; iMeter++) {
+    for (pstBlocks = &apstMeters[iMeter]->stShort, iBlock = 0; iBlock < pstBlocks->iCount; iBlock++)
+      if (pstBlocks->adEnergy[iBlock] > dAbsolute) {
+        dSum += pstBlocks->adEnergy[iBlock];
+        lCount++;
+      }
+
+    lShortTotal += apstMeters[iMeter]->stShort.iCount;
+  }
+
+  if ((lCount > 0) && (adRange = (double *) calloc(lShortTotal, sizeof(double)))) {
+    dRelative = dSum / lCount * pow(10.0, kdLoudness_RangeGate / 10.0);
+
+    for (iMeter = 0; iMeter < iMeters; iMeter++)
+      for (pstBlocks = &apstMeters[iMeter]->stShort, iBlock = 0; iBlock < pstBlocks->iCount; iBlock++)
+        if ((pstBlocks->adEnergy[iBlock] > dAbsolute) && (pstBlocks->adEnergy[iBlock] > dRelative))
+          adRange[lRange++] = -0.691 + 10.0 * log10(pstBlocks->adEnergy[iBlock]);
+
+    if (lRange > 1) {
+      qsort(adRange, lRange, sizeof(double), fnLoudness_CompareDoubles);
+
+      pstResult->dRange = adRange[(long) (0.95 * (lRange - 1) + 0.5)] -
+                          adRange[(long) (0.10 * (lRange - 1) + 0.5)];
+    }
+
+    free(adRange);
+  }
+
+  /* True peak. */
+  for (iMeter = 0; iMeter < iMeters; iMeter++)
+    if (apstMeters[iMeter]->dTruePeak > pstResult->dTruePeak)
+      pstResult->dTruePeak = apstMeters[iMeter]->dTruePeak;
+}
+
+
+/*========================================================================*/
+void
+fnLoudness_Dispose(struct LoudnessMeter_t *pstMeter)
+/*
+ * Free the block lists held by a meter.
+ *
+ *   Input:  pstMeter - The meter.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  if (pstMeter->stGating.adEnergy) {
+    free(pstMeter->stGating.adEnergy);
+    pstMeter->stGating.adEnergy = NULL;
+  }
+
+  if (pstMeter->stShort.adEnergy) {
+    free(pstMeter->stShort.adEnergy);
+    pstMeter->stShort.adEnergy = NULL;
+  }
+
+  pstMeter->stGating.iCount = pstMeter->stGating.iAllocated = 0;
+  pstMeter->stShort.iCount  = pstMeter->stShort.iAllocated  = 0;
+}
+
+/* EOF */
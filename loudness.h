@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * loudness.h - Header for the EBU R128 / ReplayGain 2.0 loudness meter.
+ *
+ * $Id$
+ */
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define kiLoudness_SubBlocksPerBlock	4	/* 400 ms gating block = 4 x 100 ms        */
+#define kiLoudness_SubBlocksPerShort	30	/* 3 s short-term window = 30 x 100 ms     */
+#define kiLoudness_TruePeakTaps		12	/* Taps per phase of the 4x interpolator   */
+#define kiLoudness_TruePeakPhases	4	/* Oversampling factor for true peak       */
+
+#define kdLoudness_AbsoluteGate		-70.0	/* LUFS                                    */
+#define kdLoudness_RelativeGate		-10.0	/* LU, integrated loudness                 */
+#define kdLoudness_RangeGate		-20.0	/* LU, loudness range                      */
+#define kdLoudness_ReplayGainReference	-18.0	/* LUFS, ReplayGain 2.0 reference level    */
+
+/* A list of mean-square energies, one per gating block or short-term window. */
+struct LoudnessBlocks_t {
+  double *adEnergy;                 /* The energies                                */
+  int    iCount,                    /* Energies stored                             */
+         iAllocated;                /* Energies allocated                          */
+};
+
+/* State of the meter for one track.  The filter and interpolator state is
+ * kept as left/right pairs, so that both channels are processed together.
+ */
+struct LoudnessMeter_t {
+  double adFilterB[2][3],           /* K-weighting numerators, per stage           */
+         adFilterA[2][3];           /* K-weighting denominators, per stage         */
+  double adFilterState[2][2][2];    /* [stage][z1, z2][channel]                    */
+
+  double adSubBlock[kiLoudness_SubBlocksPerShort]; /* Ring of 100 ms energies      */
+  double dSubBlockSum;              /* Energy of the current 100 ms, both channels */
+  int    iSubBlockFrames,           /* Frames in the current 100 ms                */
+         iFramesPerSubBlock,        /* Frames in 100 ms                            */
+         iSubBlocks;                /* 100 ms sub-blocks completed                 */
+
+  double adHistory[2 * kiLoudness_TruePeakTaps][2]; /* Interpolator input, doubled */
+  int    iHistory;                  /* Newest entry in adHistory                   */
+  double dTruePeak;                 /* Largest interpolated magnitude              */
+
+  struct LoudnessBlocks_t stGating, /* 400 ms blocks, for integrated loudness      */
+                          stShort;  /* 3 s windows, for loudness range             */
+};
+
+/* Results for a track or an album. */
+struct LoudnessResult_t {
+  double dIntegrated;               /* Integrated loudness, LUFS                   */
+  double dRange;                    /* Loudness range, LU                          */
+  double dTruePeak;                 /* True peak, linear (1.0 == full scale)       */
+  double dGain;                     /* ReplayGain 2.0 gain, dB                     */
+};
+
+/* Loudness function prototypes. */
+void fnLoudness_Initialize(struct LoudnessMeter_t *pstMeter, int iSampleRate);
+void fnLoudness_AddFrames(struct LoudnessMeter_t *pstMeter, const int *aiSamples, int iFrames);
+void fnLoudness_Result(struct LoudnessMeter_t **apstMeters, int iMeters,
+                       struct LoudnessResult_t *pstResult);
+void fnLoudness_Dispose(struct LoudnessMeter_t *pstMeter);
+
+/* EOF */
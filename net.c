@@ -0,0 +1,689 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX  - The Digital Audio EXtractor
+ *
+ * net.c - Network sink.  Each track's file is streamed to daex-recv over
+ *         TCP as it is extracted, in frames, with no more than a window of
+ *         it unacknowledged.  A lost connection is reopened, and the file
+ *         resumed from what daex-recv says it holds.  See net.h for the
+ *         protocol.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "checksum.h"
+#include "net.h"
+
+
+/*========================================================================*/
+u_char *
+fnNet_PutBE(u_char *pFrame, u_int64_t llValue, int iBytes)
+/*
+ * Store a big-endian field.
+ *
+ *   Input:  pFrame  - Where the field goes.
+ *           llValue - Its value.
+ *           iBytes  - Its size.
+ *
+ * Returns:  The address following the field.
+ */
+/*========================================================================*/
+{
+  int iByte;					/* Current byte              */
+
+
+  for (iByte = iBytes - 1; iByte >= 0; iByte--, llValue >>= 8)
+    pFrame[iByte] = (u_char) (llValue & 0xff);
+
+  return pFrame + iBytes;
+}
+
+
+/*========================================================================*/
+u_int64_t
+fnNet_GetBE(const u_char *pFrame, int iBytes)
+/*
+ * Fetch a big-endian field.
+ */
+/*========================================================================*/
+{
+  u_int64_t llValue = 0;			/* The field's value         */
+  int       iByte;				/* Current byte              */
+
+
+  for (iByte = 0; iByte < iBytes; iByte++)
+    llValue = (llValue << 8) | pFrame[iByte];
+
+  return llValue;
+}
+
+
+/*========================================================================*/
+void
+fnNet_Options(int iSocket)
+/*
+ * Set up a connection: frames go out as soon as they're written, and a
+ * peer which goes quiet for kiNet_Timeout seconds is an error (EAGAIN)
+ * rather than a hang.
+ */
+/*========================================================================*/
+{
+  struct timeval stTimeout;			/* Send and receive timeout  */
+  int iOn = 1;					/* Option value              */
+
+
+  stTimeout.tv_sec  = kiNet_Timeout;
+  stTimeout.tv_usec = 0;
+
+  setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, &iOn, sizeof(iOn));
+  setsockopt(iSocket, SOL_SOCKET, SO_RCVTIMEO, &stTimeout, sizeof(stTimeout));
+  setsockopt(iSocket, SOL_SOCKET, SO_SNDTIMEO, &stTimeout, sizeof(stTimeout));
+}
+
+
+/*========================================================================*/
+int
+fnNet_SendFrame(int iSocket, int iType, int iTrack, u_int64_t llOffset, u_int32_t lValue,
+                const void *pvPayload, size_t iLength)
+/*
+ * Send a frame, header and payload together.
+ *
+ *   Input:  iSocket   - The connection.
+ *           iType     - kiNet_*.
+ *           iTrack    - The track.
+ *           llOffset  - The frame's offset.
+ *           lValue    - The frame's value.
+ *           pvPayload - The payload, or NULL.
+ *           iLength   - Bytes of payload, at most kiNet_MaxPayload.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_char  aHeader[kiNet_HeaderLength];		/* The frame's header        */
+  u_char  *pHeader;				/* Current field             */
+  struct iovec astVector[2];			/* Header and payload        */
+  struct msghdr stMessage;			/* ... for sendmsg()         */
+  ssize_t iSent;				/* Bytes sent by one call    */
+
+
+  pHeader = fnNet_PutBE(aHeader, iType, 4);
+  pHeader = fnNet_PutBE(pHeader, iTrack, 4);
+  pHeader = fnNet_PutBE(pHeader, llOffset, 8);
+  pHeader = fnNet_PutBE(pHeader, iLength, 4);
+  fnNet_PutBE(pHeader, lValue, 4);
+
+  astVector[0].iov_base = aHeader;
+  astVector[0].iov_len  = kiNet_HeaderLength;
+  astVector[1].iov_base = (void *) pvPayload;
+  astVector[1].iov_len  = iLength;
+
+  memset(&stMessage, 0, sizeof(stMessage));
+
+  stMessage.msg_iov    = astVector;
+  stMessage.msg_iovlen = iLength ? 2 : 1;
+
+  while (stMessage.msg_iovlen > 0) {
+    if ((iSent = sendmsg(iSocket, &stMessage, MSG_NOSIGNAL)) < 0) {
+      if (errno == EINTR)  continue;
+      return -1;
+    }
+
+    /* Step over whatever went. */
+    while ((stMessage.msg_iovlen > 0) && ((size_t) iSent >= stMessage.msg_iov->iov_len)) {
+      iSent -= stMessage.msg_iov->iov_len;
+      stMessage.msg_iov++;
+      stMessage.msg_iovlen--;
+    }
+
+    if (stMessage.msg_iovlen > 0) {
+      stMessage.msg_iov->iov_base  = (u_char *) stMessage.msg_iov->iov_base + iSent;
+      stMessage.msg_iov->iov_len  -= iSent;
+    }
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_ReadFully(int iSocket, void *pvBuffer, size_t iLength)
+/*
+ * Read exactly the number of bytes given.
+ *
+ *   Input:  iSocket  - The connection.
+ *           pvBuffer - For the bytes.
+ *           iLength  - Bytes to read.
+ *
+ * Returns:  -1 on error (see errno; ECONNRESET if the peer closed the
+ *           connection), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_char  *pBuffer;				/* Current position          */
+  ssize_t iRead;				/* Bytes read by one call    */
+
+
+  for (pBuffer = (u_char *) pvBuffer; iLength > 0; pBuffer += iRead, iLength -= iRead) {
+    if ((iRead = recv(iSocket, pBuffer, iLength, 0)) < 0) {
+      if (errno == EINTR) {
+        iRead = 0;
+        continue;
+      }
+
+      return -1;
+    }
+
+    if (iRead == 0) {
+      errno = ECONNRESET;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_ReadFrame(int iSocket, struct NetFrame_t *pstFrame)
+/*
+ * Read a frame's header.  The payload, if any, is left to be read.
+ *
+ *   Input:  iSocket  - The connection.
+ *           pstFrame - For the header.
+ *
+ * Returns:  -1 on error (see errno; EPROTO if the payload is too long),
+ *           0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_char aHeader[kiNet_HeaderLength];		/* The frame's header        */
+
+
+  if (fnNet_ReadFully(iSocket, aHeader, sizeof(aHeader)) < 0)  return -1;
+
+  pstFrame->lType    = (u_int32_t) fnNet_GetBE(aHeader, 4);
+  pstFrame->lTrack   = (u_int32_t) fnNet_GetBE(aHeader + 4, 4);
+  pstFrame->llOffset = fnNet_GetBE(aHeader + 8, 8);
+  pstFrame->lLength  = (u_int32_t) fnNet_GetBE(aHeader + 16, 4);
+  pstFrame->lValue   = (u_int32_t) fnNet_GetBE(aHeader + 20, 4);
+
+  if (pstFrame->lLength > kiNet_MaxPayload) {
+    errno = EPROTO;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_Connect(struct NetSink_t *pstSink)
+/*
+ * Connect to daex-recv, and greet it.
+ *
+ *   Input:  pstSink - The sink, not connected.
+ * Returns:  -1 on error (see errno; EPROTO if it isn't daex-recv, or
+ *           speaks another version), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct sockaddr_in stAddress;			/* daex-recv's address       */
+  struct hostent     *pstHostEntry;		/* ... looked up by name     */
+  struct NetFrame_t  stFrame;			/* Its greeting              */
+
+
+  memset(&stAddress, 0, sizeof(stAddress));
+
+  stAddress.sin_family = AF_INET;
+  stAddress.sin_port   = htons(pstSink->iPort);
+
+  if (!inet_aton(pstSink->szHost, &stAddress.sin_addr)) {
+    if (! (pstHostEntry = gethostbyname(pstSink->szHost))) {
+      errno = EHOSTUNREACH;
+      return -1;
+    }
+
+    stAddress.sin_addr = * (struct in_addr *) pstHostEntry->h_addr_list[0];
+  }
+
+  if ((pstSink->iSocket = socket(AF_INET, SOCK_STREAM, 0)) < 0)  return -1;
+
+  fnNet_Options(pstSink->iSocket);
+
+  if ((connect(pstSink->iSocket, (struct sockaddr *) &stAddress, sizeof(stAddress)) < 0) ||
+      (fnNet_SendFrame(pstSink->iSocket, kiNet_Hello, 0, pstSink->iWindow, kiNet_Version,
+                       NULL, 0) < 0) ||
+      (fnNet_ReadFrame(pstSink->iSocket, &stFrame) < 0))
+    goto failed;
+
+  if ((stFrame.lType != kiNet_Hello) || (stFrame.lValue != kiNet_Version)) {
+    errno = EPROTO;
+    goto failed;
+  }
+
+  return 0;
+
+  failed:
+  close(pstSink->iSocket);
+  pstSink->iSocket = -1;
+
+  return -1;
+}
+
+
+/*========================================================================*/
+int
+fnNet_Open(struct NetSink_t *pstSink, u_int64_t *pllHeld)
+/*
+ * Ask daex-recv for the current track's file.
+ *
+ *   Input:  pstSink - The sink, connected.
+ *           pllHeld - For the bytes of the file it already holds.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct NetFrame_t stFrame;			/* Its answer                */
+
+
+  if ((fnNet_SendFrame(pstSink->iSocket, kiNet_Open, pstSink->iTrack, 0, 0,
+                       pstSink->szFilename, strlen(pstSink->szFilename)) < 0) ||
+      (fnNet_ReadFrame(pstSink->iSocket, &stFrame) < 0))
+    return -1;
+
+  if ((stFrame.lType != kiNet_Resume) || (stFrame.lTrack != (u_int32_t) pstSink->iTrack) ||
+      (stFrame.lLength != 0)) {
+    errno = EPROTO;
+    return -1;
+  }
+
+  *pllHeld = stFrame.llOffset;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_Transmit(struct NetSink_t *pstSink, u_int64_t llFrom, u_int64_t llTo)
+/*
+ * Send part of the file from the window.
+ *
+ *   Input:  pstSink - The sink, connected.
+ *           llFrom  - Offset of the first byte.
+ *           llTo    - Offset after the last.  Both must be in the window.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  size_t iPosition,				/* Place in the window       */
+         iChunk;				/* Bytes in the frame        */
+
+
+  for (; llFrom < llTo; llFrom += iChunk) {
+    iPosition = llFrom % pstSink->iWindow;
+    iChunk    = pstSink->iWindow - iPosition;
+
+    if (iChunk > llTo - llFrom)     iChunk = llTo - llFrom;
+    if (iChunk > kiNet_MaxPayload)  iChunk = kiNet_MaxPayload;
+
+    if (fnNet_SendFrame(pstSink->iSocket, kiNet_Data, pstSink->iTrack, llFrom, 0,
+                        pstSink->pWindow + iPosition, iChunk) < 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_Receive(struct NetSink_t *pstSink, int iWait)
+/*
+ * Take in daex-recv's acknowledgements.
+ *
+ *   Input:  pstSink - The sink, connected.
+ *           iWait   - Wait for one, if none have arrived (flag).
+ *
+ * Returns:  -1 on error (see errno; ETIMEDOUT if none came), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct pollfd     stPoll;			/* Waiting for the socket    */
+  struct NetFrame_t stFrame;			/* An acknowledgement        */
+  int    iReady;				/* Frames have arrived       */
+
+
+  stPoll.fd     = pstSink->iSocket;
+  stPoll.events = POLLIN;
+
+  for (;;) {
+    if ((iReady = poll(&stPoll, 1, iWait ? kiNet_Timeout * 1000 : 0)) < 0) {
+      if (errno == EINTR)  continue;
+      return -1;
+    }
+
+    if (iReady == 0) {
+      if (!iWait)  return 0;
+
+      errno = ETIMEDOUT;
+      return -1;
+    }
+
+    if (fnNet_ReadFrame(pstSink->iSocket, &stFrame) < 0)  return -1;
+
+    if ((stFrame.lType != kiNet_Ack) || (stFrame.lTrack != (u_int32_t) pstSink->iTrack) ||
+        (stFrame.lLength != 0) || (stFrame.llOffset > pstSink->llProduced)) {
+      errno = EPROTO;
+      return -1;
+    }
+
+    if (stFrame.llOffset > pstSink->llAcked)
+      pstSink->llAcked = stFrame.llOffset;
+
+    iWait = 0;
+  }
+}
+
+
+/*========================================================================*/
+int
+fnNet_Reconnect(struct NetSink_t *pstSink)
+/*
+ * Reopen a lost connection, and pick the current track up from where
+ * daex-recv says it has got to.  Attempts are spaced out, doubling from a
+ * second.
+ *
+ *   Input:  pstSink - The sink.
+ * Returns:  -1 if it can't be done (see errno; ESPIPE if daex-recv holds
+ *           less than is left in the window), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_int64_t llHeld,				/* Bytes daex-recv holds     */
+            llOldest;				/* Oldest byte in the window */
+  int       iTry;				/* Current attempt           */
+
+
+  if (errno == EPROTO)  return -1;
+
+  fprintf(stderr, "\nDAEX: Lost the connection to %s:%i (%s).  Reconnecting.\n",
+          pstSink->szHost, pstSink->iPort, strerror(errno));
+
+  llOldest = (pstSink->llProduced > pstSink->iWindow) ?
+             pstSink->llProduced - pstSink->iWindow : 0;
+
+  if (llOldest < pstSink->llSkip)  llOldest = pstSink->llSkip;
+
+  for (iTry = 0; iTry < kiNet_Retries; iTry++) {
+    if (pstSink->iSocket >= 0)  close(pstSink->iSocket);
+
+    pstSink->iSocket = -1;
+
+    sleep(1 << iTry);
+
+    if (fnNet_Connect(pstSink) < 0)  continue;
+
+    pstSink->iReconnects++;
+
+    if (!pstSink->iTrack)  return 0;
+
+    if (fnNet_Open(pstSink, &llHeld) < 0)  continue;
+
+    if ((llHeld < llOldest) || (llHeld > pstSink->llProduced)) {
+      errno = ESPIPE;
+      return -1;
+    }
+
+    pstSink->llAcked = llHeld;
+
+    if (fnNet_Transmit(pstSink, llHeld, pstSink->llProduced) == 0)
+      return 0;
+  }
+
+  return -1;
+}
+
+
+/*========================================================================*/
+int
+fnNet_Initialize(struct NetSink_t *pstSink, char *szHost, int iPort, size_t iWindow)
+/*
+ * Connect to daex-recv.
+ *
+ *   Input:  pstSink - The sink.
+ *           szHost  - daex-recv's host.
+ *           iPort   - ... and port.
+ *           iWindow - Bytes which may be sent before they're acknowledged.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  memset(pstSink, 0, sizeof(struct NetSink_t));
+
+  pstSink->iSocket = -1;
+  pstSink->iPort   = iPort;
+  pstSink->iWindow = iWindow;
+
+  if (! (pstSink->szHost = strdup(szHost)) ||
+      ! (pstSink->pWindow = (u_char *) malloc(iWindow))) {
+    fnNet_Dispose(pstSink);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  if (fnNet_Connect(pstSink) < 0) {
+    fnNet_Dispose(pstSink);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_StartTrack(struct NetSink_t *pstSink, int iTrack, char *szFilename)
+/*
+ * Start sending a track's file.  Should daex-recv already hold part of it,
+ * from a transfer that was cut off, that much is not sent again.
+ *
+ *   Input:  pstSink    - The sink.
+ *           iTrack     - The track.
+ *           szFilename - Its file's name; only the last part is used.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ *
+ *           pstSink    - llSkip is the bytes already held.
+ */
+/*========================================================================*/
+{
+  u_int64_t llHeld;				/* Bytes daex-recv holds     */
+
+
+  snprintf(pstSink->szFilename, sizeof(pstSink->szFilename), "%s",
+           strrchr(szFilename, '/') ? strrchr(szFilename, '/') + 1 : szFilename);
+
+  pstSink->iTrack     = iTrack;
+  pstSink->llProduced = 0;
+  pstSink->llAcked    = 0;
+  pstSink->llSkip     = 0;
+  pstSink->lCRC       = 0;
+
+  while ((pstSink->iSocket < 0) || (fnNet_Open(pstSink, &llHeld) < 0)) {
+    pstSink->iTrack = 0;
+
+    if (fnNet_Reconnect(pstSink) < 0)  return -1;
+
+    pstSink->iTrack = iTrack;
+  }
+
+  pstSink->llSkip  = llHeld;
+  pstSink->llAcked = llHeld;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_Send(struct NetSink_t *pstSink, const u_char *pData, size_t iLength)
+/*
+ * Send the next part of the track's file.  It is copied into the window,
+ * to be sent again should the connection be lost before daex-recv has
+ * acknowledged it.  Once the window is full, this waits for daex-recv.
+ *
+ *   Input:  pstSink - The sink, with a track started.
+ *           pData   - The data.
+ *           iLength - Bytes of data.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  size_t iPosition,				/* Place in the window       */
+         iChunk;				/* Bytes sent at once        */
+
+
+  pstSink->lCRC = fnCRC_Update(pstSink->lCRC, pData, iLength);
+
+  for (; iLength > 0; pData += iChunk, iLength -= iChunk) {
+    /* daex-recv has the start of the file already. */
+    if (pstSink->llProduced < pstSink->llSkip) {
+      iChunk = (pstSink->llSkip - pstSink->llProduced < iLength) ?
+               (size_t) (pstSink->llSkip - pstSink->llProduced) : iLength;
+
+      pstSink->llProduced += iChunk;
+      continue;
+    }
+
+    iPosition = pstSink->llProduced % pstSink->iWindow;
+    iChunk    = pstSink->iWindow - (size_t) (pstSink->llProduced - pstSink->llAcked);
+
+    if (iChunk > pstSink->iWindow - iPosition)  iChunk = pstSink->iWindow - iPosition;
+    if (iChunk > kiNet_MaxPayload)              iChunk = kiNet_MaxPayload;
+    if (iChunk > iLength)                       iChunk = iLength;
+
+    /* The window is full. */
+    if (iChunk == 0) {
+      if ((fnNet_Receive(pstSink, 1) < 0) && (fnNet_Reconnect(pstSink) < 0))
+        return -1;
+
+      continue;
+    }
+
+    memcpy(pstSink->pWindow + iPosition, pData, iChunk);
+
+    pstSink->llProduced += iChunk;
+
+    if (((fnNet_Transmit(pstSink, pstSink->llProduced - iChunk, pstSink->llProduced) < 0) ||
+         (fnNet_Receive(pstSink, 0) < 0)) &&
+        (fnNet_Reconnect(pstSink) < 0))
+      return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnNet_EndTrack(struct NetSink_t *pstSink)
+/*
+ * Finish the track's file, and wait for daex-recv to check it against its
+ * length and CRC-32 and put it in place.
+ *
+ *   Input:  pstSink - The sink, with a track started.
+ * Returns:  -1 on error (see errno; EIO if daex-recv's copy doesn't match
+ *           or couldn't be written), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct NetFrame_t stFrame;			/* daex-recv's answer        */
+  int    iResult;				/* Result of the last read   */
+
+
+  for (;;) {
+    if (fnNet_SendFrame(pstSink->iSocket, kiNet_Close, pstSink->iTrack, pstSink->llProduced,
+                        pstSink->lCRC, NULL, 0) == 0) {
+      /* Acknowledgements still on their way come first. */
+      while (((iResult = fnNet_ReadFrame(pstSink->iSocket, &stFrame)) == 0) &&
+             (stFrame.lType == kiNet_Ack))
+        ;
+
+      if (iResult == 0)  break;
+    }
+
+    if (fnNet_Reconnect(pstSink) < 0)  return -1;
+  }
+
+  pstSink->iTrack = 0;
+
+  if ((stFrame.lType != kiNet_Finished) || (stFrame.lLength != 0)) {
+    errno = EPROTO;
+    return -1;
+  }
+
+  if (stFrame.lValue != kiNet_Complete) {
+    errno = EIO;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnNet_Dispose(struct NetSink_t *pstSink)
+/*
+ * Close the connection, and free the sink's memory.
+ */
+/*========================================================================*/
+{
+  if (pstSink->iSocket >= 0)
+    close(pstSink->iSocket);
+
+  if (pstSink->pWindow)
+    free(pstSink->pWindow);
+
+  if (pstSink->szHost)
+    free(pstSink->szHost);
+
+  pstSink->iSocket = -1;
+  pstSink->pWindow = NULL;
+  pstSink->szHost  = NULL;
+}
+
+/* EOF */
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX  - The Digital Audio EXtractor
+ *
+ * net.h - Header for the network sink, and a description of the protocol
+ *         spoken between DAEX and daex-recv.
+ *
+ * $Id$
+ */
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+
+/* DAEX connects to daex-recv over TCP.  Everything sent either way is a
+ * frame: a 24 byte header, with every field big-endian,
+ *
+ *   type    4 bytes   kiNet_*
+ *   track   4 bytes   The track the frame is about
+ *   offset  8 bytes   A byte offset in the track's file
+ *   length  4 bytes   Bytes of payload following the header
+ *   value   4 bytes   Depends on the type
+ *
+ * followed by the payload, of at most kiNet_MaxPayload bytes.
+ *
+ *   HELLO     DAEX   -> recv   value: kiNet_Version, offset: DAEX's window
+ *             recv   -> DAEX   value: kiNet_Version
+ *   OPEN      DAEX   -> recv   payload: the file's name
+ *   RESUME    recv   -> DAEX   offset: bytes of the file already held
+ *   DATA      DAEX   -> recv   offset: where the payload goes in the file
+ *   ACK       recv   -> DAEX   offset: bytes of the file written so far
+ *   CLOSE     DAEX   -> recv   offset: the file's length, value: its CRC-32
+ *   FINISHED  recv   -> DAEX   value: 0 if the file is complete and its
+ *                              CRC-32 matches, else non-zero
+ *
+ * Each track's file is the byte stream DAEX would have written to a pipe in
+ * the -w format.  daex-recv keeps it as "name.part" until it is finished,
+ * so that a transfer that is cut off may be resumed from the RESUME offset,
+ * by the same run of DAEX once it has reconnected, or by a later one.
+ *
+ * Flow control: DAEX keeps no more than its window of data unacknowledged,
+ * and daex-recv acknowledges at least every quarter window.  The window is
+ * also what DAEX resends from after reconnecting.
+ */
+
+#define kiNet_Version		1		/* HELLO's value                       */
+#define kiNet_DefaultPort	7786		/* daex-recv's port, by default        */
+#define kiNet_DefaultWindow	4		/* Mbytes unacknowledged, by default   */
+#define kiNet_HeaderLength	24		/* Bytes in a frame's header           */
+#define kiNet_MaxPayload	(64 * 1024)	/* Bytes in a frame's payload, at most */
+#define kiNet_Timeout		30		/* Seconds before a silent peer is     */
+						/* given up on                         */
+#define kiNet_Retries		5		/* Reconnections tried in a row        */
+
+/* FINISHED's value */
+#define kiNet_Complete		0	/* The file is complete, and renamed        */
+#define kiNet_Mismatch		1	/* Its length or CRC-32 is not DAEX's       */
+#define kiNet_Failed		2	/* It could not be written                  */
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL		0	/* A dead peer is an EPIPE, not a SIGPIPE   */
+#endif
+
+/* Frame types */
+#define kiNet_Hello		1
+#define kiNet_Open		2
+#define kiNet_Resume		3
+#define kiNet_Data		4
+#define kiNet_Ack		5
+#define kiNet_Close		6
+#define kiNet_Finished		7
+
+/* A frame's header, decoded. */
+struct NetFrame_t {
+  u_int32_t lType,                  /* kiNet_*                                     */
+            lTrack;                 /* The track                                   */
+  u_int64_t llOffset;               /* A byte offset in the track's file           */
+  u_int32_t lLength,                /* Bytes of payload                            */
+            lValue;                 /* Depends on the type                         */
+};
+
+/* DAEX's end of the connection. */
+struct NetSink_t {
+  char      *szHost;                /* daex-recv's host                            */
+  int       iPort;                  /* ... and port                                */
+  int       iSocket;                /* The connection, or -1                       */
+  size_t    iWindow;                /* Bytes which may be unacknowledged           */
+  u_char    *pWindow;               /* The unacknowledged bytes, by offset modulo  */
+                                    /* iWindow                                     */
+  int       iTrack;                 /* The track being sent, or 0                  */
+  char      szFilename[kiMaxStringLength]; /* ... and its file's name              */
+  u_int64_t llSkip,                 /* Bytes daex-recv held at the start           */
+            llProduced,             /* Bytes of the file handed to the sink        */
+            llAcked;                /* Bytes daex-recv has acknowledged            */
+  u_int32_t lCRC;                   /* CRC-32 of the file so far                   */
+  int       iReconnects;            /* Reconnections, over the whole run           */
+};
+
+/* Network function prototypes -- frames, for both ends ... */
+int   fnNet_SendFrame(int iSocket, int iType, int iTrack, u_int64_t llOffset, u_int32_t lValue,
+                      const void *pvPayload, size_t iLength);
+int   fnNet_ReadFully(int iSocket, void *pvBuffer, size_t iLength);
+int   fnNet_ReadFrame(int iSocket, struct NetFrame_t *pstFrame);
+void  fnNet_Options(int iSocket);
+
+/* ... and the sink. */
+int   fnNet_Initialize(struct NetSink_t *pstSink, char *szHost, int iPort, size_t iWindow);
+int   fnNet_StartTrack(struct NetSink_t *pstSink, int iTrack, char *szFilename);
+int   fnNet_Send(struct NetSink_t *pstSink, const u_char *pData, size_t iLength);
+int   fnNet_EndTrack(struct NetSink_t *pstSink);
+void  fnNet_Dispose(struct NetSink_t *pstSink);
+
+/* EOF */
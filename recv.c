@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX   - The Digital Audio EXtractor
+ *
+ * recv.c - daex-recv: receives the tracks DAEX streams over the network
+ *          (daex -N), and writes them to a directory.  A file arrives as
+ *          "name.part", and is renamed once its length and CRC-32 are found
+ *          to match DAEX's; a transfer that is cut off resumes from there.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "checksum.h"
+#include "net.h"
+#include "recv.h"
+
+
+/*========================================================================*/
+void
+fnRecv_Usage(void)
+/*
+ * Displays information on how to use daex-recv from the command line.
+ *
+ *   Input:  None.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  fprintf(stderr, "usage: daex-recv [-1] [-d directory] [-p port]\n\n");
+
+  fprintf(stderr, "   -1               :  Exit once the first connection closes.\n");
+  fprintf(stderr, "   -d directory     :  Write the files received here. (default: .)\n");
+  fprintf(stderr, "   -p port          :  Listen on the specified port. (default: %i)\n\n",
+          kiNet_DefaultPort);
+
+  exit(kiExitStatus_General);
+}
+
+
+/*========================================================================*/
+int
+fnRecv_Open(struct RecvFile_t *pstFile, char *szDirectory, char *szName, int iTrack)
+/*
+ * Open a track's partial file, creating it if need be, and take the CRC-32
+ * of whatever it already holds.  Should a complete file of that name
+ * exist, an alternate name is found for the new one, as DAEX does.
+ *
+ *   Input:  pstFile     - The file, not open.
+ *           szDirectory - The directory to write to.
+ *           szName      - The file's name, as sent.
+ *           iTrack      - The track.
+ *
+ * Returns:  -1 on error (see errno; EINVAL for a name that isn't a plain
+ *           filename, ENAMETOOLONG for one too long), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_char  aBuffer[kiNet_MaxPayload];		/* What's held, being read   */
+  struct stat stStatus;				/* A complete file's status  */
+  ssize_t iRead;				/* Bytes read by one call    */
+  int     iDupe,				/* Alternate names tried     */
+          iLength;				/* The last name's length    */
+
+
+  if (!szName[0] || (szName[0] == '.') || strchr(szName, '/')) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  iLength = snprintf(pstFile->szFilename, sizeof(pstFile->szFilename), "%s/%s", szDirectory,
+                     szName);
+
+  for (iDupe = 1; (iLength < (int) sizeof(pstFile->szFilename)) &&
+                  (stat(pstFile->szFilename, &stStatus) == 0) && (iDupe <= kiRecv_MaxDupes);
+       iDupe++)
+    iLength = snprintf(pstFile->szFilename, sizeof(pstFile->szFilename), "%s/%s.%i", szDirectory,
+                       szName, iDupe);
+
+  if (iDupe > kiRecv_MaxDupes) {
+    errno = EEXIST;
+    return -1;
+  }
+
+  /* A name cut short could be another file's. */
+  if ((iLength >= (int) sizeof(pstFile->szFilename)) ||
+      (snprintf(pstFile->szPartname, sizeof(pstFile->szPartname), "%s%s", pstFile->szFilename,
+                kszRecv_PartSuffix) >= (int) sizeof(pstFile->szPartname))) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if ((pstFile->iFileDesc = open(pstFile->szPartname, O_RDWR | O_CREAT, 0644)) < 0)
+    return -1;
+
+  pstFile->iTrack   = iTrack;
+  pstFile->llLength = 0;
+  pstFile->lCRC     = 0;
+
+  while ((iRead = read(pstFile->iFileDesc, aBuffer, sizeof(aBuffer))) > 0) {
+    pstFile->lCRC      = fnCRC_Update(pstFile->lCRC, aBuffer, iRead);
+    pstFile->llLength += iRead;
+  }
+
+  pstFile->llAcked = pstFile->llLength;
+
+  if (iRead < 0) {
+    close(pstFile->iFileDesc);
+    pstFile->iFileDesc = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnRecv_Write(struct RecvFile_t *pstFile, u_int64_t llOffset, u_char *pData, size_t iLength)
+/*
+ * Append data to the partial file.  Data resent after a reconnection may
+ * start before the end of what's held; that much is skipped.
+ *
+ *   Input:  pstFile  - The file, open.
+ *           llOffset - Where the data goes in the file, no further than
+ *                      its end.
+ *           pData    - The data.
+ *           iLength  - Bytes of data.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  ssize_t iWritten;				/* Bytes written by one call */
+
+
+  if (llOffset + iLength <= pstFile->llLength)  return 0;
+
+  pData   += pstFile->llLength - llOffset;
+  iLength -= pstFile->llLength - llOffset;
+
+  pstFile->lCRC = fnCRC_Update(pstFile->lCRC, pData, iLength);
+
+  for (; iLength > 0; pData += iWritten, iLength -= iWritten) {
+    if ((iWritten = pwrite(pstFile->iFileDesc, pData, iLength, (off_t) pstFile->llLength)) < 0) {
+      if (errno == EINTR) {
+        iWritten = 0;
+        continue;
+      }
+
+      return -1;
+    }
+
+    pstFile->llLength += iWritten;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnRecv_Finish(struct RecvFile_t *pstFile, u_int64_t llLength, u_int32_t lCRC)
+/*
+ * Finish a file: if it is the length DAEX says, with the same CRC-32, put
+ * it on disk and give it its name.  If not, throw it away, so that it is
+ * sent again from the start next time.
+ *
+ *   Input:  pstFile  - The file, open.
+ *           llLength - The file's length, according to DAEX.
+ *           lCRC     - ... and its CRC-32.
+ *
+ * Returns:  kiNet_Complete, kiNet_Mismatch or kiNet_Failed.
+ */
+/*========================================================================*/
+{
+  int iStatus = kiNet_Complete;			/* The result                */
+
+
+  if ((pstFile->llLength != llLength) || (pstFile->lCRC != lCRC)) {
+    fprintf(stderr, "daex-recv: %s doesn't match what was sent; discarded.\n",
+            pstFile->szFilename);
+    unlink(pstFile->szPartname);
+    iStatus = kiNet_Mismatch;
+
+  } else if ((fsync(pstFile->iFileDesc) < 0) ||
+             (rename(pstFile->szPartname, pstFile->szFilename) < 0)) {
+    fprintf(stderr, "daex-recv: Unable to write %s: %s.\n", pstFile->szFilename,
+            strerror(errno));
+    iStatus = kiNet_Failed;
+
+  } else
+    fprintf(stderr, "daex-recv: Received %s (%llu bytes).\n", pstFile->szFilename,
+            (unsigned long long) llLength);
+
+  close(pstFile->iFileDesc);
+  pstFile->iFileDesc = -1;
+
+  return iStatus;
+}
+
+
+/*========================================================================*/
+int
+fnRecv_Serve(int iSocket, char *szDirectory)
+/*
+ * Receive files over a connection from DAEX, until it closes.  A file
+ * left unfinished is kept, to be resumed.
+ *
+ *   Input:  iSocket     - The connection.
+ *           szDirectory - The directory to write to.
+ *
+ * Returns:  -1 if the connection failed, or DAEX broke the protocol, 0 if
+ *           it closed the connection between frames.
+ */
+/*========================================================================*/
+{
+  u_char    aPayload[kiNet_MaxPayload + 1];	/* A frame's payload         */
+  struct NetFrame_t stFrame;			/* A frame                   */
+  struct RecvFile_t stFile;			/* The file being received   */
+  u_int64_t llInterval;				/* Bytes between acks        */
+  int       iStatus,				/* A file's result           */
+            iReturnValue = -1;			/* Return value              */
+
+
+  memset(&stFile, 0, sizeof(stFile));
+  stFile.iFileDesc = -1;
+
+  fnNet_Options(iSocket);
+
+  if ((fnNet_ReadFrame(iSocket, &stFrame) < 0) || (stFrame.lType != kiNet_Hello)) {
+    fprintf(stderr, "daex-recv: Not a DAEX connection.\n");
+    return -1;
+  }
+
+  /* Answer in any case, so that DAEX can say why it won't work. */
+  if ((fnNet_SendFrame(iSocket, kiNet_Hello, 0, 0, kiNet_Version, NULL, 0) < 0) ||
+      (stFrame.lValue != kiNet_Version))
+    return -1;
+
+  /* Acknowledge often enough that DAEX never waits on a full window. */
+  llInterval = (stFrame.llOffset / 4) ? stFrame.llOffset / 4 : 1;
+
+  for (;;) {
+    if (fnNet_ReadFrame(iSocket, &stFrame) < 0) {
+      if (errno == ECONNRESET)  iReturnValue = 0;
+      break;
+    }
+
+    if (stFrame.lLength && (fnNet_ReadFully(iSocket, aPayload, stFrame.lLength) < 0))
+      break;
+
+    if ((stFrame.lType != kiNet_Open) &&
+        ((stFile.iFileDesc < 0) || (stFrame.lTrack != (u_int32_t) stFile.iTrack))) {
+      errno = EPROTO;
+      break;
+    }
+
+    if (stFrame.lType == kiNet_Open) {
+      aPayload[stFrame.lLength] = '\0';
+
+      if (stFile.iFileDesc >= 0)  close(stFile.iFileDesc);
+
+      if (fnRecv_Open(&stFile, szDirectory, (char *) aPayload, stFrame.lTrack) < 0) {
+        fprintf(stderr, "daex-recv: Unable to open \"%s\": %s.\n", aPayload, strerror(errno));
+        break;
+      }
+
+      if (fnNet_SendFrame(iSocket, kiNet_Resume, stFile.iTrack, stFile.llLength, 0, NULL, 0) < 0)
+        break;
+
+    } else if (stFrame.lType == kiNet_Data) {
+      if (stFrame.llOffset > stFile.llLength) {
+        errno = EPROTO;
+        break;
+      }
+
+      if (fnRecv_Write(&stFile, stFrame.llOffset, aPayload, stFrame.lLength) < 0) {
+        fprintf(stderr, "daex-recv: Unable to write %s: %s.\n", stFile.szPartname,
+                strerror(errno));
+        break;
+      }
+
+      if (stFile.llLength - stFile.llAcked >= llInterval) {
+        if (fnNet_SendFrame(iSocket, kiNet_Ack, stFile.iTrack, stFile.llLength, 0, NULL, 0) < 0)
+          break;
+
+        stFile.llAcked = stFile.llLength;
+      }
+
+    } else if (stFrame.lType == kiNet_Close) {
+      iStatus = fnRecv_Finish(&stFile, stFrame.llOffset, stFrame.lValue);
+
+      if (fnNet_SendFrame(iSocket, kiNet_Finished, stFrame.lTrack, stFrame.llOffset, iStatus,
+                          NULL, 0) < 0)
+        break;
+
+    } else {
+      errno = EPROTO;
+      break;
+    }
+  }
+
+  if (iReturnValue < 0)
+    fprintf(stderr, "daex-recv: Connection closed: %s.\n", strerror(errno));
+
+  if (stFile.iFileDesc >= 0)
+    close(stFile.iFileDesc);
+
+  return iReturnValue;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  extern int  optind;		/* The current argument number - getopt()    */
+  extern char *optarg;		/* Current option's arg. string - getopt()   */
+
+  struct sockaddr_in stAddress;			/* Where to listen           */
+  char   *szDirectory = ".";			/* Where to write            */
+  int    iArgument,				/* Current getopt() argument */
+         iListener,				/* The listening socket      */
+         iSocket,				/* A connection              */
+         iPort = kiNet_DefaultPort,		/* The port                  */
+         iOnce = 0,				/* Exit after one connection */
+         iOn = 1,				/* Option value              */
+         iReturnValue = 0;			/* Result of the last one    */
+
+
+  while ((iArgument = getopt(argc, argv, "1d:p:")) != -1) {
+    switch (iArgument) {
+      case '1':					/* One connection            */
+        iOnce = 1;
+        break;
+
+      case 'd':					/* Directory                 */
+        szDirectory = optarg;
+        break;
+
+      case 'p':					/* Port                      */
+        if (((iPort = atoi(optarg)) < 1) || (iPort > 65535)) {
+          fprintf(stderr, "daex-recv: The port must be from 1 to 65535.\n");
+          exit(kiExitStatus_General);
+        }
+        break;
+
+      case '?':
+      default:
+        fnRecv_Usage();
+    }
+  }
+
+  if (argc != optind)  fnRecv_Usage();
+
+  fnCRC_Initialize();
+
+  signal(SIGPIPE, SIG_IGN);
+
+  memset(&stAddress, 0, sizeof(stAddress));
+
+  stAddress.sin_family      = AF_INET;
+  stAddress.sin_port        = htons(iPort);
+  stAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (((iListener = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+      (setsockopt(iListener, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn)) < 0) ||
+      (bind(iListener, (struct sockaddr *) &stAddress, sizeof(stAddress)) < 0) ||
+      (listen(iListener, kiRecv_Backlog) < 0)) {
+    fprintf(stderr, "daex-recv: Unable to listen on port %i: %s.\n", iPort, strerror(errno));
+    exit(kiExitStatus_General);
+  }
+
+  fprintf(stderr, "daex-recv: Listening on port %i, writing to %s.\n", iPort, szDirectory);
+
+  /* One DAEX at a time.  A DAEX which reconnects waits for its old
+   * connection to be closed.
+   */
+  for (;;) {
+    if ((iSocket = accept(iListener, NULL, NULL)) < 0) {
+      if (errno == EINTR)  continue;
+
+      fprintf(stderr, "daex-recv: Unable to accept a connection: %s.\n", strerror(errno));
+      exit(kiExitStatus_General);
+    }
+
+    iReturnValue = fnRecv_Serve(iSocket, szDirectory);
+
+    close(iSocket);
+
+    if (iOnce)  break;
+  }
+
+  close(iListener);
+
+  return (iReturnValue < 0) ? kiExitStatus_General : 0;
+}
+
+/* EOF */
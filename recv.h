@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX   - The Digital Audio EXtractor
+ *
+ * recv.h - Header for daex-recv, the network sink's receiver.
+ *
+ * $Id$
+ */
+
+#include <signal.h>
+
+#define kiRecv_Backlog		4	/* Connections waiting to be accepted      */
+#define kiRecv_MaxDupes		10	/* Alternate names tried for a file        */
+#define kszRecv_PartSuffix	".part"	/* A file still being received             */
+
+/* A file being received. */
+struct RecvFile_t {
+  int       iFileDesc;              /* The partial file, or -1                     */
+  int       iTrack;                 /* The track it holds                          */
+  char      szFilename[kiMaxStringLength]; /* Its name once complete               */
+  char      szPartname[kiMaxStringLength]; /* ... and until then                   */
+  u_int64_t llLength,               /* Bytes held                                  */
+            llAcked;                /* ... as of the last acknowledgement          */
+  u_int32_t lCRC;                   /* CRC-32 of the bytes held                    */
+};
+
+/* EOF */
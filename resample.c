@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * resample.c - Polyphase sample rate conversion, from CDDA's 44.1 kHz to
+ *              48 kHz or a lower rate, with a Kaiser windowed sinc filter.
+ *              The conversion is streamed a block at a time, and is exact
+ *              in length: n input frames become ceil(n * L / M) output
+ *              frames, aligned with the input.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "resample.h"
+
+/* Quality presets: taps per phase at the lower of the two rates, and the
+ * Kaiser window's beta (which sets the stopband attenuation).
+ */
+static const struct {
+  int    iTaps;
+  double dBeta;
+} astPresets[] = {
+  {  24,  6.0 },				/* kiResample_Low            */
+  {  64,  8.6 },				/* kiResample_Medium         */
+  { 128, 11.5 }					/* kiResample_High           */
+};
+
+
+/*========================================================================*/
+double
+fnResample_Bessel(double dX)
+/*
+ * The zeroth order modified Bessel function of the first kind, I0(x), from
+ * its power series.  Used to build the Kaiser window.
+ */
+/*========================================================================*/
+{
+  double dSum  = 1.0,				/* Series so far             */
+         dTerm = 1.0;				/* Current term              */
+  int    iTerm;					/* Current term number       */
+
+
+  for (iTerm = 1; dTerm > dSum * 1e-12; iTerm++) {
+    dTerm *= (dX / (2.0 * iTerm)) * (dX / (2.0 * iTerm));
+    dSum  += dTerm;
+  }
+
+  return dSum;
+}
+
+
+/*========================================================================*/
+int
+fnResample_GreatestDivisor(int iA, int iB)
+/*
+ * Euclid's algorithm.
+ */
+/*========================================================================*/
+{
+  int iRemainder;				/* iA mod iB                 */
+
+
+  while (iB != 0) {
+    iRemainder = iA % iB;
+    iA = iB;
+    iB = iRemainder;
+  }
+
+  return iA;
+}
+
+
+/*========================================================================*/
+int
+fnResample_Initialize(struct Resampler_t *pstResampler, int iInputRate, int iOutputRate,
+                      int iChannels, int iQuality, int iMaximumFrames)
+/*
+ * Set up a conversion between the rates given, and design its filter.  The
+ * filter's cut-off is placed so that its transition band ends at the lower
+ * of the two Nyquist frequencies, so nothing aliases.
+ *
+ *   Input:  pstResampler   - The resampler.
+ *           iInputRate     - Input sample rate (Hz).
+ *           iOutputRate    - Output sample rate (Hz).
+ *           iChannels      - Channels per frame, 1 or 2.
+ *           iQuality       - Filter quality (kiResample_*).
+ *           iMaximumFrames - Most input frames passed in any one call.
+ *
+ * Returns:  -1 if the conversion is not supported or memory could not be
+ *           allocated, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  double dAttenuation,				/* Stopband attenuation, dB  */
+         dTransition,				/* Transition width          */
+         dCutoff,				/* Cut-off, per filter tap   */
+         dCentre,				/* Centre of the filter      */
+         dOffset,				/* Tap's distance from it    */
+         dSum,					/* Sum of a phase's taps     */
+         *adPhase;				/* One phase's taps          */
+  int    iDivisor,				/* GCD of the rates          */
+         iPhase,				/* Current phase             */
+         iTap,					/* Current tap               */
+         iChannel;				/* Current channel           */
+
+
+  memset(pstResampler, 0, sizeof(struct Resampler_t));
+
+  if ((iOutputRate < kiResample_MinimumRate) || (iOutputRate > kiResample_MaximumRate) ||
+      (iChannels < 1) || (iChannels > 2) || (iQuality < kiResample_Low) || (iQuality > kiResample_High))
+    return -1;
+
+  iDivisor = fnResample_GreatestDivisor(iInputRate, iOutputRate);
+
+  pstResampler->iUp       = iOutputRate / iDivisor;
+  pstResampler->iDown     = iInputRate / iDivisor;
+  pstResampler->iChannels = iChannels;
+
+  if (pstResampler->iUp > kiResample_MaximumPhases)  return -1;
+
+  /* When decimating, the filter must be longer in input frames to keep the
+   * same transition width relative to the output rate.  Round up to a
+   * multiple of four for the vector loop.
+   */
+  pstResampler->iTaps  = astPresets[iQuality].iTaps;
+
+  if (pstResampler->iDown > pstResampler->iUp)
+    pstResampler->iTaps = (pstResampler->iTaps * pstResampler->iDown + pstResampler->iUp - 1) /
+                          pstResampler->iUp;
+
+  pstResampler->iTaps  = (pstResampler->iTaps + 3) & ~3;
+  pstResampler->iDelay = pstResampler->iTaps / 2;
+
+  /* Kaiser's estimates: the attenuation given by beta, and the transition
+   * width (in cycles per tap of the prototype) given by that and the length.
+   */
+  dAttenuation = astPresets[iQuality].dBeta / 0.1102 + 8.7;
+  dTransition  = (dAttenuation - 8.0) /
+                 (2.285 * (pstResampler->iTaps * pstResampler->iUp - 1)) / (2.0 * M_PI);
+  dCutoff      = 0.5 / ((pstResampler->iUp > pstResampler->iDown) ? pstResampler->iUp :
+                                                                    pstResampler->iDown) -
+                 dTransition / 2.0;
+  dCentre      = (double) pstResampler->iDelay * pstResampler->iUp;
+
+  if (! (pstResampler->afCoefficients = (float *) malloc(sizeof(float) * pstResampler->iUp *
+                                                         pstResampler->iTaps * iChannels)))
+    return -1;
+
+  if (! (adPhase = (double *) malloc(sizeof(double) * pstResampler->iTaps))) {
+    fnResample_Dispose(pstResampler);
+    return -1;
+  }
+
+  /* Phase p holds taps p, p + L, p + 2L, ... of the prototype.  Each phase
+   * is scaled to unity gain at DC, which keeps the DC ripple out of the
+   * output.
+   */
+  for (iPhase = 0; iPhase < pstResampler->iUp; iPhase++) {
+    dSum = 0.0;
+
+    for (iTap = 0; iTap < pstResampler->iTaps; iTap++) {
+      dOffset = iPhase + (double) iTap * pstResampler->iUp - dCentre;
+
+      if (fabs(dOffset) >= dCentre)
+        adPhase[iTap] = 0.0;
+      else {
+        adPhase[iTap] = fnResample_Bessel(astPresets[iQuality].dBeta *
+                                          sqrt(1.0 - (dOffset / dCentre) * (dOffset / dCentre))) *
+                        ((dOffset == 0.0) ? 2.0 * dCutoff :
+                                            sin(2.0 * M_PI * dCutoff * dOffset) / (M_PI * dOffset));
+      }
+
+      dSum += adPhase[iTap];
+    }
+
+    /* Stored newest frame last, once per channel. */
+    for (iTap = 0; iTap < pstResampler->iTaps; iTap++)
+      for (iChannel = 0; iChannel < iChannels; iChannel++)
+        pstResampler->afCoefficients[(iPhase * pstResampler->iTaps + iTap) * iChannels + iChannel] =
+          (float) (adPhase[pstResampler->iTaps - 1 - iTap] / dSum);
+  }
+
+  free(adPhase);
+
+  /* The buffer holds a filter's length of past frames, one call's worth of
+   * new ones, and the group delay's worth of silence added by the flush.
+   * The frames before the start are silence, and the first output frame is
+   * centred on the first input frame.
+   */
+  pstResampler->iBufferAllocated = pstResampler->iTaps + iMaximumFrames + pstResampler->iDelay;
+
+  if (! (pstResampler->afBuffer = (float *) calloc(pstResampler->iBufferAllocated,
+                                                   sizeof(float) * iChannels))) {
+    fnResample_Dispose(pstResampler);
+    return -1;
+  }
+
+  pstResampler->iBufferFrames = pstResampler->iTaps - 1 - pstResampler->iDelay;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnResample_Filter(struct Resampler_t *pstResampler, float *afOutput, u_long lLimit)
+/*
+ * Produce as many output frames as the buffered input allows, up to the
+ * limit given, and discard the input frames no longer needed.
+ *
+ *   Input:  pstResampler - The resampler.
+ *           afOutput     - Where to put the output frames.
+ *           lLimit       - Total output frames not to go beyond.
+ *
+ * Returns:  Output frames produced.
+ */
+/*========================================================================*/
+{
+  const float *afFrames,			/* Frames under the filter   */
+              *afTaps;				/* Phase's coefficients      */
+  float  afSum[4];				/* Partial sums              */
+  int    iStart = 0,				/* First frame under filter  */
+         iLength,				/* Floats under the filter   */
+         iOutput = 0,				/* Output frames produced    */
+         iIndex;				/* Current float             */
+#ifdef __SSE2__
+  __m128 vSum;					/* Partial sums              */
+#else
+  int    iLane;					/* Current partial sum       */
+#endif
+
+
+  iLength = pstResampler->iTaps * pstResampler->iChannels;
+
+  while ((iStart + pstResampler->iTaps <= pstResampler->iBufferFrames) &&
+         (pstResampler->lOutputFrames < lLimit)) {
+    afFrames = pstResampler->afBuffer + iStart * pstResampler->iChannels;
+    afTaps   = pstResampler->afCoefficients + pstResampler->iPhase * iLength;
+
+    /* Four partial sums, in the same order with or without SSE2, so that
+     * both give the same result.  With two channels, lanes 0 and 2 are the
+     * left channel and 1 and 3 the right.
+     */
+#ifdef __SSE2__
+    vSum = _mm_setzero_ps();
+
+    for (iIndex = 0; iIndex < iLength; iIndex += 4)
+      vSum = _mm_add_ps(vSum, _mm_mul_ps(_mm_loadu_ps(afTaps + iIndex),
+                                         _mm_loadu_ps(afFrames + iIndex)));
+
+    _mm_storeu_ps(afSum, vSum);
+#else
+    afSum[0] = afSum[1] = afSum[2] = afSum[3] = 0.0f;
+
+    for (iIndex = 0; iIndex < iLength; iIndex += 4)
+      for (iLane = 0; iLane < 4; iLane++)
+        afSum[iLane] += afTaps[iIndex + iLane] * afFrames[iIndex + iLane];
+#endif
+
+    if (pstResampler->iChannels == 2) {
+      afOutput[iOutput * 2]     = afSum[0] + afSum[2];
+      afOutput[iOutput * 2 + 1] = afSum[1] + afSum[3];
+    } else
+      afOutput[iOutput] = (afSum[0] + afSum[2]) + (afSum[1] + afSum[3]);
+
+    iOutput++;
+    pstResampler->lOutputFrames++;
+
+    /* On to the next output frame: M more steps of the L times rate. */
+    pstResampler->iPhase += pstResampler->iDown;
+    iStart               += pstResampler->iPhase / pstResampler->iUp;
+    pstResampler->iPhase %= pstResampler->iUp;
+  }
+
+  /* Keep the frames the next output frame will need.  (A step is at most
+   * M / L frames, which is less than the filter's length, so iStart never
+   * passes the end of the buffer.)
+   */
+  memmove(pstResampler->afBuffer, pstResampler->afBuffer + iStart * pstResampler->iChannels,
+          sizeof(float) * (pstResampler->iBufferFrames - iStart) * pstResampler->iChannels);
+  pstResampler->iBufferFrames -= iStart;
+
+  return iOutput;
+}
+
+
+/*========================================================================*/
+int
+fnResample_ProcessBuffer(struct Resampler_t *pstResampler, const float *afInput,
+                         int iFrames, float *afOutput)
+/*
+ * Resample the frames given.  Output lags the input by the filter's group
+ * delay; fnResample_Flush() produces the rest at the end of the stream.
+ * The output is not clipped: a full scale square wave rings to about 1.26,
+ * and it is left to the converter's store kernels to clip.
+ *
+ *   Input:  pstResampler - The resampler.
+ *           afInput      - The input frames, interleaved, 1.0 == full scale.
+ *           iFrames      - Frames in afInput (at most iMaximumFrames).
+ *           afOutput     - Where to put the output frames.  Must have room
+ *                          for fnResample_Frames() of the frames given, and
+ *                          one more.
+ *
+ * Returns:  Output frames produced.
+ */
+/*========================================================================*/
+{
+  memcpy(pstResampler->afBuffer + pstResampler->iBufferFrames * pstResampler->iChannels,
+         afInput, sizeof(float) * iFrames * pstResampler->iChannels);
+
+  pstResampler->iBufferFrames += iFrames;
+  pstResampler->lInputFrames  += iFrames;
+
+  return fnResample_Filter(pstResampler, afOutput,
+                           fnResample_Frames(pstResampler, pstResampler->lInputFrames));
+}
+
+
+/*========================================================================*/
+int
+fnResample_Flush(struct Resampler_t *pstResampler, float *afOutput)
+/*
+ * Finish the stream: feed the filter a group delay's worth of silence, and
+ * produce the output frames still owed.
+ *
+ *   Input:  pstResampler - The resampler.
+ *           afOutput     - Where to put the output frames.  Must have room
+ *                          for fnResample_Frames() of iTaps frames.
+ *
+ * Returns:  Output frames produced.
+ */
+/*========================================================================*/
+{
+  memset(pstResampler->afBuffer + pstResampler->iBufferFrames * pstResampler->iChannels, 0,
+         sizeof(float) * pstResampler->iDelay * pstResampler->iChannels);
+
+  pstResampler->iBufferFrames += pstResampler->iDelay;
+
+  return fnResample_Filter(pstResampler, afOutput,
+                           fnResample_Frames(pstResampler, pstResampler->lInputFrames));
+}
+
+
+/*========================================================================*/
+u_long
+fnResample_Frames(struct Resampler_t *pstResampler, u_long lInputFrames)
+/*
+ * Output frames which the input frames given become, once flushed.
+ *
+ *   Input:  pstResampler - The resampler.
+ *           lInputFrames - Frames from the start of the stream.
+ *
+ * Returns:  ceil(lInputFrames * L / M).
+ */
+/*========================================================================*/
+{
+  return (u_long) (((unsigned long long) lInputFrames * pstResampler->iUp +
+                    pstResampler->iDown - 1) / pstResampler->iDown);
+}
+
+
+/*========================================================================*/
+void
+fnResample_Dispose(struct Resampler_t *pstResampler)
+/*
+ * Free the resampler's filter and buffer.
+ */
+/*========================================================================*/
+{
+  if (pstResampler->afCoefficients)  free(pstResampler->afCoefficients);
+  if (pstResampler->afBuffer)        free(pstResampler->afBuffer);
+
+  pstResampler->afCoefficients = NULL;
+  pstResampler->afBuffer       = NULL;
+}
+
+/* EOF */
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX       - The Digital Audio EXtractor
+ *
+ * resample.h - Header for the polyphase sample rate converter.
+ *
+ * $Id$
+ */
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Quality presets (fnResample_Initialize's iQuality) */
+#define kiResample_Low		0	/* ~60 dB stopband, passband to ~15 kHz    */
+#define kiResample_Medium	1	/* ~85 dB stopband, passband to ~18 kHz    */
+#define kiResample_High		2	/* ~110 dB stopband, passband to ~19.5 kHz */
+
+#define kiResample_MinimumRate	8000	/* Lowest output rate supported (Hz)       */
+#define kiResample_MaximumRate	48000	/* Highest output rate supported (Hz)      */
+#define kiResample_MaximumPhases 512	/* Largest interpolation factor supported  */
+
+/* State of a rational L/M resampler.  The prototype low-pass filter is split
+ * into L phases of iTaps coefficients each; each output frame is the dot
+ * product of one phase with the last iTaps input frames.  The coefficients
+ * are stored reversed, and repeated once per channel, so that the dot
+ * product runs over interleaved frames in order.  Input frames not yet used
+ * up are carried in afBuffer from one call to the next.
+ */
+struct Resampler_t {
+  int    iUp,                       /* Interpolation factor, L                     */
+         iDown,                     /* Decimation factor, M                        */
+         iTaps,                     /* Coefficients per phase                      */
+         iDelay,                    /* Group delay, in input frames                */
+         iChannels;                 /* Channels per frame                          */
+
+  float  *afCoefficients;           /* [phase][tap][channel]                       */
+
+  float  *afBuffer;                 /* Input frames, interleaved                   */
+  int    iBufferFrames,             /* Frames in afBuffer                          */
+         iBufferAllocated,          /* Frames allocated                            */
+         iPhase;                    /* Phase of the next output frame              */
+
+  u_long lInputFrames,              /* Frames taken in                             */
+         lOutputFrames;             /* Frames put out                              */
+};
+
+/* Resampler function prototypes. */
+int    fnResample_Initialize(struct Resampler_t *pstResampler, int iInputRate, int iOutputRate,
+                             int iChannels, int iQuality, int iMaximumFrames);
+int    fnResample_ProcessBuffer(struct Resampler_t *pstResampler, const float *afInput,
+                                int iFrames, float *afOutput);
+int    fnResample_Flush(struct Resampler_t *pstResampler, float *afOutput);
+u_long fnResample_Frames(struct Resampler_t *pstResampler, u_long lInputFrames);
+void   fnResample_Dispose(struct Resampler_t *pstResampler);
+
+/* EOF */
@@ -0,0 +1,570 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX   - The Digital Audio EXtractor
+ *
+ * ring.c - Shared memory ring.  Tracks are published a slot at a time into
+ *          a named shared memory object, which any number of programs on
+ *          the same host may map and read in place.  Audio is read from
+ *          the drive straight into the slots.  See ring.h for the layout.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "resample.h"
+#include "convert.h"
+#include "ring.h"
+
+
+/*========================================================================*/
+void
+fnRing_Pause(void)
+/*
+ * Wait a moment before looking at the ring again.
+ */
+/*========================================================================*/
+{
+  struct timespec stPause;			/* How long                  */
+
+
+  stPause.tv_sec  = 0;
+  stPause.tv_nsec = kiRing_PollInterval * 1000000L;
+
+  nanosleep(&stPause, NULL);
+}
+
+
+/*========================================================================*/
+u_int64_t
+fnRing_Slowest(struct SharedRing_t *pstRing, int iReap)
+/*
+ * Find the slot the slowest reader is waiting for.
+ *
+ *   Input:  pstRing - The ring, being written.
+ *           iReap   - Free the entries of readers which have exited,
+ *                     rather than wait for them (flag).
+ *
+ * Returns:  The slot, or kllRing_Free if no-one is reading.
+ */
+/*========================================================================*/
+{
+  u_int64_t llSlowest = kllRing_Free,		/* Slowest reader's slot     */
+            llCursor;				/* Current reader's slot     */
+  pid_t     tReader;				/* Current reader            */
+  int       iIndex;				/* Current entry             */
+
+
+  for (iIndex = 0; iIndex < kiRing_MaxReaders; iIndex++) {
+    if ((llCursor = RING_LOAD(pstRing->pstHeader->allReaders[iIndex])) == kllRing_Free)
+      continue;
+
+    tReader = (pid_t) RING_LOAD(pstRing->pstHeader->alReaderPids[iIndex]);
+
+    if (iReap && tReader && (kill(tReader, 0) < 0) && (errno == ESRCH)) {
+      __atomic_compare_exchange_n(&pstRing->pstHeader->allReaders[iIndex], &llCursor,
+                                  kllRing_Free, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+      continue;
+    }
+
+    if (llCursor < llSlowest)  llSlowest = llCursor;
+  }
+
+  return llSlowest;
+}
+
+
+/*========================================================================*/
+int
+fnRing_Create(struct SharedRing_t *pstRing, char *szName, size_t iLength, int iPolicy,
+              struct SampleFormat_t *pstFormat, char *szFormat)
+/*
+ * Create a ring, ready to publish to.  A ring of the same name left behind
+ * by a DAEX which is no longer running is replaced.
+ *
+ *   Input:  pstRing   - The ring.
+ *           szName    - The shared memory object's name ("/name").
+ *           iLength   - Bytes of slots, roughly.
+ *           iPolicy   - kiRing_Block or kiRing_Drop.
+ *           pstFormat - The samples' format.
+ *           szFormat  - The -w format of the stream.
+ *
+ * Returns:  -1 on error (see errno; EEXIST if the ring is in use), 0
+ *           otherwise.
+ */
+/*========================================================================*/
+{
+  struct RingHeader_t *pstStale;		/* A ring already there      */
+  struct stat stStatus;				/* ... and its size          */
+  long   lPageLength;				/* Bytes per page            */
+  size_t iSlots,				/* Slots in the ring         */
+         iHeaderLength;				/* Bytes before the data     */
+  void   *pvMapping;				/* The mapping               */
+  int    iFileDesc,				/* The shared memory object  */
+         iIndex;				/* Current reader entry      */
+
+
+  memset(pstRing, 0, sizeof(struct SharedRing_t));
+  pstRing->iReader = -1;
+
+  lPageLength   = sysconf(_SC_PAGESIZE);
+  iSlots        = (iLength / kiRing_SlotLength < 2) ? 2 : iLength / kiRing_SlotLength;
+  iHeaderLength = (sizeof(struct RingHeader_t) + iSlots * sizeof(struct RingSlot_t) +
+                   lPageLength - 1) / lPageLength * lPageLength;
+
+  pstRing->iMapLength = iHeaderLength + iSlots * kiRing_SlotLength;
+
+  if ((iFileDesc = shm_open(szName, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0) {
+    if (errno != EEXIST)  return -1;
+
+    /* See whether the ring there is still being written. */
+    if ((iFileDesc = shm_open(szName, O_RDONLY, 0)) < 0)  return -1;
+
+    pvMapping = MAP_FAILED;
+
+    if ((fstat(iFileDesc, &stStatus) == 0) && (stStatus.st_size >= (off_t) sizeof(struct RingHeader_t)))
+      pvMapping = mmap(NULL, sizeof(struct RingHeader_t), PROT_READ, MAP_SHARED, iFileDesc, 0);
+
+    close(iFileDesc);
+
+    if (pvMapping == MAP_FAILED) {
+      errno = EEXIST;
+      return -1;
+    }
+
+    pstStale = (struct RingHeader_t *) pvMapping;
+
+    if ((memcmp(pstStale->acMagic, kszRing_Magic, sizeof(pstStale->acMagic)) != 0) ||
+        (kill((pid_t) pstStale->lWriter, 0) == 0) || (errno != ESRCH)) {
+      munmap(pvMapping, sizeof(struct RingHeader_t));
+      errno = EEXIST;
+      return -1;
+    }
+
+    munmap(pvMapping, sizeof(struct RingHeader_t));
+    shm_unlink(szName);
+
+    if ((iFileDesc = shm_open(szName, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0)  return -1;
+  }
+
+  if ((ftruncate(iFileDesc, (off_t) pstRing->iMapLength) < 0) ||
+      ((pvMapping = mmap(NULL, pstRing->iMapLength, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         iFileDesc, 0)) == MAP_FAILED)) {
+    close(iFileDesc);
+    shm_unlink(szName);
+    return -1;
+  }
+
+  close(iFileDesc);
+
+  if (! (pstRing->szName = strdup(szName))) {
+    munmap(pvMapping, pstRing->iMapLength);
+    shm_unlink(szName);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  pstRing->pstHeader = (struct RingHeader_t *) pvMapping;
+  pstRing->pstSlots  = (struct RingSlot_t *) (pstRing->pstHeader + 1);
+  pstRing->pData     = (u_char *) pvMapping + iHeaderLength;
+
+  /* The new object is all zeroes; fill in the rest, then the magic, so
+   * that a reader never sees a ring half set up.
+   */
+  pstRing->pstHeader->lVersion       = kiRing_Version;
+  pstRing->pstHeader->lHeaderLength  = iHeaderLength;
+  pstRing->pstHeader->lSlotLength    = kiRing_SlotLength;
+  pstRing->pstHeader->lSlots         = iSlots;
+  pstRing->pstHeader->lPolicy        = iPolicy;
+  pstRing->pstHeader->lChannels      = pstFormat->iChannels;
+  pstRing->pstHeader->lBitsPerSample = pstFormat->iBitsPerSample;
+  pstRing->pstHeader->lFloat         = pstFormat->iFloat;
+  pstRing->pstHeader->lSampleRate    = pstFormat->iSampleRate;
+  pstRing->pstHeader->lWriter        = getpid();
+
+  snprintf(pstRing->pstHeader->acFormat, sizeof(pstRing->pstHeader->acFormat), "%s", szFormat);
+
+  for (iIndex = 0; iIndex < kiRing_MaxReaders; iIndex++)
+    pstRing->pstHeader->allReaders[iIndex] = kllRing_Free;
+
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(pstRing->pstHeader->acMagic, kszRing_Magic, sizeof(pstRing->pstHeader->acMagic));
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnRing_WaitForReader(struct SharedRing_t *pstRing)
+/*
+ * Under kiRing_Block, wait for the first reader to attach, so that it
+ * misses nothing.  Under kiRing_Drop, return at once.
+ */
+/*========================================================================*/
+{
+  if (pstRing->pstHeader->lPolicy != kiRing_Block)  return;
+
+  while (fnRing_Slowest(pstRing, 1) == kllRing_Free)
+    fnRing_Pause();
+}
+
+
+/*========================================================================*/
+void
+fnRing_StartTrack(struct SharedRing_t *pstRing, int iTrack)
+/*
+ * Tag the slots published from here on with a new track.
+ */
+/*========================================================================*/
+{
+  pstRing->iTrack   = iTrack;
+  pstRing->llOffset = 0;
+}
+
+
+/*========================================================================*/
+u_char *
+fnRing_Claim(struct SharedRing_t *pstRing)
+/*
+ * Take the next slot to fill, if it hasn't been already.  Under
+ * kiRing_Block this waits until every reader is done with it.
+ *
+ *   Input:  pstRing - The ring, being written.
+ * Returns:  The slot's data, kiRing_SlotLength bytes.
+ */
+/*========================================================================*/
+{
+  struct RingSlot_t *pstSlot;			/* The slot                  */
+  u_int64_t llSlowest;				/* Slowest reader's slot     */
+  size_t    iPosition;				/* The slot's place          */
+
+
+  iPosition = pstRing->llNext % pstRing->pstHeader->lSlots;
+
+  if (pstRing->iClaimed)
+    return pstRing->pData + iPosition * pstRing->pstHeader->lSlotLength;
+
+  /* The slot last held the slot lSlots before this one. */
+  if (pstRing->pstHeader->lPolicy == kiRing_Block)
+    while (((llSlowest = fnRing_Slowest(pstRing, 0)) != kllRing_Free) &&
+           (llSlowest + pstRing->pstHeader->lSlots <= pstRing->llNext)) {
+      fnRing_Pause();
+      fnRing_Slowest(pstRing, 1);
+    }
+
+  pstSlot = &pstRing->pstSlots[iPosition];
+
+  __atomic_store_n(&pstSlot->llSequence, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  pstRing->iClaimed = 1;
+
+  return pstRing->pData + iPosition * pstRing->pstHeader->lSlotLength;
+}
+
+
+/*========================================================================*/
+int
+fnRing_Publish(struct SharedRing_t *pstRing, size_t iLength, int iFlags)
+/*
+ * Publish the slot being filled.
+ *
+ *   Input:  pstRing - The ring, being written.
+ *           iLength - Bytes of data put in the slot.
+ *           iFlags  - kiRing_Track*, or 0.
+ *
+ * Returns:  -1 if the slot can't hold that much (EINVAL), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct RingSlot_t *pstSlot;			/* The slot                  */
+
+
+  if (iLength > pstRing->pstHeader->lSlotLength) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  fnRing_Claim(pstRing);
+
+  pstSlot = &pstRing->pstSlots[pstRing->llNext % pstRing->pstHeader->lSlots];
+
+  pstSlot->llOffset = pstRing->llOffset;
+  pstSlot->lTrack   = pstRing->iTrack;
+  pstSlot->lFlags   = iFlags;
+  pstSlot->lLength  = iLength;
+
+  RING_STORE(pstSlot->llSequence, pstRing->llNext + 1);
+
+  pstRing->llOffset += iLength;
+  pstRing->llNext++;
+  pstRing->iClaimed  = 0;
+
+  RING_STORE(pstRing->pstHeader->llPublished, pstRing->llNext);
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnRing_Close(struct SharedRing_t *pstRing)
+/*
+ * Say nothing more will be published and, under kiRing_Block, wait for the
+ * readers to finish.  The ring's name is then removed.
+ */
+/*========================================================================*/
+{
+  u_int64_t llSlowest;				/* Slowest reader's slot     */
+
+
+  RING_STORE(pstRing->pstHeader->lClosed, 1);
+
+  if (pstRing->pstHeader->lPolicy == kiRing_Block)
+    while (((llSlowest = fnRing_Slowest(pstRing, 1)) != kllRing_Free) &&
+           (llSlowest < pstRing->llNext))
+      fnRing_Pause();
+
+  shm_unlink(pstRing->szName);
+  munmap(pstRing->pstHeader, pstRing->iMapLength);
+  free(pstRing->szName);
+
+  pstRing->pstHeader = NULL;
+  pstRing->szName    = NULL;
+}
+
+
+/*========================================================================*/
+int
+fnRing_Attach(struct SharedRing_t *pstRing, char *szName)
+/*
+ * Start reading a ring, from the next slot to be published.
+ *
+ *   Input:  pstRing - The ring.
+ *           szName  - Its name.
+ *
+ * Returns:  -1 on error (see errno; ENOENT if there is no ring, or its
+ *           DAEX has exited; EAGAIN if it isn't ready yet; EBUSY if it has
+ *           too many readers), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct stat stStatus;				/* The object's size         */
+  void      *pvMapping;				/* The mapping               */
+  u_int64_t llFree;				/* A free entry's value      */
+  int       iFileDesc,				/* The shared memory object  */
+            iIndex;				/* Current reader entry      */
+
+
+  memset(pstRing, 0, sizeof(struct SharedRing_t));
+  pstRing->iReader = -1;
+
+  if ((iFileDesc = shm_open(szName, O_RDWR, 0)) < 0)  return -1;
+
+  if ((fstat(iFileDesc, &stStatus) < 0) ||
+      (stStatus.st_size < (off_t) sizeof(struct RingHeader_t)) ||
+      ((pvMapping = mmap(NULL, stStatus.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         iFileDesc, 0)) == MAP_FAILED)) {
+    close(iFileDesc);
+    errno = EAGAIN;
+    return -1;
+  }
+
+  close(iFileDesc);
+
+  pstRing->pstHeader  = (struct RingHeader_t *) pvMapping;
+  pstRing->iMapLength = stStatus.st_size;
+
+  if (memcmp(pstRing->pstHeader->acMagic, kszRing_Magic, sizeof(pstRing->pstHeader->acMagic)) != 0) {
+    munmap(pvMapping, pstRing->iMapLength);
+    errno = EAGAIN;
+    return -1;
+  }
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  if (pstRing->pstHeader->lVersion != kiRing_Version) {
+    munmap(pvMapping, pstRing->iMapLength);
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* A ring left behind by a DAEX which has exited is as good as gone. */
+  if ((kill((pid_t) pstRing->pstHeader->lWriter, 0) < 0) && (errno == ESRCH)) {
+    munmap(pvMapping, pstRing->iMapLength);
+    errno = ENOENT;
+    return -1;
+  }
+
+  pstRing->pstSlots = (struct RingSlot_t *) (pstRing->pstHeader + 1);
+  pstRing->pData    = (u_char *) pvMapping + pstRing->pstHeader->lHeaderLength;
+
+  for (iIndex = 0; iIndex < kiRing_MaxReaders; iIndex++) {
+    llFree          = kllRing_Free;
+    pstRing->llNext = RING_LOAD(pstRing->pstHeader->llPublished);
+
+    if (__atomic_compare_exchange_n(&pstRing->pstHeader->allReaders[iIndex], &llFree,
+                                    pstRing->llNext, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      RING_STORE(pstRing->pstHeader->alReaderPids[iIndex], (u_int32_t) getpid());
+      pstRing->iReader = iIndex;
+      break;
+    }
+  }
+
+  if ((pstRing->iReader < 0) || ! (pstRing->szName = strdup(szName))) {
+    fnRing_Detach(pstRing);
+    errno = (pstRing->iReader < 0) ? EBUSY : ENOMEM;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnRing_Next(struct SharedRing_t *pstRing, struct RingSlot_t *pstSlot, u_char **ppData)
+/*
+ * Wait for the next slot.  A reader which has been overrun skips ahead to
+ * the oldest slot still held, and counts those it lost in llOverruns.
+ * The slot's data may be used until fnRing_Release().
+ *
+ *   Input:  pstRing - The ring, being read.
+ *           pstSlot - For the slot's description.
+ *           ppData  - For its data.
+ *
+ * Returns:  1 with the next slot; 0 once the ring is closed and every slot
+ *           has been read; -1 if DAEX has gone away without closing it
+ *           (EPIPE).
+ */
+/*========================================================================*/
+{
+  struct RingSlot_t *pstShared;			/* The slot, in the ring     */
+  u_int64_t llPublished,			/* Slots published           */
+            llOldest;				/* Oldest slot still held    */
+
+
+  for (;;) {
+    llPublished = RING_LOAD(pstRing->pstHeader->llPublished);
+
+    if (pstRing->llNext < llPublished) {
+      /* The oldest slot's place may already be being refilled. */
+      llOldest = (llPublished >= pstRing->pstHeader->lSlots) ?
+                 llPublished - pstRing->pstHeader->lSlots + 1 : 0;
+
+      if (pstRing->llNext < llOldest) {
+        pstRing->llOverruns += llOldest - pstRing->llNext;
+        pstRing->llNext      = llOldest;
+
+        RING_STORE(pstRing->pstHeader->allReaders[pstRing->iReader], pstRing->llNext);
+      }
+
+      pstShared = &pstRing->pstSlots[pstRing->llNext % pstRing->pstHeader->lSlots];
+
+      if (RING_LOAD(pstShared->llSequence) != pstRing->llNext + 1)
+        continue;
+
+      memcpy(pstSlot, pstShared, sizeof(struct RingSlot_t));
+
+      *ppData = pstRing->pData + (pstRing->llNext % pstRing->pstHeader->lSlots) *
+                                 pstRing->pstHeader->lSlotLength;
+
+      return 1;
+    }
+
+    if (RING_LOAD(pstRing->pstHeader->lClosed) &&
+        (pstRing->llNext >= RING_LOAD(pstRing->pstHeader->llPublished)))
+      return 0;
+
+    if ((kill((pid_t) pstRing->pstHeader->lWriter, 0) < 0) && (errno == ESRCH)) {
+      errno = EPIPE;
+      return -1;
+    }
+
+    fnRing_Pause();
+  }
+}
+
+
+/*========================================================================*/
+int
+fnRing_Release(struct SharedRing_t *pstRing)
+/*
+ * Finish with the slot fnRing_Next() returned, and move on.
+ *
+ *   Input:  pstRing - The ring, being read.
+ *
+ * Returns:  -1 if the slot was refilled while in use (ESTALE), in which
+ *           case its data must be thrown away; 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct RingSlot_t *pstShared;			/* The slot, in the ring     */
+  int    iStale;				/* It was refilled (flag)    */
+
+
+  pstShared = &pstRing->pstSlots[pstRing->llNext % pstRing->pstHeader->lSlots];
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+  iStale = (__atomic_load_n(&pstShared->llSequence, __ATOMIC_RELAXED) != pstRing->llNext + 1);
+
+  pstRing->llNext++;
+
+  RING_STORE(pstRing->pstHeader->allReaders[pstRing->iReader], pstRing->llNext);
+
+  if (iStale) {
+    pstRing->llOverruns++;
+    errno = ESTALE;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnRing_Detach(struct SharedRing_t *pstRing)
+/*
+ * Stop reading a ring.
+ */
+/*========================================================================*/
+{
+  if (pstRing->iReader >= 0)
+    RING_STORE(pstRing->pstHeader->allReaders[pstRing->iReader], kllRing_Free);
+
+  munmap(pstRing->pstHeader, pstRing->iMapLength);
+
+  if (pstRing->szName)
+    free(pstRing->szName);
+
+  pstRing->pstHeader = NULL;
+  pstRing->szName    = NULL;
+  pstRing->iReader   = -1;
+}
+
+/* EOF */
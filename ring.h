@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX   - The Digital Audio EXtractor
+ *
+ * ring.h - Header for the shared memory ring, and a description of its
+ *          layout for the programs which read it.
+ *
+ * $Id$
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <time.h>
+
+/* The ring is a POSIX shared memory object (see shm_open(2)), laid out as:
+ *
+ *   struct RingHeader_t              at offset 0
+ *   struct RingSlot_t [lSlots]       straight after it
+ *   the slots' data [lSlots]         at lHeaderLength, lSlotLength bytes each
+ *
+ * All fields are in the host's byte order.  DAEX publishes each track as
+ * the byte stream it would have written to a pipe in the -w format: a
+ * first slot flagged kiRing_TrackStart holding the header (none for -w
+ * raw), slots of audio in order, and an empty slot flagged kiRing_TrackEnd.
+ *
+ * Slot n (counting from 0 since the ring was created) is astSlots[n %
+ * lSlots].  Its llSequence is n + 1 once it has been published, and 0
+ * while it is being filled.  llPublished is the number of slots published.
+ *
+ * To read, a program claims a free entry in allReaders by swapping
+ * kllRing_Free for llPublished, and stores its pid beside it.  It then
+ * reads slot allReaders[i], waiting for llPublished to pass it, and stores
+ * the next slot's number in allReaders[i] once it is done with the data.
+ * The data may be used in place, with no copy.  It frees the entry on the
+ * way out.
+ *
+ * Under kiRing_Block, DAEX never refills a slot that a reader hasn't
+ * finished with; a slow reader holds up the drive.  Under kiRing_Drop, DAEX
+ * never waits, and a reader which falls more than lSlots behind is
+ * overrun: it must check llSequence is unchanged after using the data (a
+ * seqlock), and skip ahead to the oldest slot still held.  Readers which
+ * exit without freeing their entry are freed by DAEX.
+ *
+ * Once lClosed is set, nothing more will be published.  DAEX removes the
+ * ring's name when it exits, having waited (under kiRing_Block) for the
+ * readers to finish.
+ */
+
+#define kszRing_Magic		"DAEXRING"	/* acMagic, once the ring is ready     */
+#define kiRing_Version		1		/* lVersion                            */
+#define kiRing_MaxReaders	16		/* Readers attached at once, at most   */
+#define kiRing_SlotLength	(32 * CDDA_DATA_LENGTH) /* Bytes per slot            */
+#define kiRing_DefaultLength	16		/* Mbytes of slots, by default         */
+#define kiRing_PollInterval	1		/* ms between looks, when waiting      */
+
+#define kllRing_Free		(~(u_int64_t) 0) /* An entry of allReaders not in use  */
+
+/* Ring policies (struct RingHeader_t's lPolicy) */
+#define kiRing_Block		0	/* DAEX waits for the slowest reader        */
+#define kiRing_Drop		1	/* DAEX never waits; readers may be overrun */
+
+/* Slot flags (struct RingSlot_t's lFlags) */
+#define kiRing_TrackStart	0x01	/* First slot of a track: its header        */
+#define kiRing_TrackEnd		0x02	/* Last slot of a track, with no data       */
+#define kiRing_TrackFailed	0x04	/* ... which could not be read in full      */
+
+/* Atomic access to the shared fields. */
+#define RING_LOAD(x)		__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define RING_STORE(x, v)	__atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+/* The ring's header, at the start of the shared memory. */
+struct RingHeader_t {
+  char      acMagic[8];             /* kszRing_Magic, without the NUL              */
+  u_int32_t lVersion,               /* kiRing_Version                              */
+            lHeaderLength,          /* Offset of the first slot's data             */
+            lSlotLength,            /* Bytes of data per slot                      */
+            lSlots,                 /* Slots in the ring                           */
+            lPolicy;                /* kiRing_Block or kiRing_Drop                 */
+  char      acFormat[8];            /* -w format of the stream, NUL terminated     */
+  u_int32_t lChannels,              /* Samples' format: channels                   */
+            lBitsPerSample,         /* ... bits per sample                         */
+            lFloat,                 /* ... IEEE floats (flag)                      */
+            lSampleRate;            /* ... frames per second                       */
+  u_int32_t lWriter,                /* DAEX's pid                                  */
+            lClosed;                /* Nothing more will be published (flag)       */
+  u_int64_t llPublished;            /* Slots published                             */
+  u_int64_t allReaders[kiRing_MaxReaders];  /* Next slot each reader wants, or     */
+                                            /* kllRing_Free                        */
+  u_int32_t alReaderPids[kiRing_MaxReaders]; /* ... and the reader's pid           */
+};
+
+/* A slot's description. */
+struct RingSlot_t {
+  u_int64_t llSequence;             /* Slot number + 1 if published, else 0        */
+  u_int64_t llOffset;               /* Offset of the data in the track's stream    */
+  u_int32_t lTrack,                 /* The track                                   */
+            lFlags,                 /* kiRing_Track*                               */
+            lLength,                /* Bytes of data                               */
+            lReserved;              /* Zero                                        */
+};
+
+/* A process's view of a ring, writing or reading. */
+struct SharedRing_t {
+  char      *szName;                /* The shared memory object's name             */
+  struct RingHeader_t *pstHeader;   /* The mapping                                 */
+  struct RingSlot_t   *pstSlots;    /* The slots' descriptions                     */
+  u_char    *pData;                 /* The slots' data                             */
+  size_t    iMapLength;             /* Bytes mapped                                */
+  int       iReader;                /* Our entry in allReaders, or -1 if writing   */
+  int       iClaimed;               /* The writer is filling slot llNext (flag)    */
+  int       iTrack;                 /* The track being published                   */
+  u_int64_t llNext,                 /* Slot being filled, or to be read next       */
+            llOffset;               /* Bytes of the track published                */
+  u_int64_t llOverruns;             /* Slots a reader has lost                     */
+};
+
+/* Ring function prototypes -- writing ... */
+int    fnRing_Create(struct SharedRing_t *pstRing, char *szName, size_t iLength, int iPolicy,
+                     struct SampleFormat_t *pstFormat, char *szFormat);
+void   fnRing_WaitForReader(struct SharedRing_t *pstRing);
+void   fnRing_StartTrack(struct SharedRing_t *pstRing, int iTrack);
+u_char *fnRing_Claim(struct SharedRing_t *pstRing);
+int    fnRing_Publish(struct SharedRing_t *pstRing, size_t iLength, int iFlags);
+void   fnRing_Close(struct SharedRing_t *pstRing);
+
+/* ... and reading. */
+int    fnRing_Attach(struct SharedRing_t *pstRing, char *szName);
+int    fnRing_Next(struct SharedRing_t *pstRing, struct RingSlot_t *pstSlot, u_char **ppData);
+int    fnRing_Release(struct SharedRing_t *pstRing);
+void   fnRing_Detach(struct SharedRing_t *pstRing);
+
+/* EOF */
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * tests/convert.c - Checks of the sample format conversion: the vector
+ *                   store kernels must round and clip exactly as the
+ *                   scalar ones do, out of range samples included, and a
+ *                   resampled full scale square wave, which overshoots,
+ *                   must come out clipped rather than wrapped around.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "resample.h"
+#include "convert.h"
+
+#define kiCheck_Samples		1003	/* Samples per store (not a multiple of 4) */
+#define kiCheck_Blocks		20	/* Blocks of square wave resampled         */
+#define kiCheck_Period		100	/* Frames per cycle of the square wave     */
+
+struct Converter_t stConverter,			/* The converter             */
+                  stReference;			/* ... and one to float      */
+
+
+/*========================================================================*/
+long
+fnCheck_Load(const u_char *pOutput, int iBitsPerSample)
+/*
+ * Read back one stored (signed, little-endian) sample.
+ */
+/*========================================================================*/
+{
+  u_int32_t lSample = 0;			/* The sample, unsigned      */
+  int       iByte;				/* Current byte              */
+
+
+  if (iBitsPerSample == 8)
+    return (long) pOutput[0] - 128;
+
+  for (iByte = 0; iByte < iBitsPerSample / 8; iByte++)
+    lSample |= (u_int32_t) pOutput[iByte] << (8 * iByte);
+
+  if (iBitsPerSample < 32)
+    lSample = (lSample ^ (1U << (iBitsPerSample - 1))) - (1U << (iBitsPerSample - 1));
+
+  return (int32_t) lSample;
+}
+
+
+/*========================================================================*/
+int
+fnCheck_Samples(const char *szName, const float *afInput, const u_char *pOutput,
+                int iSamples, int iBitsPerSample)
+/*
+ * Compare stored samples with the input, rounded and clipped one at a
+ * time.  The largest float below 2^31 is 2^31 - 128, so that is as far as
+ * a clipped 32 bit sample may fall short.
+ *
+ * Returns:  -1 if any sample differs, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  double dScale,				/* Full scale                */
+         dExpected;				/* A sample, as it should be */
+  long   lStored;				/* ... and as it was stored  */
+  int    iSample,				/* Current sample            */
+         iFailed = 0;				/* Samples which differ      */
+
+
+  dScale = ldexp(1.0, iBitsPerSample - 1);
+
+  for (iSample = 0; iSample < iSamples; iSample++) {
+    dExpected = rint((double) afInput[iSample] * dScale);
+    dExpected = (dExpected < -dScale) ? -dScale : (dExpected > dScale - 1) ? dScale - 1 : dExpected;
+    lStored   = fnCheck_Load(pOutput + iSample * (iBitsPerSample / 8), iBitsPerSample);
+
+    if ((lStored > dExpected) || (lStored < dExpected - ((iBitsPerSample == 32) ? 127 : 0))) {
+      if (!iFailed++)
+        printf("FAIL %s: sample %i, %.9g, stored as %li, not %.0f\n",
+               szName, iSample, afInput[iSample], lStored, dExpected);
+    }
+  }
+
+  return iFailed ? -1 : 0;
+}
+
+
+/*========================================================================*/
+int
+fnCheck_Store(int iBitsPerSample)
+/*
+ * Store samples up to three times full scale through the kernel for the
+ * word length given (with no dither), and check them.
+ *
+ * Returns:  -1 if the check failed, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  static const float afEdges[] = { 0.0f, 0.5f, -0.5f, 1.0f, -1.0f, 1.26f, -1.26f, 3.0f, -3.0f,
+                                   0.99999994f, -0.99999994f, 1.0000001f, -1.0000001f };
+
+  struct SampleFormat_t stFormat;		/* The output format         */
+  float  afInput[kiCheck_Samples];		/* The samples               */
+  char   szName[32];				/* The check's name          */
+  int    iSample;				/* Current sample            */
+
+
+  for (iSample = 0; iSample < kiCheck_Samples; iSample++)
+    afInput[iSample] = (iSample < (int) (sizeof(afEdges) / sizeof(float))) ? afEdges[iSample] :
+                       (float) (random() % 2000001 - 1000000) * 3e-6f;
+
+  stFormat.iChannels      = 1;
+  stFormat.iBitsPerSample = iBitsPerSample;
+  stFormat.iFloat         = 0;
+  stFormat.iSampleRate    = CDDA_SAMPLE_RATE;
+
+  if (fnConvert_Initialize(&stConverter, &stFormat, kiDither_None, kiResample_Medium) < 0) {
+    printf("FAIL store, %i bit: no converter\n", iBitsPerSample);
+    return -1;
+  }
+
+  stConverter.pfnStore(&stConverter, afInput, stConverter.aOutput, kiCheck_Samples);
+  fnConvert_Dispose(&stConverter);
+
+  snprintf(szName, sizeof(szName), "store, %i bit", iBitsPerSample);
+
+  if (fnCheck_Samples(szName, afInput, stConverter.aOutput, kiCheck_Samples, iBitsPerSample) < 0)
+    return -1;
+
+  printf("ok   %s\n", szName);
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCheck_Square(int iBitsPerSample, int iSampleRate)
+/*
+ * Resample a full scale square wave (stereo, the channels in opposite
+ * phase) to the rate and word length given, and check it against the same
+ * wave resampled to floats.  The floats must overshoot full scale, or the
+ * check proves nothing.
+ *
+ * Returns:  -1 if the check failed, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct SampleFormat_t stFormat;		/* The output format         */
+  u_char aBlock[CDDA_DATA_LENGTH],		/* One block of CDDA         */
+         *pOutput;				/* ... converted             */
+  float  afReference[kiConvert_MaximumFrames * 2], /* ... and as floats      */
+         fPeak = 0.0f;				/* Largest float seen        */
+  char   szName[48];				/* The check's name          */
+  size_t iLength,				/* Bytes converted           */
+         iReference;				/* ... and as floats         */
+  int    iBlock,				/* Current block             */
+         iFrame,				/* Current frame             */
+         iSample,				/* Current sample            */
+         iFailed = 0;				/* Blocks which failed       */
+  int16_t iValue;				/* A CDDA sample             */
+
+
+  snprintf(szName, sizeof(szName), "square, %i Hz, %i bit", iSampleRate, iBitsPerSample);
+
+  stFormat.iChannels      = 2;
+  stFormat.iBitsPerSample = iBitsPerSample;
+  stFormat.iFloat         = 0;
+  stFormat.iSampleRate    = iSampleRate;
+
+  if (fnConvert_Initialize(&stConverter, &stFormat, kiDither_None, kiResample_High) < 0)
+    return -1;
+
+  stFormat.iBitsPerSample = 32;
+  stFormat.iFloat         = 1;
+
+  if (fnConvert_Initialize(&stReference, &stFormat, kiDither_None, kiResample_High) < 0) {
+    fnConvert_Dispose(&stConverter);
+    return -1;
+  }
+
+  for (iBlock = 0; iBlock < kiCheck_Blocks; iBlock++) {
+    for (iFrame = 0; iFrame < CDDA_DATA_LENGTH / 4; iFrame++) {
+      iValue = (((iBlock * CDDA_DATA_LENGTH / 4 + iFrame) % kiCheck_Period) < kiCheck_Period / 2) ?
+               32767 : -32768;
+
+      aBlock[iFrame * 4]     = iValue & 0xff;
+      aBlock[iFrame * 4 + 1] = (iValue >> 8) & 0xff;
+      aBlock[iFrame * 4 + 2] = ~iValue & 0xff;
+      aBlock[iFrame * 4 + 3] = (~iValue >> 8) & 0xff;
+    }
+
+    pOutput = fnConvert_ProcessBuffer(&stReference, aBlock, CDDA_DATA_LENGTH / 4, &iReference);
+    memcpy(afReference, pOutput, iReference);
+
+    for (iSample = 0; iSample < (int) (iReference / sizeof(float)); iSample++)
+      fPeak = (fabsf(afReference[iSample]) > fPeak) ? fabsf(afReference[iSample]) : fPeak;
+
+    pOutput = fnConvert_ProcessBuffer(&stConverter, aBlock, CDDA_DATA_LENGTH / 4, &iLength);
+
+    if ((iLength / (iBitsPerSample / 8) != iReference / sizeof(float)) ||
+        (fnCheck_Samples(szName, afReference, pOutput, iLength / (iBitsPerSample / 8),
+                         iBitsPerSample) < 0))
+      iFailed++;
+  }
+
+  fnConvert_Dispose(&stConverter);
+  fnConvert_Dispose(&stReference);
+
+  if (fPeak <= 1.0f) {
+    printf("FAIL %s: the resampler peaked at %.3f, without overshooting\n", szName, fPeak);
+    iFailed++;
+  }
+
+  if (iFailed)
+    return -1;
+
+  printf("ok   %s: peak %.3f\n", szName, fPeak);
+
+  return 0;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  int iFailed = 0;				/* Checks which failed       */
+
+
+  srandom(1998);
+
+  iFailed += fnCheck_Store(8) < 0;
+  iFailed += fnCheck_Store(16) < 0;
+  iFailed += fnCheck_Store(24) < 0;
+  iFailed += fnCheck_Store(32) < 0;
+
+  iFailed += fnCheck_Square(16, 48000) < 0;
+  iFailed += fnCheck_Square(24, 48000) < 0;
+  iFailed += fnCheck_Square(32, 48000) < 0;
+  iFailed += fnCheck_Square(24, 32000) < 0;
+  iFailed += fnCheck_Square(32, 22050) < 0;
+
+  return iFailed ? kiExitStatus_General : 0;
+}
+
+/* EOF */
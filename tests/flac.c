@@ -0,0 +1,627 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX    - The Digital Audio EXtractor
+ *
+ * tests/flac.c - Round trip check of the FLAC encoder: signals are
+ *                encoded, decoded again by the small decoder here, and
+ *                compared sample for sample, and against the stream's MD5.
+ *                White noise makes the encoder store frames verbatim, so
+ *                that path is checked too, and full scale square waves
+ *                put predictors at the limits of the sample width; a pair
+ *                of tones must be stored with LPC, in fewer bits than the
+ *                best fixed predictor would take.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "checksum.h"
+#include "flac.h"
+
+#define kiCheck_Frames		(3 * kiFlac_BlockFrames + 1000) /* Frames per signal */
+
+/* A stream, as it is encoded. */
+struct CheckStream_t {
+  u_char    *pData;                 /* The frames                                  */
+  size_t    iLength,                /* ... bytes held                              */
+            iSize;                  /* ... and allocated                           */
+};
+
+/* Bits being read from a frame, most significant first. */
+struct CheckBits_t {
+  const u_char *pData;              /* The frame                                   */
+  size_t    iLength;                /* ... its length                              */
+  size_t    iBit;                   /* The next bit                                */
+};
+
+int aiSubframes[64];				/* Subframes decoded, by type */
+u_int64_t llLPCBits,				/* Bits in LPC subframes     */
+          llFixedBits;				/* ... had they been fixed   */
+
+
+/*========================================================================*/
+int
+fnCheck_Emit(void *pvStream, const u_char *pFrame, size_t iLength)
+/*
+ * Keep an encoded frame (the encoder's pfnEmit).
+ */
+/*========================================================================*/
+{
+  struct CheckStream_t *pstStream;		/* The stream                */
+
+
+  pstStream = (struct CheckStream_t *) pvStream;
+
+  if (pstStream->iLength + iLength > pstStream->iSize) {
+    pstStream->iSize = (pstStream->iLength + iLength) * 2;
+
+    if (! (pstStream->pData = realloc(pstStream->pData, pstStream->iSize)))
+      return -1;
+  }
+
+  memcpy(pstStream->pData + pstStream->iLength, pFrame, iLength);
+  pstStream->iLength += iLength;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+u_int32_t
+fnCheck_Bits(struct CheckBits_t *pstBits, int iCount)
+/*
+ * Read an unsigned value of up to 32 bits.  Past the end, zeroes are read.
+ */
+/*========================================================================*/
+{
+  u_int32_t lValue = 0;				/* The value                 */
+
+
+  while (iCount-- > 0) {
+    lValue <<= 1;
+
+    if (pstBits->iBit < pstBits->iLength * 8)
+      lValue |= (pstBits->pData[pstBits->iBit / 8] >> (7 - pstBits->iBit % 8)) & 1;
+
+    pstBits->iBit++;
+  }
+
+  return lValue;
+}
+
+
+/*========================================================================*/
+int
+fnCheck_Signed(struct CheckBits_t *pstBits, int iCount)
+/*
+ * Read a two's complement value of iCount bits.
+ */
+/*========================================================================*/
+{
+  u_int32_t lValue;				/* The value, unsigned       */
+
+
+  lValue = fnCheck_Bits(pstBits, iCount);
+
+  if ((iCount < 32) && (lValue & (1U << (iCount - 1))))
+    lValue |= ~0U << iCount;
+
+  return (int) lValue;
+}
+
+
+/*========================================================================*/
+u_int64_t
+fnCheck_FixedBits(const int *aiSamples, int iFrames, int iBitsPerSample)
+/*
+ * Work out the fewest bits a subframe with a fixed predictor could take
+ * for some samples: every order, every Rice partition order and every
+ * parameter is tried.
+ */
+/*========================================================================*/
+{
+  static const int aaiFixed[5][4] = { { 0 }, { 1 }, { 2, -1 }, { 3, -3, 1 }, { 4, -6, 4, -1 } };
+
+  u_int64_t llBest = ~(u_int64_t) 0,		/* Fewest bits so far        */
+            llBits,				/* ... for this order        */
+            llPartition,			/* ... and partition order   */
+            llParameter,			/* ... and Rice parameter    */
+            llSmallest;				/* A partition's fewest      */
+  u_int32_t *alFolded;				/* Residuals, zigzag coded   */
+  int64_t   llResidual;				/* A residual                */
+  int       iOrder,				/* Current predictor order   */
+            iPartitionOrder,			/* Current partition order   */
+            iPartition,				/* Current partition         */
+            iParameter,				/* Current Rice parameter    */
+            iIndex,				/* Current sample            */
+            iTap;				/* Current coefficient       */
+
+
+  alFolded = malloc(iFrames * sizeof(u_int32_t));
+
+  for (iOrder = 0; (iOrder <= 4) && (iOrder < iFrames); iOrder++) {
+    for (iIndex = iOrder; iIndex < iFrames; iIndex++) {
+      for (llResidual = aiSamples[iIndex], iTap = 0; iTap < iOrder; iTap++)
+        llResidual -= (int64_t) aaiFixed[iOrder][iTap] * aiSamples[iIndex - 1 - iTap];
+
+      alFolded[iIndex] = (u_int32_t) ((llResidual << 1) ^ (llResidual >> 63));
+    }
+
+    llBits = ~(u_int64_t) 0;
+
+    for (iPartitionOrder = 0; (iPartitionOrder <= kiFlac_MaxPartitions) &&
+                              !(iFrames & ((1 << iPartitionOrder) - 1)) &&
+                              ((iFrames >> iPartitionOrder) > iOrder); iPartitionOrder++) {
+      for (llPartition = 0, iPartition = 0; iPartition < (1 << iPartitionOrder); iPartition++) {
+        for (llSmallest = ~(u_int64_t) 0, iParameter = 0; iParameter < 31; iParameter++) {
+          llParameter = (iParameter < 15) ? 4 : 5;
+
+          for (iIndex = iPartition ? iPartition * (iFrames >> iPartitionOrder) : iOrder;
+               iIndex < (iPartition + 1) * (iFrames >> iPartitionOrder); iIndex++)
+            llParameter += 1 + iParameter + (alFolded[iIndex] >> iParameter);
+
+          if (llParameter < llSmallest)  llSmallest = llParameter;
+        }
+
+        llPartition += llSmallest;
+      }
+
+      if (llPartition + 2 + 4 < llBits)  llBits = llPartition + 2 + 4;
+    }
+
+    llBits += 8 + (u_int64_t) iOrder * iBitsPerSample;
+
+    if (llBits < llBest)  llBest = llBits;
+  }
+
+  free(alFolded);
+
+  return llBest;
+}
+
+
+/*========================================================================*/
+int
+fnCheck_Subframe(struct CheckBits_t *pstBits, int *aiSamples, int iFrames, int iBitsPerSample)
+/*
+ * Decode a subframe.
+ *
+ * Returns:  -1 if it is malformed, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  static const int aaiFixed[5][4] = { { 0 }, { 1 }, { 2, -1 }, { 3, -3, 1 }, { 4, -6, 4, -1 } };
+
+  int     aiCoefficients[32],			/* Predictor coefficients    */
+          iType,				/* Subframe type             */
+          iWasted = 0,				/* Wasted bits per sample    */
+          iOrder,				/* Predictor order           */
+          iPrecision,				/* Coefficient width         */
+          iShift = 0,				/* Coefficient shift         */
+          iParameterBits,			/* 4 (RICE) or 5 (RICE2)     */
+          iPartitionOrder,			/* Rice partitions are 2^this */
+          iPartition,				/* Current partition         */
+          iParameter,				/* Its Rice parameter        */
+          iEnd,					/* ... and its end           */
+          iIndex,				/* Current sample            */
+          iTap;					/* Current coefficient       */
+  int64_t llPrediction;				/* A sample, as predicted    */
+  u_int32_t lQuotient;				/* A Rice code's unary part  */
+  size_t  iStart;				/* The subframe's first bit  */
+
+
+  iStart = pstBits->iBit;
+
+  if (fnCheck_Bits(pstBits, 1) != 0)  return -1;
+
+  iType = fnCheck_Bits(pstBits, 6);
+
+  if (fnCheck_Bits(pstBits, 1))
+    for (iWasted = 1; !fnCheck_Bits(pstBits, 1); iWasted++)
+      ;
+
+  aiSubframes[iType]++;
+  iBitsPerSample -= iWasted;
+
+  if (iType == kiFlac_Constant) {
+    aiSamples[0] = fnCheck_Signed(pstBits, iBitsPerSample);
+
+    for (iIndex = 1; iIndex < iFrames; iIndex++)
+      aiSamples[iIndex] = aiSamples[0];
+
+  } else if (iType == kiFlac_Verbatim) {
+    for (iIndex = 0; iIndex < iFrames; iIndex++)
+      aiSamples[iIndex] = fnCheck_Signed(pstBits, iBitsPerSample);
+
+  } else {
+    if ((iType & 0x38) == kiFlac_Fixed) {
+      if ((iOrder = iType & 0x07) > 4)  return -1;
+
+      for (iTap = 0; iTap < iOrder; iTap++)
+        aiCoefficients[iTap] = aaiFixed[iOrder][iTap];
+
+    } else if (iType & kiFlac_LPC) {
+      iOrder = (iType & 0x1f) + 1;
+
+    } else
+      return -1;
+
+    for (iIndex = 0; iIndex < iOrder; iIndex++)
+      aiSamples[iIndex] = fnCheck_Signed(pstBits, iBitsPerSample);
+
+    if (iType & kiFlac_LPC) {
+      if ((iPrecision = fnCheck_Bits(pstBits, 4) + 1) == 16)  return -1;
+
+      iShift = fnCheck_Signed(pstBits, 5);
+
+      for (iTap = 0; iTap < iOrder; iTap++)
+        aiCoefficients[iTap] = fnCheck_Signed(pstBits, iPrecision);
+    }
+
+    /* The residual, in place, then the prediction added to it. */
+    if ((iParameterBits = fnCheck_Bits(pstBits, 2)) > 1)  return -1;
+
+    iParameterBits += 4;
+    iPartitionOrder = fnCheck_Bits(pstBits, 4);
+
+    for (iPartition = 0; iPartition < (1 << iPartitionOrder); iPartition++) {
+      iIndex     = iPartition ? iPartition * (iFrames >> iPartitionOrder) : iOrder;
+      iEnd       = (iPartition + 1) * (iFrames >> iPartitionOrder);
+      iParameter = fnCheck_Bits(pstBits, iParameterBits);
+
+      /* The encoder never escapes to unencoded residuals. */
+      if (iParameter == (1 << iParameterBits) - 1)  return -1;
+
+      for (; iIndex < iEnd; iIndex++) {
+        for (lQuotient = 0; !fnCheck_Bits(pstBits, 1); lQuotient++)
+          if (pstBits->iBit > pstBits->iLength * 8)  return -1;
+
+        lQuotient = (lQuotient << iParameter) | fnCheck_Bits(pstBits, iParameter);
+        aiSamples[iIndex] = (lQuotient >> 1) ^ -(int) (lQuotient & 1);
+      }
+    }
+
+    for (iIndex = iOrder; iIndex < iFrames; iIndex++) {
+      for (llPrediction = 0, iTap = 0; iTap < iOrder; iTap++)
+        llPrediction += (int64_t) aiCoefficients[iTap] * aiSamples[iIndex - 1 - iTap];
+
+      aiSamples[iIndex] += (int) (llPrediction >> iShift);
+    }
+
+    if (iType & kiFlac_LPC) {
+      llLPCBits   += pstBits->iBit - iStart;
+      llFixedBits += fnCheck_FixedBits(aiSamples, iFrames, iBitsPerSample);
+    }
+  }
+
+  for (iIndex = 0; iIndex < iFrames; iIndex++)
+    aiSamples[iIndex] <<= iWasted;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCheck_Decode(struct CheckStream_t *pstStream, int iChannels, int iBitsPerSample,
+               int **aaiDecoded, int *piFrames)
+/*
+ * Decode a stream's frames, checking their CRCs and numbers.  The CRCs
+ * are worked out bit by bit, not with the encoder's tables.
+ *
+ * Returns:  -1 if the stream is malformed, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct CheckBits_t stBits;			/* The frame being read      */
+  u_int16_t iCRC16;				/* Frame CRC                 */
+  u_char    cCRC8;				/* Header CRC                */
+  int       *aiSubframe[2],			/* Subframes, as coded       */
+            iAssignment,			/* Channel assignment        */
+            iFrames,				/* Frames in this frame      */
+            iNumber,				/* Its number                */
+            iChannel,				/* Current channel           */
+            iIndex,				/* Current sample or byte    */
+            iBit;				/* Current bit of a CRC      */
+  size_t    iStart;				/* The frame's first byte    */
+  u_int32_t lCode;				/* A field                   */
+
+
+  *piFrames = 0;
+
+  for (iStart = 0, iNumber = 0; iStart < pstStream->iLength; iNumber++) {
+    stBits.pData   = pstStream->pData + iStart;
+    stBits.iLength = pstStream->iLength - iStart;
+    stBits.iBit    = 0;
+
+    if (fnCheck_Bits(&stBits, 16) != 0xfff8)  return -1;
+
+    lCode = fnCheck_Bits(&stBits, 4);
+    fnCheck_Bits(&stBits, 4);
+    iAssignment = fnCheck_Bits(&stBits, 4);
+
+    if ((iAssignment != ((iChannels == 1) ? 0 : 1)) &&
+        ((iChannels == 1) || (iAssignment < 8) || (iAssignment > 10)))
+      return -1;
+
+    if (fnCheck_Bits(&stBits, 4) != (u_int32_t) (((iBitsPerSample == 8) ? 1 :
+                                                 (iBitsPerSample == 16) ? 4 : 6) << 1))
+      return -1;
+
+    /* Frame numbers here are small enough for one byte of UTF-8, or two. */
+    if ((iIndex = fnCheck_Bits(&stBits, 8)) >= 0x80)
+      iIndex = ((iIndex & 0x1f) << 6) | (fnCheck_Bits(&stBits, 8) & 0x3f);
+
+    if (iIndex != iNumber)  return -1;
+
+    iFrames = (lCode == 12) ? kiFlac_BlockFrames :
+              (lCode == 6)  ? (int) fnCheck_Bits(&stBits, 8) + 1 :
+              (lCode == 7)  ? (int) fnCheck_Bits(&stBits, 16) + 1 : -1;
+
+    if (iFrames < 0)  return -1;
+
+    for (cCRC8 = 0, iIndex = 0; iIndex < (int) stBits.iBit / 8; iIndex++)
+      for (cCRC8 ^= stBits.pData[iIndex], iBit = 0; iBit < 8; iBit++)
+        cCRC8 = (cCRC8 << 1) ^ ((cCRC8 & 0x80) ? 0x07 : 0);
+
+    if (fnCheck_Bits(&stBits, 8) != cCRC8)  return -1;
+
+    for (iChannel = 0; iChannel < iChannels; iChannel++) {
+      aiSubframe[iChannel] = aaiDecoded[iChannel] + *piFrames;
+
+      if (fnCheck_Subframe(&stBits, aiSubframe[iChannel], iFrames,
+                           iBitsPerSample + (((iAssignment == 8) || (iAssignment == 10)) ?
+                                             (iChannel == 1) : (iAssignment == 9) ?
+                                             (iChannel == 0) : 0)) < 0)
+        return -1;
+    }
+
+    /* Undo the stereo decorrelation. */
+    for (iIndex = 0; iIndex < iFrames; iIndex++) {
+      int iLeft, iRight, iMid, iSide;
+
+      switch (iAssignment) {
+        case 8:					/* Left, side                */
+          aiSubframe[1][iIndex] = aiSubframe[0][iIndex] - aiSubframe[1][iIndex];
+          break;
+
+        case 9:					/* Side, right               */
+          aiSubframe[0][iIndex] = aiSubframe[0][iIndex] + aiSubframe[1][iIndex];
+          break;
+
+        case 10:				/* Mid, side                 */
+          iSide  = aiSubframe[1][iIndex];
+          iMid   = (aiSubframe[0][iIndex] << 1) | (iSide & 1);
+          iLeft  = (iMid + iSide) >> 1;
+          iRight = (iMid - iSide) >> 1;
+
+          aiSubframe[0][iIndex] = iLeft;
+          aiSubframe[1][iIndex] = iRight;
+          break;
+      }
+    }
+
+    stBits.iBit = (stBits.iBit + 7) & ~(size_t) 7;
+
+    for (iCRC16 = 0, iIndex = 0; iIndex < (int) stBits.iBit / 8; iIndex++)
+      for (iCRC16 ^= stBits.pData[iIndex] << 8, iBit = 0; iBit < 8; iBit++)
+        iCRC16 = (iCRC16 << 1) ^ ((iCRC16 & 0x8000) ? 0x8005 : 0);
+
+    if (fnCheck_Bits(&stBits, 16) != iCRC16)  return -1;
+
+    *piFrames += iFrames;
+    iStart    += stBits.iBit / 8;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnCheck_Signal(const char *szName, int iChannels, int iBitsPerSample, int iSignal)
+/*
+ * Encode a signal, decode it, and compare.
+ *
+ *   Input:  szName         - The signal's name, for the report.
+ *           iChannels      - 1 or 2.
+ *           iBitsPerSample - 8, 16 or 24.
+ *           iSignal        - 0 for white noise, 1 for a full scale square
+ *                            wave alternating every sample, 2 for a slow
+ *                            sine, 3 for two tones (around 900 and 2200
+ *                            Hz).
+ *
+ * Returns:  -1 if the round trip failed, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct FlacEncoder_t stEncoder;		/* The encoder               */
+  struct CheckStream_t stStream;		/* The encoded stream        */
+  struct MD5Context_t  stMD5;			/* MD5 of what was decoded   */
+  u_char    *pSamples,				/* The signal, as bytes      */
+            aDigest[16];			/* ... the MD5 of the decode */
+  int       *aaiOriginal[2],			/* The signal, per channel   */
+            *aaiDecoded[2],			/* ... and as decoded        */
+            iSampleLength,			/* Bytes per sample          */
+            iMaximum,				/* Full scale                */
+            iFrames,				/* Frames decoded            */
+            iFrame,				/* Current frame             */
+            iChannel,				/* Current channel           */
+            iByte,				/* Current byte              */
+            iVerbatim,				/* Verbatim subframes before */
+            iLPC,				/* ... and LPC subframes     */
+            iReturnValue = 0;			/* What to return            */
+  u_int64_t llLPC,				/* LPC subframe bits before  */
+            llFixed;				/* ... had they been fixed   */
+  u_int32_t lSample;				/* A sample, as stored       */
+
+
+  iSampleLength = iBitsPerSample / 8;
+  iMaximum      = (1 << (iBitsPerSample - 1)) - 1;
+
+  pSamples = malloc(kiCheck_Frames * iChannels * iSampleLength);
+
+  for (iChannel = 0; iChannel < iChannels; iChannel++) {
+    aaiOriginal[iChannel] = malloc(kiCheck_Frames * sizeof(int));
+    aaiDecoded[iChannel]  = calloc(kiCheck_Frames, sizeof(int));
+  }
+
+  for (iFrame = 0; iFrame < kiCheck_Frames; iFrame++)
+    for (iChannel = 0; iChannel < iChannels; iChannel++) {
+      switch (iSignal) {
+        case 0:
+          aaiOriginal[iChannel][iFrame] = (int) ((u_int32_t) random() % (2U * iMaximum + 2)) -
+                                          iMaximum - 1;
+          break;
+
+        case 1:
+          aaiOriginal[iChannel][iFrame] = ((iFrame + iChannel) & 1) ? iMaximum : -iMaximum - 1;
+          break;
+
+        case 2:
+          aaiOriginal[iChannel][iFrame] = (int) (iMaximum * sin(iFrame * 0.01 + iChannel));
+          break;
+
+        default:
+          aaiOriginal[iChannel][iFrame] = (int) (iMaximum / 2 * sin(iFrame * 0.13 + iChannel) +
+                                                 iMaximum / 2 * sin(iFrame * 0.31 + 1));
+          break;
+      }
+
+      /* Little-endian, 8 bit samples offset binary, as the converter gives. */
+      lSample = (u_int32_t) aaiOriginal[iChannel][iFrame] ^ ((iSampleLength == 1) ? 0x80 : 0);
+
+      for (iByte = 0; iByte < iSampleLength; iByte++)
+        pSamples[(iFrame * iChannels + iChannel) * iSampleLength + iByte] = lSample >> (8 * iByte);
+    }
+
+  memset(&stStream, 0, sizeof(stStream));
+
+  iVerbatim = aiSubframes[kiFlac_Verbatim];
+  llLPC     = llLPCBits;
+  llFixed   = llFixedBits;
+
+  for (iLPC = 0, iByte = kiFlac_LPC; iByte < 64; iByte++)
+    iLPC += aiSubframes[iByte];
+
+  if ((fnFlac_Initialize(&stEncoder, iChannels, iBitsPerSample, CDDA_SAMPLE_RATE) < 0) ||
+      (fnFlac_Write(&stEncoder, pSamples, kiCheck_Frames * iChannels * iSampleLength,
+                    fnCheck_Emit, &stStream) < 0) ||
+      (fnFlac_Finish(&stEncoder, fnCheck_Emit, &stStream) < 0)) {
+    printf("FAIL %s: the encoder failed\n", szName);
+    iReturnValue = -1;
+
+  } else if ((fnCheck_Decode(&stStream, iChannels, iBitsPerSample, aaiDecoded, &iFrames) < 0) ||
+             (iFrames != kiCheck_Frames)) {
+    printf("FAIL %s: the stream doesn't decode\n", szName);
+    iReturnValue = -1;
+
+  } else {
+    for (iFrame = 0; iFrame < kiCheck_Frames; iFrame++)
+      for (iChannel = 0; iChannel < iChannels; iChannel++)
+        if (aaiDecoded[iChannel][iFrame] != aaiOriginal[iChannel][iFrame])
+          iReturnValue = -1;
+
+    /* The MD5 is of the decoded samples, signed, little-endian. */
+    fnMD5_Initialize(&stMD5);
+
+    for (iFrame = 0; iFrame < kiCheck_Frames; iFrame++)
+      for (iChannel = 0; iChannel < iChannels; iChannel++)
+        for (iByte = 0; iByte < iSampleLength; iByte++) {
+          u_char cByte = (u_int32_t) aaiDecoded[iChannel][iFrame] >> (8 * iByte);
+
+          fnMD5_Update(&stMD5, &cByte, 1);
+        }
+
+    fnMD5_Final(&stMD5, aDigest);
+
+    if (memcmp(aDigest, stEncoder.aDigest, sizeof(aDigest)))
+      iReturnValue = -1;
+
+    /* Noise can only be stored verbatim. */
+    if ((iSignal == 0) && (aiSubframes[kiFlac_Verbatim] == iVerbatim))
+      iReturnValue = -1;
+
+    /* Tones are what LPC is for: it must be chosen, and beat the fixed
+     * predictors.  Badly quantised coefficients fail here, though the
+     * round trip is still exact.
+     */
+    for (iByte = kiFlac_LPC; iByte < 64; iByte++)
+      iLPC -= aiSubframes[iByte];
+
+    if ((iSignal == 3) && ((iLPC == 0) || (llLPCBits - llLPC >= llFixedBits - llFixed)))
+      iReturnValue = -1;
+
+    printf("%s %s: %i frames, %lu bytes, %i verbatim subframes, %i LPC (%llu bits, fixed %llu)\n",
+           iReturnValue ? "FAIL" : "ok  ", szName, iFrames, (u_long) stStream.iLength,
+           aiSubframes[kiFlac_Verbatim] - iVerbatim, -iLPC,
+           (unsigned long long) (llLPCBits - llLPC), (unsigned long long) (llFixedBits - llFixed));
+  }
+
+  fnFlac_Dispose(&stEncoder);
+
+  free(stStream.pData);
+  free(pSamples);
+
+  for (iChannel = 0; iChannel < iChannels; iChannel++) {
+    free(aaiOriginal[iChannel]);
+    free(aaiDecoded[iChannel]);
+  }
+
+  return iReturnValue;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  static const int aiBits[] = { 8, 16, 24 };
+
+  char szName[64];				/* A signal's name           */
+  int  iBits,					/* Current sample format     */
+       iChannels,				/* Current channel count     */
+       iSignal,					/* Current signal            */
+       iFailed = 0;				/* Round trips which failed  */
+
+
+  srandom(1998);
+
+  for (iBits = 0; iBits < 3; iBits++)
+    for (iChannels = 1; iChannels <= 2; iChannels++)
+      for (iSignal = 0; iSignal < 4; iSignal++) {
+        snprintf(szName, sizeof(szName), "%s, %i bit, %s",
+                 (iSignal == 0) ? "noise" : (iSignal == 1) ? "square" :
+                 (iSignal == 2) ? "sine" : "tones",
+                 aiBits[iBits], (iChannels == 1) ? "mono" : "stereo");
+
+        if (fnCheck_Signal(szName, iChannels, aiBits[iBits], iSignal) < 0)
+          iFailed++;
+      }
+
+  return iFailed ? kiExitStatus_General : 0;
+}
+
+/* EOF */
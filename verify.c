@@ -0,0 +1,583 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX     - The Digital Audio EXtractor
+ *
+ * verify.c - daex-verify: re-validates WAVE files previously written by DAEX.
+ *            Each file's header is checked against the file's size, and the
+ *            CRC-32 of its audio data is compared with the checksum recorded
+ *            by "daex -k" at rip time.  Files are memory-mapped and handed
+ *            out to one worker thread per CPU.
+ *
+ * $Id$
+ */
+
+#include "daex.h"
+#include "format.h"
+#include "checksum.h"
+#include "verify.h"
+
+
+/*========================================================================*/
+void
+fnVerify_Usage(void)
+/*
+ * Displays information on how to use daex-verify from the command line.
+ *
+ *   Input:  None.
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  fprintf(stderr, "usage: daex-verify [-j jobs] [-k checksum_file] [-v] [file ...]\n\n");
+
+  fprintf(stderr, "   -j jobs          :  Number of worker threads. (default: one per CPU)\n");
+  fprintf(stderr, "   -k checksum_file :  Compare against the checksums recorded by \"daex -k\".\n");
+  fprintf(stderr, "                       If no files are named, every file listed is checked.\n");
+  fprintf(stderr, "   -v               :  Report files which verify correctly as well.\n\n");
+
+  fprintf(stderr, "   Without -k, the checksum of each file is written to the standard output\n");
+  fprintf(stderr, "   in the checksum file format.\n\n");
+
+  exit(kiExitStatus_General);
+}
+
+
+/*========================================================================*/
+u_long
+fnVerify_ReadLE(const u_char *pBuffer, int iBytes)
+/*
+ * Read a little-endian field from the on-disk header.  The header is never
+ * overlaid with struct WavFormat_t directly, since the in-memory layout of
+ * the structure depends on the size of the host's "long".
+ *
+ *   Input:  pBuffer - Start of the field.
+ *           iBytes  - Field width (2 or 4).
+ *
+ * Returns:  The field's value.
+ */
+/*========================================================================*/
+{
+  u_long lValue = 0;				/* Assembled value           */
+
+  while (iBytes-- > 0)
+    lValue = (lValue << 8) | pBuffer[iBytes];
+
+  return lValue;
+}
+
+
+/*========================================================================*/
+int
+fnVerify_ParseHeader(const u_char *pHeader, off_t llFileLength,
+                     struct WavFormat_t *pstWavHeader)
+/*
+ * Fill a WavFormat_t from the first WAV_HEADER_LENGTH bytes of a file, and
+ * check that the header describes the file it was found in.
+ *
+ *   Input:  pHeader      - The first WAV_HEADER_LENGTH bytes of the file.
+ *           llFileLength - The length of the file.
+ *           pstWavHeader - Where to store the parsed header.
+ *
+ * Returns:  -1 if the header is not a canonical PCM or float WAVE header
+ *           matching the file's length, 0 otherwise.
+ *
+ *           pstWavHeader - The header's fields.
+ */
+/*========================================================================*/
+{
+  memcpy(pstWavHeader->sRiffHeader,   pHeader + 0,  4);
+  pstWavHeader->lFileLength     = fnVerify_ReadLE(pHeader + 4,  4);
+  memcpy(pstWavHeader->sWavHeader,    pHeader + 8,  4);
+  memcpy(pstWavHeader->sFormatHeader, pHeader + 12, 4);
+  pstWavHeader->lFormatLength   = fnVerify_ReadLE(pHeader + 16, 4);
+  pstWavHeader->nFormatTag      = fnVerify_ReadLE(pHeader + 20, 2);
+  pstWavHeader->nChannels       = fnVerify_ReadLE(pHeader + 22, 2);
+  pstWavHeader->lSampleRate     = fnVerify_ReadLE(pHeader + 24, 4);
+  pstWavHeader->lBytesPerSecond = fnVerify_ReadLE(pHeader + 28, 4);
+  pstWavHeader->nBlockAlign     = fnVerify_ReadLE(pHeader + 32, 2);
+  pstWavHeader->nBitsPerSample  = fnVerify_ReadLE(pHeader + 34, 2);
+  memcpy(pstWavHeader->sDataHeader,   pHeader + 36, 4);
+  pstWavHeader->lSampleLength   = fnVerify_ReadLE(pHeader + 40, 4);
+
+  /* The chunk identifiers must be where DAEX puts them. */
+  if ((memcmp(pstWavHeader->sRiffHeader, "RIFF", 4) != 0) ||
+      (memcmp(pstWavHeader->sWavHeader, "WAVE", 4) != 0) ||
+      (memcmp(pstWavHeader->sFormatHeader, "fmt ", 4) != 0) ||
+      (memcmp(pstWavHeader->sDataHeader, "data", 4) != 0))
+    return -1;
+
+  /* PCM or float, with a self-consistent format block. */
+  if ((pstWavHeader->lFormatLength != 0x10) ||
+      ((pstWavHeader->nFormatTag != 0x01) && (pstWavHeader->nFormatTag != 0x03)) ||
+      (pstWavHeader->nChannels == 0) ||
+      (pstWavHeader->nBlockAlign != pstWavHeader->nChannels * pstWavHeader->nBitsPerSample / 8) ||
+      (pstWavHeader->lBytesPerSecond != pstWavHeader->lSampleRate * pstWavHeader->nBlockAlign))
+    return -1;
+
+  /* Both length fields must agree with the file as it stands.  A short file
+   * means it was truncated, a long one means the header was never finalized.
+   * An odd length data chunk is followed by a pad byte.
+   */
+  if (((off_t) pstWavHeader->lFileLength + 8 != llFileLength) ||
+      ((off_t) pstWavHeader->lSampleLength + (pstWavHeader->lSampleLength & 1) +
+       WAV_HEADER_LENGTH != llFileLength) ||
+      (pstWavHeader->lSampleLength % pstWavHeader->nBlockAlign != 0))
+    return -1;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnVerify_File(struct VerifyJob_t *pstJob, struct VerifyQueue_t *pstQueue)
+/*
+ * Verify a single file.  The file is mapped a window at a time, so that the
+ * address space used stays small however large the file, and the kernel is
+ * told the access is sequential so it may read ahead aggressively.
+ *
+ *   Input:  pstJob   - The file to verify.
+ *           pstQueue - The work queue (for the byte count).
+ *
+ * Returns:  pstJob   - The result, the file's size and its checksum.
+ */
+/*========================================================================*/
+{
+  struct WavFormat_t stWavHeader;		/* Parsed header             */
+  struct stat stFileStatus;			/* File status               */
+  u_char    *pMapping;				/* Current mapped window     */
+  off_t     llOffset,				/* Start of the window       */
+            llDataEnd;				/* End of the audio data     */
+  size_t    iWindowLength,			/* Length of the window      */
+            iSkip;				/* Header bytes in window    */
+  u_int32_t lChecksum = 0;			/* Running CRC-32            */
+  int       iFileDesc;				/* The file                  */
+
+
+  if ((iFileDesc = open(pstJob->szFilename, O_RDONLY)) < 0) {
+    pstJob->iResult = kiVerify_IOError;
+    return;
+  }
+
+  if ((fstat(iFileDesc, &stFileStatus) < 0) || !S_ISREG(stFileStatus.st_mode)) {
+    close(iFileDesc);
+    pstJob->iResult = kiVerify_IOError;
+    return;
+  }
+
+  pstJob->llBytes = stFileStatus.st_size;
+
+  if (stFileStatus.st_size < WAV_HEADER_LENGTH) {
+    close(iFileDesc);
+    pstJob->iResult = kiVerify_BadHeader;
+    return;
+  }
+
+  llDataEnd = stFileStatus.st_size;
+
+  /* Walk the file one window at a time.  Windows are a multiple of the
+   * page size, so each mapping offset is suitably aligned.
+   */
+  for (llOffset = 0; llOffset < llDataEnd; llOffset += kiVerifyWindowLength) {
+    iWindowLength = (llDataEnd - llOffset > kiVerifyWindowLength) ?
+                    kiVerifyWindowLength : (size_t) (llDataEnd - llOffset);
+
+    pMapping = mmap(NULL, iWindowLength, PROT_READ, MAP_SHARED, iFileDesc, llOffset);
+
+    if (pMapping == MAP_FAILED) {
+      close(iFileDesc);
+      pstJob->iResult = kiVerify_IOError;
+      return;
+    }
+
+    madvise(pMapping, iWindowLength, MADV_SEQUENTIAL);
+
+    iSkip = 0;
+
+    /* The header lives in the first window. */
+    if (llOffset == 0) {
+      if (fnVerify_ParseHeader(pMapping, stFileStatus.st_size, &stWavHeader) < 0) {
+        munmap(pMapping, iWindowLength);
+        close(iFileDesc);
+        pstJob->iResult = kiVerify_BadHeader;
+        return;
+      }
+
+      iSkip = WAV_HEADER_LENGTH;
+
+      /* A pad byte after odd length data is not part of the audio. */
+      llDataEnd -= stWavHeader.lSampleLength & 1;
+    }
+
+    lChecksum = fnCRC_Update(lChecksum, pMapping + iSkip,
+                             ((llDataEnd - llOffset < (off_t) iWindowLength) ?
+                              (size_t) (llDataEnd - llOffset) : iWindowLength) - iSkip);
+
+    munmap(pMapping, iWindowLength);
+
+    /* Account for the bytes, so the throughput reflects work in progress. */
+    pthread_mutex_lock(&pstQueue->stLock);
+    pstQueue->llBytesDone += iWindowLength;
+    pthread_mutex_unlock(&pstQueue->stLock);
+  }
+
+  close(iFileDesc);
+
+  pstJob->lChecksum = lChecksum;
+
+  if (!pstJob->iExpected)
+    pstJob->iResult = kiVerify_Unlisted;
+  else if (pstJob->lExpectedChecksum != lChecksum)
+    pstJob->iResult = kiVerify_Mismatch;
+  else
+    pstJob->iResult = kiVerify_OK;
+}
+
+
+/*========================================================================*/
+void *
+fnVerify_Worker(void *pvQueue)
+/*
+ * Worker thread.  Take the next file from the queue until none are left.
+ *
+ *   Input:  pvQueue - The work queue.
+ * Returns:  NULL.
+ */
+/*========================================================================*/
+{
+  struct VerifyQueue_t *pstQueue;		/* The work queue            */
+  int iJob;					/* Job taken from the queue  */
+
+
+  pstQueue = (struct VerifyQueue_t *) pvQueue;
+
+  for (;;) {
+    pthread_mutex_lock(&pstQueue->stLock);
+    iJob = pstQueue->iNextJob++;
+    pthread_mutex_unlock(&pstQueue->stLock);
+
+    if (iJob >= pstQueue->iJobCount)  break;
+
+    fnVerify_File(&pstQueue->pstJobs[iJob], pstQueue);
+  }
+
+  return NULL;
+}
+
+
+/*========================================================================*/
+int
+fnVerify_CompareJobs(const void *pvJob1, const void *pvJob2)
+/*
+ * qsort()/bsearch() comparison function -- orders jobs by filename.
+ */
+/*========================================================================*/
+{
+  return strcmp(((const struct VerifyJob_t *) pvJob1)->szFilename,
+                ((const struct VerifyJob_t *) pvJob2)->szFilename);
+}
+
+
+/*========================================================================*/
+int
+fnVerify_CompareEntries(const void *pvJob1, const void *pvJob2)
+/*
+ * qsort() comparison function for checksum file entries -- orders entries
+ * by filename, then by the line they were read from (held in llBytes).
+ */
+/*========================================================================*/
+{
+  const struct VerifyJob_t *pstJob1 = pvJob1,
+                           *pstJob2 = pvJob2;
+  int iOrder;
+
+
+  if ((iOrder = strcmp(pstJob1->szFilename, pstJob2->szFilename)) != 0)
+    return iOrder;
+
+  return (pstJob1->llBytes < pstJob2->llBytes) ? -1 : (pstJob1->llBytes > pstJob2->llBytes);
+}
+
+
+/*========================================================================*/
+struct VerifyJob_t *
+fnVerify_LoadChecksums(char *szChecksumFilename, int *piEntries)
+/*
+ * Read a checksum file, as written by "daex -k".  Each line is the CRC-32
+ * in hex, whitespace, and a filename.  Blank lines and lines starting with
+ * '#' are ignored.  Should a file be listed more than once, the last entry
+ * wins, since "daex -k" appends.
+ *
+ *   Input:  szChecksumFilename - The checksum file.
+ *           piEntries          - Where to store the number of entries.
+ *
+ * Returns:  An array of jobs sorted by filename, with the expected checksums
+ *           filled in.  Exits on error.
+ */
+/*========================================================================*/
+{
+  FILE   *fChecksumFile;			/* Checksum file stream      */
+  struct VerifyJob_t *pstEntries = NULL,	/* The entries read          */
+                     *pstResized;		/* Entries after realloc()   */
+  char   szLine[kiChecksumLineLength],		/* Current line              */
+         *pFilename;				/* Filename within the line  */
+  u_long lChecksum;				/* Checksum within the line  */
+  int    iEntries = 0,				/* Entries read              */
+         iAllocated = 0,			/* Entries allocated         */
+         iIndex,				/* Current entry             */
+         iKept;					/* Entries kept after dedup  */
+
+
+  if (! (fChecksumFile = fopen(szChecksumFilename, "r"))) {
+    fprintf(stderr, "daex-verify: Unable to open checksum file: %s.\n", strerror(errno));
+    exit(kiExitStatus_General);
+  }
+
+  while (fgets(szLine, sizeof(szLine), fChecksumFile)) {
+    if ((szLine[0] == '#') || (szLine[0] == '\n'))  continue;
+
+    szLine[strcspn(szLine, "\r\n")] = 0;
+
+    lChecksum = strtoul(szLine, &pFilename, 16);
+
+    if ((pFilename == szLine) || !isspace((u_char) *pFilename)) {
+      fprintf(stderr, "daex-verify: Ignoring malformed checksum line: %s\n", szLine);
+      continue;
+    }
+
+    pFilename += strspn(pFilename, " \t");
+
+    if (iEntries == iAllocated) {
+      iAllocated = iAllocated ? iAllocated * 2 : 256;
+
+      if (! (pstResized = realloc(pstEntries, iAllocated * sizeof(struct VerifyJob_t)))) {
+        fprintf(stderr, "daex-verify: Unable to allocate sufficient memory for the checksums.\n");
+        exit(kiExitStatus_General);
+      }
+
+      pstEntries = pstResized;
+    }
+
+    memset(&pstEntries[iEntries], 0, sizeof(struct VerifyJob_t));
+
+    if (! (pstEntries[iEntries].szFilename = strdup(pFilename))) {
+      fprintf(stderr, "daex-verify: Unable to allocate sufficient memory for the checksums.\n");
+      exit(kiExitStatus_General);
+    }
+
+    pstEntries[iEntries].iExpected         = 1;
+    pstEntries[iEntries].lExpectedChecksum = (u_int32_t) lChecksum;
+    pstEntries[iEntries].iResult           = kiVerify_Pending;
+    pstEntries[iEntries].llBytes           = iEntries;  /* Line order, for the sort */
+    iEntries++;
+  }
+
+  fclose(fChecksumFile);
+
+  /* Sort by filename, then line order, and keep only the last entry for
+   * each file.
+   */
+  qsort(pstEntries, iEntries, sizeof(struct VerifyJob_t), fnVerify_CompareEntries);
+
+  for (iIndex = iKept = 0; iIndex < iEntries; iIndex++) {
+    if ((iIndex + 1 < iEntries) &&
+        (strcmp(pstEntries[iIndex].szFilename, pstEntries[iIndex + 1].szFilename) == 0)) {
+      free(pstEntries[iIndex].szFilename);
+      continue;
+    }
+
+    pstEntries[iKept] = pstEntries[iIndex];
+    pstEntries[iKept++].llBytes = 0;
+  }
+
+  *piEntries = iKept;
+  return pstEntries;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  extern int  optind;		/* The current argument number - getopt()    */
+  extern char *optarg;		/* Current option's arg. string - getopt()   */
+
+  struct VerifyQueue_t stQueue;			/* Shared work queue         */
+  struct VerifyJob_t   *pstChecksums = NULL,	/* Checksum file entries     */
+                       *pstListed,		/* Entry matching a file     */
+                       stKey;			/* bsearch() key             */
+  struct timeval       stStart,			/* Start of verification     */
+                       stFinish;		/* End of verification       */
+  pthread_t            atThreads[kiVerifyMaxThreads]; /* Worker threads      */
+
+  char   *szChecksumFilename = NULL;		/* Checksum file             */
+  double dElapsed;				/* Wall time, in seconds     */
+  int    iArgument,				/* Current getopt() argument */
+         iThreads = 0,				/* Worker thread count       */
+         iVerbose = 0,				/* Report good files too     */
+         iChecksums = 0,			/* Checksum file entries     */
+         iFailures = 0,				/* Files which failed        */
+         iIndex;				/* Current job               */
+
+
+  while ((iArgument = getopt(argc, argv, "j:k:v")) != -1) {
+    switch (iArgument) {
+      case 'j':					/* Worker threads            */
+        iThreads = atoi(optarg);
+
+        if ((iThreads < 1) || (iThreads > kiVerifyMaxThreads)) {
+          fprintf(stderr, "daex-verify: The job count must be between 1 and %i.\n",
+                  kiVerifyMaxThreads);
+          exit(kiExitStatus_General);
+        }
+        break;
+
+      case 'k':					/* Checksum file             */
+        szChecksumFilename = optarg;
+        break;
+
+      case 'v':					/* Verbose                   */
+        iVerbose = 1;
+        break;
+
+      case '?':
+      default:
+        fnVerify_Usage();
+    }
+  }
+
+  argc -= optind;
+  argv += optind;
+
+  if ((argc == 0) && !szChecksumFilename)  fnVerify_Usage();
+
+  /* Default to one worker per CPU. */
+  if (iThreads == 0) {
+    iThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (iThreads < 1)  iThreads = 1;
+    if (iThreads > kiVerifyMaxThreads)  iThreads = kiVerifyMaxThreads;
+  }
+
+  fnCRC_Initialize();
+
+  if (szChecksumFilename)
+    pstChecksums = fnVerify_LoadChecksums(szChecksumFilename, &iChecksums);
+
+  memset(&stQueue, 0, sizeof(stQueue));
+  pthread_mutex_init(&stQueue.stLock, NULL);
+
+  /* With no files named, verify everything in the checksum file.  Otherwise
+   * look each named file up in it.
+   */
+  if (argc == 0) {
+    stQueue.pstJobs   = pstChecksums;
+    stQueue.iJobCount = iChecksums;
+
+  } else {
+    if (! (stQueue.pstJobs = calloc(argc, sizeof(struct VerifyJob_t)))) {
+      fprintf(stderr, "daex-verify: Unable to allocate sufficient memory for the job list.\n");
+      exit(kiExitStatus_General);
+    }
+
+    stQueue.iJobCount = argc;
+
+    for (iIndex = 0; iIndex < argc; iIndex++) {
+      stQueue.pstJobs[iIndex].szFilename = argv[iIndex];
+      stKey.szFilename = argv[iIndex];
+
+      if (pstChecksums &&
+          (pstListed = bsearch(&stKey, pstChecksums, iChecksums, sizeof(struct VerifyJob_t),
+                               fnVerify_CompareJobs))) {
+        stQueue.pstJobs[iIndex].iExpected         = 1;
+        stQueue.pstJobs[iIndex].lExpectedChecksum = pstListed->lExpectedChecksum;
+      }
+    }
+  }
+
+  if (iThreads > stQueue.iJobCount)  iThreads = stQueue.iJobCount;
+
+  gettimeofday(&stStart, NULL);
+
+  for (iIndex = 0; iIndex < iThreads; iIndex++)
+    if (pthread_create(&atThreads[iIndex], NULL, fnVerify_Worker, &stQueue) != 0) {
+      fprintf(stderr, "daex-verify: Unable to create worker thread.\n");
+      exit(kiExitStatus_General);
+    }
+
+  for (iIndex = 0; iIndex < iThreads; iIndex++)
+    pthread_join(atThreads[iIndex], NULL);
+
+  gettimeofday(&stFinish, NULL);
+
+  /* Report, in the order the files were given. */
+  for (iIndex = 0; iIndex < stQueue.iJobCount; iIndex++) {
+    struct VerifyJob_t *pstJob = &stQueue.pstJobs[iIndex];
+
+    switch (pstJob->iResult) {
+      case kiVerify_OK:
+        if (iVerbose)  fprintf(stderr, "%s: OK\n", pstJob->szFilename);
+        break;
+
+      case kiVerify_Unlisted:
+        if (szChecksumFilename) {
+          fprintf(stderr, "%s: no recorded checksum\n", pstJob->szFilename);
+          iFailures++;
+        } else
+          printf("%08x  %s\n", pstJob->lChecksum, pstJob->szFilename);
+        break;
+
+      case kiVerify_Mismatch:
+        fprintf(stderr, "%s: MISMATCH (recorded %08x, found %08x)\n", pstJob->szFilename,
+                pstJob->lExpectedChecksum, pstJob->lChecksum);
+        iFailures++;
+        break;
+
+      case kiVerify_BadHeader:
+        fprintf(stderr, "%s: BAD HEADER (not a complete PCM WAVE file)\n", pstJob->szFilename);
+        iFailures++;
+        break;
+
+      case kiVerify_IOError:
+      default:
+        fprintf(stderr, "%s: unable to read\n", pstJob->szFilename);
+        iFailures++;
+    }
+  }
+
+  dElapsed = (stFinish.tv_sec - stStart.tv_sec) +
+             (stFinish.tv_usec - stStart.tv_usec) / 1000000.0;
+
+  if (dElapsed <= 0)  dElapsed = 0.000001;
+
+  fprintf(stderr, "daex-verify: %i files, %lld bytes in %.2f seconds (%.1f Mbytes/sec, %i threads).\n",
+          stQueue.iJobCount, (long long) stQueue.llBytesDone, dElapsed,
+          stQueue.llBytesDone / dElapsed / (1024 * 1024), iThreads);
+  fprintf(stderr, "daex-verify: %i failed.\n", iFailures);
+
+  exit(iFailures ? kiExitStatus_General : 0);
+}
+
+/* EOF */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX     - The Digital Audio EXtractor
+ *
+ * verify.h - Header for daex-verify, the offline archive verifier.
+ *
+ * $Id$
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define kiVerifyWindowLength	(16 * 1024 * 1024) /* Bytes mapped at a time     */
+#define kiVerifyMaxThreads	64	/* Upper bound on worker threads           */
+
+/* Verification results */
+#define kiVerify_Pending	0	/* Not yet examined                        */
+#define kiVerify_OK		1	/* Header sane, checksum matches (if any)  */
+#define kiVerify_Unlisted	2	/* Header sane, no checksum to compare     */
+#define kiVerify_Mismatch	3	/* Checksum differs from the recorded one  */
+#define kiVerify_BadHeader	4	/* Not a canonical PCM WAVE, or truncated  */
+#define kiVerify_IOError	5	/* Unable to open, stat or map the file    */
+
+/* A file to verify, along with the result once a worker is through with it. */
+struct VerifyJob_t {
+  char      *szFilename;            /* The WAVE file                               */
+  int       iExpected;              /* 1 == lExpectedChecksum is valid             */
+  u_int32_t lExpectedChecksum;      /* Checksum recorded at rip time               */
+  u_int32_t lChecksum;              /* Checksum of the audio data as found         */
+  off_t     llBytes;                /* Size of the file                            */
+  int       iResult;                /* One of the kiVerify_ results                */
+};
+
+/* The work queue shared by the worker threads. */
+struct VerifyQueue_t {
+  pthread_mutex_t    stLock;        /* Protects iNextJob and llBytesDone           */
+  struct VerifyJob_t *pstJobs;      /* Array of jobs                               */
+  int                iJobCount,     /* Number of jobs                              */
+                     iNextJob;      /* Next job to hand out                        */
+  off_t              llBytesDone;   /* Bytes verified thus far                     */
+};
+
+/* EOF */
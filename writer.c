@@ -0,0 +1,2033 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX     - The Digital Audio EXtractor
+ *
+ * writer.c - Output file writers: RIFF/WAVE, RF64, Sony Wave64, AIFF (and
+ *            AIFF-C for floats), raw PCM and FLAC.  Each writer supplies
+ *            only its header and the encoder for its byte order; opening,
+ *            writing, padding and rewriting the header are shared.
+ *
+ * $Id$
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE			/* vmsplice(), F_SETPIPE_SZ          */
+#endif
+
+#include "daex.h"
+#include "format.h"
+#include "resample.h"
+#include "convert.h"
+#include "checksum.h"
+#include "flac.h"
+#include "ring.h"
+#include "net.h"
+#include "writer.h"
+
+/* Sony Wave64 chunk GUIDs, as stored on disk. */
+static const u_char aW64_Riff[16] = { 0x72, 0x69, 0x66, 0x66, 0x2e, 0x91, 0xcf, 0x11,
+                                      0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00 };
+static const u_char aW64_Wave[16] = { 0x77, 0x61, 0x76, 0x65, 0xf3, 0xac, 0xd3, 0x11,
+                                      0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+static const u_char aW64_Fmt[16]  = { 0x66, 0x6d, 0x74, 0x20, 0xf3, 0xac, 0xd3, 0x11,
+                                      0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+static const u_char aW64_Data[16] = { 0x64, 0x61, 0x74, 0x61, 0xf3, 0xac, 0xd3, 0x11,
+                                      0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a };
+
+
+/*------------------------------------------------------------------------*/
+/* Header fields.                                                         */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+u_char *
+fnWriter_PutLE(u_char *pHeader, u_int64_t llValue, int iBytes)
+/*
+ * Store a little-endian field.
+ *
+ *   Input:  pHeader - Where to store it.
+ *           llValue - The value.
+ *           iBytes  - Field width.
+ *
+ * Returns:  The position after the field.
+ */
+/*========================================================================*/
+{
+  int iByte;					/* Current byte              */
+
+
+  for (iByte = 0; iByte < iBytes; iByte++, llValue >>= 8)
+    pHeader[iByte] = llValue & 0xff;
+
+  return pHeader + iBytes;
+}
+
+
+/*========================================================================*/
+u_char *
+fnWriter_PutBE(u_char *pHeader, u_int64_t llValue, int iBytes)
+/*
+ * Store a big-endian field.  As above.
+ */
+/*========================================================================*/
+{
+  int iByte;					/* Current byte              */
+
+
+  for (iByte = iBytes - 1; iByte >= 0; iByte--, llValue >>= 8)
+    pHeader[iByte] = llValue & 0xff;
+
+  return pHeader + iBytes;
+}
+
+
+/*========================================================================*/
+u_char *
+fnWriter_PutID(u_char *pHeader, const void *pvID, int iBytes)
+/*
+ * Store a chunk identifier (four characters, or a GUID).  As above.
+ */
+/*========================================================================*/
+{
+  memcpy(pHeader, pvID, iBytes);
+
+  return pHeader + iBytes;
+}
+
+
+/*========================================================================*/
+u_char *
+fnWriter_PutWaveFormat(u_char *pHeader, struct AudioOutput_t *pstOutput)
+/*
+ * Store the 16 byte WAVEFORMAT block shared by WAVE, RF64 and Wave64.
+ */
+/*========================================================================*/
+{
+  struct SampleFormat_t *pstFormat = pstOutput->pstFormat;
+
+
+  pHeader = fnWriter_PutLE(pHeader, pstFormat->iFloat ? 0x03 : 0x01, 2);  /* Format tag */
+  pHeader = fnWriter_PutLE(pHeader, pstFormat->iChannels, 2);
+  pHeader = fnWriter_PutLE(pHeader, pstFormat->iSampleRate, 4);
+  pHeader = fnWriter_PutLE(pHeader, pstFormat->iSampleRate * pstOutput->iFrameLength, 4);
+  pHeader = fnWriter_PutLE(pHeader, pstOutput->iFrameLength, 2);          /* Block align */
+  pHeader = fnWriter_PutLE(pHeader, pstFormat->iBitsPerSample, 2);
+
+  return pHeader;
+}
+
+
+/*========================================================================*/
+u_char *
+fnWriter_PutExtended(u_char *pHeader, u_long lValue)
+/*
+ * Store an integer as an 80 bit IEEE extended float, as AIFF stores its
+ * sample rate: a 15 bit biased exponent, then a 64 bit mantissa with an
+ * explicit leading 1.
+ */
+/*========================================================================*/
+{
+  int iExponent = 63;				/* Unbiased exponent         */
+  u_int64_t llMantissa = lValue;		/* Normalised mantissa       */
+
+
+  if (lValue == 0)
+    return fnWriter_PutBE(fnWriter_PutBE(pHeader, 0, 2), 0, 8);
+
+  while (! (llMantissa & ((u_int64_t) 1 << 63))) {
+    llMantissa <<= 1;
+    iExponent--;
+  }
+
+  return fnWriter_PutBE(fnWriter_PutBE(pHeader, 16383 + iExponent, 2), llMantissa, 8);
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Encoders: little-endian output samples in, file byte order out, in     */
+/* place.  One is picked per file, by sample width.                       */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+void
+fnWriter_Sign8(u_char *pSamples, size_t iLength)
+/*
+ * 8 bit offset binary to 8 bit signed (AIFF).
+ */
+/*========================================================================*/
+{
+  size_t iByte = 0;				/* Current byte              */
+#ifdef __SSE2__
+  __m128i vSign = _mm_set1_epi8((char) 0x80);	/* Sign bits                 */
+
+
+  for (; iByte + 16 <= iLength; iByte += 16)
+    _mm_storeu_si128((__m128i *) (pSamples + iByte),
+                     _mm_xor_si128(_mm_loadu_si128((__m128i *) (pSamples + iByte)), vSign));
+#endif
+
+  for (; iByte < iLength; iByte++)
+    pSamples[iByte] ^= 0x80;
+}
+
+
+/*========================================================================*/
+void
+fnWriter_Swap16(u_char *pSamples, size_t iLength)
+/*
+ * Byte swap 16 bit samples.  With SSE2, eight at a time, by shifting each
+ * 16 bit lane both ways.
+ */
+/*========================================================================*/
+{
+  size_t iByte = 0;				/* Current byte              */
+  u_char cTemp;					/* Byte being swapped        */
+#ifdef __SSE2__
+  __m128i vSamples;				/* Eight samples             */
+
+
+  for (; iByte + 16 <= iLength; iByte += 16) {
+    vSamples = _mm_loadu_si128((__m128i *) (pSamples + iByte));
+    _mm_storeu_si128((__m128i *) (pSamples + iByte),
+                     _mm_or_si128(_mm_slli_epi16(vSamples, 8), _mm_srli_epi16(vSamples, 8)));
+  }
+#endif
+
+  for (; iByte + 2 <= iLength; iByte += 2) {
+    cTemp               = pSamples[iByte];
+    pSamples[iByte]     = pSamples[iByte + 1];
+    pSamples[iByte + 1] = cTemp;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnWriter_Swap24(u_char *pSamples, size_t iLength)
+/*
+ * Byte swap packed 24 bit samples: the outer bytes of each trade places.
+ * (SSE2 has no byte shuffle, and the three byte stride does not suit the
+ * shifts used for the other widths.)
+ */
+/*========================================================================*/
+{
+  size_t iByte;					/* Current byte              */
+  u_char cTemp;					/* Byte being swapped        */
+
+
+  for (iByte = 0; iByte + 3 <= iLength; iByte += 3) {
+    cTemp               = pSamples[iByte];
+    pSamples[iByte]     = pSamples[iByte + 2];
+    pSamples[iByte + 2] = cTemp;
+  }
+}
+
+
+/*========================================================================*/
+void
+fnWriter_Swap32(u_char *pSamples, size_t iLength)
+/*
+ * Byte swap 32 bit samples (integer or float).  With SSE2, four at a time:
+ * swap the bytes of each 16 bit lane, then the lanes of each sample.
+ */
+/*========================================================================*/
+{
+  size_t iByte = 0;				/* Current byte              */
+  u_char cTemp;					/* Byte being swapped        */
+#ifdef __SSE2__
+  __m128i vSamples;				/* Four samples              */
+
+
+  for (; iByte + 16 <= iLength; iByte += 16) {
+    vSamples = _mm_loadu_si128((__m128i *) (pSamples + iByte));
+    vSamples = _mm_or_si128(_mm_slli_epi16(vSamples, 8), _mm_srli_epi16(vSamples, 8));
+    vSamples = _mm_shufflehi_epi16(_mm_shufflelo_epi16(vSamples, 0xb1), 0xb1);
+    _mm_storeu_si128((__m128i *) (pSamples + iByte), vSamples);
+  }
+#endif
+
+  for (; iByte + 4 <= iLength; iByte += 4) {
+    cTemp               = pSamples[iByte];
+    pSamples[iByte]     = pSamples[iByte + 3];
+    pSamples[iByte + 3] = cTemp;
+    cTemp               = pSamples[iByte + 1];
+    pSamples[iByte + 1] = pSamples[iByte + 2];
+    pSamples[iByte + 2] = cTemp;
+  }
+}
+
+
+/*------------------------------------------------------------------------*/
+/* The writers.                                                           */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+int
+fnWriter_OpenLittleEndian(struct AudioOutput_t *pstOutput)
+/*
+ * The samples leave the converter little-endian, with 8 bit samples offset
+ * binary, as WAVE, RF64, Wave64 and raw files hold them.  Nothing to do.
+ */
+/*========================================================================*/
+{
+  pstOutput->pfnEncode = NULL;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_OpenBigEndian(struct AudioOutput_t *pstOutput)
+/*
+ * AIFF holds samples big-endian, and 8 bit samples signed.
+ */
+/*========================================================================*/
+{
+  switch (pstOutput->pstFormat->iBitsPerSample) {
+    case 8:   pstOutput->pfnEncode = fnWriter_Sign8;   break;
+    case 16:  pstOutput->pfnEncode = fnWriter_Swap16;  break;
+    case 24:  pstOutput->pfnEncode = fnWriter_Swap24;  break;
+    case 32:  pstOutput->pfnEncode = fnWriter_Swap32;  break;
+    default:  return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_OpenFLAC(struct AudioOutput_t *pstOutput)
+/*
+ * FLAC compresses integer samples of up to 24 bits.  The encoder starts
+ * its workers now, so that the first blocks are encoded while the rest of
+ * the track is read.
+ */
+/*========================================================================*/
+{
+  pstOutput->pfnEncode = NULL;
+
+  if (pstOutput->pstFormat->iFloat || (pstOutput->pstFormat->iBitsPerSample > 24))
+    return -1;
+
+  if (! (pstOutput->pstEncoder = calloc(1, sizeof(struct FlacEncoder_t))))
+    return -1;
+
+  return fnFlac_Initialize(pstOutput->pstEncoder, pstOutput->pstFormat->iChannels,
+                           pstOutput->pstFormat->iBitsPerSample,
+                           pstOutput->pstFormat->iSampleRate);
+}
+
+
+/*========================================================================*/
+int
+fnWriter_WAVHeader(struct AudioOutput_t *pstOutput, u_char *pHeader, u_int64_t llDataLength)
+/*
+ * RIFF/WAVE.  While the length is unknown, both sizes are 0xffffffff, as
+ * streamed WAVE files have them.
+ *
+ *   Input:  pstOutput    - The output file.
+ *           pHeader      - Where to lay out the header.
+ *           llDataLength - Bytes of audio, or kllWriter_Unknown.
+ *
+ * Returns:  The header's length, or -1 if the audio is too long for the
+ *           format.
+ */
+/*========================================================================*/
+{
+  u_int64_t llRiffLength,			/* RIFF chunk size           */
+            llChunkLength;			/* data chunk size           */
+
+
+  if (llDataLength == kllWriter_Unknown)
+    llRiffLength = llChunkLength = WAV_MAXIMUM_LENGTH;
+  else {
+    llChunkLength = llDataLength;
+    llRiffLength  = WAV_HEADER_LENGTH - 8 + llDataLength + (llDataLength & 1);
+
+    if (llRiffLength > WAV_MAXIMUM_LENGTH)  return -1;
+  }
+
+  pHeader = fnWriter_PutID(pHeader, "RIFF", 4);
+  pHeader = fnWriter_PutLE(pHeader, llRiffLength, 4);
+  pHeader = fnWriter_PutID(pHeader, "WAVE", 4);
+  pHeader = fnWriter_PutID(pHeader, "fmt ", 4);
+  pHeader = fnWriter_PutLE(pHeader, 16, 4);
+  pHeader = fnWriter_PutWaveFormat(pHeader, pstOutput);
+  pHeader = fnWriter_PutID(pHeader, "data", 4);
+  pHeader = fnWriter_PutLE(pHeader, llChunkLength, 4);
+
+  return WAV_HEADER_LENGTH;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_RF64Header(struct AudioOutput_t *pstOutput, u_char *pHeader, u_int64_t llDataLength)
+/*
+ * RF64 (EBU Tech 3306): WAVE, with the 32 bit sizes set to 0xffffffff and
+ * the real ones kept in a ds64 chunk.  Arguments as above.
+ */
+/*========================================================================*/
+{
+  u_int64_t llRiffLength,			/* RF64 chunk size           */
+            llFrames;				/* Sample frames             */
+
+
+  if (llDataLength == kllWriter_Unknown)
+    llRiffLength = llFrames = kllWriter_Unknown;
+  else {
+    llRiffLength = RF64_HEADER_LENGTH - 8 + llDataLength + (llDataLength & 1);
+    llFrames     = llDataLength / pstOutput->iFrameLength;
+  }
+
+  pHeader = fnWriter_PutID(pHeader, "RF64", 4);
+  pHeader = fnWriter_PutLE(pHeader, WAV_MAXIMUM_LENGTH, 4);
+  pHeader = fnWriter_PutID(pHeader, "WAVE", 4);
+  pHeader = fnWriter_PutID(pHeader, "ds64", 4);
+  pHeader = fnWriter_PutLE(pHeader, 28, 4);
+  pHeader = fnWriter_PutLE(pHeader, llRiffLength, 8);
+  pHeader = fnWriter_PutLE(pHeader, llDataLength, 8);
+  pHeader = fnWriter_PutLE(pHeader, llFrames, 8);
+  pHeader = fnWriter_PutLE(pHeader, 0, 4);	/* No table entries          */
+  pHeader = fnWriter_PutID(pHeader, "fmt ", 4);
+  pHeader = fnWriter_PutLE(pHeader, 16, 4);
+  pHeader = fnWriter_PutWaveFormat(pHeader, pstOutput);
+  pHeader = fnWriter_PutID(pHeader, "data", 4);
+  pHeader = fnWriter_PutLE(pHeader, WAV_MAXIMUM_LENGTH, 4);
+
+  return RF64_HEADER_LENGTH;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_W64Header(struct AudioOutput_t *pstOutput, u_char *pHeader, u_int64_t llDataLength)
+/*
+ * Sony Wave64: WAVE with GUIDs for chunk identifiers, 64 bit sizes which
+ * include the chunk headers, and chunks aligned to 8 bytes.  Arguments as
+ * above.
+ */
+/*========================================================================*/
+{
+  u_int64_t llRiffLength,			/* riff chunk size           */
+            llChunkLength;			/* data chunk size           */
+
+
+  if (llDataLength == kllWriter_Unknown)
+    llRiffLength = llChunkLength = kllWriter_Unknown;
+  else {
+    llChunkLength = 24 + llDataLength;
+    llRiffLength  = W64_HEADER_LENGTH + ((llDataLength + 7) & ~(u_int64_t) 7);
+  }
+
+  pHeader = fnWriter_PutID(pHeader, aW64_Riff, 16);
+  pHeader = fnWriter_PutLE(pHeader, llRiffLength, 8);
+  pHeader = fnWriter_PutID(pHeader, aW64_Wave, 16);
+  pHeader = fnWriter_PutID(pHeader, aW64_Fmt, 16);
+  pHeader = fnWriter_PutLE(pHeader, 24 + 16, 8);
+  pHeader = fnWriter_PutWaveFormat(pHeader, pstOutput);
+  pHeader = fnWriter_PutID(pHeader, aW64_Data, 16);
+  pHeader = fnWriter_PutLE(pHeader, llChunkLength, 8);
+
+  return W64_HEADER_LENGTH;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_AIFFHeader(struct AudioOutput_t *pstOutput, u_char *pHeader, u_int64_t llDataLength)
+/*
+ * FORM/AIFF, or FORM/AIFC with "fl32" compression for floats.  Arguments as
+ * above.
+ */
+/*========================================================================*/
+{
+  struct SampleFormat_t *pstFormat = pstOutput->pstFormat;
+  int       iHeaderLength;			/* Length of the header      */
+  u_int64_t llFormLength,			/* FORM chunk size           */
+            llChunkLength,			/* SSND chunk size           */
+            llFrames;				/* Sample frames             */
+
+
+  iHeaderLength = pstFormat->iFloat ? AIFC_HEADER_LENGTH : AIFF_HEADER_LENGTH;
+
+  if (llDataLength == kllWriter_Unknown) {
+    llFormLength = llChunkLength = WAV_MAXIMUM_LENGTH;
+    llFrames     = 0;
+  } else {
+    llChunkLength = 8 + llDataLength;
+    llFormLength  = iHeaderLength - 8 + llDataLength + (llDataLength & 1);
+    llFrames      = llDataLength / pstOutput->iFrameLength;
+
+    if (llFormLength > WAV_MAXIMUM_LENGTH)  return -1;
+  }
+
+  pHeader = fnWriter_PutID(pHeader, "FORM", 4);
+  pHeader = fnWriter_PutBE(pHeader, llFormLength, 4);
+
+  if (pstFormat->iFloat) {
+    pHeader = fnWriter_PutID(pHeader, "AIFC", 4);
+    pHeader = fnWriter_PutID(pHeader, "FVER", 4);
+    pHeader = fnWriter_PutBE(pHeader, 4, 4);
+    pHeader = fnWriter_PutBE(pHeader, 0xa2805140, 4);	/* AIFC version 1    */
+    pHeader = fnWriter_PutID(pHeader, "COMM", 4);
+    pHeader = fnWriter_PutBE(pHeader, 24, 4);
+  } else {
+    pHeader = fnWriter_PutID(pHeader, "AIFF", 4);
+    pHeader = fnWriter_PutID(pHeader, "COMM", 4);
+    pHeader = fnWriter_PutBE(pHeader, 18, 4);
+  }
+
+  pHeader = fnWriter_PutBE(pHeader, pstFormat->iChannels, 2);
+  pHeader = fnWriter_PutBE(pHeader, llFrames, 4);
+  pHeader = fnWriter_PutBE(pHeader, pstFormat->iBitsPerSample, 2);
+  pHeader = fnWriter_PutExtended(pHeader, pstFormat->iSampleRate);
+
+  if (pstFormat->iFloat) {
+    pHeader = fnWriter_PutID(pHeader, "fl32", 4);
+    pHeader = fnWriter_PutBE(pHeader, 0, 2);	/* Empty name, padded        */
+  }
+
+  pHeader = fnWriter_PutID(pHeader, "SSND", 4);
+  pHeader = fnWriter_PutBE(pHeader, llChunkLength, 4);
+  pHeader = fnWriter_PutBE(pHeader, 0, 4);	/* Offset                    */
+  pHeader = fnWriter_PutBE(pHeader, 0, 4);	/* Block size                */
+
+  return iHeaderLength;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_FLACHeader(struct AudioOutput_t *pstOutput, u_char *pHeader, u_int64_t llDataLength)
+/*
+ * FLAC: the stream marker and a STREAMINFO block, the only metadata.  The
+ * total samples, frame lengths and MD5 are 0 (unknown) until the stream
+ * is finished; a pipe's header gives the total samples, if known, but
+ * never the MD5.
+ */
+/*========================================================================*/
+{
+  pHeader = fnWriter_PutID(pHeader, "fLaC", 4);
+  pHeader = fnWriter_PutBE(pHeader, 0x80, 1);	/* Last block, STREAMINFO    */
+  pHeader = fnWriter_PutBE(pHeader, kiFlac_StreamInfoLength, 3);
+
+  fnFlac_StreamInfo(pstOutput->pstEncoder, pHeader,
+                    (llDataLength == kllWriter_Unknown) ? 0 :
+                    llDataLength / pstOutput->iFrameLength);
+
+  return 4 + 4 + kiFlac_StreamInfoLength;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_RawHeader(struct AudioOutput_t *pstOutput, u_char *pHeader, u_int64_t llDataLength)
+/*
+ * Raw PCM has no header.
+ */
+/*========================================================================*/
+{
+  return 0;
+}
+
+
+/* The writers, by name.  The first is the default. */
+static struct AudioWriter_t astWriters[] = {
+  { "wav",  "wav",  kiWriter_Lengths,                    2, fnWriter_OpenLittleEndian, fnWriter_WAVHeader  },
+  { "aiff", "aiff", kiWriter_Lengths,                    2, fnWriter_OpenBigEndian,    fnWriter_AIFFHeader },
+  { "rf64", "wav",  kiWriter_Lengths,                    2, fnWriter_OpenLittleEndian, fnWriter_RF64Header },
+  { "w64",  "w64",  kiWriter_Lengths,                    8, fnWriter_OpenLittleEndian, fnWriter_W64Header  },
+  { "raw",  "pcm",  0,                                   1, fnWriter_OpenLittleEndian, fnWriter_RawHeader  },
+  { "flac", "flac", kiWriter_Lengths | kiWriter_Encoded, 1, fnWriter_OpenFLAC,         fnWriter_FLACHeader },
+  { "bin",  "bin",  kiWriter_Image,                      1, fnWriter_OpenLittleEndian, fnWriter_RawHeader  },
+  { NULL }
+};
+
+
+/*------------------------------------------------------------------------*/
+/* Common to all writers.                                                 */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+struct AudioWriter_t *
+fnWriter_Find(char *szName)
+/*
+ * Look a writer up by name.
+ *
+ *   Input:  szName - The writer's name, or NULL for the default.
+ * Returns:  The writer, or NULL if there is none by that name.
+ */
+/*========================================================================*/
+{
+  struct AudioWriter_t *pstWriter;		/* Current writer            */
+
+
+  if (!szName)  return astWriters;
+
+  for (pstWriter = astWriters; pstWriter->szName; pstWriter++)
+    if (strcmp(pstWriter->szName, szName) == 0)
+      return pstWriter;
+
+  return NULL;
+}
+
+
+/*========================================================================*/
+void
+fnWriter_List(FILE *pstStream)
+/*
+ * List the writers' names, comma separated.
+ */
+/*========================================================================*/
+{
+  struct AudioWriter_t *pstWriter;		/* Current writer            */
+
+
+  for (pstWriter = astWriters; pstWriter->szName; pstWriter++)
+    fprintf(pstStream, "%s%s", (pstWriter == astWriters) ? "" : ", ", pstWriter->szName);
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Send(struct AudioOutput_t *pstOutput, u_char *pData, size_t iLength)
+/*
+ * Hand staged data to the file, all of it.  A file is written where the
+ * data belongs, so that trimming may move the end back.  A pipe is written
+ * in order; on Linux its pages are handed over by vmsplice() rather than
+ * copied, and the slot is not refilled until the rest of the ring has been
+ * sent after it, by which time the pipe can no longer be holding it.
+ * Published to a ring, the data is already in the ring's slot; sent to
+ * daex-recv, it is copied into the sink's window.
+ *
+ *   Input:  pstOutput - The output file.
+ *           pData     - The data.
+ *           iLength   - Bytes of data.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  ssize_t iSent;				/* Bytes sent by one call    */
+#ifdef __linux__
+  struct iovec stVector;			/* Pages to hand over        */
+#endif
+
+
+  if (pstOutput->pstRing) {
+    if (fnRing_Publish(pstOutput->pstRing, iLength, 0) < 0)  return -1;
+
+    pstOutput->llSent += iLength;
+
+    return 0;
+  }
+
+  if (pstOutput->pstSink) {
+    if (fnNet_Send(pstOutput->pstSink, pData, iLength) < 0)  return -1;
+
+    pstOutput->llSent += iLength;
+
+    return 0;
+  }
+
+  while (iLength > 0) {
+    if (pstOutput->iSeekable)
+      iSent = pwrite(pstOutput->iFileDesc, pData, iLength,
+                     pstOutput->llBase + (off_t) pstOutput->llSent);
+#ifdef __linux__
+    else if (pstOutput->iSplice) {
+      stVector.iov_base = pData;
+      stVector.iov_len  = iLength;
+
+      iSent = vmsplice(pstOutput->iFileDesc, &stVector, 1, 0);
+    }
+#endif
+    else
+      iSent = write(pstOutput->iFileDesc, pData, iLength);
+
+    if (iSent < 0) {
+      if (errno == EINTR)  continue;
+
+#ifdef __linux__
+      /* Not every kind of pipe can take pages; fall back to copying. */
+      if (pstOutput->iSplice && (errno == EINVAL)) {
+        pstOutput->iSplice = 0;
+        continue;
+      }
+#endif
+
+      return -1;
+    }
+
+    if (iSent == 0) {
+      errno = ENOSPC;
+      return -1;
+    }
+
+    pData             += iSent;
+    iLength           -= iSent;
+    pstOutput->llSent += iSent;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Complete(struct AudioOutput_t *pstOutput, u_char *pData, size_t iLength,
+                  off_t llOffset, ssize_t iWritten)
+/*
+ * Finish an asynchronous write which came up short, synchronously.
+ *
+ *   Input:  pstOutput - The output file.
+ *           pData     - The data the write was given.
+ *           iLength   - ... bytes of it.
+ *           llOffset  - Where it goes in the file.
+ *           iWritten  - Bytes the write managed.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  ssize_t iMore;				/* Bytes written here        */
+
+
+  while ((size_t) iWritten < iLength) {
+    iMore = pwrite(pstOutput->iFileDesc, pData + iWritten, iLength - iWritten,
+                   llOffset + iWritten);
+
+    if (iMore <= 0) {
+      if (iMore == 0)  errno = ENOSPC;
+      return -1;
+    }
+
+    iWritten += iMore;
+  }
+
+  return 0;
+}
+
+
+#ifdef __linux__
+/*------------------------------------------------------------------------*/
+/* io_uring, by way of the raw system calls.                              */
+/*------------------------------------------------------------------------*/
+
+/*========================================================================*/
+void
+fnWriter_UringClose(struct AudioOutput_t *pstOutput)
+/*
+ * Tear down the output's io_uring.  Closing the ring unregisters the
+ * slots and the file, and settles any write a failure left in flight.
+ */
+/*========================================================================*/
+{
+  struct WriterUring_t *pstUring;		/* The ring                  */
+
+
+  if (! (pstUring = pstOutput->pstUring))  return;
+
+  if (pstUring->pstEntries != MAP_FAILED)
+    munmap(pstUring->pstEntries, pstUring->iEntriesLength);
+
+  if ((pstUring->pCompletions != MAP_FAILED) &&
+      (pstUring->pCompletions != pstUring->pSubmissions))
+    munmap(pstUring->pCompletions, pstUring->iCompletionsLength);
+
+  if (pstUring->pSubmissions != MAP_FAILED)
+    munmap(pstUring->pSubmissions, pstUring->iSubmissionsLength);
+
+  close(pstUring->iRingDesc);
+  free(pstUring);
+
+  pstOutput->pstUring = NULL;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_UringOpen(struct AudioOutput_t *pstOutput, u_char *pStage, size_t iStageLength)
+/*
+ * Set up an io_uring for the output's slots, and register the slots and
+ * the file with it.
+ *
+ *   Input:  pstOutput    - The output file.
+ *           pStage       - The slots.
+ *           iStageLength - Bytes in them.
+ *
+ * Returns:  -1 if the system has no io_uring to give (or won't let us
+ *           have one), 0 otherwise.
+ *
+ *           pstOutput    - pstUring is set.
+ */
+/*========================================================================*/
+{
+  struct WriterUring_t *pstUring;		/* The ring                  */
+  struct io_uring_params stParameters;		/* What it was set up with   */
+  struct iovec stBuffer;			/* The slots, to register    */
+
+
+  if (! (pstUring = (struct WriterUring_t *) calloc(1, sizeof(struct WriterUring_t))))
+    return -1;
+
+  memset(&stParameters, 0, sizeof(stParameters));
+
+  if ((pstUring->iRingDesc = syscall(__NR_io_uring_setup, kiWriter_AsyncSlots,
+                                     &stParameters)) < 0) {
+    free(pstUring);
+    return -1;
+  }
+
+  /* Newer kernels map both rings in one go. */
+  pstUring->iSubmissionsLength = stParameters.sq_off.array +
+                                 stParameters.sq_entries * sizeof(u_int32_t);
+  pstUring->iCompletionsLength = stParameters.cq_off.cqes +
+                                 stParameters.cq_entries * sizeof(struct io_uring_cqe);
+  pstUring->iEntriesLength     = stParameters.sq_entries * sizeof(struct io_uring_sqe);
+
+  if ((stParameters.features & IORING_FEAT_SINGLE_MMAP) &&
+      (pstUring->iCompletionsLength > pstUring->iSubmissionsLength))
+    pstUring->iSubmissionsLength = pstUring->iCompletionsLength;
+
+  pstUring->pSubmissions = mmap(NULL, pstUring->iSubmissionsLength, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, pstUring->iRingDesc,
+                                IORING_OFF_SQ_RING);
+  pstUring->pCompletions = MAP_FAILED;
+  pstUring->pstEntries   = MAP_FAILED;
+
+  if (pstUring->pSubmissions != MAP_FAILED)
+    pstUring->pCompletions = (stParameters.features & IORING_FEAT_SINGLE_MMAP) ?
+                             pstUring->pSubmissions :
+                             mmap(NULL, pstUring->iCompletionsLength, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, pstUring->iRingDesc,
+                                  IORING_OFF_CQ_RING);
+
+  if (pstUring->pCompletions != MAP_FAILED)
+    pstUring->pstEntries = mmap(NULL, pstUring->iEntriesLength, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, pstUring->iRingDesc,
+                                IORING_OFF_SQES);
+
+  if (pstUring->pstEntries == MAP_FAILED) {
+    pstOutput->pstUring = pstUring;
+    fnWriter_UringClose(pstOutput);
+    return -1;
+  }
+
+  pstUring->plSQTail       = (u_int32_t *) (pstUring->pSubmissions + stParameters.sq_off.tail);
+  pstUring->plSQArray      = (u_int32_t *) (pstUring->pSubmissions + stParameters.sq_off.array);
+  pstUring->lSQMask        = *(u_int32_t *) (pstUring->pSubmissions + stParameters.sq_off.ring_mask);
+  pstUring->plCQHead       = (u_int32_t *) (pstUring->pCompletions + stParameters.cq_off.head);
+  pstUring->plCQTail       = (u_int32_t *) (pstUring->pCompletions + stParameters.cq_off.tail);
+  pstUring->lCQMask        = *(u_int32_t *) (pstUring->pCompletions + stParameters.cq_off.ring_mask);
+  pstUring->pstCompletions = (struct io_uring_cqe *) (pstUring->pCompletions +
+                                                      stParameters.cq_off.cqes);
+
+  /* Registered buffers count against RLIMIT_MEMLOCK, so this may well be
+   * refused; the writes then name the slots themselves.
+   */
+  stBuffer.iov_base = pStage;
+  stBuffer.iov_len  = iStageLength;
+
+  pstUring->iFixedFile   = (syscall(__NR_io_uring_register, pstUring->iRingDesc,
+                                    IORING_REGISTER_FILES, &pstOutput->iFileDesc, 1) == 0);
+  pstUring->iFixedBuffer = (syscall(__NR_io_uring_register, pstUring->iRingDesc,
+                                    IORING_REGISTER_BUFFERS, &stBuffer, 1) == 0);
+
+  pstOutput->pstUring = pstUring;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnWriter_UringQueue(struct AudioOutput_t *pstOutput, u_char *pData, size_t iLength)
+/*
+ * Queue the write of the current slot.  It goes to the kernel with the
+ * next fnWriter_UringEnter().  The ring has an entry for every slot, and
+ * a slot is never queued twice, so there is always room.
+ *
+ *   Input:  pstOutput - The output file.
+ *           pData     - The slot.
+ *           iLength   - Bytes in the slot.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  struct WriterUring_t *pstUring;		/* The ring                  */
+  struct io_uring_sqe  *pstEntry;		/* The write's entry         */
+  u_int32_t lTail,				/* Submission ring tail      */
+            lIndex;				/* ... the entry it names    */
+  int       iSlot;				/* The slot                  */
+
+
+  pstUring = pstOutput->pstUring;
+  iSlot    = pstOutput->iSlot;
+
+  pstUring->astSlots[iSlot].iov_base = pData;
+  pstUring->astSlots[iSlot].iov_len  = iLength;
+  pstUring->allOffsets[iSlot]        = pstOutput->llBase + (off_t) pstOutput->llSent;
+  pstUring->aiDone[iSlot]            = 0;
+
+  lTail    = *pstUring->plSQTail;
+  lIndex   = lTail & pstUring->lSQMask;
+  pstEntry = &pstUring->pstEntries[lIndex];
+
+  memset(pstEntry, 0, sizeof(struct io_uring_sqe));
+
+  /* Without the fixed buffer, a vectored write is the one every io_uring
+   * kernel has.
+   */
+  if (pstUring->iFixedBuffer) {
+    pstEntry->opcode    = IORING_OP_WRITE_FIXED;
+    pstEntry->addr      = (u_int64_t) (uintptr_t) pData;
+    pstEntry->len       = iLength;
+    pstEntry->buf_index = 0;
+  } else {
+    pstEntry->opcode    = IORING_OP_WRITEV;
+    pstEntry->addr      = (u_int64_t) (uintptr_t) &pstUring->astSlots[iSlot];
+    pstEntry->len       = 1;
+  }
+
+  pstEntry->fd        = pstUring->iFixedFile ? 0 : pstOutput->iFileDesc;
+  pstEntry->flags     = pstUring->iFixedFile ? IOSQE_FIXED_FILE : 0;
+  pstEntry->off       = pstUring->allOffsets[iSlot];
+  pstEntry->user_data = iSlot;
+
+  pstUring->plSQArray[lIndex] = lIndex;
+  __atomic_store_n(pstUring->plSQTail, lTail + 1, __ATOMIC_RELEASE);
+
+  pstUring->iQueued++;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_UringEnter(struct AudioOutput_t *pstOutput, int iWait)
+/*
+ * Submit the writes queued, wait for a completion if asked, and reap
+ * every completion there is.
+ *
+ *   Input:  pstOutput - The output file.
+ *           iWait     - Wait for at least one completion (flag).
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct WriterUring_t *pstUring;		/* The ring                  */
+  struct io_uring_cqe  *pstCompletion;		/* Current completion        */
+  u_int32_t lHead,				/* Completion ring head      */
+            lTail;				/* ... and tail              */
+  int       iSubmitted;				/* Writes the kernel took    */
+
+
+  pstUring = pstOutput->pstUring;
+
+  if (pstUring->iQueued || iWait) {
+    iSubmitted = syscall(__NR_io_uring_enter, pstUring->iRingDesc, pstUring->iQueued,
+                         iWait ? 1 : 0, iWait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+    if (iSubmitted < 0)
+      return (errno == EINTR) ? 0 : -1;
+
+    pstUring->iQueued -= iSubmitted;
+  }
+
+  lHead = *pstUring->plCQHead;
+  lTail = __atomic_load_n(pstUring->plCQTail, __ATOMIC_ACQUIRE);
+
+  for (; lHead != lTail; lHead++) {
+    pstCompletion = &pstUring->pstCompletions[lHead & pstUring->lCQMask];
+
+    pstUring->aiResults[pstCompletion->user_data] = pstCompletion->res;
+    pstUring->aiDone[pstCompletion->user_data]    = 1;
+  }
+
+  __atomic_store_n(pstUring->plCQHead, lHead, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_UringDrain(struct AudioOutput_t *pstOutput)
+/*
+ * Submit whatever is queued, and wait until every write in flight has
+ * completed, whether or not it succeeded.  Their results are left for
+ * fnWriter_UringWait().
+ *
+ *   Input:  pstOutput - The output file.
+ *
+ * Returns:  -1 if the ring itself failed, so that writes may still be with
+ *           the kernel (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct WriterUring_t *pstUring;		/* The ring                  */
+  int    iSlot;					/* Current slot              */
+
+
+  pstUring = pstOutput->pstUring;
+
+  for (iSlot = 0; iSlot < pstOutput->iSlots; )
+    if (!pstUring->astSlots[iSlot].iov_len || pstUring->aiDone[iSlot])
+      iSlot++;
+    else if ((fnWriter_UringEnter(pstOutput, 1) < 0) && (errno != EAGAIN) && (errno != EBUSY))
+      return -1;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_UringWait(struct AudioOutput_t *pstOutput, int iSlot)
+/*
+ * fnWriter_Wait(), for writes through the io_uring.  Whatever is queued
+ * is submitted on the way, so a write never waits in the queue for long.
+ */
+/*========================================================================*/
+{
+  struct WriterUring_t *pstUring;		/* The ring                  */
+  struct iovec *pstSlot;			/* The slot's write          */
+  size_t iLength;				/* ... bytes in it           */
+
+
+  pstUring = pstOutput->pstUring;
+  pstSlot  = &pstUring->astSlots[iSlot];
+
+  if (fnWriter_UringEnter(pstOutput, 0) < 0)  return -1;
+
+  if (pstSlot->iov_len == 0)  return 0;
+
+  /* On error the write may still be with the kernel, so the slot is kept
+   * in flight, for fnWriter_UringDrain() to see through.
+   */
+  while (!pstUring->aiDone[iSlot])
+    if (fnWriter_UringEnter(pstOutput, 1) < 0)  return -1;
+
+  iLength          = pstSlot->iov_len;
+  pstSlot->iov_len = 0;
+
+  if (pstUring->aiResults[iSlot] < 0) {
+    errno = -pstUring->aiResults[iSlot];
+    return -1;
+  }
+
+  return fnWriter_Complete(pstOutput, pstSlot->iov_base, iLength, pstUring->allOffsets[iSlot],
+                           pstUring->aiResults[iSlot]);
+}
+#endif
+
+
+/*========================================================================*/
+int
+fnWriter_Wait(struct AudioOutput_t *pstOutput, int iSlot)
+/*
+ * Wait for the asynchronous write of a slot, if one is in flight, so that
+ * the slot may be refilled.  Should the write come up short, the rest is
+ * written here.
+ *
+ *   Input:  pstOutput - The output file.
+ *           iSlot     - The slot.
+ *
+ * Returns:  -1 if the write failed (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct aiocb *pstRequest;			/* The slot's write          */
+  const struct aiocb *apstList[1];		/* ... for aio_suspend()     */
+  ssize_t iWritten;				/* Bytes it wrote            */
+  size_t  iLength;				/* ... of those it was given */
+  int     iError;				/* Its status                */
+
+
+#ifdef __linux__
+  if (pstOutput->pstUring)
+    return fnWriter_UringWait(pstOutput, iSlot);
+#endif
+
+  if (!pstOutput->pstRequests)  return 0;
+
+  pstRequest = &pstOutput->pstRequests[iSlot];
+
+  if (pstRequest->aio_nbytes == 0)  return 0;
+
+  apstList[0] = pstRequest;
+
+  while ((iError = aio_error(pstRequest)) == EINPROGRESS)
+    aio_suspend(apstList, 1, NULL);
+
+  iWritten = aio_return(pstRequest);
+  iLength  = pstRequest->aio_nbytes;
+
+  pstRequest->aio_nbytes = 0;
+
+  if (iError != 0) {
+    errno = iError;
+    return -1;
+  }
+
+  return fnWriter_Complete(pstOutput, (u_char *) pstRequest->aio_buf, iLength,
+                           pstRequest->aio_offset, iWritten);
+}
+
+
+/*========================================================================*/
+int
+fnWriter_WaitAll(struct AudioOutput_t *pstOutput)
+/*
+ * Wait for every asynchronous write in flight.  All of them are waited
+ * for before any failure is reported.
+ *
+ *   Input:  pstOutput - The output file.
+ * Returns:  -1 if any write failed (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  int iSlot,					/* Current slot              */
+      iReturnValue = 0;				/* Return value              */
+
+
+  if (!pstOutput->pstRequests && !pstOutput->pstUring)  return 0;
+
+#ifdef __linux__
+  if (pstOutput->pstUring && (fnWriter_UringDrain(pstOutput) < 0))
+    iReturnValue = -1;
+#endif
+
+  for (iSlot = 0; iSlot < pstOutput->iSlots; iSlot++)
+    if (fnWriter_Wait(pstOutput, iSlot) < 0)
+      iReturnValue = -1;
+
+  return iReturnValue;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Submit(struct AudioOutput_t *pstOutput, u_char *pData, size_t iLength)
+/*
+ * Send a full slot.  With asynchronous output the write is queued and we
+ * return at once; the slot is not touched again until fnWriter_Wait() says
+ * the write is done.  On Linux it goes through the io_uring, and is handed
+ * to the kernel by that fnWriter_Wait(); elsewhere it goes to aio_write().
+ * If the system won't queue it, output carries on synchronously from
+ * here, to the same effect.
+ *
+ *   Input:  pstOutput - The output file.
+ *           pData     - The slot.
+ *           iLength   - Bytes in the slot.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct aiocb *pstRequest;			/* The slot's write          */
+
+
+#ifdef __linux__
+  if (pstOutput->pstUring) {
+    fnWriter_UringQueue(pstOutput, pData, iLength);
+    pstOutput->llSent += iLength;
+
+    return 0;
+  }
+#endif
+
+  if (pstOutput->pstRequests) {
+    pstRequest = &pstOutput->pstRequests[pstOutput->iSlot];
+
+    memset(pstRequest, 0, sizeof(struct aiocb));
+
+    pstRequest->aio_fildes = pstOutput->iFileDesc;
+    pstRequest->aio_buf    = pData;
+    pstRequest->aio_nbytes = iLength;
+    pstRequest->aio_offset = pstOutput->llBase + (off_t) pstOutput->llSent;
+
+    if (aio_write(pstRequest) == 0) {
+      pstOutput->llSent += iLength;
+      return 0;
+    }
+
+    /* Out of requests, or no AIO for this file: wait for what's queued,
+     * and write synchronously from now on.
+     */
+    pstRequest->aio_nbytes = 0;
+
+    if (fnWriter_WaitAll(pstOutput) < 0)  return -1;
+
+    free(pstOutput->pstRequests);
+    pstOutput->pstRequests = NULL;
+  }
+
+  return fnWriter_Send(pstOutput, pData, iLength);
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Sync(struct AudioOutput_t *pstOutput)
+/*
+ * Keep the dirty data bounded, if asked to: fdatasync() once the sync
+ * interval's worth has been sent since the last time.
+ *
+ *   Input:  pstOutput - The output file.
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  if (!pstOutput->llSyncInterval ||
+      (pstOutput->llSent - pstOutput->llSynced < pstOutput->llSyncInterval))
+    return 0;
+
+  if ((fnWriter_WaitAll(pstOutput) < 0) || (fdatasync(pstOutput->iFileDesc) < 0))
+    return -1;
+
+  pstOutput->llSynced = pstOutput->llSent;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnWriter_Cached(struct AudioOutput_t *pstOutput)
+/*
+ * Go back to writing through the page cache, for the odd sized and odd
+ * placed writes O_DIRECT won't take: the end of the audio, and the header.
+ */
+/*========================================================================*/
+{
+#ifdef O_DIRECT
+  if (pstOutput->iDirect)
+    fcntl(pstOutput->iFileDesc, F_SETFL, fcntl(pstOutput->iFileDesc, F_GETFL) & ~O_DIRECT);
+#endif
+
+  pstOutput->iDirect = 0;
+}
+
+
+/*========================================================================*/
+u_char *
+fnWriter_Slot(struct AudioOutput_t *pstOutput)
+/*
+ * The current staging slot: the ring's slot being filled, when publishing
+ * to a ring.
+ */
+/*========================================================================*/
+{
+  if (pstOutput->pstRing)
+    return fnRing_Claim(pstOutput->pstRing);
+
+  return pstOutput->pStage + pstOutput->iSlot * pstOutput->iSlotLength;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Stage(struct AudioOutput_t *pstOutput, const u_char *pData, size_t iLength)
+/*
+ * Add data to the staging slots, sending each slot as it fills.  A file
+ * has a single, large slot, so that it is written in large pieces at
+ * offsets which are a multiple of the slot's length.  Data which is
+ * already in its place in the slot (see fnWriter_Buffer()) isn't copied.
+ *
+ *   Input:  pstOutput - The output file.
+ *           pData     - The data, in the file's byte order.
+ *           iLength   - Bytes of data.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_char *pSlot;				/* The current slot          */
+  size_t iCopy;					/* Bytes going in this slot  */
+
+
+  while (iLength > 0) {
+    pSlot = fnWriter_Slot(pstOutput);
+    iCopy = pstOutput->iSlotLength - pstOutput->iStaged;
+
+    if (iCopy > iLength)  iCopy = iLength;
+
+    if (pSlot + pstOutput->iStaged != pData)
+      memmove(pSlot + pstOutput->iStaged, pData, iCopy);
+
+    pstOutput->iStaged += iCopy;
+    pData              += iCopy;
+    iLength            -= iCopy;
+
+    if (pstOutput->iStaged == pstOutput->iSlotLength) {
+      if (fnWriter_Submit(pstOutput, pSlot, pstOutput->iSlotLength) < 0)
+        return -1;
+
+      pstOutput->iSlot   = (pstOutput->iSlot + 1) % pstOutput->iSlots;
+      pstOutput->iStaged = 0;
+
+      if ((fnWriter_Wait(pstOutput, pstOutput->iSlot) < 0) || (fnWriter_Sync(pstOutput) < 0))
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Drain(struct AudioOutput_t *pstOutput)
+/*
+ * Wait for the writes in flight, and send whatever is staged in the
+ * current slot.
+ *
+ *   Input:  pstOutput - The output file.
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  if (fnWriter_WaitAll(pstOutput) < 0)  return -1;
+
+  if (pstOutput->iStaged == 0)  return 0;
+
+  /* A short slot would be a short O_DIRECT write. */
+  fnWriter_Cached(pstOutput);
+
+  if (fnWriter_Send(pstOutput, fnWriter_Slot(pstOutput), pstOutput->iStaged) < 0)
+    return -1;
+
+  pstOutput->iSlot   = (pstOutput->iSlot + 1) % pstOutput->iSlots;
+  pstOutput->iStaged = 0;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Allocate(struct AudioOutput_t *pstOutput)
+/*
+ * Allocate the staging slots.  A file gets a single slot, so that it is
+ * written a megabyte at a time rather than a block at a time.  A pipe gets
+ * smaller slots; on Linux, with the pipe enlarged if we're allowed, enough
+ * of them that vmsplice() may be used.
+ *
+ *   Input:  pstOutput - The output file.
+ * Returns:  -1 if the slots could not be allocated, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  long lPageLength;				/* Bytes per page            */
+#ifdef __linux__
+  struct stat stStatus;				/* The output's type         */
+  int iPipeLength;				/* Bytes the pipe holds      */
+#endif
+
+
+  lPageLength            = sysconf(_SC_PAGESIZE);
+  pstOutput->iSlotLength = pstOutput->iSeekable ? kiWriter_FileSlot : kiWriter_PipeSlot;
+  pstOutput->iSlots      = 1;
+
+#ifdef __linux__
+  if (!pstOutput->iSeekable &&
+      (fstat(pstOutput->iFileDesc, &stStatus) == 0) && S_ISFIFO(stStatus.st_mode)) {
+    fcntl(pstOutput->iFileDesc, F_SETPIPE_SZ, kiWriter_PipeLength);
+
+    if ((iPipeLength = fcntl(pstOutput->iFileDesc, F_GETPIPE_SZ)) > 0) {
+      pstOutput->iSplice = 1;
+      pstOutput->iSlots  = iPipeLength / kiWriter_PipeSlot + 2;
+    }
+  }
+#endif
+
+  if (posix_memalign((void **) &pstOutput->pStage, lPageLength,
+                     pstOutput->iSlots * pstOutput->iSlotLength) != 0) {
+    pstOutput->pStage = NULL;
+    errno = ENOMEM;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Open(struct AudioOutput_t *pstOutput, struct AudioWriter_t *pstWriter,
+              int iFileDesc, struct SampleFormat_t *pstFormat,
+              u_int64_t llExpectedLength)
+/*
+ * Start an output file: check the writer can hold the samples, and stage
+ * the header.  If the file can be seeked, the header is rewritten once the
+ * track is complete.  If not (a pipe), the header is final from the start:
+ * it holds the length expected if that is known, or says the length is
+ * unknown if not.
+ *
+ *   Input:  pstOutput        - The output file.
+ *           pstWriter        - The file format.
+ *           iFileDesc        - The file, positioned where the header goes.
+ *           pstFormat        - The samples' format.  Must outlive the output.
+ *           llExpectedLength - Bytes of audio which will be written, or
+ *                              kllWriter_Unknown.
+ *
+ * Returns:  -1 if the format is not supported or the staging slots could
+ *           not be allocated, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_char aHeader[kiWriter_MaximumHeader];	/* The header                */
+  struct stat stStatus;				/* The file's type           */
+
+
+  memset(pstOutput, 0, sizeof(struct AudioOutput_t));
+
+  pstOutput->pstWriter    = pstWriter;
+  pstOutput->pstFormat    = pstFormat;
+  pstOutput->iFileDesc    = iFileDesc;
+  pstOutput->llBase       = lseek(iFileDesc, 0, SEEK_CUR);
+  pstOutput->iSeekable    = (pstOutput->llBase >= 0);
+  pstOutput->iRegular     = (fstat(iFileDesc, &stStatus) == 0) && S_ISREG(stStatus.st_mode);
+  pstOutput->iFrameLength = pstFormat->iChannels * pstFormat->iBitsPerSample / 8;
+
+  errno = 0;
+
+  if ((pstWriter->pfnOpen(pstOutput) < 0) || (fnWriter_Allocate(pstOutput) < 0))
+    return -1;
+
+  /* A seekable file starts out claiming no audio, so that one left behind
+   * by a crash is never mistaken for a whole track.
+   */
+  if (pstOutput->iSeekable) {
+    pstOutput->llExpectedLength = kllWriter_Unknown;
+    pstOutput->iHeaderLength    = pstWriter->pfnHeader(pstOutput, aHeader, 0);
+
+    return fnWriter_Stage(pstOutput, aHeader, pstOutput->iHeaderLength);
+  }
+
+  /* A length too long for the format's sizes is as good as unknown. */
+  pstOutput->llExpectedLength = llExpectedLength;
+
+  if ((llExpectedLength == kllWriter_Unknown) ||
+      ((pstOutput->iHeaderLength = pstWriter->pfnHeader(pstOutput, aHeader, llExpectedLength)) < 0)) {
+    pstOutput->llExpectedLength = kllWriter_Unknown;
+    pstOutput->iHeaderLength    = pstWriter->pfnHeader(pstOutput, aHeader, kllWriter_Unknown);
+  }
+
+  return fnWriter_Stage(pstOutput, aHeader, pstOutput->iHeaderLength);
+}
+
+
+/*========================================================================*/
+void
+fnWriter_Policy(struct AudioOutput_t *pstOutput, int iPolicy, u_int64_t llSyncInterval)
+/*
+ * Choose how a file is written.  Must be called before any audio is
+ * written.  The policies only apply to regular files.  Bypassing the page
+ * cache is quietly dropped if the file system won't have it, as is
+ * asynchronous output if the slots for it can't be had.
+ *
+ *   Input:  pstOutput      - The output file.
+ *           iPolicy        - Output policies (kiWriter_*).
+ *           llSyncInterval - fdatasync() each time this many bytes have
+ *                            been written, or 0 not to.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  u_char *pStage;				/* Slots for asynchronous output */
+  int    iUring = 0;				/* ... written through io_uring */
+
+
+  /* Only a file can be synced. */
+  pstOutput->iPolicy        = pstOutput->iRegular ? iPolicy : 0;
+  pstOutput->llSyncInterval = pstOutput->iRegular ? llSyncInterval : 0;
+
+#ifdef O_DIRECT
+  /* The slots are page aligned and written at multiples of their length,
+   * so every write but the last meets O_DIRECT's alignment rules as long
+   * as the header starts on a page.
+   */
+  if ((pstOutput->iPolicy & kiWriter_Uncached) &&
+      (pstOutput->llBase % sysconf(_SC_PAGESIZE) == 0))
+    pstOutput->iDirect = (fcntl(pstOutput->iFileDesc, F_SETFL,
+                                fcntl(pstOutput->iFileDesc, F_GETFL) | O_DIRECT) == 0);
+#endif
+
+  /* Asynchronous output keeps several slots in flight, so that filling
+   * one never waits on the write of another.  Only the header has been
+   * staged so far, and it moves across to the new slots.  On Linux the
+   * writes go through an io_uring if the kernel will give us one, and
+   * through POSIX AIO if not.
+   */
+  if (pstOutput->iPolicy & kiWriter_Async) {
+    if (posix_memalign((void **) &pStage, sysconf(_SC_PAGESIZE),
+                       kiWriter_AsyncSlots * pstOutput->iSlotLength) != 0)
+      return;
+
+#ifdef __linux__
+    iUring = (fnWriter_UringOpen(pstOutput, pStage,
+                                 kiWriter_AsyncSlots * pstOutput->iSlotLength) == 0);
+#endif
+
+    if (!iUring && ! (pstOutput->pstRequests = (struct aiocb *)
+                      calloc(kiWriter_AsyncSlots, sizeof(struct aiocb)))) {
+      free(pStage);
+      return;
+    }
+
+    memcpy(pStage, pstOutput->pStage, pstOutput->iStaged);
+    free(pstOutput->pStage);
+
+    pstOutput->pStage = pStage;
+    pstOutput->iSlots = kiWriter_AsyncSlots;
+  }
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Reserve(struct AudioOutput_t *pstOutput, u_int64_t llDataLength)
+/*
+ * Allocate the file's blocks up front, so that the file system may lay
+ * them out in one piece rather than as the file grows.  The file is cut
+ * back to the length of what is actually written when it is finalized.
+ * Where the file system can't do this cheaply, nothing is done.
+ *
+ *   Input:  pstOutput    - The output file.
+ *           llDataLength - Bytes of audio expected.
+ *
+ * Returns:  -1 if the blocks were not allocated, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  off_t llLength;				/* Bytes to allocate         */
+
+
+  if (!pstOutput->iRegular || (llDataLength == kllWriter_Unknown))  return -1;
+
+  llLength = pstOutput->iHeaderLength + llDataLength + pstOutput->pstWriter->iAlignment;
+
+#ifdef __linux__
+  /* Unlike posix_fallocate(), this never falls back to writing zeroes. */
+  return (fallocate(pstOutput->iFileDesc, 0, pstOutput->llBase, llLength) == 0) ? 0 : -1;
+#else
+  return (posix_fallocate(pstOutput->iFileDesc, pstOutput->llBase, llLength) == 0) ? 0 : -1;
+#endif
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Map(struct AudioOutput_t *pstOutput, u_int64_t llDataLength)
+/*
+ * Map the file into memory, so that audio may be read from the device
+ * straight into the file's pages (see fnWriter_Buffer()).  The blocks are
+ * allocated first: a write to a page the file system then couldn't find
+ * room for would be a SIGBUS, rather than an error we could report.
+ *
+ *   Input:  pstOutput    - The output file, with only the header staged.
+ *           llDataLength - Bytes of audio expected.  No more may be written.
+ *
+ * Returns:  -1 if the file can't be mapped (as a compressed one can't be),
+ *           in which case it is written as usual, 0 otherwise.
+ */
+/*========================================================================*/
+{
+  void *pvMapping;				/* The mapping               */
+
+
+  if (pstOutput->pstEncoder || (pstOutput->llBase % sysconf(_SC_PAGESIZE) != 0) ||
+      (fnWriter_Reserve(pstOutput, llDataLength) < 0))
+    return -1;
+
+  pstOutput->iMapLength = pstOutput->iHeaderLength + llDataLength +
+                          pstOutput->pstWriter->iAlignment;
+
+  if ((pvMapping = mmap(NULL, pstOutput->iMapLength, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        pstOutput->iFileDesc, pstOutput->llBase)) == MAP_FAILED)
+    return -1;
+
+  madvise(pvMapping, pstOutput->iMapLength, MADV_SEQUENTIAL);
+
+  /* The header moves from the staging slot to the file. */
+  pstOutput->pMapping = (u_char *) pvMapping;
+
+  memcpy(pstOutput->pMapping, pstOutput->pStage, pstOutput->iStaged);
+
+  pstOutput->iStaged = 0;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Ring(struct AudioOutput_t *pstOutput, struct SharedRing_t *pstRing, int iTrack)
+/*
+ * Publish the output to a shared memory ring instead of the file, as it
+ * would have been written to a pipe.  The header goes in a slot of its
+ * own, so that each block of audio which follows fills a slot exactly and
+ * may be read straight into it (see fnWriter_Buffer()).
+ *
+ *   Input:  pstOutput - The output, opened on no file (-1), with only the
+ *                       header staged.
+ *           pstRing   - The ring, created.
+ *           iTrack    - The track being published.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  fnRing_StartTrack(pstRing, iTrack);
+
+  memcpy(fnRing_Claim(pstRing), pstOutput->pStage, pstOutput->iStaged);
+
+  if (fnRing_Publish(pstRing, pstOutput->iStaged, kiRing_TrackStart) < 0)
+    return -1;
+
+  pstOutput->pstRing     = pstRing;
+  pstOutput->iSlotLength = pstRing->pstHeader->lSlotLength;
+  pstOutput->llSent     += pstOutput->iStaged;
+  pstOutput->iStaged     = 0;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnWriter_Sink(struct AudioOutput_t *pstOutput, struct NetSink_t *pstSink)
+/*
+ * Send the output to daex-recv instead of the file, as it would have been
+ * written to a pipe.  Nothing has been sent yet; the header goes with the
+ * first slot.
+ *
+ *   Input:  pstOutput - The output, opened on no file (-1).
+ *           pstSink   - The sink, its track started.
+ *
+ * Returns:  None.
+ */
+/*========================================================================*/
+{
+  pstOutput->pstSink = pstSink;
+}
+
+
+/*========================================================================*/
+u_char *
+fnWriter_Buffer(struct AudioOutput_t *pstOutput)
+/*
+ * Where the next audio written will be stored, if the file is mapped, or
+ * if a ring's slot has room for another block.  Audio put there and then
+ * passed to fnWriter_Write() is not copied again.
+ *
+ *   Input:  pstOutput - The output file.
+ * Returns:  The address in the file's mapping or the ring's slot, or NULL
+ *           if there is none.
+ */
+/*========================================================================*/
+{
+  if (pstOutput->pstRing && !pstOutput->pstEncoder &&
+      (pstOutput->iSlotLength - pstOutput->iStaged >= CDDA_DATA_LENGTH))
+    return fnWriter_Slot(pstOutput) + pstOutput->iStaged;
+
+  if (!pstOutput->pMapping)  return NULL;
+
+  return pstOutput->pMapping + pstOutput->iHeaderLength + pstOutput->llDataLength;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Emit(void *pvOutput, const u_char *pFrame, size_t iLength)
+/*
+ * Stage a frame of compressed audio; the encoder's way out to the file.
+ *
+ *   Input:  pvOutput - The output file.
+ *           pFrame   - The frame.
+ *           iLength  - Bytes in the frame.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  struct AudioOutput_t *pstOutput;		/* The output file           */
+
+
+  pstOutput = (struct AudioOutput_t *) pvOutput;
+
+  if (fnWriter_Stage(pstOutput, pFrame, iLength) < 0)  return -1;
+
+  pstOutput->llEncodedLength += iLength;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Write(struct AudioOutput_t *pstOutput, u_char **ppSamples, size_t iLength)
+/*
+ * Write samples to the output file.  They are put in the file's byte order
+ * in place, or handed to the encoder, which writes out whatever frames it
+ * has finished.
+ *
+ * A mapped file is written by moving the samples into the mapping, unless
+ * they're already there.  Every so often the pages completed are
+ * scheduled for writing with msync(), so that they go to disk in large
+ * pieces while the rest of the track is read.
+ *
+ *   Input:  pstOutput - The output file.
+ *           ppSamples - Whole frames, in the converter's output format.
+ *           iLength   - Bytes of samples.
+ *
+ * Returns:  Bytes written, or -1 (see errno).
+ *
+ *           ppSamples - Where the samples are now, exactly as in the file.
+ */
+/*========================================================================*/
+{
+  u_char  *pDestination;			/* Their place in the file   */
+  u_int64_t llChunk;				/* Bytes to msync() at once  */
+  size_t  iPageLength,				/* Bytes per page            */
+          iDone;				/* Whole pages completed     */
+
+
+  if (pstOutput->pfnEncode)
+    pstOutput->pfnEncode(*ppSamples, iLength);
+
+  if (pstOutput->pstEncoder) {
+    if (fnFlac_Write(pstOutput->pstEncoder, *ppSamples, iLength, fnWriter_Emit, pstOutput) < 0)
+      return -1;
+
+    pstOutput->llDataLength += iLength;
+
+    return iLength;
+  }
+
+  if (!pstOutput->pMapping) {
+    if (fnWriter_Stage(pstOutput, *ppSamples, iLength) < 0)  return -1;
+
+    pstOutput->llDataLength += iLength;
+
+    return iLength;
+  }
+
+  pDestination = fnWriter_Buffer(pstOutput);
+
+  if (pstOutput->iHeaderLength + pstOutput->llDataLength + iLength > pstOutput->iMapLength) {
+    errno = EFBIG;
+    return -1;
+  }
+
+  /* Leading silence trimmed off a block read into place leaves the sound
+   * a little way in, overlapping where it belongs.
+   */
+  if (*ppSamples != pDestination)
+    memmove(pDestination, *ppSamples, iLength);
+
+  *ppSamples               = pDestination;
+  pstOutput->llDataLength += iLength;
+
+  llChunk     = pstOutput->llSyncInterval ? pstOutput->llSyncInterval : kiWriter_MapChunk;
+  iPageLength = sysconf(_SC_PAGESIZE);
+  iDone       = (pstOutput->iHeaderLength + pstOutput->llDataLength) / iPageLength * iPageLength;
+
+  if (iDone >= pstOutput->iMapSynced + llChunk) {
+    if (msync(pstOutput->pMapping + pstOutput->iMapSynced, iDone - pstOutput->iMapSynced,
+              pstOutput->llSyncInterval ? MS_SYNC : MS_ASYNC) < 0)
+      return -1;
+
+    pstOutput->iMapSynced = iDone;
+  }
+
+  return iLength;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Truncate(struct AudioOutput_t *pstOutput, u_int64_t llDataLength)
+/*
+ * Cut the audio written back to the length given.  Audio still staged is
+ * simply dropped.
+ *
+ *   Input:  pstOutput    - The output file.
+ *           llDataLength - Bytes of audio to keep.
+ *
+ * Returns:  -1 if the file could not be truncated (see errno; ESPIPE for a
+ *           pipe, EINVAL for compressed audio), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_int64_t llEnd;				/* New end of the file       */
+
+
+  if (llDataLength >= pstOutput->llDataLength)  return 0;
+
+  if (!pstOutput->iSeekable) {
+    errno = ESPIPE;
+    return -1;
+  }
+
+  if (pstOutput->pstEncoder) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  llEnd = pstOutput->iHeaderLength + llDataLength;
+
+  /* A mapped file is cut to length when it is finalized. */
+  if (pstOutput->pMapping)
+    ;
+  else if (llEnd >= pstOutput->llSent)
+    pstOutput->iStaged = llEnd - pstOutput->llSent;
+  else {
+    if ((fnWriter_WaitAll(pstOutput) < 0) ||
+        (ftruncate(pstOutput->iFileDesc, pstOutput->llBase + (off_t) llEnd) < 0))
+      return -1;
+
+    /* Writing resumes part way into a block. */
+    fnWriter_Cached(pstOutput);
+
+    pstOutput->iStaged = 0;
+    pstOutput->llSent  = llEnd;
+  }
+
+  pstOutput->llDataLength = llDataLength;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Unmap(struct AudioOutput_t *pstOutput, int iPadding)
+/*
+ * Finish a mapped file: pad it, fill in the header, write the last pages
+ * out and cut the file to the length of what was written.
+ *
+ *   Input:  pstOutput - The output file.
+ *           iPadding  - Bytes of padding the format requires.
+ *
+ * Returns:  -1 on error (see errno), 0 otherwise.
+ */
+/*========================================================================*/
+{
+  u_char *pMapping;				/* The mapping               */
+  int    iResult;				/* Result of the last step   */
+
+
+  memset(pstOutput->pMapping + pstOutput->iHeaderLength + pstOutput->llDataLength, 0, iPadding);
+
+  pstOutput->llFileLength = pstOutput->iHeaderLength + pstOutput->llDataLength + iPadding;
+
+  if ((pstOutput->pstWriter->iFlags & kiWriter_Lengths) &&
+      (pstOutput->pstWriter->pfnHeader(pstOutput, pstOutput->pMapping, pstOutput->llDataLength) < 0)) {
+    errno = EFBIG;
+    return -1;
+  }
+
+  /* Only now is it known where the file ends, so it can't be cut back
+   * beforehand; and cutting it while mapped would leave the pages beyond
+   * the end in the mapping.
+   */
+  pMapping = pstOutput->pMapping;
+  pstOutput->pMapping = NULL;
+
+  iResult = (((pstOutput->iPolicy & kiWriter_SyncTrack) || pstOutput->llSyncInterval) &&
+             (msync(pMapping + pstOutput->iMapSynced, pstOutput->iMapLength - pstOutput->iMapSynced,
+                    MS_SYNC) < 0)) ? -1 : 0;
+
+  if (munmap(pMapping, pstOutput->iMapLength) < 0)  iResult = -1;
+
+  if ((iResult < 0) ||
+      (ftruncate(pstOutput->iFileDesc, pstOutput->llBase + (off_t) pstOutput->llFileLength) < 0))
+    return -1;
+
+  if (((pstOutput->iPolicy & kiWriter_SyncTrack) || pstOutput->llSyncInterval) &&
+      (fdatasync(pstOutput->iFileDesc) < 0))
+    return -1;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+int
+fnWriter_Finalize(struct AudioOutput_t *pstOutput)
+/*
+ * Finish the output file: pad the audio out to the format's alignment,
+ * write out whatever is staged, cut off any blocks reserved but not used,
+ * and rewrite the header with the lengths now known.  The file is synced
+ * if the policy asks for it, but not closed.
+ *
+ *   Input:  pstOutput - The output file.
+ *
+ * Returns:  -1 on error (see errno; EFBIG if the audio is too long for the
+ *           format), 0 otherwise.
+ *
+ *           pstOutput - llFileLength is set.
+ */
+/*========================================================================*/
+{
+  u_char aHeader[kiWriter_MaximumHeader];	/* The header                */
+  u_char *pPadding;				/* Silence, to pad with      */
+  int    iPadding;				/* Bytes of padding          */
+
+
+  memset(aHeader, 0, sizeof(aHeader));
+
+  /* A pipe's header can't be taken back, so should the audio fall short of
+   * the length it promised, make up the difference with silence.  The
+   * encoder is given whole frames of it.
+   */
+  while ((pstOutput->llExpectedLength != kllWriter_Unknown) &&
+         (pstOutput->llDataLength < pstOutput->llExpectedLength)) {
+    iPadding = (pstOutput->llExpectedLength - pstOutput->llDataLength > sizeof(aHeader)) ?
+               (int) sizeof(aHeader) : (int) (pstOutput->llExpectedLength - pstOutput->llDataLength);
+
+    if (pstOutput->pstEncoder) {
+      iPadding -= iPadding % pstOutput->iFrameLength;
+      pPadding  = aHeader;
+
+      if (fnWriter_Write(pstOutput, &pPadding, iPadding) < 0)  return -1;
+      continue;
+    }
+
+    if (fnWriter_Stage(pstOutput, aHeader, iPadding) < 0)  return -1;
+
+    pstOutput->llDataLength += iPadding;
+  }
+
+  if (pstOutput->pstEncoder &&
+      (fnFlac_Finish(pstOutput->pstEncoder, fnWriter_Emit, pstOutput) < 0))
+    return -1;
+
+  iPadding = (pstOutput->pstWriter->iAlignment -
+              pstOutput->llDataLength % pstOutput->pstWriter->iAlignment) %
+             pstOutput->pstWriter->iAlignment;
+
+  if (pstOutput->pMapping)
+    return fnWriter_Unmap(pstOutput, iPadding);
+
+  if ((fnWriter_Stage(pstOutput, aHeader, iPadding) < 0) || (fnWriter_Drain(pstOutput) < 0))
+    return -1;
+
+  /* A ring's readers are told the track is complete. */
+  if (pstOutput->pstRing) {
+    if (fnRing_Publish(pstOutput->pstRing, 0, kiRing_TrackEnd) < 0)  return -1;
+
+    pstOutput->pstRing = NULL;
+  }
+
+  pstOutput->llFileLength = pstOutput->iHeaderLength + iPadding +
+                            (pstOutput->pstEncoder ? pstOutput->llEncodedLength :
+                                                     pstOutput->llDataLength);
+
+  if (pstOutput->iRegular &&
+      (ftruncate(pstOutput->iFileDesc, pstOutput->llBase + (off_t) pstOutput->llFileLength) < 0))
+    return -1;
+
+  if ((pstOutput->pstWriter->iFlags & kiWriter_Lengths) && pstOutput->iSeekable) {
+    if (pstOutput->pstWriter->pfnHeader(pstOutput, aHeader, pstOutput->llDataLength) < 0) {
+      errno = EFBIG;
+      return -1;
+    }
+
+    fnWriter_Cached(pstOutput);
+
+    if (pwrite(pstOutput->iFileDesc, aHeader, pstOutput->iHeaderLength, pstOutput->llBase) !=
+        pstOutput->iHeaderLength)
+      return -1;
+  }
+
+  if (((pstOutput->iPolicy & kiWriter_SyncTrack) || pstOutput->llSyncInterval) &&
+      (fdatasync(pstOutput->iFileDesc) < 0))
+    return -1;
+
+  return 0;
+}
+
+
+/*========================================================================*/
+void
+fnWriter_Dispose(struct AudioOutput_t *pstOutput)
+/*
+ * Free anything the output allocated.  The file is not closed.
+ */
+/*========================================================================*/
+{
+  /* The slots can't be freed from under the kernel, so every write is
+   * waited for, failed or not.  Should the io_uring itself have failed,
+   * writes may still hold them; they are left allocated.
+   */
+  fnWriter_WaitAll(pstOutput);
+
+#ifdef __linux__
+  if (pstOutput->pstUring && (fnWriter_UringDrain(pstOutput) < 0))
+    pstOutput->pStage = NULL;
+#endif
+
+  /* A track abandoned part way is ended, so that readers don't wait on it. */
+  if (pstOutput->pstRing)
+    fnRing_Publish(pstOutput->pstRing, 0, kiRing_TrackEnd | kiRing_TrackFailed);
+
+  if (pstOutput->pMapping)
+    munmap(pstOutput->pMapping, pstOutput->iMapLength);
+
+  if (pstOutput->pstEncoder) {
+    fnFlac_Dispose(pstOutput->pstEncoder);
+    free(pstOutput->pstEncoder);
+  }
+
+  if (pstOutput->pstRequests)
+    free(pstOutput->pstRequests);
+
+#ifdef __linux__
+  fnWriter_UringClose(pstOutput);
+#endif
+
+  if (pstOutput->pStage)
+    free(pstOutput->pStage);
+
+  pstOutput->pMapping    = NULL;
+  pstOutput->pstEncoder  = NULL;
+  pstOutput->pstRequests = NULL;
+  pstOutput->pStage      = NULL;
+  pstOutput->pstRing     = NULL;
+  pstOutput->pstSink     = NULL;
+}
+
+/* EOF */
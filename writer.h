@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 1998 Robert Mooney
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * DAEX     - The Digital Audio EXtractor
+ *
+ * writer.h - Header for the output file writers.
+ *
+ * $Id$
+ */
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <aio.h>
+
+#ifdef __linux__
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Writer capabilities (struct AudioWriter_t's iFlags) */
+#define kiWriter_Lengths	0x01	/* The header holds the audio's length, and */
+					/* is rewritten once that is known          */
+#define kiWriter_Encoded	0x02	/* The audio is compressed, so the file     */
+					/* can't be cut back to a length of it      */
+#define kiWriter_Image		0x04	/* One image of the whole disc, described   */
+					/* by a cue sheet, rather than a file each  */
+
+#define kiWriter_MaximumHeader	128	/* Longest header any writer produces       */
+
+#define kllWriter_Unknown	(~(u_int64_t) 0) /* Length not yet known            */
+
+/* Output policies (struct AudioOutput_t's iPolicy) */
+#define kiWriter_Uncached	0x01	/* Bypass the page cache (O_DIRECT)         */
+#define kiWriter_SyncTrack	0x02	/* fdatasync() once the track is complete   */
+#define kiWriter_Async		0x04	/* Queue writes (io_uring, or aio_write())  */
+#define kiWriter_Mapped		0x08	/* Read the audio into the mapped file      */
+
+#define kiWriter_PipeSlot	(64 * 1024)	/* Audio sent to a pipe at a time     */
+#define kiWriter_FileSlot	(1024 * 1024)	/* Audio written to a file at a time  */
+#define kiWriter_PipeLength	(1024 * 1024)	/* Pipe buffer asked for, if possible */
+#define kiWriter_AsyncSlots	4		/* File slots, when asynchronous      */
+#define kiWriter_MapChunk	(8 * 1024 * 1024) /* Mapped audio msync()ed at a time */
+
+struct AudioOutput_t;
+struct WriterUring_t;
+struct FlacEncoder_t;
+struct SharedRing_t;
+struct NetSink_t;
+
+#ifdef __linux__
+/* An io_uring, for asynchronous output on Linux.  There is no liburing to
+ * lean on, so the rings are set up and mapped here.  The slots are
+ * registered with the kernel as one fixed buffer, and the file as fixed
+ * file 0, so neither is looked up again for each write; where either
+ * can't be registered, the write is made without it.  fnWriter_Submit()
+ * only queues a slot's write: the next fnWriter_Wait() submits it and
+ * reaps every completion then waiting, in the one io_uring_enter().
+ */
+struct WriterUring_t {
+  int      iRingDesc;               /* The ring                                    */
+  u_char   *pSubmissions,           /* Submission ring, mapped                     */
+           *pCompletions;           /* Completion ring, mapped (may be the same)   */
+  size_t   iSubmissionsLength,      /* Bytes mapped for each                       */
+           iCompletionsLength;
+  struct io_uring_sqe *pstEntries;  /* Submission queue entries, mapped           */
+  size_t   iEntriesLength;          /* ... bytes mapped                            */
+  u_int32_t *plSQTail,              /* Submission ring tail and index array        */
+           *plSQArray,
+           lSQMask,                 /* ... entries, less one                       */
+           *plCQHead,               /* Completion ring head and tail               */
+           *plCQTail,
+           lCQMask;                 /* ... entries, less one                       */
+  struct io_uring_cqe *pstCompletions; /* Completion queue entries                */
+  int      iFixedFile,              /* The file is registered (flag)               */
+           iFixedBuffer,            /* The slots are registered (flag)             */
+           iQueued;                 /* Writes queued, not yet submitted            */
+
+  struct iovec astSlots[kiWriter_AsyncSlots]; /* Each slot's write, in flight if   */
+                                    /* iov_len is not 0                            */
+  off_t    allOffsets[kiWriter_AsyncSlots]; /* ... where it goes in the file       */
+  int      aiDone[kiWriter_AsyncSlots],     /* ... it has completed (flag)         */
+           aiResults[kiWriter_AsyncSlots];  /* ... and its result                  */
+};
+#endif
+
+/* An output file format.  Open checks that the format can hold the samples
+ * and picks the encoder which puts them in the file's byte order; Header
+ * lays out the header for a given length of audio.  Everything else, from
+ * writing the samples to padding and rewriting the header at the end, is
+ * common to all writers.
+ */
+struct AudioWriter_t {
+  char  *szName;                    /* Name given to -w                            */
+  char  *szExtension;               /* Filename extension, without the dot         */
+  int   iFlags;                     /* Capabilities (kiWriter_*)                   */
+  int   iAlignment;                 /* Audio is padded to a multiple of this       */
+
+  int   (*pfnOpen)(struct AudioOutput_t *pstOutput);
+  int   (*pfnHeader)(struct AudioOutput_t *pstOutput, u_char *pHeader, u_int64_t llDataLength);
+};
+
+/* An output file, open for writing. */
+struct AudioOutput_t {
+  struct AudioWriter_t  *pstWriter; /* The file's format                           */
+  struct SampleFormat_t *pstFormat; /* The samples' format                         */
+  int   iFileDesc;                  /* The file                                    */
+  int   iSeekable,                  /* The header may be rewritten (flag)          */
+        iRegular,                   /* A regular file, which may be truncated      */
+        iDirect,                    /* O_DIRECT is set on the file (flag)          */
+        iPolicy;                    /* Output policies (kiWriter_*)                */
+  off_t llBase;                     /* Offset of the header in the file            */
+  int   iFrameLength;               /* Bytes per frame                             */
+  int   iHeaderLength;              /* Bytes before the audio                      */
+  u_int64_t llDataLength,           /* Bytes of audio written                      */
+            llExpectedLength,       /* Bytes of audio promised by the header       */
+            llFileLength,           /* Bytes in the file, once finalized           */
+            llSent,                 /* Bytes handed to the file, header included   */
+            llSynced,               /* ... as of the last fdatasync()              */
+            llSyncInterval;         /* fdatasync() after this many bytes, or 0     */
+
+  u_char *pStage;                   /* Staged header and audio, page aligned       */
+  struct aiocb *pstRequests;        /* Each slot's write, when asynchronous        */
+  struct WriterUring_t *pstUring;   /* ... or the ring they go through, on Linux   */
+  size_t iSlotLength,               /* Bytes per slot                              */
+         iStaged;                   /* Bytes staged in the current slot            */
+  int    iSlots,                    /* Slots in pStage                             */
+         iSlot,                     /* Current slot                                */
+         iSplice;                   /* Slots are sent with vmsplice() (flag)       */
+
+  u_char *pMapping;                 /* The file, when mapped, or NULL              */
+  size_t iMapLength,                /* Bytes mapped                                */
+         iMapSynced;                /* Bytes of the mapping msync()ed              */
+
+  void  (*pfnEncode)(u_char *pSamples, size_t iLength); /* To file order, or NULL  */
+
+  struct FlacEncoder_t *pstEncoder; /* Compresses the audio, or NULL               */
+  u_int64_t llEncodedLength;        /* Bytes of compressed audio written           */
+
+  struct SharedRing_t *pstRing;     /* Published to this ring, rather than the     */
+                                    /* file, or NULL                               */
+  struct NetSink_t *pstSink;        /* Sent to daex-recv, rather than the file,    */
+                                    /* or NULL                                     */
+};
+
+/* Writer function prototypes. */
+struct AudioWriter_t *fnWriter_Find(char *szName);
+void  fnWriter_List(FILE *pstStream);
+int   fnWriter_Open(struct AudioOutput_t *pstOutput, struct AudioWriter_t *pstWriter,
+                    int iFileDesc, struct SampleFormat_t *pstFormat,
+                    u_int64_t llExpectedLength);
+void  fnWriter_Policy(struct AudioOutput_t *pstOutput, int iPolicy, u_int64_t llSyncInterval);
+int   fnWriter_Reserve(struct AudioOutput_t *pstOutput, u_int64_t llDataLength);
+int   fnWriter_Map(struct AudioOutput_t *pstOutput, u_int64_t llDataLength);
+int   fnWriter_Ring(struct AudioOutput_t *pstOutput, struct SharedRing_t *pstRing, int iTrack);
+void  fnWriter_Sink(struct AudioOutput_t *pstOutput, struct NetSink_t *pstSink);
+u_char *fnWriter_Buffer(struct AudioOutput_t *pstOutput);
+int   fnWriter_Write(struct AudioOutput_t *pstOutput, u_char **ppSamples, size_t iLength);
+int   fnWriter_Truncate(struct AudioOutput_t *pstOutput, u_int64_t llDataLength);
+int   fnWriter_Finalize(struct AudioOutput_t *pstOutput);
+void  fnWriter_Dispose(struct AudioOutput_t *pstOutput);
+
+/* EOF */